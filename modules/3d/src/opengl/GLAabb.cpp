@@ -21,6 +21,7 @@
     @file GLAabb.cpp
 */
 
+#include <AabbBatch.hpp>
 #include <GLAabb.hpp>
 
 GLAabb::GLAabb() : valid_(false)
@@ -58,40 +59,16 @@ void GLAabb::set(const QVector3D &min, const QVector3D &max)
 
 void GLAabb::set(const std::vector<float> &xyz)
 {
-    float min_x, min_y, min_z;
-    float max_x, max_y, max_z;
+    float min[3] = {0.F, 0.F, 0.F};
+    float max[3] = {0.F, 0.F, 0.F};
 
     size_t n = xyz.size() / 3;
     if (n > 0)
     {
-        min_x = max_x = xyz[0];
-        min_y = max_y = xyz[1];
-        min_z = max_z = xyz[2];
-
-        for (size_t i = 1; i < n; i++)
-        {
-            if (xyz[3 * i + 0] < min_x)
-                min_x = xyz[3 * i + 0];
-            else if (xyz[3 * i + 0] > max_x)
-                max_x = xyz[3 * i + 0];
-            if (xyz[3 * i + 1] < min_y)
-                min_y = xyz[3 * i + 1];
-            else if (xyz[3 * i + 1] > max_y)
-                max_y = xyz[3 * i + 1];
-            if (xyz[3 * i + 2] < min_z)
-                min_z = xyz[3 * i + 2];
-            else if (xyz[3 * i + 2] > max_z)
-                max_z = xyz[3 * i + 2];
-        }
-    }
-    else
-    {
-        min_x = max_x = 0.F;
-        min_y = max_y = 0.F;
-        min_z = max_z = 0.F;
+        aabbMinMax3(min, max, xyz.data(), n);
     }
 
-    set(min_x, min_y, min_z, max_x, max_y, max_z);
+    set(min[0], min[1], min[2], max[0], max[1], max[2]);
 }
 
 void GLAabb::extend(const GLAabb &box)
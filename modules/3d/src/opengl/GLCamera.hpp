@@ -90,6 +90,9 @@ public:
         return modelViewProjectionInv_;
     }
 
+    // Frustrum, six planes for aabbFrustum()
+    const std::vector<float> &getFrustrum() const { return frustrumPlanes_; }
+
 protected:
     // Camera
     QVector3D eye_;
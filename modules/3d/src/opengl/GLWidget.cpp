@@ -21,6 +21,7 @@
     @file GLWidget.cpp
 */
 
+#include <AabbBatch.hpp>
 #include <GLMesh.hpp>
 #include <GLWidget.hpp>
 #include <MeshNode.hpp>
@@ -100,12 +101,29 @@ bool GLWidget::isSelected() const
 
 void GLWidget::validateNodes()
 {
+    size_t n = nodes_.size();
+
     aabb_.invalidate();
+    for (size_t k = 0; k < 3; k++)
+    {
+        nodesMin_[k].resize(n);
+        nodesMax_[k].resize(n);
+    }
+    nodesFrustum_.resize(n);
 
-    for (auto &node : nodes_)
+    for (size_t i = 0; i < n; i++)
     {
-        node->validate();
-        aabb_.extend(node->getAabb());
+        nodes_[i]->validate();
+
+        const GLAabb &box = nodes_[i]->getAabb();
+        aabb_.extend(box);
+
+        nodesMin_[0][i] = box.getMin().x();
+        nodesMin_[1][i] = box.getMin().y();
+        nodesMin_[2][i] = box.getMin().z();
+        nodesMax_[0][i] = box.getMax().x();
+        nodesMax_[1][i] = box.getMax().y();
+        nodesMax_[2][i] = box.getMax().z();
     }
 }
 
@@ -137,10 +155,25 @@ void GLWidget::paintGL()
     glMatrixMode(GL_MODELVIEW);
     glLoadMatrixf(camera_.getModelView().data());
 
-    // Render nodes
-    for (auto &node : nodes_)
+    // Render nodes which are not outside of the camera frustum
+    const float *min[3] = {nodesMin_[0].data(),
+                           nodesMin_[1].data(),
+                           nodesMin_[2].data()};
+    const float *max[3] = {nodesMax_[0].data(),
+                           nodesMax_[1].data(),
+                           nodesMax_[2].data()};
+    aabbFrustum(nodesFrustum_.data(),
+                camera_.getFrustrum().data(),
+                min,
+                max,
+                nodes_.size());
+
+    for (size_t i = 0; i < nodes_.size(); i++)
     {
-        node->render();
+        if (nodesFrustum_[i] != AABB_FRUSTUM_OUTSIDE)
+        {
+            nodes_[i]->render();
+        }
     }
 }
 
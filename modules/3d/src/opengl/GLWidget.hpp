@@ -34,7 +34,12 @@
 
 class Viewer;
 
-/** OpenGL Widget. */
+/** OpenGL Widget.
+
+    Bounds of nodes are cached in columns by validateNodes(), so that each
+    frame tests all nodes against the camera frustum in one batch and
+    skips rendering of nodes outside of it.
+*/
 class GLWidget : public QOpenGLWidget, protected QOpenGLFunctions
 {
     Q_OBJECT
@@ -66,6 +71,11 @@ protected:
     std::vector<std::shared_ptr<GLNode>> nodes_;
     GLAabb aabb_;
 
+    // Bounds of nodes, columns of x, y and z
+    std::vector<float> nodesMin_[3];
+    std::vector<float> nodesMax_[3];
+    std::vector<uint8_t> nodesFrustum_;
+
     GLCamera camera_;
 
     void initializeGLWidget();
@@ -38,10 +38,12 @@ void Explorer::updateProject(const Project &project)
     // Header
     setColumnCount(COLUMN_LAST);
     QStringList labels;
-    labels << tr("File name") << tr("Timestamp") << tr("Path");
+    labels << tr("File name") << tr("Timestamp") << tr("Points")
+           << tr("Format") << tr("CRS") << tr("Path");
     setHeaderLabels(labels);
 
-    // Content
+    // Content, header summaries are taken from the project catalog
+    const ProjectCatalog &catalog = project.getCatalog();
     QList<QTreeWidgetItem *> items;
     for (size_t i = 0; i < project.size(); i++)
     {
@@ -50,6 +52,33 @@ void Explorer::updateProject(const Project &project)
         item->setText(COLUMN_FILE_NAME, QString::fromStdString(file.fileName));
         item->setText(COLUMN_TIMESTAMP, QString::fromStdString(file.timestamp));
         item->setText(COLUMN_PATH, QString::fromStdString(file.path));
+
+        if (i < catalog.size() && catalog.getEntry(i).valid())
+        {
+            const ProjectCatalog::Entry &entry = catalog.getEntry(i);
+            item->setData(COLUMN_POINTS,
+                          Qt::DisplayRole,
+                          QVariant(static_cast<qulonglong>(
+                              entry.number_of_point_records)));
+            uint versionMajor = entry.version_major;
+            uint versionMinor = entry.version_minor;
+            uint pointFormat = entry.point_data_record_format;
+            QString format = QString("LAS %1.%2 / %3")
+                                 .arg(versionMajor)
+                                 .arg(versionMinor)
+                                 .arg(pointFormat);
+            if (entry.compressed)
+            {
+                format += " LAZ";
+            }
+            item->setText(COLUMN_FORMAT, format);
+            item->setText(COLUMN_CRS, QString::fromStdString(entry.crs()));
+        }
+        else if (i < catalog.size())
+        {
+            item->setToolTip(COLUMN_FILE_NAME,
+                             QString::fromStdString(catalog.getEntry(i).error));
+        }
     }
 
     setColumnHidden(COLUMN_PATH, true);
@@ -37,6 +37,9 @@ public:
     {
         COLUMN_FILE_NAME,
         COLUMN_TIMESTAMP,
+        COLUMN_POINTS,
+        COLUMN_FORMAT,
+        COLUMN_CRS,
         COLUMN_PATH,
         COLUMN_LAST,
     };
@@ -0,0 +1,36 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file Cpu.hpp
+*/
+
+#ifndef CPU_HPP
+#define CPU_HPP
+
+/** Check if the processor supports SSE 4.2 instructions. */
+bool cpuSupportsSse42();
+
+/** Check if the processor supports AVX2 instructions. */
+bool cpuSupportsAvx2();
+
+/** Check if the processor supports AVX-512 foundation instructions. */
+bool cpuSupportsAvx512();
+
+#endif /* CPU_HPP */
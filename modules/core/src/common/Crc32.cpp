@@ -0,0 +1,209 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file Crc32.cpp
+*/
+
+#include <Cpu.hpp>
+#include <Crc32.hpp>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#endif
+
+/** Reflected CRC-32C polynomial. */
+static const uint32_t CRC32C_POLYNOMIAL = 0x82F63B78U;
+
+/** Lookup tables for software slicing-by-8. */
+class Crc32Table
+{
+public:
+    uint32_t table[8][256];
+
+    Crc32Table()
+    {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t crc = i;
+            for (int k = 0; k < 8; k++)
+            {
+                crc = (crc >> 1) ^ (CRC32C_POLYNOMIAL & (0U - (crc & 1U)));
+            }
+            table[0][i] = crc;
+        }
+
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            for (size_t k = 1; k < 8; k++)
+            {
+                uint32_t crc = table[k - 1][i];
+                table[k][i] = (crc >> 8) ^ table[0][crc & 0xFFU];
+            }
+        }
+    }
+};
+
+static const Crc32Table crc32cTable;
+
+static uint32_t crc32cSoftware(uint32_t crc, const uint8_t *buffer, size_t n)
+{
+    const uint32_t(*t)[256] = crc32cTable.table;
+
+    while (n > 0 && (reinterpret_cast<uintptr_t>(buffer) & 7U) != 0)
+    {
+        crc = (crc >> 8) ^ t[0][(crc ^ *buffer++) & 0xFFU];
+        n--;
+    }
+
+    while (n >= 8)
+    {
+        uint32_t lo = crc ^ (static_cast<uint32_t>(buffer[0]) |
+                             (static_cast<uint32_t>(buffer[1]) << 8) |
+                             (static_cast<uint32_t>(buffer[2]) << 16) |
+                             (static_cast<uint32_t>(buffer[3]) << 24));
+        crc = t[7][lo & 0xFFU] ^ t[6][(lo >> 8) & 0xFFU] ^
+              t[5][(lo >> 16) & 0xFFU] ^ t[4][lo >> 24] ^ t[3][buffer[4]] ^
+              t[2][buffer[5]] ^ t[1][buffer[6]] ^ t[0][buffer[7]];
+        buffer += 8;
+        n -= 8;
+    }
+
+    while (n > 0)
+    {
+        crc = (crc >> 8) ^ t[0][(crc ^ *buffer++) & 0xFFU];
+        n--;
+    }
+
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2"))) static uint32_t
+crc32cHardware(uint32_t crc, const uint8_t *buffer, size_t n)
+{
+    uint64_t crc64 = crc;
+
+    while (n >= 8)
+    {
+        uint64_t v;
+        std::memcpy(&v, buffer, sizeof(v));
+        crc64 = _mm_crc32_u64(crc64, v);
+        buffer += 8;
+        n -= 8;
+    }
+
+    crc = static_cast<uint32_t>(crc64);
+    while (n > 0)
+    {
+        crc = _mm_crc32_u8(crc, *buffer++);
+        n--;
+    }
+
+    return crc;
+}
+#endif
+
+uint32_t crc32c(uint32_t crc, const uint8_t *buffer, size_t nbyte)
+{
+    crc = ~crc;
+
+#if defined(__x86_64__)
+    if (cpuSupportsSse42())
+    {
+        return ~crc32cHardware(crc, buffer, nbyte);
+    }
+#endif
+
+    return ~crc32cSoftware(crc, buffer, nbyte);
+}
+
+static uint32_t crc32cMatrixTimes(const uint32_t *mat, uint32_t vec)
+{
+    uint32_t sum = 0;
+
+    while (vec)
+    {
+        if (vec & 1U)
+        {
+            sum ^= *mat;
+        }
+        vec >>= 1;
+        mat++;
+    }
+
+    return sum;
+}
+
+static void crc32cMatrixSquare(uint32_t *square, const uint32_t *mat)
+{
+    for (size_t i = 0; i < 32; i++)
+    {
+        square[i] = crc32cMatrixTimes(mat, mat[i]);
+    }
+}
+
+uint32_t crc32cCombine(uint32_t crc1, uint32_t crc2, uint64_t nbyte2)
+{
+    uint32_t even[32];
+    uint32_t odd[32];
+
+    if (nbyte2 == 0)
+    {
+        return crc1;
+    }
+
+    // Operator for one zero bit
+    odd[0] = CRC32C_POLYNOMIAL;
+    uint32_t row = 1;
+    for (size_t i = 1; i < 32; i++)
+    {
+        odd[i] = row;
+        row <<= 1;
+    }
+
+    // Operators for two and four zero bits
+    crc32cMatrixSquare(even, odd);
+    crc32cMatrixSquare(odd, even);
+
+    // Apply nbyte2 zero bytes to crc1
+    do
+    {
+        crc32cMatrixSquare(even, odd);
+        if (nbyte2 & 1U)
+        {
+            crc1 = crc32cMatrixTimes(even, crc1);
+        }
+        nbyte2 >>= 1;
+
+        if (nbyte2 == 0)
+        {
+            break;
+        }
+
+        crc32cMatrixSquare(odd, even);
+        if (nbyte2 & 1U)
+        {
+            crc1 = crc32cMatrixTimes(odd, crc1);
+        }
+        nbyte2 >>= 1;
+    } while (nbyte2 != 0);
+
+    return crc1 ^ crc2;
+}
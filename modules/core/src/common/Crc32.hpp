@@ -0,0 +1,46 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file Crc32.hpp
+*/
+
+#ifndef CRC32_HPP
+#define CRC32_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/** Update CRC-32C (Castagnoli) checksum with data buffer.
+
+    The initial checksum is 0. The checksum of data split into several
+    buffers is computed by passing the previous result to the next call.
+    SSE 4.2 instructions are used when the processor supports them.
+*/
+uint32_t crc32c(uint32_t crc, const uint8_t *buffer, size_t nbyte);
+
+/** Combine CRC-32C checksums of two consecutive data buffers.
+
+    @param crc1 Checksum of the first buffer.
+    @param crc2 Checksum of the second buffer.
+    @param nbyte2 Length of the second buffer.
+*/
+uint32_t crc32cCombine(uint32_t crc1, uint32_t crc2, uint64_t nbyte2);
+
+#endif /* CRC32_HPP */
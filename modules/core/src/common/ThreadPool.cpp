@@ -0,0 +1,168 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file ThreadPool.cpp
+*/
+
+#include <ThreadPool.hpp>
+
+thread_local bool ThreadPool_running = false;
+
+ThreadPool::ThreadPool(size_t nthreads)
+    : fn_(nullptr),
+      n_(0),
+      next_(0),
+      active_(0),
+      generation_(0),
+      stop_(false)
+{
+    if (nthreads == 0)
+    {
+        nthreads = std::thread::hardware_concurrency();
+    }
+
+    // The calling thread is one of the threads
+    for (size_t i = 1; i < nthreads; i++)
+    {
+        threads_.push_back(std::thread(&ThreadPool::worker, this));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+
+    start_.notify_all();
+
+    for (auto &it : threads_)
+    {
+        it.join();
+    }
+}
+
+void ThreadPool::run(size_t n, const std::function<void(size_t)> &fn)
+{
+    if (threads_.empty() || n < 2 || ThreadPool_running)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            fn(i);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> runLock(runMutex_);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fn_ = &fn;
+        n_ = n;
+        next_ = 0;
+        active_ = threads_.size();
+        error_ = nullptr;
+        generation_++;
+    }
+
+    start_.notify_all();
+
+    ThreadPool_running = true;
+    work();
+    ThreadPool_running = false;
+
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return active_ == 0; });
+        fn_ = nullptr;
+        error = error_;
+        error_ = nullptr;
+    }
+
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+void ThreadPool::worker()
+{
+    uint64_t generation = 0;
+
+    ThreadPool_running = true;
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            start_.wait(lock, [&] {
+                return stop_ || generation != generation_;
+            });
+
+            if (stop_)
+            {
+                return;
+            }
+
+            generation = generation_;
+        }
+
+        work();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            active_--;
+            if (active_ == 0)
+            {
+                done_.notify_all();
+            }
+        }
+    }
+}
+
+void ThreadPool::work()
+{
+    for (;;)
+    {
+        size_t i = next_.fetch_add(1);
+        if (i >= n_)
+        {
+            return;
+        }
+
+        try
+        {
+            (*fn_)(i);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error_)
+            {
+                error_ = std::current_exception();
+            }
+
+            // Skip remaining items
+            next_ = n_;
+        }
+    }
+}
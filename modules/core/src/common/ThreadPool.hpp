@@ -0,0 +1,82 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file ThreadPool.hpp
+*/
+
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** Thread Pool.
+
+    Worker threads are created once and reused by all calls to run().
+    The calling thread takes part in the work. Nested calls from inside
+    a running job are executed serially in the calling thread.
+
+\code
+    ThreadPool pool;
+    std::vector<double> data(1000);
+    pool.run(data.size(), [&](size_t i) { data[i] = std::sqrt(i); });
+\endcode
+*/
+class ThreadPool
+{
+public:
+    explicit ThreadPool(size_t nthreads = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /** Get the number of threads including the calling thread. */
+    size_t size() const { return threads_.size() + 1; }
+
+    /** Call fn(i) for each i in [0, n) and wait for completion.
+        The first exception thrown by fn is rethrown to the caller.
+    */
+    void run(size_t n, const std::function<void(size_t)> &fn);
+
+protected:
+    std::vector<std::thread> threads_;
+    std::mutex runMutex_;
+    std::mutex mutex_;
+    std::condition_variable start_;
+    std::condition_variable done_;
+    const std::function<void(size_t)> *fn_;
+    size_t n_;
+    std::atomic<size_t> next_;
+    size_t active_;
+    uint64_t generation_;
+    bool stop_;
+    std::exception_ptr error_;
+
+    void worker();
+    void work();
+};
+
+#endif /* THREAD_POOL_HPP */
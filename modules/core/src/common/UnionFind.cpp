@@ -0,0 +1,91 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file UnionFind.cpp
+*/
+
+#include <UnionFind.hpp>
+#include <utility>
+
+UnionFind::UnionFind(size_t n)
+{
+    create(n);
+}
+
+UnionFind::~UnionFind()
+{
+}
+
+void UnionFind::create(size_t n)
+{
+    parent_ = std::vector<std::atomic<size_t>>(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        parent_[i].store(i, std::memory_order_relaxed);
+    }
+}
+
+size_t UnionFind::find(size_t x)
+{
+    while (true)
+    {
+        size_t p = parent_[x].load(std::memory_order_relaxed);
+        if (p == x)
+        {
+            return x;
+        }
+
+        // Path halving, a failed exchange only means that other thread
+        // already shortened the path
+        size_t g = parent_[p].load(std::memory_order_relaxed);
+        if (g != p)
+        {
+            parent_[x].compare_exchange_weak(p, g, std::memory_order_relaxed);
+        }
+        x = g;
+    }
+}
+
+void UnionFind::unite(size_t a, size_t b)
+{
+    while (true)
+    {
+        a = find(a);
+        b = find(b);
+        if (a == b)
+        {
+            return;
+        }
+
+        if (a < b)
+        {
+            std::swap(a, b);
+        }
+
+        // Root a may have been linked by other thread meanwhile
+        size_t expected = a;
+        if (parent_[a].compare_exchange_strong(expected,
+                                               b,
+                                               std::memory_order_relaxed))
+        {
+            return;
+        }
+    }
+}
@@ -0,0 +1,62 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file UnionFind.hpp
+*/
+
+#ifndef UNION_FIND_HPP
+#define UNION_FIND_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/** Union Find.
+
+    Disjoint sets of elements [0, n) which may be joined concurrently
+    from many threads without locks. Parents are atomic, roots are
+    linked by compare and swap and paths are halved during searches.
+    The larger root is always linked below the smaller one, so the root
+    of each set is its smallest element regardless of the order of
+    unions.
+*/
+class UnionFind
+{
+public:
+    explicit UnionFind(size_t n = 0);
+    ~UnionFind();
+    UnionFind(const UnionFind &) = delete;
+    UnionFind &operator=(const UnionFind &) = delete;
+
+    void create(size_t n);
+
+    size_t size() const { return parent_.size(); }
+
+    /** Get the smallest element of the set of element x. */
+    size_t find(size_t x);
+
+    /** Join the sets of elements a and b. */
+    void unite(size_t a, size_t b);
+
+protected:
+    std::vector<std::atomic<size_t>> parent_;
+};
+
+#endif /* UNION_FIND_HPP */
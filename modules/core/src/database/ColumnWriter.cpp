@@ -0,0 +1,173 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file ColumnWriter.cpp
+*/
+
+#include <ChunkFile.hpp>
+#include <ColumnWriter.hpp>
+#include <Crc32.hpp>
+#include <Error.hpp>
+#include <cstdio>
+#include <cstring>
+
+/** Number of bytes copied at once. */
+static const size_t COLUMN_WRITER_BLOCK_SIZE = 1048576;
+
+ColumnWriter::ColumnWriter() : type_(0), stride_(0), npoints_(0)
+{
+}
+
+ColumnWriter::~ColumnWriter()
+{
+}
+
+void ColumnWriter::create(const Database &db, uint32_t type, size_t stride)
+{
+    if (!db.isIndexed())
+    {
+        THROW("Columns can be written only to spatial index database");
+    }
+
+    path_ = db.path();
+    tmpPath_ = path_ + ".column";
+    type_ = type;
+    stride_ = stride;
+    npoints_ = db.getPointSize();
+
+    // Tiles write at any position
+    file_.open(tmpPath_, "w+");
+    if (npoints_ > 0)
+    {
+        const uint8_t zero = 0;
+        file_.seek((npoints_ * stride_) - 1);
+        file_.write(&zero, 1);
+    }
+}
+
+void ColumnWriter::write(const DatabaseCell &cell,
+                         const std::vector<size_t> &points,
+                         const uint8_t *values)
+{
+    std::vector<uint8_t> buffer;
+    size_t i = 0;
+
+    // Consecutive records are written at once
+    while (i < points.size())
+    {
+        uint64_t from = cell.record[points[i]];
+        size_t n = 1;
+        while (i + n < points.size() &&
+               cell.record[points[i + n]] == from + n)
+        {
+            n++;
+        }
+
+        buffer.resize(n * stride_);
+        for (size_t k = 0; k < n; k++)
+        {
+            std::memcpy(&buffer[k * stride_],
+                        values + (points[i + k] * stride_),
+                        stride_);
+        }
+
+        file_.write(buffer.data(), buffer.size(), from * stride_);
+        i += n;
+    }
+}
+
+void ColumnWriter::close()
+{
+    close(0, Json());
+}
+
+void ColumnWriter::close(uint32_t metadataType, const Json &metadata)
+{
+    file_.close();
+
+    // Mapped, so columns of the same type can be found
+    ChunkFile output;
+    output.open(path_, "r+m");
+    size_t id = Database::findColumn(output, type_, stride_, npoints_);
+    bool replace = id < output.getEntrySize();
+    output.seekEnd();
+
+    // Checksum is set when all data are written
+    ChunkFile::Chunk c;
+    c.type = type_;
+    c.major_version = 1;
+    c.minor_version = 0;
+    c.header_lenght = output.alignedHeaderLength();
+    c.codec = Compression::CODEC_NONE;
+    c.flags = ChunkFile::CHUNK_FLAG_CHECKSUM;
+    c.stride = static_cast<uint16_t>(stride_);
+    c.checksum = 0;
+    c.data_length = npoints_ * stride_;
+    c.total_length = c.header_lenght + c.data_length;
+
+    uint64_t offset = output.offset();
+    output.write(c);
+
+    std::vector<uint8_t> buffer(COLUMN_WRITER_BLOCK_SIZE);
+
+    File tmp_file;
+    tmp_file.open(tmpPath_, "r");
+    for (uint64_t i = 0; i < c.data_length; i += buffer.size())
+    {
+        size_t n = buffer.size();
+        if (c.data_length - i < n)
+        {
+            n = static_cast<size_t>(c.data_length - i);
+        }
+
+        tmp_file.read(buffer.data(), n);
+        c.checksum = crc32c(c.checksum, buffer.data(), n);
+        output.write(buffer.data(), n);
+    }
+    tmp_file.close();
+    (void)std::remove(tmpPath_.c_str());
+
+    output.seek(offset);
+    output.write(c);
+    output.seek(offset + c.total_length);
+
+    // Column of the same type and size from an earlier run is replaced
+    // in the directory only when the new data are complete, its old data
+    // stay unused until the database is compacted
+    if (replace)
+    {
+        output.replaceEntry(id);
+    }
+
+    // Metadata type 0 means no metadata
+    if (metadataType != 0)
+    {
+        size_t metadataId = output.findEntry(metadataType);
+        bool replaceMetadata = metadataId < output.getEntrySize();
+        output.writeJson(metadataType, metadata);
+        if (replaceMetadata)
+        {
+            output.replaceEntry(metadataId);
+        }
+    }
+
+    output.writeDirectory();
+    output.close();
+}
@@ -0,0 +1,95 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file ColumnWriter.hpp
+*/
+
+#ifndef COLUMN_WRITER_HPP
+#define COLUMN_WRITER_HPP
+
+#include <Database.hpp>
+#include <File.hpp>
+#include <Json.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/** Column Writer.
+
+    Writes one value of fixed size for each point of a spatial index
+    database into a new column chunk. Values are written by tiles from many
+    threads into a temporary file. The chunk is written to the database
+    file by close(), the database must then be opened again to use it.
+    The chunk is always appended. A column of the same type and size
+    written by an earlier run is replaced in the chunk directory, so the
+    directory keeps one column of each type. The old data stay in the
+    file until it is compacted. An optional metadata chunk, for example
+    with inputs of the column, is written and replaced together with it.
+*/
+class ColumnWriter
+{
+public:
+    ColumnWriter();
+    ~ColumnWriter();
+
+    void create(const Database &db, uint32_t type, size_t stride);
+    void close();
+    void close(uint32_t metadataType, const Json &metadata);
+
+    void write(const DatabaseCell &cell,
+               const std::vector<size_t> &points,
+               const uint8_t *values);
+
+    template <class T>
+    void write(const DatabaseCell &cell,
+               const std::vector<size_t> &points,
+               const std::vector<T> &values);
+
+protected:
+    std::string path_;
+    std::string tmpPath_;
+    File file_;
+    uint32_t type_;
+    size_t stride_;
+    uint64_t npoints_;
+};
+
+/** Write values of selected cell points, values are indexed by cell point. */
+template <class T>
+inline void ColumnWriter::write(const DatabaseCell &cell,
+                                const std::vector<size_t> &points,
+                                const std::vector<T> &values)
+{
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+    if (sizeof(T) > 1)
+    {
+        THROW("Column of multi-byte values requires little endian host");
+    }
+#endif
+
+    if (sizeof(T) != stride_ || values.size() != cell.size())
+    {
+        THROW("Column values do not match column '" + tmpPath_ + "'");
+    }
+
+    write(cell, points, reinterpret_cast<const uint8_t *>(values.data()));
+}
+
+#endif /* COLUMN_WRITER_HPP */
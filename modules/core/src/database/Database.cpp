@@ -22,9 +22,31 @@
 */
 
 #include <Database.hpp>
+#include <Endian.hpp>
+#include <Error.hpp>
+#include <File.hpp>
+#include <SpatialIndex.hpp>
+#include <cstring>
 #include <limits>
 
+const uint32_t Database::CHUNK_ID_CLASSIFICATION = 0x50434C53U;
+const uint32_t Database::CHUNK_ID_HEIGHT = 0x50484147U;
+const uint32_t Database::CHUNK_ID_HEIGHT_METADATA = 0x50484D54U;
+const uint32_t Database::CHUNK_ID_NORMAL = 0x504E524DU;
+const uint32_t Database::CHUNK_ID_TREE = 0x50544944U;
+const uint32_t Database::CHUNK_ID_LABEL = 0x504C424CU;
+
+/** Normal column has three int16 and two uint8 values per point. */
+const size_t Database::NORMAL_SIZE = 8;
+
 Database::Database()
+    : points_(nullptr),
+      npoints_(0),
+      classification_(nullptr),
+      height_(nullptr),
+      normal_(nullptr),
+      tree_(nullptr),
+      label_(nullptr)
 {
 }
 
@@ -33,6 +55,28 @@ Database::~Database()
 }
 
 void Database::open(const std::string &path)
+{
+    // The path may be path() of this database
+    std::string openPath = path;
+    close();
+
+    // LAS files start with signature, anything else is a spatial index
+    uint8_t signature[4];
+    File::read(signature, openPath, sizeof(signature), 0);
+
+    if (std::memcmp(signature, "LASF", sizeof(signature)) == 0)
+    {
+        openLas(openPath);
+    }
+    else
+    {
+        openIndex(openPath);
+    }
+
+    path_ = openPath;
+}
+
+void Database::openLas(const std::string &path)
 {
     LasFile las_;
     las_.open(path);
@@ -85,10 +129,266 @@ void Database::open(const std::string &path)
     cells_.push_back(cell);
 }
 
+void Database::openIndex(const std::string &path)
+{
+    file_.open(path, "rm");
+
+    if (SpatialIndex::segments(file_) > 0)
+    {
+        THROW("Database '" + path +
+              "' has appended segments, compact it first");
+    }
+
+    index_.read(file_);
+
+    size_t id = file_.findEntry(SpatialIndex::CHUNK_ID_METADATA);
+    if (id == file_.getEntrySize())
+    {
+        THROW("Missing metadata in database '" + path + "'");
+    }
+
+    Json metadata;
+    file_.readJson(id, metadata);
+    SpatialIndex::readHeader(header_, metadata);
+
+    id = file_.findEntry(SpatialIndex::CHUNK_ID_POINTS);
+    if (id == file_.getEntrySize())
+    {
+        THROW("Missing points in database '" + path + "'");
+    }
+
+    ChunkFile::Chunk c;
+    points_ = file_.map(id, c);
+    if (c.stride != header_.point_data_record_length ||
+        c.data_length != header_.number_of_point_records * c.stride)
+    {
+        THROW("Points do not match metadata in database '" + path + "'");
+    }
+    npoints_ = header_.number_of_point_records;
+
+    aabb.set(header_.min_x,
+             header_.min_y,
+             header_.min_z,
+             header_.max_x,
+             header_.max_y,
+             header_.max_z);
+
+    // Results of ground classification replace LAS classification
+    id = findColumn(CHUNK_ID_CLASSIFICATION, sizeof(uint8_t));
+    if (id < file_.getEntrySize())
+    {
+        classification_ = file_.map(id, c);
+    }
+
+    // Height above ground
+    id = findColumn(CHUNK_ID_HEIGHT, sizeof(float));
+    if (id < file_.getEntrySize())
+    {
+        height_ = file_.map(id, c);
+    }
+
+    // Normals and shape features
+    id = findColumn(CHUNK_ID_NORMAL, NORMAL_SIZE);
+    if (id < file_.getEntrySize())
+    {
+        normal_ = file_.map(id, c);
+    }
+
+    // Segmented trees
+    id = findColumn(CHUNK_ID_TREE, sizeof(uint32_t));
+    if (id < file_.getEntrySize())
+    {
+        tree_ = file_.map(id, c);
+    }
+
+    // Clusters
+    id = findColumn(CHUNK_ID_LABEL, sizeof(uint32_t));
+    if (id < file_.getEntrySize())
+    {
+        label_ = file_.map(id, c);
+    }
+}
+
 void Database::close()
 {
     cells_.clear();
     // las_.close();
+
+    if (file_.isMapped())
+    {
+        file_.close();
+    }
+
+    path_.clear();
+    points_ = nullptr;
+    npoints_ = 0;
+    classification_ = nullptr;
+    height_ = nullptr;
+    normal_ = nullptr;
+    tree_ = nullptr;
+    label_ = nullptr;
+}
+
+size_t Database::findColumn(uint32_t type, size_t stride) const
+{
+    return findColumn(file_, type, stride, npoints_);
+}
+
+/** Find the last column chunk of type with one value for each point. */
+size_t Database::findColumn(const ChunkFile &file,
+                            uint32_t type,
+                            size_t stride,
+                            uint64_t npoints)
+{
+    size_t result = file.getEntrySize();
+    size_t id = file.findEntry(type);
+
+    while (id < file.getEntrySize())
+    {
+        ChunkFile::Chunk c;
+        (void)file.map(id, c);
+        if (c.stride == stride && c.data_length == npoints * stride)
+        {
+            result = id;
+        }
+        id = file.findEntry(type, id + 1);
+    }
+
+    return result;
+}
+
+void Database::read(DatabaseCell &cell, const Aabbd &window) const
+{
+    std::vector<OctreeIndex::Cell> cells;
+    index_.select(cells, window);
+
+    cell.clear();
+
+    // Partial octree cells also contain points outside of the window
+    for (size_t i = 0; i < cells.size(); i++)
+    {
+        read(cell,
+             cells[i].from_,
+             cells[i].n_,
+             cells[i].inside_ ? nullptr : &window);
+    }
+
+    cell.fileFrom = 0;
+    cell.fileSize = cell.size();
+    cell.id = 0;
+}
+
+void Database::read(DatabaseCell &cell,
+                    uint64_t from,
+                    uint64_t n,
+                    const Aabbd *window) const
+{
+    uint8_t fmt = header_.point_data_record_format & 0x3FU;
+    size_t stride = header_.point_data_record_length;
+    bool rgbFlag = header_.hasRgb();
+    bool gpsFlag = (fmt == 1 || fmt > 2);
+    constexpr float scaleU16 =
+        1.F / static_cast<float>(std::numeric_limits<uint16_t>::max());
+
+    size_t posGps = (fmt > 5) ? 22 : 20;
+    size_t posRgb = posGps + (gpsFlag ? 8 : 0);
+
+    const uint8_t *buffer = points_ + (from * stride);
+    for (uint64_t record = from; record < from + n; record++)
+    {
+        double x = (static_cast<double>(static_cast<int32_t>(ltoh32(buffer))) *
+                    header_.x_scale_factor) +
+                   header_.x_offset;
+        double y =
+            (static_cast<double>(static_cast<int32_t>(ltoh32(buffer + 4))) *
+             header_.y_scale_factor) +
+            header_.y_offset;
+        double z =
+            (static_cast<double>(static_cast<int32_t>(ltoh32(buffer + 8))) *
+             header_.z_scale_factor) +
+            header_.z_offset;
+
+        if (window && !window->isInside(x, y, z))
+        {
+            buffer += stride;
+            continue;
+        }
+
+        cell.xyz.push_back(x);
+        cell.xyz.push_back(y);
+        cell.xyz.push_back(z);
+
+        DatabaseCell::Laser laser;
+        laser.intensity = ltoh16(buffer + 12);
+        if (fmt > 5)
+        {
+            laser.returnNumber = static_cast<uint8_t>(buffer[14] & 15U);
+            laser.numberOfReturns = static_cast<uint8_t>(buffer[14] >> 4);
+            laser.classification = buffer[16];
+            laser.userData = buffer[17];
+            laser.scanAngle = static_cast<int16_t>(ltoh16(buffer + 18));
+        }
+        else
+        {
+            laser.returnNumber = static_cast<uint8_t>(buffer[14] & 7U);
+            laser.numberOfReturns =
+                static_cast<uint8_t>((buffer[14] >> 3) & 7U);
+            laser.classification = static_cast<uint8_t>(buffer[15] & 31U);
+            laser.userData = buffer[17];
+            laser.scanAngle = static_cast<int8_t>(buffer[16]);
+        }
+
+        if (classification_)
+        {
+            laser.classification = classification_[record];
+        }
+
+        cell.laser.push_back(laser);
+
+        if (height_)
+        {
+            cell.height.push_back(ltohf(height_ + (record * sizeof(float))));
+        }
+
+        if (normal_)
+        {
+            const uint8_t *normal = normal_ + (record * NORMAL_SIZE);
+            for (size_t k = 0; k < 3; k++)
+            {
+                cell.normal.push_back(
+                    static_cast<int16_t>(ltoh16(normal + (2 * k))));
+            }
+            cell.features.push_back(normal[6]);
+            cell.features.push_back(normal[7]);
+        }
+
+        if (tree_)
+        {
+            cell.tree.push_back(ltoh32(tree_ + (record * sizeof(uint32_t))));
+        }
+
+        if (label_)
+        {
+            cell.label.push_back(
+                ltoh32(label_ + (record * sizeof(uint32_t))));
+        }
+
+        if (gpsFlag)
+        {
+            cell.gps.push_back(ltohd(buffer + posGps));
+        }
+
+        if (rgbFlag)
+        {
+            cell.rgb.push_back(ltoh16(buffer + posRgb) * scaleU16);
+            cell.rgb.push_back(ltoh16(buffer + posRgb + 2) * scaleU16);
+            cell.rgb.push_back(ltoh16(buffer + posRgb + 4) * scaleU16);
+        }
+
+        cell.record.push_back(record);
+
+        buffer += stride;
+    }
 }
 
 // size_t Database::map(uint64_t index)
@@ -25,14 +25,36 @@
 #define DATABASE_HPP
 
 #include <Aabb.hpp>
+#include <ChunkFile.hpp>
 #include <DatabaseCell.hpp>
 #include <LasFile.hpp>
+#include <OctreeIndex.hpp>
+#include <memory>
 #include <string>
 
-/** Database. */
+/** Database.
+
+    A database is opened either from a LAS file, which is read whole into
+    one cell, or from a spatial index file created by SpatialIndex. The
+    spatial index file is memory mapped and points of any window are read
+    into a cell on demand, so the whole cloud does not have to fit into
+    memory. Reading of windows is thread safe.
+
+    Results of processing stages are stored in the spatial index file as
+    column chunks with one value per point in the order of 'PNTS' records.
+    The last column chunk of each type with the right length is used.
+*/
 class Database
 {
 public:
+    static const uint32_t CHUNK_ID_CLASSIFICATION;
+    static const uint32_t CHUNK_ID_HEIGHT;
+    static const uint32_t CHUNK_ID_HEIGHT_METADATA;
+    static const uint32_t CHUNK_ID_NORMAL;
+    static const uint32_t CHUNK_ID_TREE;
+    static const uint32_t CHUNK_ID_LABEL;
+    static const size_t NORMAL_SIZE;
+
     Aabbd aabb;
 
     Database();
@@ -46,9 +68,43 @@ public:
     size_t getCellSize() const { return cells_.size(); }
     const DatabaseCell &getCell(size_t i) const { return *cells_[i]; }
 
+    // spatial index file
+    bool isIndexed() const { return file_.isMapped(); }
+    const std::string &path() const { return path_; }
+    const ChunkFile &getFile() const { return file_; }
+    const OctreeIndex &getIndex() const { return index_; }
+    const LasFile::Header &getHeader() const { return header_; }
+    uint64_t getPointSize() const { return npoints_; }
+
+    size_t findColumn(uint32_t type, size_t stride) const;
+    static size_t findColumn(const ChunkFile &file,
+                             uint32_t type,
+                             size_t stride,
+                             uint64_t npoints);
+    void read(DatabaseCell &cell, const Aabbd &window) const;
+
 protected:
     // LasFile las_;
     std::vector<std::shared_ptr<DatabaseCell>> cells_;
+
+    std::string path_;
+    ChunkFile file_;
+    OctreeIndex index_;
+    LasFile::Header header_;
+    const uint8_t *points_;
+    uint64_t npoints_;
+    const uint8_t *classification_;
+    const uint8_t *height_;
+    const uint8_t *normal_;
+    const uint8_t *tree_;
+    const uint8_t *label_;
+
+    void openLas(const std::string &path);
+    void openIndex(const std::string &path);
+    void read(DatabaseCell &cell,
+              uint64_t from,
+              uint64_t n,
+              const Aabbd *window) const;
 };
 
 #endif /* DATABASE_HPP */
@@ -30,3 +30,17 @@ DatabaseCell::DatabaseCell()
 DatabaseCell::~DatabaseCell()
 {
 }
+
+void DatabaseCell::clear()
+{
+    xyz.clear();
+    rgb.clear();
+    laser.clear();
+    gps.clear();
+    height.clear();
+    normal.clear();
+    features.clear();
+    tree.clear();
+    label.clear();
+    record.clear();
+}
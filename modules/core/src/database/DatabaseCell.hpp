@@ -24,6 +24,7 @@
 #ifndef DATABASE_CELL_HPP
 #define DATABASE_CELL_HPP
 
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 
@@ -46,12 +47,41 @@ public:
     std::vector<Laser> laser;
     std::vector<double> gps;
 
+    /** Height above ground, empty if it was not computed. */
+    std::vector<float> height;
+
+    /** Unit normal times 32767, three values per point, zero if unknown.
+        Empty if normals were not computed.
+    */
+    std::vector<int16_t> normal;
+
+    /** Linearity and planarity times 255, two values per point. Sphericity
+        is the rest to one. Empty if normals were not computed.
+    */
+    std::vector<uint8_t> features;
+
+    /** Tree of each point, zero outside of trees. Empty if trees were not
+        segmented.
+    */
+    std::vector<uint32_t> tree;
+
+    /** Cluster of each point, zero outside of clusters. Empty if points
+        were not clustered.
+    */
+    std::vector<uint32_t> label;
+
+    /** Index of each point in points of the spatial index file. */
+    std::vector<uint64_t> record;
+
     uint64_t fileFrom;
     uint64_t fileSize;
     uint64_t id;
 
     DatabaseCell();
     ~DatabaseCell();
+
+    size_t size() const { return xyz.size() / 3; }
+    void clear();
 };
 
 #endif /* DATABASE_CELL_HPP */
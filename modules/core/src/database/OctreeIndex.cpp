@@ -22,19 +22,25 @@
 */
 
 #include <Endian.hpp>
+#include <Error.hpp>
 #include <OctreeIndex.hpp>
+#include <cstring>
 
 const uint32_t OctreeIndex::CHUNK_ID_OCTREE = 0x4F494458U;
 
-#if 0
+/** Number of 64-bit values before the nodes in octree chunk. */
+static const size_t OCTREE_INDEX_HEADER_SIZE = 8;
+
+/** Maximum number of levels which fit into node code. */
+static const size_t OCTREE_INDEX_MAX_LEVEL = 18;
+
 OctreeIndex::Cell::Cell(uint64_t code, uint64_t from, uint64_t n, uint8_t inside)
     : code_(code), from_(from), n_(n), inside_(inside)
 {
     // empty
 }
-#endif
 
-OctreeIndex::OctreeIndex() : maxlevel_(1)
+OctreeIndex::OctreeIndex() : maxlevel_(1), nodeSize_(OFFSET_SIZE + 1)
 {
     // empty
 }
@@ -46,35 +52,34 @@ OctreeIndex::~OctreeIndex()
 
 void OctreeIndex::setMaxLevel(size_t maxlevel)
 {
+    if (maxlevel == 0 || maxlevel > OCTREE_INDEX_MAX_LEVEL)
+    {
+        THROW("Octree index level is out of range");
+    }
+
     maxlevel_ = maxlevel;
-    nodeSize_ = 2 + (2 * maxlevel_);
+    nodeSize_ = OFFSET_SIZE + 1;
 }
 
 void OctreeIndex::addLevel()
 {
-    size_t n = 8 * nodeSize_;
-    size_t s = nodes.size();
-    nodes.resize(s + n);
-    for (size_t i = 0; i < n; i++)
-    {
-        nodes[s + i] = 0;
-    }
+    nodes_.resize(nodes_.size() + (8 * nodeSize_), 0);
+    view_ = ChunkView<uint64_t>(nodes_.data(), nodes_.size());
 }
 
 void OctreeIndex::setup(const Aabbd &boundary, size_t maxlevel)
 {
     setMaxLevel(maxlevel);
     boundary_ = boundary;
-    nodes.clear();
+    nodes_.clear();
     addLevel();
 }
 
-uint64_t OctreeIndex::insert(double x, double y, double z)
+uint64_t OctreeIndex::code(double x, double y, double z) const
 {
     uint64_t code = 0;
+    uint64_t path = 0;
     uint64_t c;
-    uint64_t pos = 0;
-    uint64_t idx;
     double px;
     double py;
     double pz;
@@ -85,11 +90,11 @@ uint64_t OctreeIndex::insert(double x, double y, double z)
     {
         octant.getCenter(px, py, pz);
 
-        code = code << (i * 3);
+        c = 0;
 
         if (x > px)
         {
-            code |= 1;
+            c |= 1;
             x1 = px;
             x2 = octant.max(0);
         }
@@ -101,7 +106,7 @@ uint64_t OctreeIndex::insert(double x, double y, double z)
 
         if (y > py)
         {
-            code |= 2;
+            c |= 2;
             y1 = py;
             y2 = octant.max(1);
         }
@@ -113,7 +118,7 @@ uint64_t OctreeIndex::insert(double x, double y, double z)
 
         if (z > pz)
         {
-            code |= 4;
+            c |= 4;
             z1 = pz;
             z2 = octant.max(2);
         }
@@ -125,36 +130,125 @@ uint64_t OctreeIndex::insert(double x, double y, double z)
 
         octant.set(x1, y1, z1, x2, y2, z2);
 
-        c = code & 7;
+        // Octants from the root form the path, level is in the top byte
+        path = (path << 3) | c;
+        code = path | ((static_cast<uint64_t>(i) & 0xff) << 56);
+    }
+
+    return code;
+}
+
+uint64_t OctreeIndex::insert(double x, double y, double z)
+{
+    uint64_t c = code(x, y, z);
+    insert(c);
+    return c;
+}
+
+void OctreeIndex::insert(uint64_t code, uint64_t n)
+{
+    const uint64_t path = code & ((static_cast<uint64_t>(1) << 56) - 1);
+    uint64_t pos = 0;
+    uint64_t idx;
 
-        code = code | ((static_cast<uint64_t>(i) & 0xff) << 56);
+    for (size_t i = 0; i < maxlevel_; i++)
+    {
+        // Node code is the leaf path up to its level
+        size_t shift = 3 * (maxlevel_ - 1 - i);
+        uint64_t c = (path >> shift) & 7U;
 
-        idx = (pos * nodeSize_) + c;
-        nodes[idx + OFFSET_CODE] = code;
+        idx = pos + (c * nodeSize_);
+        nodes_[idx + OFFSET_CODE] =
+            (path >> shift) | ((static_cast<uint64_t>(i) & 0xff) << 56);
 
         if (i + 1 == maxlevel_)
         {
-            nodes[idx + OFFSET_SIZE]++;
+            nodes_[idx + OFFSET_SIZE] += n;
         }
         else
         {
-            if (nodes[idx + OFFSET_NEXT] == 0)
+            if (nodes_[idx + OFFSET_NEXT] == 0)
             {
-                nodes[idx + OFFSET_NEXT] = nodes.size();
+                nodes_[idx + OFFSET_NEXT] = nodes_.size();
                 addLevel();
             }
-            pos = nodes[idx + OFFSET_NEXT];
+            pos = nodes_[idx + OFFSET_NEXT];
         }
     }
+}
 
-    return code;
+void OctreeIndex::updateRanges()
+{
+    if (!nodes_.empty())
+    {
+        (void)updateRanges(0, 0);
+    }
+}
+
+uint64_t OctreeIndex::updateRanges(size_t pos, uint64_t from)
+{
+    uint64_t total = 0;
+
+    // Children are visited in the order of point codes
+    for (size_t i = 0; i < 8; i++)
+    {
+        size_t idx = pos + (i * nodeSize_);
+        nodes_[idx + OFFSET_FROM] = from + total;
+
+        if (nodes_[idx + OFFSET_NEXT] != 0)
+        {
+            nodes_[idx + OFFSET_SIZE] =
+                updateRanges(nodes_[idx + OFFSET_NEXT], from + total);
+        }
+
+        total += nodes_[idx + OFFSET_SIZE];
+    }
+
+    return total;
+}
+
+void OctreeIndex::leaves(std::vector<Cell> &cells) const
+{
+    if (!view_.empty())
+    {
+        leaves(cells, 0);
+    }
+}
+
+void OctreeIndex::leaves(std::vector<Cell> &cells, size_t pos) const
+{
+    if (pos + (8 * nodeSize_) > view_.size())
+    {
+        THROW("Octree index node is out of range");
+    }
+
+    // Leaves are visited in the order of point codes
+    for (size_t i = 0; i < 8; i++)
+    {
+        const uint64_t *v = view_.data() + pos + (i * nodeSize_);
+
+        if (v[OFFSET_NEXT] != 0)
+        {
+            leaves(cells, v[OFFSET_NEXT]);
+        }
+        else if (v[OFFSET_SIZE] != 0)
+        {
+            cells.push_back(
+                Cell(v[OFFSET_CODE], v[OFFSET_FROM], v[OFFSET_SIZE], 1));
+        }
+    }
 }
-#if 0
+
 void OctreeIndex::select(std::vector<Cell> &cells,
-                    const Aabbd &window,
-                    int maxlevel) const
+                         const Aabbd &window,
+                         size_t maxlevel) const
 {
-    if (maxlevel == 0)
+    if (view_.empty())
+    {
+        return;
+    }
+
+    if (maxlevel == 0 || maxlevel > maxlevel_)
     {
         maxlevel = maxlevel_;
     }
@@ -163,74 +257,67 @@ void OctreeIndex::select(std::vector<Cell> &cells,
 }
 
 void OctreeIndex::select(std::vector<Cell> &cells,
-                    const Aabbd &window,
-                    const Aabbd &boundary,
-                    size_t pos,
-                    int level,
-                    int maxlevel) const
+                         const Aabbd &window,
+                         const Aabbd &boundary,
+                         size_t pos,
+                         size_t level,
+                         size_t maxlevel) const
 {
     double px;
     double py;
     double pz;
     Aabbd octant;
 
+    if (pos + (8 * nodeSize_) > view_.size())
+    {
+        THROW("Octree index node is out of range");
+    }
+
     boundary.getCenter(px, py, pz);
 
     for (size_t i = 0; i < 8; i++)
     {
-        const Node &v = nodes_[pos + i];
+        const uint64_t *v = view_.data() + pos + (i * nodeSize_);
 
-        if (v.next > 0 || v.n > 0)
+        if (v[OFFSET_SIZE] == 0)
         {
-            octant = boundary;
+            continue;
+        }
 
-            divide(octant, px, py, pz, i);
+        octant = boundary;
+        divide(octant, px, py, pz, i);
 
-            if (octant.isInside(window))
+        if (octant.isInside(window))
+        {
+            // Points of the whole subtree are one contiguous range
+            cells.push_back(
+                Cell(v[OFFSET_CODE], v[OFFSET_FROM], v[OFFSET_SIZE], 1));
+        }
+        else if (octant.intersects(window))
+        {
+            if (v[OFFSET_NEXT] == 0 || level >= maxlevel)
             {
-                selectall(cells, pos + i, level, maxlevel);
+                cells.push_back(
+                    Cell(v[OFFSET_CODE], v[OFFSET_FROM], v[OFFSET_SIZE], 0));
             }
-            else if (octant.intersects(window))
+            else
             {
-                if (v.n > 0)
-                {
-                    cells.push_back(Cell(v.code, v.from, v.n, 0));
-                }
-
-                if (level < maxlevel)
-                {
-                    select(cells, window, octant, v.next, level + 1, maxlevel);
-                }
+                select(cells,
+                       window,
+                       octant,
+                       v[OFFSET_NEXT],
+                       level + 1,
+                       maxlevel);
             }
         }
     }
 }
 
-void OctreeIndex::selectall(std::vector<Cell> &cells,
-                       size_t pos,
-                       int level,
-                       int maxlevel) const
-{
-    if (nodes_[pos].n > 0)
-    {
-        const Node &v = nodes_[pos];
-        cells.push_back(Cell(v.code, v.from, v.n, 1));
-    }
-
-    if (nodes_[pos].next > 0 && level < maxlevel)
-    {
-        for (size_t i = 0; i < 8; i++)
-        {
-            selectall(cells, nodes_[pos].next + i, level + 1, maxlevel);
-        }
-    }
-}
-
 void OctreeIndex::divide(Aabbd &boundary,
-                    double x,
-                    double y,
-                    double z,
-                    size_t code) const
+                         double x,
+                         double y,
+                         double z,
+                         size_t code) const
 {
     double x1, y1, z1, x2, y2, z2;
 
@@ -270,63 +357,179 @@ void OctreeIndex::divide(Aabbd &boundary,
     boundary.set(x1, y1, z1, x2, y2, z2);
 }
 
-void OctreeIndex::setnode(uint64_t code, uint64_t from)
+static uint64_t OctreeIndex_fromDouble(double value)
+{
+    uint64_t ret;
+    std::memcpy(&ret, &value, sizeof(ret));
+    return ret;
+}
+
+static double OctreeIndex_toDouble(uint64_t value)
 {
-    (void)code;
-    (void)from;
+    double ret;
+    std::memcpy(&ret, &value, sizeof(ret));
+    return ret;
 }
-#endif
 
-#if 0
 void OctreeIndex::read(ChunkFile &f)
 {
-    uint8_t buffer[512];
+    size_t id = f.findEntry(CHUNK_ID_OCTREE);
+    if (id == f.getEntrySize())
+    {
+        THROW("Missing octree index in file '" + f.path() + "'");
+    }
+
+    read(f, id);
+}
 
-    nodes.resize(ncells);
+void OctreeIndex::read(ChunkFile &f, size_t id)
+{
+    ChunkView<uint64_t> data;
 
-    for (size_t i = 0; i < ncells; i++)
+    if (f.isMapped())
+    {
+        data = f.view<uint64_t>(id);
+    }
+    else
     {
-        f.read(buffer, sizeof(buffer));
+        ChunkFile::Chunk c;
+        std::vector<uint8_t> buffer;
+        f.read(id, c, buffer);
 
-        node.code = ltoh64(&buffer[0]);
-        node.from[0] = ltoh64(&buffer[8]);
-        node.n[0] = ltoh64(&buffer[16]);
-        node.next = ltoh64(&buffer[24]);
+        nodes_.resize(buffer.size() / 8);
+        for (size_t i = 0; i < nodes_.size(); i++)
+        {
+            nodes_[i] = ltoh64(&buffer[i * 8]);
+        }
+
+        data = ChunkView<uint64_t>(nodes_.data(), nodes_.size());
     }
+
+    if (data.size() < OCTREE_INDEX_HEADER_SIZE)
+    {
+        THROW("Invalid octree index in file '" + f.path() + "'");
+    }
+
+    setMaxLevel(static_cast<size_t>(data[0]));
+
+    size_t n = data.size() - OCTREE_INDEX_HEADER_SIZE;
+    if (data[1] != nodeSize_ || n % (8 * nodeSize_) != 0)
+    {
+        THROW("Invalid octree index nodes in file '" + f.path() + "'");
+    }
+
+    boundary_.set(OctreeIndex_toDouble(data[2]),
+                  OctreeIndex_toDouble(data[3]),
+                  OctreeIndex_toDouble(data[4]),
+                  OctreeIndex_toDouble(data[5]),
+                  OctreeIndex_toDouble(data[6]),
+                  OctreeIndex_toDouble(data[7]));
+
+    view_ = ChunkView<uint64_t>(data.data() + OCTREE_INDEX_HEADER_SIZE, n);
 }
 
-void OctreeIndex::write(ChunkFile &f) const
+void OctreeIndex::write(ChunkFile &f, uint32_t type) const
 {
-    uint8_t buffer[512];
-
-    for (size_t i = 0; i < nodes.size(); i++)
+    std::vector<uint8_t> buffer;
+    uint64_t header[OCTREE_INDEX_HEADER_SIZE];
+
+    header[0] = maxlevel_;
+    header[1] = nodeSize_;
+    header[2] = OctreeIndex_fromDouble(boundary_.min(0));
+    header[3] = OctreeIndex_fromDouble(boundary_.min(1));
+    header[4] = OctreeIndex_fromDouble(boundary_.min(2));
+    header[5] = OctreeIndex_fromDouble(boundary_.max(0));
+    header[6] = OctreeIndex_fromDouble(boundary_.max(1));
+    header[7] = OctreeIndex_fromDouble(boundary_.max(2));
+
+    buffer.resize((OCTREE_INDEX_HEADER_SIZE + view_.size()) * 8);
+    uint8_t *ptr = buffer.data();
+
+    for (size_t i = 0; i < OCTREE_INDEX_HEADER_SIZE; i++, ptr += 8)
     {
-        htol64(&buffer[0], node.code);
-        htol64(&buffer[8], node.from[0]);
-        htol64(&buffer[16], node.n[0]);
-        htol64(&buffer[24], node.next);
+        htol64(ptr, header[i]);
+    }
 
-        f.write(buffer, sizeof(buffer));
+    for (size_t i = 0; i < view_.size(); i++, ptr += 8)
+    {
+        htol64(ptr, view_[i]);
     }
+
+    ChunkFile::Chunk c;
+    c.type = type;
+    c.major_version = 1;
+    c.minor_version = 0;
+    c.codec = Compression::CODEC_NONE;
+    c.flags = ChunkFile::CHUNK_FLAG_CHECKSUM;
+    c.stride = static_cast<uint16_t>(nodeSize_ * 8);
+    f.write(c, buffer.data(), buffer.size());
 }
-#endif
 
 Json &OctreeIndex::serialize(Json &out) const
 {
-#if 0
     boundary_.serialize(out["boundary"]);
     out["levels"] = maxlevel_;
-    out["nodes_size"] = nodes.size();
+    out["nodes_size"] = view_.size() / nodeSize_;
 
     Json &out_nodes = out["nodes"];
-    for (size_t i = 0; i < nodes.size(); i++)
+    size_t n = 0;
+    for (size_t i = 0; i < view_.size(); i += nodeSize_)
     {
-        Json &out_node = out_nodes[i];
-        out_node["code"] = nodes[i].code;
-        out_node["from"] = nodes[i].from[0];
-        out_node["n"] = nodes[i].n[0];
-        out_node["next"] = nodes[i].next;
+        if (view_[i + OFFSET_SIZE] > 0)
+        {
+            Json &out_node = out_nodes[n++];
+            out_node["code"] = view_[i + OFFSET_CODE];
+            out_node["next"] = view_[i + OFFSET_NEXT];
+            out_node["from"] = view_[i + OFFSET_FROM];
+            out_node["size"] = view_[i + OFFSET_SIZE];
+        }
     }
-#endif
+
     return out;
 }
+
+void OctreeIndex::serialize(JsonWriter &out) const
+{
+    out.beginObject();
+
+    out.key("boundary");
+    out.beginObject();
+    out.key("max");
+    out.beginArray();
+    for (size_t i = 0; i < 3; i++)
+    {
+        out.value(boundary_.max(i));
+    }
+    out.endArray();
+    out.key("min");
+    out.beginArray();
+    for (size_t i = 0; i < 3; i++)
+    {
+        out.value(boundary_.min(i));
+    }
+    out.endArray();
+    out.endObject();
+
+    out.value("levels", static_cast<uint64_t>(maxlevel_));
+
+    // Nodes are written one by one, the document is never held in memory
+    out.key("nodes");
+    out.beginArray();
+    for (size_t i = 0; i < view_.size(); i += nodeSize_)
+    {
+        if (view_[i + OFFSET_SIZE] > 0)
+        {
+            out.beginObject();
+            out.value("code", view_[i + OFFSET_CODE]);
+            out.value("from", view_[i + OFFSET_FROM]);
+            out.value("next", view_[i + OFFSET_NEXT]);
+            out.value("size", view_[i + OFFSET_SIZE]);
+            out.endObject();
+        }
+    }
+    out.endArray();
+
+    out.value("nodes_size", static_cast<uint64_t>(view_.size() / nodeSize_));
+
+    out.endObject();
+}
@@ -26,11 +26,21 @@
 
 #include <Aabb.hpp>
 #include <ChunkFile.hpp>
+#include <JsonWriter.hpp>
 #include <cstdint>
 #include <ostream>
 #include <vector>
 
-/** Octree Index. */
+/** Octree Index.
+
+    Nodes are stored in groups of 8 siblings in one array of 64-bit values.
+    Points are sorted by the code of their leaf node, so points of each
+    node and its whole subtree form one contiguous range.
+
+    The index can be read from a memory mapped chunk file. The node array
+    is then used directly from the mapping, which must stay open while
+    the index is used.
+*/
 class OctreeIndex
 {
 public:
@@ -44,10 +54,6 @@ public:
         OFFSET_SIZE = 3
     };
 
-    /* Node: code, next, fromL0, sizeL0, fromL1, sizeL1, .., code, .. */
-    std::vector<uint64_t> nodes;
-
-#if 0
     /** Cell. */
     struct Cell
     {
@@ -59,54 +65,62 @@ public:
         Cell() = default;
         Cell(uint64_t code, uint64_t from, uint64_t n, uint8_t inside);
     };
-    void select(std::vector<Cell> &cells,
-                const Aabbd &window,
-                int maxlevel = 0) const;
-    void setnode(uint64_t code, uint64_t from);
-#endif
 
     OctreeIndex();
     ~OctreeIndex();
 
     void setup(const Aabbd &boundary, size_t maxlevel);
 
+    uint64_t code(double x, double y, double z) const;
     uint64_t insert(double x, double y, double z);
+    void insert(uint64_t code, uint64_t n = 1);
+    void updateRanges();
 
-    // void read(ChunkFile &f);
-    // void write(ChunkFile &f) const;
+    void select(std::vector<Cell> &cells,
+                const Aabbd &window,
+                size_t maxlevel = 0) const;
+
+    void leaves(std::vector<Cell> &cells) const;
+
+    void read(ChunkFile &f);
+    void read(ChunkFile &f, size_t id);
+    void write(ChunkFile &f, uint32_t type = CHUNK_ID_OCTREE) const;
 
     size_t getMaxLevel() const { return maxlevel_; }
     size_t getNodeSize() const { return nodeSize_; }
+    const Aabbd &getBoundary() const { return boundary_; }
+    const ChunkView<uint64_t> &getNodes() const { return view_; }
 
     Json &serialize(Json &out) const;
+    void serialize(JsonWriter &out) const;
 
 protected:
     size_t maxlevel_;
     size_t nodeSize_;
     Aabbd boundary_;
 
+    /* Node: code, next, from, size, code, .. */
+    std::vector<uint64_t> nodes_;
+    ChunkView<uint64_t> view_;
+
     void setMaxLevel(size_t maxlevel);
     void addLevel();
 
-#if 0
+    uint64_t updateRanges(size_t pos, uint64_t from);
+    void leaves(std::vector<Cell> &cells, size_t pos) const;
+
     void select(std::vector<Cell> &cells,
                 const Aabbd &window,
                 const Aabbd &boundary,
                 size_t pos,
-                int level,
-                int maxlevel) const;
-
-    void selectall(std::vector<Cell> &cells,
-                   size_t pos,
-                   int level,
-                   int maxlevel) const;
+                size_t level,
+                size_t maxlevel) const;
 
     void divide(Aabbd &boundary,
                 double x,
                 double y,
                 double z,
                 size_t code) const;
-#endif
 };
 
 #endif /* OCTREE_INDEX_HPP */
@@ -21,10 +21,30 @@
     @file SpatialIndex.cpp
 */
 
+#include <ChunkFile.hpp>
+#include <Crc32.hpp>
+#include <Database.hpp>
 #include <Endian.hpp>
 #include <LasFile.hpp>
 #include <OctreeIndex.hpp>
 #include <SpatialIndex.hpp>
+#include <ThreadPool.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+const uint32_t SpatialIndex::CHUNK_ID_POINTS = 0x504E5453U;
+const uint32_t SpatialIndex::CHUNK_ID_METADATA = 0x4D455441U;
+const uint32_t SpatialIndex::CHUNK_ID_SEGMENT_POINTS = 0x50534547U;
+const uint32_t SpatialIndex::CHUNK_ID_SEGMENT_INDEX = 0x53494458U;
+const uint32_t SpatialIndex::CHUNK_ID_SEGMENT_METADATA = 0x534D4554U;
+
+/** Number of point records copied at once. */
+static const size_t SPATIAL_INDEX_BLOCK_SIZE = 4096;
+
+/** Compacted points are written in blocks of this size. */
+static const size_t SPATIAL_INDEX_COPY_SIZE = 1048576;
 
 int SpatialIndex_cmp_point(const void *a, const void *b)
 {
@@ -59,107 +79,861 @@ void SpatialIndex::create(const std::string &outputPath,
                           const std::string &inputPath,
                           size_t maxlevel)
 {
-    LasFile las;
-    las.open(inputPath);
+    create(outputPath, std::vector<std::string>{inputPath}, maxlevel);
+}
 
-    // Index
-    Aabbd boundary;
-    boundary.set(las.header.min_x,
-                 las.header.min_y,
-                 las.header.min_z,
-                 las.header.max_x,
-                 las.header.max_y,
-                 las.header.max_z);
+void SpatialIndex::create(const std::string &outputPath,
+                          const std::vector<std::string> &inputPaths,
+                          size_t maxlevel)
+{
+    create(outputPath, inputPaths, maxlevel, nullptr);
+}
 
-    OctreeIndex index;
-    index.setup(boundary, maxlevel);
+void SpatialIndex::create(const std::string &outputPath,
+                          const std::vector<std::string> &inputPaths,
+                          size_t maxlevel,
+                          const Aabbd &boundary)
+{
+    create(outputPath, inputPaths, maxlevel, &boundary);
+}
 
-    uint64_t code;
+static bool SpatialIndex_merge(LasFile::Header &out,
+                               const LasFile::Header &in,
+                               const std::string &path)
+{
+    if (in.point_data_record_format != out.point_data_record_format ||
+        in.point_data_record_length != out.point_data_record_length)
+    {
+        THROW("Point format of file '" + path + "' differs from other files");
+    }
+
+    out.min_x = std::min(out.min_x, in.min_x);
+    out.min_y = std::min(out.min_y, in.min_y);
+    out.min_z = std::min(out.min_z, in.min_z);
+    out.max_x = std::max(out.max_x, in.max_x);
+    out.max_y = std::max(out.max_y, in.max_y);
+    out.max_z = std::max(out.max_z, in.max_z);
+
+    out.number_of_point_records += in.number_of_point_records;
+    for (size_t i = 0; i < 15; i++)
+    {
+        out.number_of_points_by_return[i] += in.number_of_points_by_return[i];
+    }
+
+    bool requantize = false;
+    double *scale[3] = {&out.x_scale_factor,
+                        &out.y_scale_factor,
+                        &out.z_scale_factor};
+    const double inScale[3] = {in.x_scale_factor,
+                               in.y_scale_factor,
+                               in.z_scale_factor};
+    const double outOffset[3] = {out.x_offset, out.y_offset, out.z_offset};
+    const double inOffset[3] = {in.x_offset, in.y_offset, in.z_offset};
+
+    for (size_t k = 0; k < 3; k++)
+    {
+        if (std::islessgreater(*scale[k], inScale[k]) ||
+            std::islessgreater(outOffset[k], inOffset[k]))
+        {
+            requantize = true;
+        }
+
+        if (inScale[k] < *scale[k])
+        {
+            *scale[k] = inScale[k];
+        }
+    }
+
+    return requantize;
+}
+
+static void SpatialIndex_checkRange(const LasFile::Header &hdr)
+{
+    const double min[3] = {hdr.min_x, hdr.min_y, hdr.min_z};
+    const double max[3] = {hdr.max_x, hdr.max_y, hdr.max_z};
+    const double scale[3] = {hdr.x_scale_factor,
+                             hdr.y_scale_factor,
+                             hdr.z_scale_factor};
+    const double offset[3] = {hdr.x_offset, hdr.y_offset, hdr.z_offset};
+
+    for (size_t k = 0; k < 3; k++)
+    {
+        double a = (min[k] - offset[k]) / scale[k];
+        double b = (max[k] - offset[k]) / scale[k];
+        if (a < INT32_MIN || b > INT32_MAX)
+        {
+            THROW("Spatial index boundary is out of range of LAS scale");
+        }
+    }
+}
+
+static bool SpatialIndex_differs(const LasFile::Header &a,
+                                const LasFile::Header &b)
+{
+    return std::islessgreater(a.x_scale_factor, b.x_scale_factor) ||
+           std::islessgreater(a.y_scale_factor, b.y_scale_factor) ||
+           std::islessgreater(a.z_scale_factor, b.z_scale_factor) ||
+           std::islessgreater(a.x_offset, b.x_offset) ||
+           std::islessgreater(a.y_offset, b.y_offset) ||
+           std::islessgreater(a.z_offset, b.z_offset);
+}
+
+static bool SpatialIndex_isInside(const LasFile::Header &hdr,
+                                  const Aabbd &boundary)
+{
+    Aabbd box;
+    box.set(hdr.min_x, hdr.min_y, hdr.min_z, hdr.max_x, hdr.max_y, hdr.max_z);
+    return box.isInside(boundary);
+}
+
+static void SpatialIndex_readHeaders(std::vector<LasFile::Header> &headers,
+                                     const std::vector<std::string> &paths,
+                                     ThreadPool &pool)
+{
+    headers.resize(paths.size());
+    pool.run(paths.size(), [&](size_t i) {
+        LasFile las;
+        las.open(paths[i]);
+        headers[i] = las.header;
+    });
+}
+
+/** Write points with octree codes to a temporary file.
+
+    Input files are read in parallel. Points of each file go to their own
+    range of the temporary file, so the result does not depend on timing.
+    A single LAZ file uses the threads to decode its chunks.
+*/
+static void SpatialIndex_readPoints(const std::string &tmpPath,
+                                    const OctreeIndex &index,
+                                    const std::vector<std::string> &paths,
+                                    const std::vector<uint64_t> &start,
+                                    const LasFile::Header &header,
+                                    bool requantize,
+                                    ThreadPool &pool)
+{
+    const double scale[3] = {header.x_scale_factor,
+                             header.y_scale_factor,
+                             header.z_scale_factor};
+    const double offset[3] = {header.x_offset,
+                              header.y_offset,
+                              header.z_offset};
+
+    size_t point_size = header.point_data_record_length;
+    size_t tmp_point_size = sizeof(uint64_t) + point_size;
+    uint64_t npoints = start.back();
 
-    // Temporary file
-    const char *TMP_FILENAME_POINTS = "tmp_points.bin";
     File tmp_file;
-    tmp_file.open(TMP_FILENAME_POINTS, "w");
+    tmp_file.open(tmpPath, "w+");
+    if (npoints > 0)
+    {
+        const uint8_t zero = 0;
+        tmp_file.seek((npoints * tmp_point_size) - 1);
+        tmp_file.write(&zero, 1);
+    }
+
+    auto readFile = [&](size_t f, ThreadPool *decodePool) {
+        LasFile las;
+        las.open(paths[f]);
+
+        std::vector<uint8_t> points;
+        std::vector<uint8_t> buffer;
+        std::vector<double> xyz;
+        points.resize(point_size * SPATIAL_INDEX_BLOCK_SIZE);
+        buffer.resize(tmp_point_size * SPATIAL_INDEX_BLOCK_SIZE);
+        xyz.resize(3 * SPATIAL_INDEX_BLOCK_SIZE);
+
+        uint64_t pos = start[f];
+        size_t count;
+        while ((count = las.read(points.data(),
+                                 SPATIAL_INDEX_BLOCK_SIZE,
+                                 decodePool)) > 0)
+        {
+            las.transform(xyz.data(), points.data(), count);
+
+            for (size_t i = 0; i < count; i++)
+            {
+                double *p = &xyz[3 * i];
+                uint8_t *dst = &buffer[i * tmp_point_size];
+                std::memcpy(dst + 8, &points[i * point_size], point_size);
+
+                // Codes are computed from the stored coordinates
+                if (requantize)
+                {
+                    for (size_t k = 0; k < 3; k++)
+                    {
+                        int32_t v = static_cast<int32_t>(
+                            std::lround((p[k] - offset[k]) / scale[k]));
+                        htol32(dst + 8 + (k * 4), static_cast<uint32_t>(v));
+                        p[k] = (static_cast<double>(v) * scale[k]) + offset[k];
+                    }
+                }
 
-    size_t point_size = las.header.point_data_record_length;
+                htol64(dst, index.code(p[0], p[1], p[2]));
+            }
+
+            tmp_file.write(buffer.data(),
+                           count * tmp_point_size,
+                           pos * tmp_point_size);
+            pos += count;
+        }
+    };
+
+    // LAZ chunks of a single file are decoded in parallel instead
+    if (paths.size() == 1)
+    {
+        readFile(0, &pool);
+    }
+    else
+    {
+        pool.run(paths.size(), [&](size_t f) { readFile(f, nullptr); });
+    }
+
+    tmp_file.close();
+}
+
+/** Sort the temporary file and write its points without codes.
+
+    Codes are inserted into the index in sorted order, so the node layout
+    of the index does not depend on the order in which threads finished.
+*/
+static void SpatialIndex_writePoints(ChunkFile &output,
+                                     OctreeIndex &index,
+                                     const std::string &tmpPath,
+                                     uint32_t type,
+                                     size_t point_size,
+                                     uint64_t npoints)
+{
     size_t tmp_point_size = sizeof(uint64_t) + point_size;
-    uint8_t buffer[128];
 
-    // Create index and write points with octant codes to temporary file
-    double x;
-    double y;
-    double z;
+    File::sort(tmpPath, tmp_point_size, SpatialIndex_cmp_point);
+
+    // Checksum is set when all data are written
+    ChunkFile::Chunk c;
+    c.type = type;
+    c.major_version = 1;
+    c.minor_version = 0;
+    c.header_lenght = output.alignedHeaderLength();
+    c.codec = Compression::CODEC_NONE;
+    c.flags = ChunkFile::CHUNK_FLAG_CHECKSUM;
+    c.stride = static_cast<uint16_t>(point_size);
+    c.checksum = 0;
+    c.data_length = npoints * point_size;
+    c.total_length = c.header_lenght + c.data_length;
+
+    uint64_t offset = output.offset();
+    output.write(c);
 
-    uint64_t npoints = las.header.number_of_point_records;
-    for (uint64_t i = 0; i < npoints; i++)
+    std::vector<uint8_t> buffer;
+    buffer.resize(tmp_point_size * SPATIAL_INDEX_BLOCK_SIZE);
+
+    File tmp_file;
+    tmp_file.open(tmpPath, "r");
+    for (uint64_t i = 0; i < npoints; i += SPATIAL_INDEX_BLOCK_SIZE)
     {
-        las.read(&buffer[8]);
-        las.transform(x, y, z, &buffer[8]);
+        size_t n = SPATIAL_INDEX_BLOCK_SIZE;
+        if (npoints - i < n)
+        {
+            n = static_cast<size_t>(npoints - i);
+        }
 
-        code = index.insert(x, y, z);
+        tmp_file.read(buffer.data(), n * tmp_point_size);
+        for (size_t k = 0; k < n; k++)
+        {
+            index.insert(ltoh64(&buffer[k * tmp_point_size]));
+            std::memmove(&buffer[k * point_size],
+                         &buffer[(k * tmp_point_size) + 8],
+                         point_size);
+        }
 
-        htol64(&buffer[0], code);
-        tmp_file.write(buffer, tmp_point_size);
+        c.checksum = crc32c(c.checksum, buffer.data(), n * point_size);
+        output.write(buffer.data(), n * point_size);
     }
     tmp_file.close();
+    (void)std::remove(tmpPath.c_str());
 
-    File::sort(TMP_FILENAME_POINTS, tmp_point_size, SpatialIndex_cmp_point);
+    output.seek(offset);
+    output.write(c);
+    output.seek(offset + c.total_length);
 }
 
-#if 0
-    // output
-    DatabaseFile output;
-    output.open(filename_db, "w");
-    output.write_point_header(timestamp,
-                              npoints,
-                              boundary,
-                              point_format,
-                              data_length);
+void SpatialIndex::create(const std::string &outputPath,
+                          const std::vector<std::string> &inputPaths,
+                          size_t maxlevel,
+                          const Aabbd *boundary)
+{
+    const size_t nfiles = inputPaths.size();
+    if (nfiles == 0)
+    {
+        THROW("Spatial index needs at least one input file");
+    }
+
+    ThreadPool pool;
+
+    // Headers
+    std::vector<LasFile::Header> headers;
+    SpatialIndex_readHeaders(headers, inputPaths, pool);
 
-    // index
-    std::unordered_map<uint64_t, size_t> index_map;
-    size_t nnodes = index.nodes_.size();
-    for (size_t i = 0; i < nnodes; i++)
+    LasFile::Header header = headers[0];
+    bool requantize = false;
+    std::vector<uint64_t> start(nfiles + 1);
+    start[0] = 0;
+    start[1] = header.number_of_point_records;
+    for (size_t i = 1; i < nfiles; i++)
     {
-        if (index.nodes_[i].n > 0)
+        if (SpatialIndex_merge(header, headers[i], inputPaths[i]))
         {
-            index_map[index.nodes_[i].code] = i;
+            requantize = true;
         }
+        start[i + 1] = header.number_of_point_records;
     }
 
-    tmp_point.open(FILENAME_POINTS, "r");
-    uint64_t npoints_node = 0;
-    uint64_t npoints_node_from = 0;
-    code = 0;
-    for (uint64_t i = 0; i < npoints; i++)
+    if (requantize)
     {
-        tmp_point.read(buffer, tmp_point_size);
-        output.write(&buffer[8], tmp_point_size - 8);
-        uint64_t c = ltoh64(&buffer[0]);
+        SpatialIndex_checkRange(header);
+    }
 
-        if (i == 0)
+    if (nfiles > 1)
+    {
+        header.legacy_number_of_point_records = 0;
+        for (size_t i = 0; i < 5; i++)
+        {
+            header.legacy_number_of_points_by_return[i] = 0;
+        }
+
+        if (header.point_data_record_format < 6 &&
+            header.number_of_point_records <= UINT32_MAX)
+        {
+            header.legacy_number_of_point_records =
+                static_cast<uint32_t>(header.number_of_point_records);
+            for (size_t i = 0; i < 5; i++)
+            {
+                header.legacy_number_of_points_by_return[i] =
+                    static_cast<uint32_t>(
+                        header.number_of_points_by_return[i]);
+            }
+        }
+    }
+
+    // Index, explicit boundary leaves space for appended files
+    Aabbd indexBoundary;
+    indexBoundary.set(header.min_x,
+                      header.min_y,
+                      header.min_z,
+                      header.max_x,
+                      header.max_y,
+                      header.max_z);
+
+    if (boundary)
+    {
+        if (!indexBoundary.isInside(*boundary))
+        {
+            THROW("Input files are outside of the spatial index boundary");
+        }
+        indexBoundary = *boundary;
+    }
+
+    OctreeIndex index;
+    index.setup(indexBoundary, maxlevel);
+
+    // Write points with octant codes to temporary file
+    const std::string tmpPath = outputPath + ".tmp";
+    SpatialIndex_readPoints(tmpPath,
+                            index,
+                            inputPaths,
+                            start,
+                            header,
+                            requantize,
+                            pool);
+
+    ChunkFile output;
+    output.open(outputPath, "w+");
+
+    SpatialIndex_writePoints(output,
+                             index,
+                             tmpPath,
+                             CHUNK_ID_POINTS,
+                             header.point_data_record_length,
+                             header.number_of_point_records);
+
+    // Points of each octree node are now one contiguous range
+    index.updateRanges();
+
+    // Metadata of the first file with header of the whole database
+    Json metadata;
+    LasFile las;
+    las.open(inputPaths[0]);
+    las.header = header;
+    las.serialize(metadata);
+    for (size_t i = 0; i < nfiles; i++)
+    {
+        metadata["files"][i]["path"] = inputPaths[i];
+        metadata["files"][i]["points"] = headers[i].number_of_point_records;
+    }
+    output.writeJson(CHUNK_ID_METADATA, metadata);
+
+    index.write(output);
+
+    output.writeDirectory();
+    output.close();
+}
+
+void SpatialIndex::readHeader(LasFile::Header &header, const Json &metadata)
+{
+    const Json &in = metadata["header"];
+
+    std::memset(&header, 0, sizeof(header));
+    header.point_data_record_format =
+        static_cast<uint8_t>(in["point_data_record_format"].uint64());
+    header.point_data_record_length =
+        static_cast<uint16_t>(in["point_data_record_length"].uint64());
+    header.number_of_point_records = in["number_of_point_records"].uint64();
+    header.x_scale_factor = in["scale"][0].number();
+    header.y_scale_factor = in["scale"][1].number();
+    header.z_scale_factor = in["scale"][2].number();
+    header.x_offset = in["offset"][0].number();
+    header.y_offset = in["offset"][1].number();
+    header.z_offset = in["offset"][2].number();
+    header.min_x = in["min"][0].number();
+    header.min_y = in["min"][1].number();
+    header.min_z = in["min"][2].number();
+    header.max_x = in["max"][0].number();
+    header.max_y = in["max"][1].number();
+    header.max_z = in["max"][2].number();
+}
+
+void SpatialIndex::append(const std::string &path,
+                          const std::vector<std::string> &inputPaths)
+{
+    const size_t nfiles = inputPaths.size();
+    if (nfiles == 0)
+    {
+        THROW("Spatial index append needs at least one input file");
+    }
+
+    // Mapped, so the index is not copied
+    ChunkFile db;
+    db.open(path, "r+m");
+
+    OctreeIndex base;
+    base.read(db);
+
+    size_t id = db.findEntry(CHUNK_ID_METADATA);
+    if (id == db.getEntrySize())
+    {
+        THROW("Missing metadata in file '" + path + "'");
+    }
+
+    Json metadata;
+    db.readJson(id, metadata);
+
+    LasFile::Header header;
+    readHeader(header, metadata);
+
+    ThreadPool pool;
+
+    // Headers, points are requantized to the database scale
+    std::vector<LasFile::Header> headers;
+    SpatialIndex_readHeaders(headers, inputPaths, pool);
+
+    bool requantize = false;
+    std::vector<uint64_t> start(nfiles + 1);
+    start[0] = 0;
+
+    Json segment;
+    for (size_t i = 0; i < nfiles; i++)
+    {
+        const LasFile::Header &hdr = headers[i];
+
+        if (hdr.point_data_record_format != header.point_data_record_format ||
+            hdr.point_data_record_length != header.point_data_record_length)
+        {
+            THROW("Point format of file '" + inputPaths[i] +
+                  "' differs from the database");
+        }
+
+        if (!SpatialIndex_isInside(hdr, base.getBoundary()))
         {
-            code = c;
+            THROW("File '" + inputPaths[i] +
+                  "' is outside of the spatial index boundary");
         }
 
-        if (c != code || i + 1 == npoints)
+        if (SpatialIndex_differs(hdr, header))
         {
-            OctreeIndex::Node &node = index.nodes_[index_map[code]];
-            node.from = npoints_node_from;
+            requantize = true;
+        }
 
-            code = c;
-            npoints_node = 1;
-            npoints_node_from = i;
+        start[i + 1] = start[i] + hdr.number_of_point_records;
+
+        if (i == 0)
+        {
+            header.min_x = hdr.min_x;
+            header.min_y = hdr.min_y;
+            header.min_z = hdr.min_z;
+            header.max_x = hdr.max_x;
+            header.max_y = hdr.max_y;
+            header.max_z = hdr.max_z;
         }
         else
         {
-            npoints_node++;
+            header.min_x = std::min(header.min_x, hdr.min_x);
+            header.min_y = std::min(header.min_y, hdr.min_y);
+            header.min_z = std::min(header.min_z, hdr.min_z);
+            header.max_x = std::max(header.max_x, hdr.max_x);
+            header.max_y = std::max(header.max_y, hdr.max_y);
+            header.max_z = std::max(header.max_z, hdr.max_z);
+        }
+
+        segment["files"][i]["path"] = inputPaths[i];
+        segment["files"][i]["points"] = hdr.number_of_point_records;
+    }
+    header.number_of_point_records = start.back();
+
+    // Segment points are written with the database scale and offset
+    if (requantize)
+    {
+        SpatialIndex_checkRange(header);
+    }
+
+    segment["header"]["number_of_point_records"] = start.back();
+    segment["header"]["min"][0] = header.min_x;
+    segment["header"]["min"][1] = header.min_y;
+    segment["header"]["min"][2] = header.min_z;
+    segment["header"]["max"][0] = header.max_x;
+    segment["header"]["max"][1] = header.max_y;
+    segment["header"]["max"][2] = header.max_z;
+
+    // Segment index has the same boundary and levels as the base index
+    OctreeIndex index;
+    index.setup(base.getBoundary(), base.getMaxLevel());
+
+    const std::string tmpPath = path + ".tmp";
+    SpatialIndex_readPoints(tmpPath,
+                            index,
+                            inputPaths,
+                            start,
+                            header,
+                            requantize,
+                            pool);
+
+    // New chunks replace the directory at the end of the file
+    db.seekEnd();
+
+    SpatialIndex_writePoints(db,
+                             index,
+                             tmpPath,
+                             CHUNK_ID_SEGMENT_POINTS,
+                             header.point_data_record_length,
+                             header.number_of_point_records);
+    index.updateRanges();
+    db.writeJson(CHUNK_ID_SEGMENT_METADATA, segment);
+    index.write(db, CHUNK_ID_SEGMENT_INDEX);
+
+    db.writeDirectory();
+    db.close();
+}
+
+size_t SpatialIndex::segments(const ChunkFile &db)
+{
+    size_t n = 0;
+    size_t id = db.findEntry(CHUNK_ID_SEGMENT_INDEX);
+
+    while (id < db.getEntrySize())
+    {
+        n++;
+        id = db.findEntry(CHUNK_ID_SEGMENT_INDEX, id + 1);
+    }
+
+    return n;
+}
+
+/** Range of points of one octree leaf in one source chunk. */
+struct SpatialIndex_Range
+{
+    uint64_t code;
+    uint64_t from;
+    uint64_t n;
+    size_t source;
+};
+
+/** Column chunk of the base points which is carried over by compaction. */
+struct SpatialIndex_Column
+{
+    uint32_t type;
+    size_t stride;
+    const uint8_t *data;
+};
+
+/** Write one compacted chunk, fill appends the values of one range. */
+template <class F>
+static void SpatialIndex_writeCompacted(
+    ChunkFile &output,
+    uint32_t type,
+    size_t stride,
+    uint64_t npoints,
+    const std::vector<SpatialIndex_Range> &ranges,
+    F fill)
+{
+    ChunkFile::Chunk c;
+    c.type = type;
+    c.major_version = 1;
+    c.minor_version = 0;
+    c.header_lenght = output.alignedHeaderLength();
+    c.codec = Compression::CODEC_NONE;
+    c.flags = ChunkFile::CHUNK_FLAG_CHECKSUM;
+    c.stride = static_cast<uint16_t>(stride);
+    c.checksum = 0;
+    c.data_length = npoints * stride;
+    c.total_length = c.header_lenght + c.data_length;
+
+    uint64_t offset = output.offset();
+    output.write(c);
+
+    std::vector<uint8_t> buffer;
+    buffer.reserve(SPATIAL_INDEX_COPY_SIZE);
+
+    for (size_t i = 0; i < ranges.size(); i++)
+    {
+        fill(buffer, ranges[i]);
+        if (buffer.size() >= SPATIAL_INDEX_COPY_SIZE)
+        {
+            c.checksum = crc32c(c.checksum, buffer.data(), buffer.size());
+            output.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+
+    c.checksum = crc32c(c.checksum, buffer.data(), buffer.size());
+    output.write(buffer.data(), buffer.size());
+
+    output.seek(offset);
+    output.write(c);
+    output.seek(offset + c.total_length);
+}
+
+void SpatialIndex::compact(const std::string &path)
+{
+    ChunkFile db;
+    db.open(path, "rm");
+
+    OctreeIndex base;
+    base.read(db);
+
+    size_t id = db.findEntry(CHUNK_ID_METADATA);
+    if (id == db.getEntrySize())
+    {
+        THROW("Missing metadata in file '" + path + "'");
+    }
+
+    Json metadata;
+    db.readJson(id, metadata);
+
+    LasFile::Header header;
+    readHeader(header, metadata);
+    size_t point_size = header.point_data_record_length;
+
+    // Sources are the base points followed by segments in append order
+    std::vector<const uint8_t *> sources;
+    std::vector<SpatialIndex_Range> ranges;
+    std::vector<OctreeIndex::Cell> cells;
+    ChunkFile::Chunk c;
+
+    id = db.findEntry(CHUNK_ID_POINTS);
+    if (id == db.getEntrySize())
+    {
+        THROW("Missing points in file '" + path + "'");
+    }
+    sources.push_back(db.map(id, c));
+    base.leaves(cells);
+
+    size_t pointsId = db.findEntry(CHUNK_ID_SEGMENT_POINTS);
+    size_t indexId = db.findEntry(CHUNK_ID_SEGMENT_INDEX);
+    size_t metadataId = db.findEntry(CHUNK_ID_SEGMENT_METADATA);
+
+    // Database without segments is still rewritten to drop superseded
+    // column chunks
+
+    Json &files = metadata["files"];
+    Json &total = metadata["header"];
+    uint64_t npoints = total["number_of_point_records"].uint64();
+
+    while (indexId < db.getEntrySize())
+    {
+        if (pointsId == db.getEntrySize() || metadataId == db.getEntrySize())
+        {
+            THROW("Incomplete append segment in file '" + path + "'");
+        }
+
+        size_t source = sources.size();
+        for (size_t i = 0; i < cells.size(); i++)
+        {
+            ranges.push_back({cells[i].code_,
+                              cells[i].from_,
+                              cells[i].n_,
+                              source - 1});
+        }
+        cells.clear();
+
+        OctreeIndex segmentIndex;
+        segmentIndex.read(db, indexId);
+        if (segmentIndex.getMaxLevel() != base.getMaxLevel())
+        {
+            THROW("Append segment index does not match in file '" + path +
+                  "'");
+        }
+        segmentIndex.leaves(cells);
+        sources.push_back(db.map(pointsId, c));
+
+        // Metadata of the whole database
+        Json segment;
+        db.readJson(metadataId, segment);
+
+        const Json &hdr = segment["header"];
+        npoints += hdr["number_of_point_records"].uint64();
+        for (size_t k = 0; k < 3; k++)
+        {
+            total["min"][k] =
+                std::min(total["min"][k].number(), hdr["min"][k].number());
+            total["max"][k] =
+                std::max(total["max"][k].number(), hdr["max"][k].number());
         }
+
+        for (auto const &it : segment["files"].array())
+        {
+            files[files.size()] = it;
+        }
+
+        pointsId = db.findEntry(CHUNK_ID_SEGMENT_POINTS, pointsId + 1);
+        indexId = db.findEntry(CHUNK_ID_SEGMENT_INDEX, indexId + 1);
+        metadataId = db.findEntry(CHUNK_ID_SEGMENT_METADATA, metadataId + 1);
     }
-    tmp_point.close();
 
-    uint64_t index_data_length;
-    index_data_length = nnodes * sizeof(OctreeIndex::Node);
-    output.write_otree_header(nnodes, levels, index_data_length);
-    output.writeindex(index);
-#endif
+    for (size_t i = 0; i < cells.size(); i++)
+    {
+        ranges.push_back(
+            {cells[i].code_, cells[i].from_, cells[i].n_, sources.size() - 1});
+    }
+
+    total["number_of_point_records"] = npoints;
+
+    // Ranges of the same leaf keep the order of sources
+    std::stable_sort(ranges.begin(),
+                     ranges.end(),
+                     [](const SpatialIndex_Range &a,
+                        const SpatialIndex_Range &b) {
+                         return a.code < b.code;
+                     });
+
+    // Leaf sizes are counted by whole ranges
+    OctreeIndex index;
+    index.setup(base.getBoundary(), base.getMaxLevel());
+
+    uint64_t written = 0;
+    for (size_t i = 0; i < ranges.size(); i++)
+    {
+        index.insert(ranges[i].code, ranges[i].n);
+        written += ranges[i].n;
+    }
+    index.updateRanges();
+
+    if (written != npoints)
+    {
+        THROW("Number of points does not match metadata in file '" + path +
+              "'");
+    }
+
+    // The last valid column of each type follows the base points
+    std::vector<SpatialIndex_Column> columns = {
+        {Database::CHUNK_ID_CLASSIFICATION, sizeof(uint8_t), nullptr},
+        {Database::CHUNK_ID_HEIGHT, sizeof(float), nullptr},
+        {Database::CHUNK_ID_NORMAL, Database::NORMAL_SIZE, nullptr},
+        {Database::CHUNK_ID_TREE, sizeof(uint32_t), nullptr},
+        {Database::CHUNK_ID_LABEL, sizeof(uint32_t), nullptr}};
+
+    for (size_t i = 0; i < columns.size(); i++)
+    {
+        id = Database::findColumn(db,
+                                  columns[i].type,
+                                  columns[i].stride,
+                                  header.number_of_point_records);
+        if (id < db.getEntrySize())
+        {
+            columns[i].data = db.map(id, c);
+        }
+    }
+
+    const std::string tmpPath = path + ".compact";
+    ChunkFile output;
+    output.open(tmpPath, "w+");
+
+    SpatialIndex_writeCompacted(
+        output,
+        CHUNK_ID_POINTS,
+        point_size,
+        npoints,
+        ranges,
+        [&](std::vector<uint8_t> &buffer, const SpatialIndex_Range &r) {
+            const uint8_t *src = sources[r.source] + (r.from * point_size);
+            buffer.insert(buffer.end(), src, src + (r.n * point_size));
+        });
+
+    // Appended points get zero values, as unwritten values of a column,
+    // and classification of their LAS records
+    uint8_t fmt = header.point_data_record_format & 0x3FU;
+    size_t posClassification = (fmt > 5) ? 16 : 15;
+    uint8_t maskClassification = (fmt > 5) ? 0xFFU : 31U;
+
+    for (const SpatialIndex_Column &column : columns)
+    {
+        if (!column.data)
+        {
+            continue;
+        }
+
+        SpatialIndex_writeCompacted(
+            output,
+            column.type,
+            column.stride,
+            npoints,
+            ranges,
+            [&](std::vector<uint8_t> &buffer, const SpatialIndex_Range &r) {
+                size_t nbyte = static_cast<size_t>(r.n * column.stride);
+
+                if (r.source == 0)
+                {
+                    const uint8_t *src =
+                        column.data + (r.from * column.stride);
+                    buffer.insert(buffer.end(), src, src + nbyte);
+                }
+                else if (column.type == Database::CHUNK_ID_CLASSIFICATION)
+                {
+                    const uint8_t *src = sources[r.source] +
+                                         (r.from * point_size) +
+                                         posClassification;
+                    for (uint64_t k = 0; k < r.n; k++)
+                    {
+                        buffer.push_back(src[k * point_size] &
+                                         maskClassification);
+                    }
+                }
+                else
+                {
+                    buffer.resize(buffer.size() + nbyte, 0);
+                }
+            });
+    }
+
+    output.writeJson(CHUNK_ID_METADATA, metadata);
+
+    index.write(output);
+
+    output.writeDirectory();
+    output.close();
+    db.close();
+
+    // Readers with the old file mapped keep their copy
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0)
+    {
+        THROW("Can't replace file '" + path + "' by compacted file");
+    }
+}
@@ -24,18 +24,77 @@
 #ifndef SPATIAL_INDEX_HPP
 #define SPATIAL_INDEX_HPP
 
+#include <Aabb.hpp>
+#include <ChunkFile.hpp>
+#include <LasFile.hpp>
+#include <cstdint>
 #include <string>
+#include <vector>
 
-/** Spatial Index. */
+/** Spatial Index.
+
+    Creates database file with LAS point records sorted by octree nodes
+    ('PNTS' chunk) followed by LAS file metadata in CBOR ('META' chunk),
+    the octree index ('OIDX' chunk) and chunk directory.
+
+    An index can be created from many input files in a single pass, for
+    example from all tiles of a survey. The input files must have the same
+    point format. The octree covers the union of their header boundaries.
+    Input files are read in parallel. Points of files with different scale
+    or offset are requantized to the finest scale. The metadata header
+    then describes the whole database.
+
+    New files can be appended to an existing database without rebuilding
+    it. Each append writes one segment: sorted points ('PSEG' chunk),
+    segment metadata ('SMET' chunk) and segment octree index ('SIDX'
+    chunk). The database must be created with a boundary which covers
+    the appended files. Compaction merges all segments into a new sorted
+    'PNTS' chunk and replaces the database file. The last valid column
+    chunk of each type is reordered with the points, appended points get
+    zero values and their LAS classification. Data of replaced column
+    chunks are dropped, also from a database without segments. Readers
+    which have the old file mapped keep reading the old data. Append must
+    not run during compaction.
+*/
 class SpatialIndex
 {
 public:
+    static const uint32_t CHUNK_ID_POINTS;
+    static const uint32_t CHUNK_ID_METADATA;
+    static const uint32_t CHUNK_ID_SEGMENT_POINTS;
+    static const uint32_t CHUNK_ID_SEGMENT_INDEX;
+    static const uint32_t CHUNK_ID_SEGMENT_METADATA;
+
     SpatialIndex();
     ~SpatialIndex();
 
     static void create(const std::string &outputPath,
                        const std::string &inputPath,
                        size_t maxlevel);
+
+    static void create(const std::string &outputPath,
+                       const std::vector<std::string> &inputPaths,
+                       size_t maxlevel);
+
+    static void create(const std::string &outputPath,
+                       const std::vector<std::string> &inputPaths,
+                       size_t maxlevel,
+                       const Aabbd &boundary);
+
+    static void append(const std::string &path,
+                       const std::vector<std::string> &inputPaths);
+
+    static void compact(const std::string &path);
+
+    static size_t segments(const ChunkFile &db);
+
+    static void readHeader(LasFile::Header &header, const Json &metadata);
+
+protected:
+    static void create(const std::string &outputPath,
+                       const std::vector<std::string> &inputPaths,
+                       size_t maxlevel,
+                       const Aabbd *boundary);
 };
 
 #endif /* SPATIAL_INDEX_HPP */
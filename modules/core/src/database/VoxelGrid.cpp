@@ -0,0 +1,277 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file VoxelGrid.cpp
+*/
+
+#include <Error.hpp>
+#include <VoxelGrid.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+/** Number of key bits of each axis. */
+static const uint64_t VOXEL_GRID_BITS = 21;
+static const int64_t VOXEL_GRID_MAX = (int64_t(1) << VOXEL_GRID_BITS) - 1;
+static const uint64_t VOXEL_GRID_MASK = (uint64_t(1) << VOXEL_GRID_BITS) - 1;
+
+VoxelGrid::VoxelGrid() : voxelSize_(1.0), rgb_(false), height_(false)
+{
+    origin_[0] = origin_[1] = origin_[2] = 0;
+}
+
+VoxelGrid::~VoxelGrid()
+{
+}
+
+void VoxelGrid::clear()
+{
+    voxels_.clear();
+    points_.clear();
+}
+
+void VoxelGrid::create(const DatabaseCell &cell, double voxelSize)
+{
+    if (!(voxelSize > 0))
+    {
+        THROW("Invalid voxel size");
+    }
+
+    clear();
+    voxelSize_ = voxelSize;
+
+    size_t n = cell.size();
+    rgb_ = !cell.rgb.empty();
+    height_ = !cell.height.empty();
+    if (n == 0)
+    {
+        return;
+    }
+
+    // Voxel coordinates relative to the lowest voxel
+    std::vector<int64_t> g(3 * n);
+    int64_t gmax[3];
+    for (size_t k = 0; k < 3; k++)
+    {
+        origin_[k] = std::numeric_limits<int64_t>::max();
+        gmax[k] = std::numeric_limits<int64_t>::min();
+    }
+
+    for (size_t i = 0; i < 3 * n; i++)
+    {
+        g[i] = static_cast<int64_t>(std::floor(cell.xyz[i] / voxelSize_));
+        origin_[i % 3] = std::min(origin_[i % 3], g[i]);
+        gmax[i % 3] = std::max(gmax[i % 3], g[i]);
+    }
+
+    for (size_t k = 0; k < 3; k++)
+    {
+        if (gmax[k] - origin_[k] > VOXEL_GRID_MAX)
+        {
+            THROW("Voxel grid is too large for voxel size " +
+                  std::to_string(voxelSize_));
+        }
+    }
+
+    // Sort points by voxel keys
+    std::vector<std::pair<uint64_t, size_t>> keys(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        const int64_t *p = &g[3 * i];
+        uint64_t key = static_cast<uint64_t>(p[0] - origin_[0]) |
+                       (static_cast<uint64_t>(p[1] - origin_[1])
+                        << VOXEL_GRID_BITS) |
+                       (static_cast<uint64_t>(p[2] - origin_[2])
+                        << (2 * VOXEL_GRID_BITS));
+        keys[i] = {key, i};
+    }
+    std::sort(keys.begin(), keys.end());
+
+    points_.resize(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        points_[i] = keys[i].second;
+    }
+
+    // One pass over runs of equal keys
+    uint32_t classes[256] = {};
+    size_t i = 0;
+    while (i < n)
+    {
+        size_t j = i;
+        double sum[3] = {0, 0, 0};
+        double sumIntensity = 0;
+        double sumHeight = 0;
+        double sumRgb[3] = {0, 0, 0};
+
+        while (j < n && keys[j].first == keys[i].first)
+        {
+            size_t p = keys[j].second;
+            sum[0] += cell.xyz[3 * p];
+            sum[1] += cell.xyz[3 * p + 1];
+            sum[2] += cell.xyz[3 * p + 2];
+            sumIntensity += cell.laser[p].intensity;
+            classes[cell.laser[p].classification]++;
+
+            if (height_)
+            {
+                sumHeight += static_cast<double>(cell.height[p]);
+            }
+
+            if (rgb_)
+            {
+                sumRgb[0] += static_cast<double>(cell.rgb[3 * p]);
+                sumRgb[1] += static_cast<double>(cell.rgb[3 * p + 1]);
+                sumRgb[2] += static_cast<double>(cell.rgb[3 * p + 2]);
+            }
+
+            j++;
+        }
+
+        double count = static_cast<double>(j - i);
+
+        Voxel v;
+        v.key = keys[i].first;
+        v.from = i;
+        v.count = static_cast<uint32_t>(j - i);
+        v.x = sum[0] / count;
+        v.y = sum[1] / count;
+        v.z = sum[2] / count;
+        v.intensity = static_cast<float>(sumIntensity / count);
+        v.height = height_ ? static_cast<float>(sumHeight / count)
+                           : std::numeric_limits<float>::quiet_NaN();
+        for (size_t k = 0; k < 3; k++)
+        {
+            v.rgb[k] = static_cast<float>(sumRgb[k] / count);
+        }
+
+        // The most frequent class, the lowest class on tie
+        v.classification = 0;
+        uint32_t best = 0;
+        for (size_t k = i; k < j; k++)
+        {
+            uint8_t c = cell.laser[keys[k].second].classification;
+            if (classes[c] > best ||
+                (classes[c] == best && c < v.classification))
+            {
+                best = classes[c];
+                v.classification = c;
+            }
+        }
+        for (size_t k = i; k < j; k++)
+        {
+            classes[cell.laser[keys[k].second].classification] = 0;
+        }
+
+        voxels_.push_back(v);
+        i = j;
+    }
+}
+
+void VoxelGrid::getCoordinates(int64_t &gx,
+                               int64_t &gy,
+                               int64_t &gz,
+                               size_t i) const
+{
+    uint64_t key = voxels_[i].key;
+    gx = origin_[0] + static_cast<int64_t>(key & VOXEL_GRID_MASK);
+    gy = origin_[1] +
+         static_cast<int64_t>((key >> VOXEL_GRID_BITS) & VOXEL_GRID_MASK);
+    gz = origin_[2] +
+         static_cast<int64_t>((key >> (2 * VOXEL_GRID_BITS)) & VOXEL_GRID_MASK);
+}
+
+void VoxelGrid::getCenter(double &x, double &y, double &z, size_t i) const
+{
+    int64_t gx;
+    int64_t gy;
+    int64_t gz;
+    getCoordinates(gx, gy, gz, i);
+
+    x = (static_cast<double>(gx) + 0.5) * voxelSize_;
+    y = (static_cast<double>(gy) + 0.5) * voxelSize_;
+    z = (static_cast<double>(gz) + 0.5) * voxelSize_;
+}
+
+size_t VoxelGrid::find(int64_t gx, int64_t gy, int64_t gz) const
+{
+    gx -= origin_[0];
+    gy -= origin_[1];
+    gz -= origin_[2];
+
+    if (gx < 0 || gy < 0 || gz < 0 || gx > VOXEL_GRID_MAX ||
+        gy > VOXEL_GRID_MAX || gz > VOXEL_GRID_MAX)
+    {
+        return voxels_.size();
+    }
+
+    uint64_t key = static_cast<uint64_t>(gx) |
+                   (static_cast<uint64_t>(gy) << VOXEL_GRID_BITS) |
+                   (static_cast<uint64_t>(gz) << (2 * VOXEL_GRID_BITS));
+
+    auto it = std::lower_bound(
+        voxels_.begin(),
+        voxels_.end(),
+        key,
+        [](const Voxel &v, uint64_t k) { return v.key < k; });
+
+    if (it == voxels_.end() || it->key != key)
+    {
+        return voxels_.size();
+    }
+
+    return static_cast<size_t>(it - voxels_.begin());
+}
+
+void VoxelGrid::downsample(DatabaseCell &out) const
+{
+    out.clear();
+    out.xyz.reserve(3 * voxels_.size());
+    out.laser.reserve(voxels_.size());
+
+    // One point at the centroid of each voxel
+    for (size_t i = 0; i < voxels_.size(); i++)
+    {
+        const Voxel &v = voxels_[i];
+
+        out.xyz.push_back(v.x);
+        out.xyz.push_back(v.y);
+        out.xyz.push_back(v.z);
+
+        DatabaseCell::Laser laser = {};
+        laser.intensity = static_cast<uint16_t>(std::lround(v.intensity));
+        laser.returnNumber = 1;
+        laser.numberOfReturns = 1;
+        laser.classification = v.classification;
+        out.laser.push_back(laser);
+
+        if (rgb_)
+        {
+            out.rgb.push_back(v.rgb[0]);
+            out.rgb.push_back(v.rgb[1]);
+            out.rgb.push_back(v.rgb[2]);
+        }
+
+        if (height_)
+        {
+            out.height.push_back(v.height);
+        }
+    }
+}
@@ -0,0 +1,89 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file VoxelGrid.hpp
+*/
+
+#ifndef VOXEL_GRID_HPP
+#define VOXEL_GRID_HPP
+
+#include <DatabaseCell.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/** Voxel Grid.
+
+    Sparse grid of cubic voxels aligned to multiples of the voxel size.
+    Points are sorted by 64-bit voxel keys, so points of each voxel form
+    one run. Counts, centroids and attribute aggregates of all voxels are
+    computed in one pass over the sorted runs. Voxels are stored sorted by
+    key and found by binary search.
+
+    Keys have 21 bits per axis relative to the lowest voxel of the cell,
+    which limits the grid to 2^21 voxels along each axis.
+*/
+class VoxelGrid
+{
+public:
+    /** Voxel. */
+    struct Voxel
+    {
+        uint64_t key;
+        uint64_t from;
+        uint32_t count;
+        uint8_t classification;
+        double x;
+        double y;
+        double z;
+        float intensity;
+        float height;
+        float rgb[3];
+    };
+
+    VoxelGrid();
+    ~VoxelGrid();
+
+    void create(const DatabaseCell &cell, double voxelSize);
+    void clear();
+
+    size_t size() const { return voxels_.size(); }
+    bool empty() const { return voxels_.empty(); }
+    const Voxel &operator[](size_t i) const { return voxels_[i]; }
+
+    double getVoxelSize() const { return voxelSize_; }
+    const std::vector<size_t> &getPoints() const { return points_; }
+
+    void getCoordinates(int64_t &gx, int64_t &gy, int64_t &gz, size_t i) const;
+    void getCenter(double &x, double &y, double &z, size_t i) const;
+    size_t find(int64_t gx, int64_t gy, int64_t gz) const;
+
+    void downsample(DatabaseCell &out) const;
+
+protected:
+    double voxelSize_;
+    int64_t origin_[3];
+    std::vector<Voxel> voxels_;
+    std::vector<size_t> points_;
+    bool rgb_;
+    bool height_;
+};
+
+#endif /* VOXEL_GRID_HPP */
@@ -0,0 +1,490 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file Cbor.cpp
+*/
+
+#include <Cbor.hpp>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+/** Maximum nesting depth of skipped arrays and objects. */
+static const size_t CBOR_MAX_DEPTH = 512;
+
+/** Major types. */
+static const uint8_t CBOR_MAJOR_UNSIGNED = 0;
+static const uint8_t CBOR_MAJOR_NEGATIVE = 1;
+static const uint8_t CBOR_MAJOR_BYTES = 2;
+static const uint8_t CBOR_MAJOR_TEXT = 3;
+static const uint8_t CBOR_MAJOR_ARRAY = 4;
+static const uint8_t CBOR_MAJOR_MAP = 5;
+static const uint8_t CBOR_MAJOR_TAG = 6;
+static const uint8_t CBOR_MAJOR_SIMPLE = 7;
+
+/** Initial bytes of simple values and floats. */
+static const uint8_t CBOR_FALSE = 0xF4U;
+static const uint8_t CBOR_TRUE = 0xF5U;
+static const uint8_t CBOR_NULL = 0xF6U;
+static const uint8_t CBOR_FLOAT32 = 0xFAU;
+static const uint8_t CBOR_FLOAT64 = 0xFBU;
+
+CborWriter::CborWriter(std::vector<uint8_t> &out) : out_(out)
+{
+    // empty
+}
+
+void CborWriter::head(uint8_t major, uint64_t argument)
+{
+    uint8_t initial = static_cast<uint8_t>(major << 5);
+    size_t nbyte;
+
+    if (argument < 24)
+    {
+        out_.push_back(static_cast<uint8_t>(initial | argument));
+        return;
+    }
+    else if (argument <= 0xFFU)
+    {
+        out_.push_back(static_cast<uint8_t>(initial | 24));
+        nbyte = 1;
+    }
+    else if (argument <= 0xFFFFU)
+    {
+        out_.push_back(static_cast<uint8_t>(initial | 25));
+        nbyte = 2;
+    }
+    else if (argument <= 0xFFFFFFFFU)
+    {
+        out_.push_back(static_cast<uint8_t>(initial | 26));
+        nbyte = 4;
+    }
+    else
+    {
+        out_.push_back(static_cast<uint8_t>(initial | 27));
+        nbyte = 8;
+    }
+
+    // Big endian
+    for (size_t i = nbyte; i > 0; i--)
+    {
+        out_.push_back(static_cast<uint8_t>(argument >> ((i - 1) * 8)));
+    }
+}
+
+void CborWriter::beginObject(size_t n)
+{
+    head(CBOR_MAJOR_MAP, n);
+}
+
+void CborWriter::beginArray(size_t n)
+{
+    head(CBOR_MAJOR_ARRAY, n);
+}
+
+void CborWriter::key(const std::string &name)
+{
+    string(name.data(), name.size());
+}
+
+void CborWriter::string(const char *in, size_t n)
+{
+    head(CBOR_MAJOR_TEXT, n);
+    out_.insert(out_.end(),
+                reinterpret_cast<const uint8_t *>(in),
+                reinterpret_cast<const uint8_t *>(in) + n);
+}
+
+void CborWriter::value(double in)
+{
+    // Integral values are stored as integers, except negative zero
+    if (std::isfinite(in) && !std::islessgreater(std::trunc(in), in) &&
+        !(std::signbit(in) && in > -1.))
+    {
+        if (in >= 0. && in < 18446744073709551616.)
+        {
+            head(CBOR_MAJOR_UNSIGNED, static_cast<uint64_t>(in));
+            return;
+        }
+
+        if (in < 0. && in >= -9223372036854775808.)
+        {
+            value(static_cast<int64_t>(in));
+            return;
+        }
+    }
+
+    // Single precision when the value is exact, all NaNs are the same
+    uint64_t bits;
+    size_t nbyte = 4;
+    bool single = std::isinf(in) ||
+                  (std::fabs(in) <= std::numeric_limits<float>::max() &&
+                   !std::islessgreater(static_cast<float>(in), in));
+
+    if (std::isnan(in))
+    {
+        bits = 0x7FC00000U;
+        out_.push_back(CBOR_FLOAT32);
+    }
+    else if (single)
+    {
+        float f = static_cast<float>(in);
+        uint32_t bits32;
+        std::memcpy(&bits32, &f, sizeof(bits32));
+        bits = bits32;
+        out_.push_back(CBOR_FLOAT32);
+    }
+    else
+    {
+        std::memcpy(&bits, &in, sizeof(bits));
+        nbyte = 8;
+        out_.push_back(CBOR_FLOAT64);
+    }
+
+    for (size_t i = nbyte; i > 0; i--)
+    {
+        out_.push_back(static_cast<uint8_t>(bits >> ((i - 1) * 8)));
+    }
+}
+
+void CborWriter::value(int32_t in)
+{
+    value(static_cast<int64_t>(in));
+}
+
+void CborWriter::value(uint32_t in)
+{
+    head(CBOR_MAJOR_UNSIGNED, in);
+}
+
+void CborWriter::value(int64_t in)
+{
+    if (in < 0)
+    {
+        // Negative integer n is stored as -1 - n
+        head(CBOR_MAJOR_NEGATIVE, static_cast<uint64_t>(-(in + 1)));
+    }
+    else
+    {
+        head(CBOR_MAJOR_UNSIGNED, static_cast<uint64_t>(in));
+    }
+}
+
+void CborWriter::value(uint64_t in)
+{
+    head(CBOR_MAJOR_UNSIGNED, in);
+}
+
+void CborWriter::value(bool in)
+{
+    out_.push_back(in ? CBOR_TRUE : CBOR_FALSE);
+}
+
+void CborWriter::value(const char *in)
+{
+    string(in, std::strlen(in));
+}
+
+void CborWriter::value(const std::string &in)
+{
+    string(in.data(), in.size());
+}
+
+void CborWriter::null()
+{
+    out_.push_back(CBOR_NULL);
+}
+
+void CborWriter::value(const Json &in)
+{
+    if (in.isObject())
+    {
+        const std::map<std::string, Json> &obj = in.object();
+        beginObject(obj.size());
+        for (auto const &it : obj)
+        {
+            key(it.first);
+            value(it.second);
+        }
+    }
+    else if (in.isArray())
+    {
+        const std::vector<Json> &arr = in.array();
+        beginArray(arr.size());
+        for (size_t i = 0; i < arr.size(); i++)
+        {
+            value(arr[i]);
+        }
+    }
+    else if (in.isString())
+    {
+        value(in.string());
+    }
+    else if (in.isNumber())
+    {
+        value(in.number());
+    }
+    else if (in.isTrue())
+    {
+        value(true);
+    }
+    else if (in.isFalse())
+    {
+        value(false);
+    }
+    else
+    {
+        null();
+    }
+}
+
+static double CborReader_half(uint16_t h)
+{
+    int exponent = (h >> 10) & 0x1F;
+    int mantissa = h & 0x3FF;
+    double v;
+
+    if (exponent == 0)
+    {
+        v = std::ldexp(mantissa, -24);
+    }
+    else if (exponent != 31)
+    {
+        v = std::ldexp(mantissa + 1024, exponent - 25);
+    }
+    else
+    {
+        v = (mantissa == 0) ? std::numeric_limits<double>::infinity()
+                            : std::numeric_limits<double>::quiet_NaN();
+    }
+
+    return (h & 0x8000U) ? -v : v;
+}
+
+CborReader::CborReader(const uint8_t *data, size_t size)
+    : data_(data),
+      dataSize_(size),
+      offset_(0),
+      type_(TYPE_NULL),
+      size_(0),
+      number_(0)
+{
+    // empty
+}
+
+uint64_t CborReader::read(size_t nbyte)
+{
+    if (dataSize_ - offset_ < nbyte)
+    {
+        THROW("CBOR unexpected end of data");
+    }
+
+    // Big endian
+    uint64_t v = 0;
+    for (size_t i = 0; i < nbyte; i++)
+    {
+        v = (v << 8) | data_[offset_++];
+    }
+
+    return v;
+}
+
+CborReader::Type CborReader::next()
+{
+    size_t start;
+    uint8_t major;
+    uint8_t info;
+    uint64_t argument;
+
+    // Tags are skipped
+    do
+    {
+        if (offset_ >= dataSize_)
+        {
+            THROW("CBOR unexpected end of data");
+        }
+
+        start = offset_;
+        major = static_cast<uint8_t>(data_[offset_] >> 5);
+        info = static_cast<uint8_t>(data_[offset_] & 0x1FU);
+        offset_++;
+
+        if (major == CBOR_MAJOR_SIMPLE && info >= 25 && info <= 27)
+        {
+            argument = 0;
+            break;
+        }
+
+        if (info < 24)
+        {
+            argument = info;
+        }
+        else if (info <= 27)
+        {
+            argument = read(size_t(1) << (info - 24));
+        }
+        else if (info == 31)
+        {
+            THROW("CBOR indefinite length is not supported at offset " +
+                  std::to_string(start));
+        }
+        else
+        {
+            THROW("CBOR invalid item at offset " + std::to_string(start));
+        }
+    } while (major == CBOR_MAJOR_TAG);
+
+    size_t available = dataSize_ - offset_;
+
+    switch (major)
+    {
+        case CBOR_MAJOR_UNSIGNED:
+            type_ = TYPE_NUMBER;
+            number_ = static_cast<double>(argument);
+            break;
+
+        case CBOR_MAJOR_NEGATIVE:
+            // Negative integer is -1 - argument
+            type_ = TYPE_NUMBER;
+            if (argument == UINT64_MAX)
+            {
+                number_ = -18446744073709551616.;
+            }
+            else
+            {
+                number_ = -static_cast<double>(argument + 1);
+            }
+            break;
+
+        case CBOR_MAJOR_TEXT:
+            if (argument > available)
+            {
+                THROW("CBOR unexpected end of data in string at offset " +
+                      std::to_string(start));
+            }
+            type_ = TYPE_STRING;
+            string_ = std::string_view(
+                reinterpret_cast<const char *>(data_ + offset_),
+                static_cast<size_t>(argument));
+            offset_ += static_cast<size_t>(argument);
+            break;
+
+        case CBOR_MAJOR_ARRAY:
+            // Each element has at least one byte
+            if (argument > available)
+            {
+                THROW("CBOR unexpected end of data in array at offset " +
+                      std::to_string(start));
+            }
+            type_ = TYPE_ARRAY;
+            size_ = static_cast<size_t>(argument);
+            break;
+
+        case CBOR_MAJOR_MAP:
+            if (argument > available / 2)
+            {
+                THROW("CBOR unexpected end of data in object at offset " +
+                      std::to_string(start));
+            }
+            type_ = TYPE_OBJECT;
+            size_ = static_cast<size_t>(argument);
+            break;
+
+        case CBOR_MAJOR_SIMPLE:
+            if (info == 20)
+            {
+                type_ = TYPE_FALSE;
+            }
+            else if (info == 21)
+            {
+                type_ = TYPE_TRUE;
+            }
+            else if (info == 22 || info == 23)
+            {
+                // Null and undefined
+                type_ = TYPE_NULL;
+            }
+            else if (info == 25)
+            {
+                type_ = TYPE_NUMBER;
+                number_ = CborReader_half(static_cast<uint16_t>(read(2)));
+            }
+            else if (info == 26)
+            {
+                uint32_t bits = static_cast<uint32_t>(read(4));
+                float f;
+                std::memcpy(&f, &bits, sizeof(f));
+                type_ = TYPE_NUMBER;
+                number_ = static_cast<double>(f);
+            }
+            else if (info == 27)
+            {
+                uint64_t bits = read(8);
+                type_ = TYPE_NUMBER;
+                std::memcpy(&number_, &bits, sizeof(number_));
+            }
+            else
+            {
+                THROW("CBOR unsupported simple value at offset " +
+                      std::to_string(start));
+            }
+            break;
+
+        case CBOR_MAJOR_BYTES:
+        default:
+            THROW("CBOR byte string is not supported at offset " +
+                  std::to_string(start));
+    }
+
+    return type_;
+}
+
+void CborReader::skip()
+{
+    skip(0);
+}
+
+void CborReader::skip(size_t depth)
+{
+    if (depth > CBOR_MAX_DEPTH)
+    {
+        THROW("CBOR nesting is too deep");
+    }
+
+    size_t n;
+    if (type_ == TYPE_ARRAY)
+    {
+        n = size_;
+    }
+    else if (type_ == TYPE_OBJECT)
+    {
+        n = size_ * 2;
+    }
+    else
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < n; i++)
+    {
+        next();
+        skip(depth + 1);
+    }
+}
@@ -0,0 +1,156 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file Cbor.hpp
+*/
+
+#ifndef CBOR_HPP
+#define CBOR_HPP
+
+#include <Json.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/** CBOR writer.
+
+    Writes the Json value model in Concise Binary Object Representation
+    (RFC 8949). Numbers with integral values are written as integers,
+    other numbers as single or double precision floats, whichever keeps
+    the value exact. Arrays and objects have definite length, so their
+    size is given when they are started. The output is appended to the
+    given buffer.
+
+    example:
+\code
+    std::vector<uint8_t> buffer;
+    CborWriter out(buffer);
+    out.beginObject(2);
+    out.value("name", "tree");
+    out.value("height", 25.5);
+\endcode
+*/
+class CborWriter
+{
+public:
+    CborWriter(std::vector<uint8_t> &out);
+
+    void beginObject(size_t n);
+    void beginArray(size_t n);
+    void key(const std::string &name);
+
+    void value(double in);
+    void value(int32_t in);
+    void value(uint32_t in);
+    void value(int64_t in);
+    void value(uint64_t in);
+    void value(bool in);
+    void value(const char *in);
+    void value(const std::string &in);
+    void value(const Json &in);
+    void null();
+
+    template <class T> void value(const std::string &name, const T &in)
+    {
+        key(name);
+        value(in);
+    }
+
+protected:
+    std::vector<uint8_t> &out_;
+
+    void head(uint8_t major, uint64_t argument);
+    void string(const char *in, size_t n);
+};
+
+/** CBOR reader.
+
+    Pull reader of CBOR data items. Each call to next() reads one item
+    header. Strings are returned as views into the input buffer without
+    copying, so the buffer must outlive the returned views. Tags are
+    skipped. Items with indefinite length and byte strings are not
+    supported.
+
+    example:
+\code
+    CborReader in(buffer.data(), buffer.size());
+    if (in.next() == CborReader::TYPE_OBJECT)
+    {
+        size_t n = in.size();
+        for (size_t i = 0; i < n; i++)
+        {
+            in.next();
+            std::string_view name = in.string();
+            in.next();
+            if (name == "height" && in.type() == CborReader::TYPE_NUMBER)
+            {
+                height = in.number();
+            }
+            else
+            {
+                in.skip();
+            }
+        }
+    }
+\endcode
+*/
+class CborReader
+{
+public:
+    /** Item type. */
+    enum Type
+    {
+        TYPE_OBJECT,
+        TYPE_ARRAY,
+        TYPE_STRING,
+        TYPE_NUMBER,
+        TYPE_TRUE,
+        TYPE_FALSE,
+        TYPE_NULL
+    };
+
+    CborReader(const uint8_t *data, size_t size);
+
+    Type next();
+    void skip();
+
+    Type type() const { return type_; }
+    size_t size() const { return size_; }
+    double number() const { return number_; }
+    std::string_view string() const { return string_; }
+
+    bool eof() const { return offset_ >= dataSize_; }
+    size_t offset() const { return offset_; }
+
+protected:
+    const uint8_t *data_;
+    size_t dataSize_;
+    size_t offset_;
+
+    Type type_;
+    size_t size_;
+    double number_;
+    std::string_view string_;
+
+    uint64_t read(size_t nbyte);
+    void skip(size_t depth);
+};
+
+#endif /* CBOR_HPP */
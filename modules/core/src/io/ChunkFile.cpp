@@ -22,14 +22,44 @@
 */
 
 #include <ChunkFile.hpp>
+#include <Crc32.hpp>
 #include <Endian.hpp>
 #include <Error.hpp>
+#include <ThreadPool.hpp>
 #include <cassert>
+#include <cstring>
 #include <sstream>
 
 const size_t ChunkFile::CHUNK_HEADER_SIZE = 16;
+const size_t ChunkFile::CHUNK_HEADER_EXTENDED_SIZE = 32;
+const size_t ChunkFile::DIRECTORY_ENTRY_SIZE = 24;
+const size_t ChunkFile::DIRECTORY_FOOTER_SIZE = 16;
+const uint32_t ChunkFile::CHUNK_ID_DIRECTORY = 0x43444952U;
+const uint8_t ChunkFile::CHUNK_FLAG_CHECKSUM = 0x01U;
 
-ChunkFile::ChunkFile()
+/** Verification reads checksummed data in segments of this size. */
+static const uint64_t CHUNK_VERIFY_SEGMENT_SIZE = 8 * 1024 * 1024;
+
+static void ChunkFile_decode(ChunkFile::Chunk &c, const uint8_t *buffer)
+{
+    c.type = ltoh32(&buffer[0]);
+    c.major_version = buffer[4];
+    c.minor_version = buffer[5];
+    c.header_lenght = ltoh16(&buffer[6]);
+    c.total_length = ltoh64(&buffer[8]);
+}
+
+static void ChunkFile_decodeExtended(ChunkFile::Chunk &c,
+                                     const uint8_t *buffer)
+{
+    c.codec = buffer[16];
+    c.flags = buffer[17];
+    c.stride = ltoh16(&buffer[18]);
+    c.checksum = ltoh32(&buffer[20]);
+    c.data_length = ltoh64(&buffer[24]);
+}
+
+ChunkFile::ChunkFile() : directoryOffset_(0), hasDirectory_(false)
 {
     // empty
 }
@@ -70,11 +100,29 @@ std::string ChunkFile::status() const
 
 void ChunkFile::open(const std::string &path, const std::string &mode)
 {
+    directory_.clear();
+    directoryOffset_ = 0;
+    hasDirectory_ = false;
+
     file_.open(path, mode);
+
+    if (mode.find("r") != std::string::npos)
+    {
+        readDirectory();
+    }
+
+    if (mode.find("m") != std::string::npos)
+    {
+        (void)file_.map();
+    }
 }
 
 void ChunkFile::close()
 {
+    directory_.clear();
+    directoryOffset_ = 0;
+    hasDirectory_ = false;
+
     file_.close();
 }
 
@@ -100,20 +148,47 @@ void ChunkFile::write(const uint8_t *buffer, uint64_t nbyte)
 
 void ChunkFile::read(ChunkFile::Chunk &c)
 {
-    uint8_t buffer[CHUNK_HEADER_SIZE];
+    uint8_t buffer[CHUNK_HEADER_EXTENDED_SIZE];
 
     file_.read(buffer, CHUNK_HEADER_SIZE);
-
-    c.type = ltoh32(&buffer[0]);
-    c.major_version = buffer[4];
-    c.minor_version = buffer[5];
-    c.header_lenght = ltoh16(&buffer[6]);
-    c.total_length = ltoh64(&buffer[8]);
+    ChunkFile_decode(c, buffer);
+
+    if (c.header_lenght < CHUNK_HEADER_SIZE ||
+        c.total_length < c.header_lenght)
+    {
+        THROW("Invalid chunk header in " + status());
+    }
+
+    if (c.header_lenght >= CHUNK_HEADER_EXTENDED_SIZE)
+    {
+        file_.read(&buffer[CHUNK_HEADER_SIZE],
+                   CHUNK_HEADER_EXTENDED_SIZE - CHUNK_HEADER_SIZE);
+        ChunkFile_decodeExtended(c, buffer);
+
+        // Skip unknown header fields from newer versions
+        file_.skip(c.header_lenght - CHUNK_HEADER_EXTENDED_SIZE);
+    }
+    else
+    {
+        c.codec = Compression::CODEC_NONE;
+        c.flags = 0;
+        c.stride = 0;
+        c.checksum = 0;
+        c.data_length = c.total_length - c.header_lenght;
+
+        file_.skip(c.header_lenght - CHUNK_HEADER_SIZE);
+    }
 }
 
 void ChunkFile::write(const ChunkFile::Chunk &c)
 {
-    uint8_t buffer[CHUNK_HEADER_SIZE];
+    uint8_t buffer[CHUNK_HEADER_EXTENDED_SIZE];
+    size_t n = CHUNK_HEADER_SIZE;
+
+    if (c.type != CHUNK_ID_DIRECTORY)
+    {
+        addEntry(c, offset());
+    }
 
     htol32(&buffer[0], c.type);
     buffer[4] = c.major_version;
@@ -121,10 +196,619 @@ void ChunkFile::write(const ChunkFile::Chunk &c)
     htol16(&buffer[6], c.header_lenght);
     htol64(&buffer[8], c.total_length);
 
-    file_.write(buffer, CHUNK_HEADER_SIZE);
+    if (c.header_lenght >= CHUNK_HEADER_EXTENDED_SIZE)
+    {
+        buffer[16] = c.codec;
+        buffer[17] = c.flags;
+        htol16(&buffer[18], c.stride);
+        htol32(&buffer[20], c.checksum);
+        htol64(&buffer[24], c.data_length);
+        n = CHUNK_HEADER_EXTENDED_SIZE;
+    }
+
+    file_.write(buffer, n);
+
+    // Padding up to header length
+    if (c.header_lenght > n)
+    {
+        std::memset(buffer, 0, sizeof(buffer));
+        for (size_t i = n; i < c.header_lenght; i += sizeof(buffer))
+        {
+            size_t pad = c.header_lenght - i;
+            if (pad > sizeof(buffer))
+            {
+                pad = sizeof(buffer);
+            }
+            file_.write(buffer, pad);
+        }
+    }
 }
 
-Json &ChunkFile::Chunk::serialize(Json &out) const
+static void ChunkFile_check(const ChunkFile::Chunk &c,
+                            const std::vector<uint8_t> &stored,
+                            const std::string &path)
+{
+    if (c.header_lenght >= ChunkFile::CHUNK_HEADER_EXTENDED_SIZE &&
+        (c.flags & ChunkFile::CHUNK_FLAG_CHECKSUM) &&
+        crc32c(0, stored.data(), stored.size()) != c.checksum)
+    {
+        THROW("Chunk checksum mismatch in file '" + path + "'");
+    }
+}
+
+void ChunkFile::read(const Chunk &c, std::vector<uint8_t> &data)
+{
+    uint64_t nbyte = c.total_length - c.header_lenght;
+
+    if (c.codec == Compression::CODEC_NONE)
+    {
+        data.resize(nbyte);
+        file_.read(data.data(), nbyte);
+        ChunkFile_check(c, data, path());
+        return;
+    }
+
+    std::vector<uint8_t> packed;
+    packed.resize(nbyte);
+    file_.read(packed.data(), nbyte);
+    ChunkFile_check(c, packed, path());
+
+    data.resize(c.data_length);
+    Compression::decompress(data.data(),
+                            c.data_length,
+                            packed.data(),
+                            nbyte,
+                            c.codec,
+                            c.stride);
+}
+
+void ChunkFile::read(size_t id, Chunk &c, std::vector<uint8_t> &data)
+{
+    read(id, c);
+    read(c, data);
+}
+
+void ChunkFile::read(const std::vector<size_t> &ids,
+                     std::vector<std::vector<uint8_t>> &data,
+                     ThreadPool &pool)
+{
+    std::vector<Chunk> chunks(ids.size());
+    std::vector<std::vector<uint8_t>> packed(ids.size());
+
+    // Read stored data in file order
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        Chunk &c = chunks[i];
+        read(ids[i], c);
+        packed[i].resize(c.total_length - c.header_lenght);
+        file_.read(packed[i].data(), packed[i].size());
+    }
+
+    // Decompress chunks in parallel
+    data.resize(ids.size());
+    pool.run(ids.size(), [&](size_t i) {
+        const Chunk &c = chunks[i];
+        ChunkFile_check(c, packed[i], path());
+        if (c.codec == Compression::CODEC_NONE)
+        {
+            data[i].swap(packed[i]);
+        }
+        else
+        {
+            data[i].resize(c.data_length);
+            Compression::decompress(data[i].data(),
+                                    c.data_length,
+                                    packed[i].data(),
+                                    packed[i].size(),
+                                    c.codec,
+                                    c.stride);
+            std::vector<uint8_t>().swap(packed[i]);
+        }
+    });
+}
+
+void ChunkFile::write(Chunk &c, const uint8_t *buffer, uint64_t nbyte)
+{
+    std::vector<uint8_t> packed;
+    const uint8_t *data = buffer;
+    uint64_t length = nbyte;
+
+    if (c.codec != Compression::CODEC_NONE)
+    {
+        Compression::compress(packed, buffer, nbyte, c.codec, c.stride);
+        if (packed.size() < nbyte)
+        {
+            data = packed.data();
+            length = packed.size();
+        }
+        else
+        {
+            // Uncompressed fallback
+            c.codec = Compression::CODEC_NONE;
+        }
+    }
+
+    c.header_lenght = alignedHeaderLength();
+    c.total_length = c.header_lenght + length;
+    c.data_length = nbyte;
+    c.checksum = 0;
+    if (c.flags & CHUNK_FLAG_CHECKSUM)
+    {
+        c.checksum = crc32c(0, data, length);
+    }
+
+    write(c);
+    file_.write(data, length);
+}
+
+uint16_t ChunkFile::alignedHeaderLength() const
+{
+    // Extend the header to align data to 8 bytes
+    uint64_t headerLength = CHUNK_HEADER_EXTENDED_SIZE;
+    headerLength += (8 - ((offset() + headerLength) & 7U)) & 7U;
+
+    return static_cast<uint16_t>(headerLength);
+}
+
+void ChunkFile::readJson(size_t id, Json &out)
+{
+    Chunk c;
+
+    if (isMapped())
+    {
+        const uint8_t *data = map(id, c);
+        out.deserializeCbor(data, static_cast<size_t>(c.data_length));
+    }
+    else
+    {
+        std::vector<uint8_t> data;
+        read(id, c, data);
+        out.deserializeCbor(data.data(), data.size());
+    }
+}
+
+void ChunkFile::writeJson(uint32_t type, const Json &in)
+{
+    std::vector<uint8_t> data = in.serializeCbor();
+
+    // Uncompressed, so the chunk can be decoded from mapped file
+    Chunk c;
+    c.type = type;
+    c.major_version = 1;
+    c.minor_version = 0;
+    c.codec = Compression::CODEC_NONE;
+    c.flags = CHUNK_FLAG_CHECKSUM;
+    c.stride = 0;
+    write(c, data.data(), data.size());
+}
+
+void ChunkFile::listEntries(std::vector<Entry> &entries,
+                            std::vector<Entry> &failed) const
+{
+    uint8_t buffer[CHUNK_HEADER_SIZE];
+    uint64_t end = file_.size();
+    uint64_t offset = 0;
+    Chunk c;
+
+    if (hasDirectory_)
+    {
+        entries = directory_;
+        return;
+    }
+
+    // Walk chunk headers, the rest of the file after the first invalid
+    // header is reported as one failed entry
+    entries.clear();
+    while (offset < end)
+    {
+        if (end - offset < CHUNK_HEADER_SIZE)
+        {
+            failed.push_back({0, offset, end - offset});
+            return;
+        }
+
+        file_.read(buffer, CHUNK_HEADER_SIZE, offset);
+        ChunkFile_decode(c, buffer);
+
+        if (c.header_lenght < CHUNK_HEADER_SIZE ||
+            c.total_length < c.header_lenght || c.total_length > end - offset)
+        {
+            failed.push_back({c.type, offset, end - offset});
+            return;
+        }
+
+        entries.push_back({c.type, offset, c.total_length});
+        offset += c.total_length;
+    }
+}
+
+bool ChunkFile::verify(std::vector<Entry> &failed, ThreadPool &pool) const
+{
+    /** Part of chunk data verified by one task. */
+    struct Segment
+    {
+        size_t entry;
+        uint64_t offset;
+        uint64_t length;
+        uint32_t checksum;
+        bool error;
+    };
+
+    std::vector<Entry> entries;
+    std::vector<Chunk> chunks;
+    std::vector<bool> valid;
+    std::vector<Segment> segments;
+    uint8_t buffer[CHUNK_HEADER_EXTENDED_SIZE];
+
+    failed.clear();
+    listEntries(entries, failed);
+
+    // Check chunk headers against the directory and split checksummed
+    // data into segments which are verified in parallel
+    chunks.resize(entries.size());
+    valid.resize(entries.size(), true);
+
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        const Entry &e = entries[i];
+        Chunk &c = chunks[i];
+
+        if (e.total_length < CHUNK_HEADER_SIZE)
+        {
+            valid[i] = false;
+            continue;
+        }
+
+        size_t n = CHUNK_HEADER_SIZE;
+        if (e.total_length >= CHUNK_HEADER_EXTENDED_SIZE)
+        {
+            n = CHUNK_HEADER_EXTENDED_SIZE;
+        }
+
+        file_.read(buffer, n, e.offset);
+        ChunkFile_decode(c, buffer);
+
+        if (c.type != e.type || c.total_length != e.total_length ||
+            c.header_lenght < CHUNK_HEADER_SIZE ||
+            c.header_lenght > c.total_length)
+        {
+            valid[i] = false;
+            continue;
+        }
+
+        if (c.header_lenght < CHUNK_HEADER_EXTENDED_SIZE)
+        {
+            continue;
+        }
+
+        ChunkFile_decodeExtended(c, buffer);
+        if (!(c.flags & CHUNK_FLAG_CHECKSUM))
+        {
+            continue;
+        }
+
+        uint64_t from = e.offset + c.header_lenght;
+        uint64_t to = e.offset + c.total_length;
+        do
+        {
+            uint64_t length = to - from;
+            if (length > CHUNK_VERIFY_SEGMENT_SIZE)
+            {
+                length = CHUNK_VERIFY_SEGMENT_SIZE;
+            }
+            segments.push_back({i, from, length, 0, false});
+            from += length;
+        } while (from < to);
+    }
+
+    pool.run(segments.size(), [&](size_t i) {
+        const size_t blockSize = 1024 * 1024;
+        std::vector<uint8_t> block(blockSize);
+        Segment &s = segments[i];
+        uint64_t offset = s.offset;
+        uint64_t end = s.offset + s.length;
+
+        try
+        {
+            while (offset < end)
+            {
+                size_t n = blockSize;
+                if (end - offset < n)
+                {
+                    n = static_cast<size_t>(end - offset);
+                }
+                file_.read(block.data(), n, offset);
+                s.checksum = crc32c(s.checksum, block.data(), n);
+                offset += n;
+            }
+        }
+        catch (std::exception &)
+        {
+            s.error = true;
+        }
+    });
+
+    // Combine segment checksums of each chunk
+    for (size_t i = 0; i < segments.size();)
+    {
+        size_t entry = segments[i].entry;
+        uint32_t checksum = segments[i].checksum;
+        bool error = segments[i].error;
+
+        for (i++; i < segments.size() && segments[i].entry == entry; i++)
+        {
+            checksum = crc32cCombine(checksum,
+                                     segments[i].checksum,
+                                     segments[i].length);
+            error = error || segments[i].error;
+        }
+
+        if (error || checksum != chunks[entry].checksum)
+        {
+            valid[entry] = false;
+        }
+    }
+
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        if (!valid[i])
+        {
+            failed.push_back(entries[i]);
+        }
+    }
+
+    return failed.empty();
+}
+
+void ChunkFile::addEntry(const Chunk &c, uint64_t offset)
+{
+    // Header rewrite of an already written chunk updates its entry
+    for (size_t i = directory_.size(); i > 0; i--)
+    {
+        Entry &e = directory_[i - 1];
+        if (e.offset == offset)
+        {
+            e.type = c.type;
+            e.total_length = c.total_length;
+            return;
+        }
+    }
+
+    directory_.push_back({c.type, offset, c.total_length});
+}
+
+void ChunkFile::replaceEntry(size_t id)
+{
+    // The last entry is the new version of chunk id
+    if (id + 1 >= directory_.size())
+    {
+        THROW("Chunk index is out of range in " + status());
+    }
+
+    directory_[id] = directory_.back();
+    directory_.pop_back();
+}
+
+size_t ChunkFile::findEntry(uint32_t type, size_t from) const
+{
+    for (size_t i = from; i < directory_.size(); i++)
+    {
+        if (directory_[i].type == type)
+        {
+            return i;
+        }
+    }
+
+    return directory_.size();
+}
+
+const uint8_t *ChunkFile::map(size_t id, Chunk &c) const
+{
+    const uint8_t *data = file_.mapped();
+
+    if (!data)
+    {
+        THROW("Chunk file is not mapped in " + status());
+    }
+
+    if (id >= directory_.size())
+    {
+        THROW("Chunk index is out of range in " + status());
+    }
+
+    const Entry &e = directory_[id];
+    if (e.total_length < CHUNK_HEADER_SIZE)
+    {
+        THROW("Invalid chunk header in " + status());
+    }
+
+    data += e.offset;
+    ChunkFile_decode(c, data);
+
+    if (c.type != e.type || c.total_length != e.total_length ||
+        c.header_lenght < CHUNK_HEADER_SIZE ||
+        c.header_lenght > c.total_length)
+    {
+        THROW("Invalid chunk header in " + status());
+    }
+
+    if (c.header_lenght >= CHUNK_HEADER_EXTENDED_SIZE)
+    {
+        ChunkFile_decodeExtended(c, data);
+        if (c.codec != Compression::CODEC_NONE)
+        {
+            THROW("Compressed chunk can't be mapped in " + status());
+        }
+    }
+    else
+    {
+        c.codec = Compression::CODEC_NONE;
+        c.flags = 0;
+        c.stride = 0;
+        c.checksum = 0;
+        c.data_length = c.total_length - c.header_lenght;
+    }
+
+    return data + c.header_lenght;
+}
+
+void ChunkFile::seekChunk(size_t id)
+{
+    if (id >= directory_.size())
+    {
+        THROW("Chunk index is out of range in " + status());
+    }
+
+    file_.seek(directory_[id].offset);
+}
+
+void ChunkFile::read(size_t id, Chunk &c)
+{
+    seekChunk(id);
+    read(c);
+
+    if (c.type != directory_[id].type)
+    {
+        THROW("Chunk type does not match directory in " + status());
+    }
+}
+
+void ChunkFile::seekEnd()
+{
+    if (hasDirectory_)
+    {
+        // The next chunk overwrites the old directory
+        file_.seek(directoryOffset_);
+    }
+    else
+    {
+        file_.seek(file_.size());
+    }
+}
+
+void ChunkFile::readDirectory()
+{
+    uint8_t buffer[DIRECTORY_ENTRY_SIZE];
+    uint64_t fileSize = file_.size();
+
+    if (fileSize < CHUNK_HEADER_SIZE + 8 + DIRECTORY_FOOTER_SIZE)
+    {
+        return;
+    }
+
+    // Footer
+    file_.seek(fileSize - DIRECTORY_FOOTER_SIZE);
+    file_.read(buffer, DIRECTORY_FOOTER_SIZE);
+
+    // Bounds are compared by subtraction so that no sum can overflow
+    uint64_t dirOffset = ltoh64(&buffer[0]);
+    if (ltoh32(&buffer[8]) != CHUNK_ID_DIRECTORY ||
+        dirOffset > fileSize - (CHUNK_HEADER_SIZE + 8 + DIRECTORY_FOOTER_SIZE))
+    {
+        // Files without directory are accessed sequentially
+        file_.seek(0);
+        return;
+    }
+
+    // Directory chunk
+    Chunk c;
+    file_.seek(dirOffset);
+    read(c);
+
+    uint64_t headerLength = c.header_lenght;
+    if (c.type != CHUNK_ID_DIRECTORY ||
+        c.total_length != fileSize - dirOffset ||
+        headerLength + 8 + DIRECTORY_FOOTER_SIZE > c.total_length)
+    {
+        THROW("Invalid chunk directory in " + status());
+    }
+
+    file_.seek(dirOffset + headerLength);
+    file_.read(buffer, 8);
+    uint64_t n = ltoh64(&buffer[0]);
+
+    uint64_t entriesLength =
+        c.total_length - headerLength - 8 - DIRECTORY_FOOTER_SIZE;
+    if (n > entriesLength / DIRECTORY_ENTRY_SIZE ||
+        n * DIRECTORY_ENTRY_SIZE != entriesLength)
+    {
+        THROW("Invalid chunk directory size in " + status());
+    }
+
+    directory_.resize(n);
+    for (uint64_t i = 0; i < n; i++)
+    {
+        file_.read(buffer, DIRECTORY_ENTRY_SIZE);
+
+        Entry &e = directory_[i];
+        e.type = ltoh32(&buffer[0]);
+        e.offset = ltoh64(&buffer[8]);
+        e.total_length = ltoh64(&buffer[16]);
+
+        if (e.offset > dirOffset || e.total_length > dirOffset - e.offset)
+        {
+            THROW("Invalid chunk directory entry in " + status());
+        }
+    }
+
+    directoryOffset_ = dirOffset;
+    hasDirectory_ = true;
+
+    file_.seek(0);
+}
+
+void ChunkFile::writeDirectory()
+{
+    uint8_t buffer[DIRECTORY_ENTRY_SIZE];
+    uint64_t n = directory_.size();
+
+    Chunk c;
+    c.type = CHUNK_ID_DIRECTORY;
+    c.major_version = 1;
+    c.minor_version = 0;
+    c.header_lenght = CHUNK_HEADER_SIZE;
+    c.codec = Compression::CODEC_NONE;
+    c.flags = 0;
+    c.stride = 0;
+    c.checksum = 0;
+    c.total_length = CHUNK_HEADER_SIZE + 8 + (n * DIRECTORY_ENTRY_SIZE) +
+                     DIRECTORY_FOOTER_SIZE;
+
+    // The directory follows the last chunk
+    uint64_t dirOffset = 0;
+    for (const auto &e : directory_)
+    {
+        if (e.offset + e.total_length > dirOffset)
+        {
+            dirOffset = e.offset + e.total_length;
+        }
+    }
+
+    file_.seek(dirOffset);
+    write(c);
+
+    htol64(&buffer[0], n);
+    file_.write(buffer, 8);
+
+    for (const auto &e : directory_)
+    {
+        htol32(&buffer[0], e.type);
+        htol32(&buffer[4], 0);
+        htol64(&buffer[8], e.offset);
+        htol64(&buffer[16], e.total_length);
+        file_.write(buffer, DIRECTORY_ENTRY_SIZE);
+    }
+
+    htol64(&buffer[0], dirOffset);
+    htol32(&buffer[8], CHUNK_ID_DIRECTORY);
+    htol32(&buffer[12], 0);
+    file_.write(buffer, DIRECTORY_FOOTER_SIZE);
+
+    directoryOffset_ = dirOffset;
+    hasDirectory_ = true;
+}
+
+static std::string ChunkFile_typeString(uint32_t type)
 {
     std::string str;
 
@@ -134,11 +818,34 @@ Json &ChunkFile::Chunk::serialize(Json &out) const
     str[2] = static_cast<char>((type >> 8) & 0xFFU);
     str[3] = static_cast<char>(type & 0xFFU);
 
-    out["type"] = str;
+    return str;
+}
+
+Json &ChunkFile::Entry::serialize(Json &out) const
+{
+    out["type"] = ChunkFile_typeString(type);
+    out["offset"] = offset;
+    out["total_length"] = total_length;
+
+    return out;
+}
+
+Json &ChunkFile::Chunk::serialize(Json &out) const
+{
+    out["type"] = ChunkFile_typeString(type);
     out["major_version"] = major_version;
     out["minor_version"] = minor_version;
     out["header_lenght"] = header_lenght;
     out["total_length"] = total_length;
 
+    if (header_lenght >= CHUNK_HEADER_EXTENDED_SIZE)
+    {
+        out["codec"] = codec;
+        out["flags"] = flags;
+        out["stride"] = stride;
+        out["checksum"] = checksum;
+        out["data_length"] = data_length;
+    }
+
     return out;
 }
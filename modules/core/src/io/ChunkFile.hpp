@@ -24,14 +24,55 @@
 #ifndef CHUNK_FILE_HPP
 #define CHUNK_FILE_HPP
 
+#include <ChunkView.hpp>
+#include <Compression.hpp>
 #include <File.hpp>
 #include <Json.hpp>
-
-/** Chunk file. */
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+class ThreadPool;
+
+/** Chunk file.
+
+    A chunk file is a sequence of chunks. Each chunk starts with a header
+    which contains chunk type and total chunk length including the header.
+
+    The file may end with an optional directory chunk which lists type,
+    offset and length of all other chunks. The directory is followed by
+    a fixed size footer with the offset of the directory chunk. When the
+    directory is present, chunks can be accessed by their index without
+    walking all chunk headers from the start of the file. New chunks are
+    appended in place of the old directory, so only the directory is
+    rewritten. A chunk can be replaced by appending its new version and
+    repointing its directory entry, the old data then stay unused in the
+    file.
+
+    Chunks with extended header can store compressed data. The header
+    contains compression codec and uncompressed data length. Data which
+    does not compress is stored uncompressed. The extended header can also
+    hold CRC-32C checksum of the stored data. Checksums are validated when
+    chunk data are read and by verification of the whole file.
+
+    A file opened with mode "m" is also memory mapped. Uncompressed chunk
+    data can then be accessed through typed read-only views without copying.
+    Data of chunks written with extended header start at 8 byte aligned file
+    offsets, so views of 64-bit values are aligned. Views do not validate
+    checksums, use verify() for that.
+
+    Metadata can be stored as a chunk with Json value in binary CBOR
+    encoding. Mapped metadata chunks are decoded without copying.
+*/
 class ChunkFile
 {
 public:
     static const size_t CHUNK_HEADER_SIZE;
+    static const size_t CHUNK_HEADER_EXTENDED_SIZE;
+    static const size_t DIRECTORY_ENTRY_SIZE;
+    static const size_t DIRECTORY_FOOTER_SIZE;
+    static const uint32_t CHUNK_ID_DIRECTORY;
+    static const uint8_t CHUNK_FLAG_CHECKSUM;
 
     /** Chunk. */
     struct Chunk
@@ -42,6 +83,23 @@ public:
         uint16_t header_lenght;
         uint64_t total_length;
 
+        // extended header
+        uint8_t codec;
+        uint8_t flags;
+        uint16_t stride;
+        uint32_t checksum;
+        uint64_t data_length;
+
+        Json &serialize(Json &out) const;
+    };
+
+    /** Chunk directory entry. */
+    struct Entry
+    {
+        uint32_t type;
+        uint64_t offset;
+        uint64_t total_length;
+
         Json &serialize(Json &out) const;
     };
 
@@ -60,15 +118,83 @@ public:
     void write(const Chunk &c);
     void write(const uint8_t *buffer, uint64_t nbyte);
 
+    // chunk data
+    void read(const Chunk &c, std::vector<uint8_t> &data);
+    void read(size_t id, Chunk &c, std::vector<uint8_t> &data);
+    void read(const std::vector<size_t> &ids,
+              std::vector<std::vector<uint8_t>> &data,
+              ThreadPool &pool);
+
+    void write(Chunk &c, const uint8_t *buffer, uint64_t nbyte);
+    uint16_t alignedHeaderLength() const;
+
+    // metadata
+    void readJson(size_t id, Json &out);
+    void writeJson(uint32_t type, const Json &in);
+
+    // integrity
+    bool verify(std::vector<Entry> &failed, ThreadPool &pool) const;
+
     bool eof() const;
     uint64_t size() const;
     uint64_t offset() const;
     const std::string &path() const;
 
+    // directory
+    bool hasDirectory() const { return hasDirectory_; }
+    size_t getEntrySize() const { return directory_.size(); }
+    const Entry &getEntry(size_t id) const { return directory_[id]; }
+    size_t findEntry(uint32_t type, size_t from = 0) const;
+    void replaceEntry(size_t id);
+
+    // memory mapping
+    bool isMapped() const { return file_.mapped() != nullptr; }
+    const uint8_t *map(size_t id, Chunk &c) const;
+    template <class T> ChunkView<T> view(size_t id) const;
+
+    void seekChunk(size_t id);
+    void read(size_t id, Chunk &c);
+    void seekEnd();
+    void writeDirectory();
+
 protected:
     File file_;
+    std::vector<Entry> directory_;
+    uint64_t directoryOffset_;
+    bool hasDirectory_;
 
     std::string status() const;
+    void listEntries(std::vector<Entry> &entries,
+                     std::vector<Entry> &failed) const;
+    void readDirectory();
+    void addEntry(const Chunk &c, uint64_t offset);
 };
 
+template <class T> ChunkView<T> ChunkFile::view(size_t id) const
+{
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "Chunk view requires trivially copyable type");
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+    if (sizeof(T) > 1)
+    {
+        THROW("Chunk view of multi-byte values requires little endian host");
+    }
+#endif
+
+    Chunk c;
+    const uint8_t *data = map(id, c);
+    uint64_t nbyte = c.total_length - c.header_lenght;
+
+    if (nbyte % sizeof(T) != 0 ||
+        reinterpret_cast<uintptr_t>(data) % alignof(T) != 0)
+    {
+        THROW("Chunk data can't be viewed as the requested type in file '" +
+              path() + "'");
+    }
+
+    return ChunkView<T>(reinterpret_cast<const T *>(data),
+                        static_cast<size_t>(nbyte / sizeof(T)));
+}
+
 #endif /* CHUNK_FILE_HPP */
@@ -0,0 +1,70 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file ChunkView.hpp
+*/
+
+#ifndef CHUNK_VIEW_HPP
+#define CHUNK_VIEW_HPP
+
+#include <Error.hpp>
+#include <cassert>
+#include <cstddef>
+
+/** Chunk view.
+
+    Read-only typed array in memory owned by somebody else, usually data of
+    a chunk in a memory mapped ChunkFile. The view is valid only while the
+    memory stays mapped.
+*/
+template <class T> class ChunkView
+{
+public:
+    ChunkView() : data_(nullptr), size_(0) {}
+    ChunkView(const T *data, size_t size) : data_(data), size_(size) {}
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const T *data() const { return data_; }
+
+    const T *begin() const { return data_; }
+    const T *end() const { return data_ + size_; }
+
+    const T &operator[](size_t idx) const
+    {
+        assert(idx < size_);
+        return data_[idx];
+    }
+
+    const T &at(size_t idx) const
+    {
+        if (idx >= size_)
+        {
+            THROW("Chunk view index is out of range");
+        }
+        return data_[idx];
+    }
+
+protected:
+    const T *data_;
+    size_t size_;
+};
+
+#endif /* CHUNK_VIEW_HPP */
@@ -0,0 +1,606 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file Compression.cpp
+*/
+
+#include <Compression.hpp>
+#include <Endian.hpp>
+#include <Error.hpp>
+#include <ThreadPool.hpp>
+#include <cstring>
+
+const uint64_t Compression::BLOCK_SIZE = 4194304;
+
+static const size_t COMPRESSION_LZ4_MIN_MATCH = 4;
+static const size_t COMPRESSION_LZ4_LAST_LITERALS = 5;
+static const size_t COMPRESSION_LZ4_MATCH_LIMIT = 12;
+static const size_t COMPRESSION_LZ4_MAX_OFFSET = 65535;
+static const uint32_t COMPRESSION_LZ4_HASH_BITS = 16;
+static const size_t COMPRESSION_DELTA_GROUP = 128;
+
+static inline uint32_t Compression_read32(const uint8_t *p)
+{
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t Compression_hash(uint32_t v)
+{
+    return (v * 2654435761U) >> (32 - COMPRESSION_LZ4_HASH_BITS);
+}
+
+static inline void Compression_writeLength(std::vector<uint8_t> &out,
+                                           size_t length)
+{
+    while (length >= 255)
+    {
+        out.push_back(255);
+        length -= 255;
+    }
+    out.push_back(static_cast<uint8_t>(length));
+}
+
+static inline size_t Compression_readLength(const uint8_t *in,
+                                            size_t n,
+                                            size_t &ip)
+{
+    size_t length = 0;
+    uint8_t b;
+
+    do
+    {
+        if (ip >= n)
+        {
+            THROW("Invalid LZ4 data");
+        }
+        b = in[ip++];
+        length += b;
+    } while (b == 255);
+
+    return length;
+}
+
+void Compression::compressLz4(std::vector<uint8_t> &out,
+                              const uint8_t *in,
+                              size_t n)
+{
+    std::vector<uint32_t> table(1U << COMPRESSION_LZ4_HASH_BITS, 0);
+    size_t anchor = 0;
+    size_t ip = 0;
+
+    out.clear();
+    out.reserve(n + (n / 255) + 16);
+
+    if (n > COMPRESSION_LZ4_MATCH_LIMIT)
+    {
+        size_t ipLimit = n - COMPRESSION_LZ4_MATCH_LIMIT;
+        size_t matchLimit = n - COMPRESSION_LZ4_LAST_LITERALS;
+
+        while (ip < ipLimit)
+        {
+            uint32_t sequence = Compression_read32(in + ip);
+            uint32_t h = Compression_hash(sequence);
+            size_t ref = table[h];
+            table[h] = static_cast<uint32_t>(ip);
+
+            if (ref >= ip || ip - ref > COMPRESSION_LZ4_MAX_OFFSET ||
+                Compression_read32(in + ref) != sequence)
+            {
+                // Skip faster through data which does not compress
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+
+            // Extend the match
+            size_t length = COMPRESSION_LZ4_MIN_MATCH;
+            while (ip + length < matchLimit &&
+                   in[ref + length] == in[ip + length])
+            {
+                length++;
+            }
+
+            // Sequence
+            size_t literals = ip - anchor;
+            size_t matchCode = length - COMPRESSION_LZ4_MIN_MATCH;
+            uint8_t token = static_cast<uint8_t>(
+                ((literals < 15 ? literals : 15) << 4) |
+                (matchCode < 15 ? matchCode : 15));
+            out.push_back(token);
+            if (literals >= 15)
+            {
+                Compression_writeLength(out, literals - 15);
+            }
+            out.insert(out.end(), in + anchor, in + ip);
+
+            size_t offset = ip - ref;
+            out.push_back(static_cast<uint8_t>(offset & 0xFFU));
+            out.push_back(static_cast<uint8_t>(offset >> 8));
+            if (matchCode >= 15)
+            {
+                Compression_writeLength(out, matchCode - 15);
+            }
+
+            ip += length;
+            anchor = ip;
+        }
+    }
+
+    // Last literals
+    size_t literals = n - anchor;
+    out.push_back(static_cast<uint8_t>((literals < 15 ? literals : 15) << 4));
+    if (literals >= 15)
+    {
+        Compression_writeLength(out, literals - 15);
+    }
+    out.insert(out.end(), in + anchor, in + n);
+}
+
+void Compression::decompressLz4(uint8_t *out,
+                                size_t outSize,
+                                const uint8_t *in,
+                                size_t n)
+{
+    size_t ip = 0;
+    size_t op = 0;
+
+    while (ip < n)
+    {
+        uint8_t token = in[ip++];
+
+        // Literals
+        size_t literals = token >> 4;
+        if (literals == 15)
+        {
+            literals += Compression_readLength(in, n, ip);
+        }
+
+        if (literals > n - ip || literals > outSize - op)
+        {
+            THROW("Invalid LZ4 literal length");
+        }
+
+        std::memcpy(out + op, in + ip, literals);
+        ip += literals;
+        op += literals;
+
+        if (ip == n)
+        {
+            break;
+        }
+
+        // Match
+        if (n - ip < 2)
+        {
+            THROW("Invalid LZ4 match offset");
+        }
+
+        size_t offset = static_cast<size_t>(in[ip]) |
+                        (static_cast<size_t>(in[ip + 1]) << 8);
+        ip += 2;
+
+        if (offset == 0 || offset > op)
+        {
+            THROW("Invalid LZ4 match offset");
+        }
+
+        size_t length = token & 15U;
+        if (length == 15)
+        {
+            length += Compression_readLength(in, n, ip);
+        }
+        length += COMPRESSION_LZ4_MIN_MATCH;
+
+        if (length > outSize - op)
+        {
+            THROW("Invalid LZ4 match length");
+        }
+
+        const uint8_t *ref = out + op - offset;
+        if (offset >= length)
+        {
+            std::memcpy(out + op, ref, length);
+        }
+        else
+        {
+            // Overlapping copy repeats the last 'offset' bytes
+            for (size_t i = 0; i < length; i++)
+            {
+                out[op + i] = ref[i];
+            }
+        }
+        op += length;
+    }
+
+    if (op != outSize)
+    {
+        THROW("Invalid LZ4 data length");
+    }
+}
+
+static inline uint32_t Compression_zigzag(uint32_t v)
+{
+    return (v << 1) ^ (0U - (v >> 31));
+}
+
+static inline uint32_t Compression_unzigzag(uint32_t v)
+{
+    return (v >> 1) ^ (0U - (v & 1U));
+}
+
+static void Compression_pack(std::vector<uint8_t> &out,
+                             const uint32_t *values,
+                             size_t n)
+{
+    uint32_t bits = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        bits |= values[i];
+    }
+
+    uint32_t width = 0;
+    while (width < 32 && (bits >> width) != 0)
+    {
+        width++;
+    }
+
+    out.push_back(static_cast<uint8_t>(width));
+
+    uint64_t acc = 0;
+    uint32_t nacc = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        acc |= static_cast<uint64_t>(values[i]) << nacc;
+        nacc += width;
+        while (nacc >= 8)
+        {
+            out.push_back(static_cast<uint8_t>(acc & 0xFFU));
+            acc >>= 8;
+            nacc -= 8;
+        }
+    }
+
+    if (nacc > 0)
+    {
+        out.push_back(static_cast<uint8_t>(acc & 0xFFU));
+    }
+}
+
+static void Compression_unpack(uint32_t *values,
+                               size_t n,
+                               const uint8_t *in,
+                               size_t size,
+                               size_t &ip)
+{
+    if (ip >= size)
+    {
+        THROW("Invalid delta data");
+    }
+
+    uint32_t width = in[ip++];
+    if (width > 32)
+    {
+        THROW("Invalid delta bit width");
+    }
+
+    size_t nbyte = ((n * width) + 7) / 8;
+    if (nbyte > size - ip)
+    {
+        THROW("Invalid delta data length");
+    }
+
+    uint64_t mask = (1ULL << width) - 1ULL;
+    uint64_t acc = 0;
+    uint32_t nacc = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        while (nacc < width)
+        {
+            acc |= static_cast<uint64_t>(in[ip++]) << nacc;
+            nacc += 8;
+        }
+        values[i] = static_cast<uint32_t>(acc & mask);
+        acc >>= width;
+        nacc -= width;
+    }
+}
+
+void Compression::compressDelta(std::vector<uint8_t> &out,
+                                const uint8_t *in,
+                                size_t n,
+                                size_t stride)
+{
+    size_t nrecords = n / stride;
+    size_t nwords = stride / 4;
+    uint32_t values[COMPRESSION_DELTA_GROUP];
+
+    out.clear();
+    out.reserve(n);
+
+    for (size_t col = 0; col < stride; col += (col < nwords * 4 ? 4 : 1))
+    {
+        bool word = col < nwords * 4;
+        uint32_t prev = 0;
+
+        for (size_t i = 0; i < nrecords; i += COMPRESSION_DELTA_GROUP)
+        {
+            size_t ngroup = nrecords - i;
+            if (ngroup > COMPRESSION_DELTA_GROUP)
+            {
+                ngroup = COMPRESSION_DELTA_GROUP;
+            }
+
+            const uint8_t *ptr = in + (i * stride) + col;
+            for (size_t j = 0; j < ngroup; j++, ptr += stride)
+            {
+                uint32_t v;
+                if (word)
+                {
+                    v = ltoh32(ptr);
+                    values[j] = Compression_zigzag(v - prev);
+                }
+                else
+                {
+                    v = *ptr;
+                    uint32_t d = (v - prev) & 0xFFU;
+                    values[j] = ((d << 1) ^ (0U - (d >> 7))) & 0xFFU;
+                }
+                prev = v;
+            }
+
+            Compression_pack(out, values, ngroup);
+        }
+    }
+
+    // Bytes after the last whole record
+    out.insert(out.end(), in + (nrecords * stride), in + n);
+}
+
+void Compression::decompressDelta(uint8_t *out,
+                                  size_t outSize,
+                                  const uint8_t *in,
+                                  size_t n,
+                                  size_t stride)
+{
+    size_t nrecords = outSize / stride;
+    size_t nwords = stride / 4;
+    uint32_t values[COMPRESSION_DELTA_GROUP];
+    size_t ip = 0;
+
+    for (size_t col = 0; col < stride; col += (col < nwords * 4 ? 4 : 1))
+    {
+        bool word = col < nwords * 4;
+        uint32_t prev = 0;
+
+        for (size_t i = 0; i < nrecords; i += COMPRESSION_DELTA_GROUP)
+        {
+            size_t ngroup = nrecords - i;
+            if (ngroup > COMPRESSION_DELTA_GROUP)
+            {
+                ngroup = COMPRESSION_DELTA_GROUP;
+            }
+
+            Compression_unpack(values, ngroup, in, n, ip);
+
+            uint8_t *ptr = out + (i * stride) + col;
+            for (size_t j = 0; j < ngroup; j++, ptr += stride)
+            {
+                if (word)
+                {
+                    prev += Compression_unzigzag(values[j]);
+                    htol32(ptr, prev);
+                }
+                else
+                {
+                    uint32_t z = values[j];
+                    prev += (z >> 1) ^ (0U - (z & 1U));
+                    *ptr = static_cast<uint8_t>(prev & 0xFFU);
+                }
+            }
+        }
+    }
+
+    size_t tail = outSize - (nrecords * stride);
+    if (n - ip != tail)
+    {
+        THROW("Invalid delta data length");
+    }
+
+    std::memcpy(out + (nrecords * stride), in + ip, tail);
+}
+
+void Compression::compress(std::vector<uint8_t> &out,
+                           const uint8_t *in,
+                           uint64_t n,
+                           uint8_t codec,
+                           uint16_t stride,
+                           ThreadPool *pool)
+{
+    if (codec != CODEC_LZ4 && codec != CODEC_DELTA)
+    {
+        THROW("Unknown compression codec");
+    }
+
+    if (codec == CODEC_DELTA && stride == 0)
+    {
+        THROW("Delta compression requires record stride");
+    }
+
+    // Blocks contain whole records
+    uint64_t blockSize = BLOCK_SIZE;
+    if (codec == CODEC_DELTA)
+    {
+        blockSize = (BLOCK_SIZE / stride) * stride;
+        if (blockSize == 0)
+        {
+            blockSize = stride;
+        }
+    }
+
+    size_t nblocks = static_cast<size_t>((n + blockSize - 1) / blockSize);
+    std::vector<std::vector<uint8_t>> blocks(nblocks);
+
+    auto compressBlock = [&](size_t i) {
+        const uint8_t *src = in + (i * blockSize);
+        size_t length = static_cast<size_t>(
+            (i + 1 < nblocks) ? blockSize : n - (i * blockSize));
+        std::vector<uint8_t> &block = blocks[i];
+
+        if (codec == CODEC_LZ4)
+        {
+            compressLz4(block, src, length);
+        }
+        else
+        {
+            compressDelta(block, src, length, stride);
+        }
+
+        if (block.size() >= length)
+        {
+            block.assign(src, src + length);
+        }
+    };
+
+    if (pool)
+    {
+        pool->run(nblocks, compressBlock);
+    }
+    else
+    {
+        for (size_t i = 0; i < nblocks; i++)
+        {
+            compressBlock(i);
+        }
+    }
+
+    // Output
+    size_t total = 0;
+    for (const auto &it : blocks)
+    {
+        total += 8 + it.size();
+    }
+
+    out.resize(total);
+
+    uint8_t *ptr = out.data();
+    for (size_t i = 0; i < nblocks; i++)
+    {
+        uint64_t length = (i + 1 < nblocks) ? blockSize : n - (i * blockSize);
+        htol32(ptr, static_cast<uint32_t>(blocks[i].size()));
+        htol32(ptr + 4, static_cast<uint32_t>(length));
+        std::memcpy(ptr + 8, blocks[i].data(), blocks[i].size());
+        ptr += 8 + blocks[i].size();
+    }
+}
+
+void Compression::decompress(uint8_t *out,
+                             uint64_t outSize,
+                             const uint8_t *in,
+                             uint64_t n,
+                             uint8_t codec,
+                             uint16_t stride,
+                             ThreadPool *pool)
+{
+    if (codec != CODEC_LZ4 && codec != CODEC_DELTA)
+    {
+        THROW("Unknown compression codec");
+    }
+
+    if (codec == CODEC_DELTA && stride == 0)
+    {
+        THROW("Delta compression requires record stride");
+    }
+
+    // Find blocks
+    struct Block
+    {
+        uint64_t in;
+        uint64_t stored;
+        uint64_t out;
+        uint64_t length;
+    };
+
+    std::vector<Block> blocks;
+    uint64_t ip = 0;
+    uint64_t op = 0;
+
+    while (ip < n)
+    {
+        if (n - ip < 8)
+        {
+            THROW("Invalid compressed block header");
+        }
+
+        Block block;
+        block.stored = ltoh32(in + ip);
+        block.length = ltoh32(in + ip + 4);
+        block.in = ip + 8;
+        block.out = op;
+
+        if (block.stored > n - block.in || block.length > outSize - op)
+        {
+            THROW("Invalid compressed block length");
+        }
+
+        blocks.push_back(block);
+
+        ip = block.in + block.stored;
+        op += block.length;
+    }
+
+    if (op != outSize)
+    {
+        THROW("Invalid compressed data length");
+    }
+
+    auto decompressBlock = [&](size_t i) {
+        const Block &block = blocks[i];
+        const uint8_t *src = in + block.in;
+        uint8_t *dst = out + block.out;
+        size_t stored = static_cast<size_t>(block.stored);
+        size_t length = static_cast<size_t>(block.length);
+
+        if (stored == length)
+        {
+            std::memcpy(dst, src, length);
+        }
+        else if (codec == CODEC_LZ4)
+        {
+            decompressLz4(dst, length, src, stored);
+        }
+        else
+        {
+            decompressDelta(dst, length, src, stored, stride);
+        }
+    };
+
+    if (pool)
+    {
+        pool->run(blocks.size(), decompressBlock);
+    }
+    else
+    {
+        for (size_t i = 0; i < blocks.size(); i++)
+        {
+            decompressBlock(i);
+        }
+    }
+}
@@ -0,0 +1,98 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file Compression.hpp
+*/
+
+#ifndef COMPRESSION_HPP
+#define COMPRESSION_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+/** Compression.
+
+    Compressed data is a sequence of independent blocks. Each block
+    starts with 8 bytes: stored length and uncompressed length. A block
+    which does not compress is stored as is, with both lengths equal.
+    Independent blocks can be compressed and decompressed in parallel.
+
+    CODEC_LZ4 writes blocks in LZ4 block format.
+
+    CODEC_DELTA splits data into fixed size records of 'stride' bytes.
+    Each record is read as columns of 32-bit little endian words followed
+    by columns of remaining bytes. Differences between consecutive values
+    in each column are zigzag encoded and bit packed in groups of 128
+    values. It is suited to sorted point records and coordinates.
+*/
+class Compression
+{
+public:
+    /** Codec identifier stored in chunk header. */
+    enum Codec : uint8_t
+    {
+        CODEC_NONE = 0,
+        CODEC_LZ4 = 1,
+        CODEC_DELTA = 2
+    };
+
+    static const uint64_t BLOCK_SIZE;
+
+    static void compress(std::vector<uint8_t> &out,
+                         const uint8_t *in,
+                         uint64_t n,
+                         uint8_t codec,
+                         uint16_t stride,
+                         ThreadPool *pool = nullptr);
+
+    static void decompress(uint8_t *out,
+                           uint64_t outSize,
+                           const uint8_t *in,
+                           uint64_t n,
+                           uint8_t codec,
+                           uint16_t stride,
+                           ThreadPool *pool = nullptr);
+
+protected:
+    static void compressLz4(std::vector<uint8_t> &out,
+                            const uint8_t *in,
+                            size_t n);
+
+    static void decompressLz4(uint8_t *out,
+                              size_t outSize,
+                              const uint8_t *in,
+                              size_t n);
+
+    static void compressDelta(std::vector<uint8_t> &out,
+                              const uint8_t *in,
+                              size_t n,
+                              size_t stride);
+
+    static void decompressDelta(uint8_t *out,
+                                size_t outSize,
+                                const uint8_t *in,
+                                size_t n,
+                                size_t stride);
+};
+
+#endif /* COMPRESSION_HPP */
@@ -29,21 +29,36 @@
 #include <fcntl.h>
 #include <iostream>
 #include <limits>
+#include <mutex>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#if defined(_WIN32)
+#include <io.h>
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
 #include <filesystem>
 #include <vector>
 
 const int File::INVALID_DESCRIPTOR = -1;
 
-File::File() : fd_(INVALID_DESCRIPTOR), size_(0), offset_(0), path_()
+File::File()
+    : fd_(INVALID_DESCRIPTOR),
+      size_(0),
+      offset_(0),
+      path_(),
+      map_(nullptr),
+      mapSize_(0)
 {
     // empty
 }
 
 File::~File()
 {
+    unmap();
+
     if (fd_ != INVALID_DESCRIPTOR)
     {
         (void)::close(fd_);
@@ -83,6 +98,8 @@ bool File::exists(const std::string &path)
 
 void File::create()
 {
+    unmap();
+
     // close
     if (fd_ != INVALID_DESCRIPTOR)
     {
@@ -121,6 +138,8 @@ void File::open(const std::string &path, const std::string &mode)
     mode_t omode;
     struct stat st;
 
+    unmap();
+
     // close
     if (fd_ != INVALID_DESCRIPTOR)
     {
@@ -194,6 +213,8 @@ void File::close()
 {
     int ret;
 
+    unmap();
+
     if (fd_ != INVALID_DESCRIPTOR)
     {
         ret = ::close(fd_);
@@ -209,6 +230,70 @@ void File::close()
     path_ = "";
 }
 
+const uint8_t *File::map()
+{
+    if (map_ || size_ == 0)
+    {
+        return map_;
+    }
+
+    if (size_ > static_cast<uint64_t>(std::numeric_limits<size_t>::max()))
+    {
+        THROW("Can't map file '" + path_ + "' larger than address space");
+    }
+
+#if defined(_WIN32)
+    HANDLE handle = reinterpret_cast<HANDLE>(::_get_osfhandle(fd_));
+    HANDLE mapping =
+        ::CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping)
+    {
+        THROW("Can't map file '" + path_ + "'");
+    }
+
+    // The view keeps the mapping object alive
+    void *ptr = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    (void)::CloseHandle(mapping);
+    if (!ptr)
+    {
+        THROW("Can't map file '" + path_ + "'");
+    }
+#else
+    void *ptr = ::mmap(nullptr,
+                       static_cast<size_t>(size_),
+                       PROT_READ,
+                       MAP_SHARED,
+                       fd_,
+                       0);
+    if (ptr == MAP_FAILED)
+    {
+        THROW_ERRNO("Can't map file '" + path_ + "'");
+    }
+#endif
+
+    map_ = static_cast<uint8_t *>(ptr);
+    mapSize_ = size_;
+
+    return map_;
+}
+
+void File::unmap()
+{
+    if (!map_)
+    {
+        return;
+    }
+
+#if defined(_WIN32)
+    (void)::UnmapViewOfFile(map_);
+#else
+    (void)::munmap(map_, static_cast<size_t>(mapSize_));
+#endif
+
+    map_ = nullptr;
+    mapSize_ = 0;
+}
+
 int File::seek(int fd, uint64_t offset)
 {
     off_t ret;
@@ -369,6 +454,181 @@ int File::read(int fd, uint8_t *buffer, uint64_t nbyte)
     return 0;
 }
 
+void File::read(uint8_t *buffer, uint64_t nbyte, uint64_t offset) const
+{
+    int ret;
+
+    if (nbyte == 0)
+    {
+        return;
+    }
+
+    if (offset + nbyte > size_)
+    {
+        THROW("Can't read beyond the end of file '" + path_ + "'");
+    }
+
+    ret = read(fd_, buffer, nbyte, offset);
+    if (ret == -1)
+    {
+        THROW_ERRNO("Can't read file '" + path_ + "'");
+    }
+}
+
+void File::write(const uint8_t *buffer, uint64_t nbyte, uint64_t offset)
+{
+    int ret;
+
+    if (nbyte == 0)
+    {
+        return;
+    }
+
+    // Size is not updated, so concurrent writes must not extend the file
+    if (offset + nbyte > size_)
+    {
+        THROW("Can't write beyond the end of file '" + path_ + "'");
+    }
+
+    ret = write(fd_, buffer, nbyte, offset);
+    if (ret == -1)
+    {
+        THROW_ERRNO("Can't write file '" + path_ + "'");
+    }
+}
+
+#if defined(_WIN32)
+/** Serializes positional access on platforms without pread/pwrite. */
+static std::mutex File_positionalMutex;
+#endif
+
+int File::read(int fd, uint8_t *buffer, uint64_t nbyte, uint64_t offset)
+{
+#if defined(_WIN32)
+    std::lock_guard<std::mutex> lock(File_positionalMutex);
+
+    off_t current = ::lseek(fd, 0, SEEK_CUR);
+    if (current == -1 || seek(fd, offset) == -1)
+    {
+        return -1;
+    }
+
+    int ret = read(fd, buffer, nbyte);
+
+    if (::lseek(fd, current, SEEK_SET) == -1)
+    {
+        return -1;
+    }
+
+    return ret;
+#else
+    uint64_t total;
+    uint64_t nread;
+    ssize_t ret;
+
+    assert(buffer);
+
+    if (offset > static_cast<uint64_t>(std::numeric_limits<off_t>::max()))
+    {
+        errno = ERANGE;
+        return -1;
+    }
+
+    total = 0;
+    while (nbyte > 0)
+    {
+        nread = nbyte;
+        if (nread > UINT_MAX)
+        {
+            nread = UINT_MAX;
+        }
+        ret = ::pread(fd,
+                      buffer + total,
+                      static_cast<unsigned int>(nread),
+                      static_cast<off_t>(offset + total));
+        if (ret == 0)
+        {
+            errno = EIO;
+            return -1;
+        }
+        else if (ret == -1)
+        {
+            if (errno != EINTR)
+            {
+                return -1;
+            }
+        }
+        else
+        {
+            total += static_cast<uint64_t>(ret);
+            nbyte -= static_cast<uint64_t>(ret);
+        }
+    }
+    return 0;
+#endif
+}
+
+int File::write(int fd, const uint8_t *buffer, uint64_t nbyte, uint64_t offset)
+{
+#if defined(_WIN32)
+    std::lock_guard<std::mutex> lock(File_positionalMutex);
+
+    off_t current = ::lseek(fd, 0, SEEK_CUR);
+    if (current == -1 || seek(fd, offset) == -1)
+    {
+        return -1;
+    }
+
+    int ret = write(fd, buffer, nbyte);
+
+    if (::lseek(fd, current, SEEK_SET) == -1)
+    {
+        return -1;
+    }
+
+    return ret;
+#else
+    uint64_t total;
+    uint64_t nwrite;
+    ssize_t ret;
+
+    assert(buffer);
+
+    if (offset > static_cast<uint64_t>(std::numeric_limits<off_t>::max()))
+    {
+        errno = ERANGE;
+        return -1;
+    }
+
+    total = 0;
+    while (nbyte > 0)
+    {
+        nwrite = nbyte;
+        if (nwrite > UINT_MAX)
+        {
+            nwrite = UINT_MAX;
+        }
+        ret = ::pwrite(fd,
+                       buffer + total,
+                       static_cast<unsigned int>(nwrite),
+                       static_cast<off_t>(offset + total));
+        if (ret == -1)
+        {
+            if (errno != EINTR)
+            {
+                return -1;
+            }
+        }
+        else
+        {
+            total += static_cast<uint64_t>(ret);
+            nbyte -= static_cast<uint64_t>(ret);
+        }
+    }
+    return 0;
+#endif
+}
+
 void File::write(const uint8_t *buffer,
                  const std::string &path,
                  uint64_t nbyte,
@@ -47,6 +47,16 @@ public:
     void read(uint8_t *buffer, uint64_t nbyte);
     void write(const uint8_t *buffer, uint64_t nbyte);
 
+    // positional access, does not change the file offset
+    void read(uint8_t *buffer, uint64_t nbyte, uint64_t offset) const;
+    void write(const uint8_t *buffer, uint64_t nbyte, uint64_t offset);
+
+    // read-only memory mapping of the whole file
+    const uint8_t *map();
+    void unmap();
+    const uint8_t *mapped() const { return map_; }
+
+    bool isOpen() const { return fd_ != INVALID_DESCRIPTOR; }
     bool eof() const;
     uint64_t size() const;
     uint64_t offset() const;
@@ -76,12 +86,19 @@ protected:
     uint64_t size_;
     uint64_t offset_;
     std::string path_;
+    uint8_t *map_;
+    uint64_t mapSize_;
 
     static const int INVALID_DESCRIPTOR;
 
     static int seek(int fd, uint64_t offset);
     static int read(int fd, uint8_t *buffer, uint64_t nbyte);
     static int write(int fd, const uint8_t *buffer, uint64_t nbyte);
+    static int read(int fd, uint8_t *buffer, uint64_t nbyte, uint64_t offset);
+    static int write(int fd,
+                     const uint8_t *buffer,
+                     uint64_t nbyte,
+                     uint64_t offset);
 };
 
 #endif /* FILE_HPP */
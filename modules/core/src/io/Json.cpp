@@ -21,351 +21,600 @@
     @file Json.cpp
 */
 
+#include <Cbor.hpp>
 #include <File.hpp>
 #include <Json.hpp>
+#include <JsonWriter.hpp>
+#include <charconv>
+#include <cstring>
+#if defined(__x86_64__)
+#include <emmintrin.h>
+#endif
+
+/** Maximum nesting of parsed arrays and objects. */
+static const size_t JSON_MAX_DEPTH = 512;
 
 void Json::clear()
 {
     type_ = TYPE_NULL;
     data_.object.reset();
     data_.array.reset();
-    data_.string.reset();
+    data_.string.clear();
 }
 
 void Json::read(const std::string &filename)
 {
-    std::string data = File::read(filename);
-    deserialize(data);
+    // Parse directly from mapped file without a copy
+    File f;
+    f.open(filename);
+    const char *data = reinterpret_cast<const char *>(f.map());
+    deserialize(data, static_cast<size_t>(f.size()));
 }
 
 void Json::write(const std::string &filename, size_t indent)
 {
-    std::string data = serialize(indent);
-    File::write(filename, data);
+    JsonWriter out(indent);
+    out.create(filename);
+    out.value(*this);
+    out.close();
 }
 
 std::string Json::serialize(size_t indent) const
 {
-    std::ostringstream out;
+    JsonWriter out(indent);
+    out.value(*this);
+    return out.str();
+}
+
+void Json::deserialize(const std::string &in)
+{
+    deserialize(in.c_str(), in.size());
+}
 
-    if (indent == 0)
+static size_t Json_skipWhitespace(const char *in, size_t n, size_t i);
+
+void Json::deserialize(const char *in, size_t n)
+{
+    size_t i = Json_skipWhitespace(in, n, 0);
+    if (i == n)
     {
-        serialize(out);
+        clear();
+        return;
     }
-    else
+
+    deserialize(in, n, i, 0);
+
+    i = Json_skipWhitespace(in, n, i);
+    if (i != n)
     {
-        std::string str;
-        str.resize(indent);
-        for (size_t i = 0; i < str.size(); i++)
+        THROW("JSON unexpected data at offset " + std::to_string(i));
+    }
+}
+
+static bool Json_isWhitespace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+static size_t Json_skipWhitespace(const char *in, size_t n, size_t i)
+{
+    if (i < n && !Json_isWhitespace(in[i]))
+    {
+        return i;
+    }
+
+#if defined(__x86_64__)
+    // Indentation is skipped 16 characters at once
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i tab = _mm_set1_epi8('\t');
+
+    while (i + 16 <= n)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        __m128i ws = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, lf)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, tab)));
+        unsigned int mask =
+            static_cast<unsigned int>(_mm_movemask_epi8(ws)) ^ 0xFFFFU;
+        if (mask != 0)
         {
-            str[i] = ' ';
+            return i + static_cast<size_t>(__builtin_ctz(mask));
         }
-        serialize(out, "", str);
+        i += 16;
     }
+#endif
 
-    return out.str();
+    while (i < n && Json_isWhitespace(in[i]))
+    {
+        i++;
+    }
+
+    return i;
 }
 
-void Json::deserialize(const std::string &in)
+/** Find the next quote or backslash in string characters. */
+static size_t Json_findStringSpecial(const char *in, size_t n, size_t i)
 {
-    deserialize(in.c_str(), in.size());
+#if defined(__x86_64__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+
+    while (i + 16 <= n)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        __m128i special = _mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                       _mm_cmpeq_epi8(v, backslash));
+        unsigned int mask =
+            static_cast<unsigned int>(_mm_movemask_epi8(special));
+        if (mask != 0)
+        {
+            return i + static_cast<size_t>(__builtin_ctz(mask));
+        }
+        i += 16;
+    }
+#endif
+
+    while (i < n && in[i] != '"' && in[i] != '\\')
+    {
+        i++;
+    }
+
+    return i;
 }
 
-void Json::deserialize(const char *in, size_t n)
+static uint32_t Json_parseHex(const char *in, size_t n, size_t i)
+{
+    if (i + 4 > n)
+    {
+        THROW("JSON unexpected end of data in string escape");
+    }
+
+    uint32_t code = 0;
+    for (size_t k = 0; k < 4; k++)
+    {
+        char c = in[i + k];
+        code <<= 4;
+        if (c >= '0' && c <= '9')
+        {
+            code |= static_cast<uint32_t>(c - '0');
+        }
+        else if (c >= 'a' && c <= 'f')
+        {
+            code |= static_cast<uint32_t>(c - 'a' + 10);
+        }
+        else if (c >= 'A' && c <= 'F')
+        {
+            code |= static_cast<uint32_t>(c - 'A' + 10);
+        }
+        else
+        {
+            THROW("JSON invalid unicode escape at offset " +
+                  std::to_string(i));
+        }
+    }
+
+    return code;
+}
+
+static void Json_appendUtf8(std::string &out, uint32_t code)
 {
-    size_t i = 0;
-    deserialize(*this, in, n, i);
+    if (code < 0x80U)
+    {
+        out.push_back(static_cast<char>(code));
+    }
+    else if (code < 0x800U)
+    {
+        out.push_back(static_cast<char>(0xC0U | (code >> 6)));
+        out.push_back(static_cast<char>(0x80U | (code & 0x3FU)));
+    }
+    else if (code < 0x10000U)
+    {
+        out.push_back(static_cast<char>(0xE0U | (code >> 12)));
+        out.push_back(static_cast<char>(0x80U | ((code >> 6) & 0x3FU)));
+        out.push_back(static_cast<char>(0x80U | (code & 0x3FU)));
+    }
+    else
+    {
+        out.push_back(static_cast<char>(0xF0U | (code >> 18)));
+        out.push_back(static_cast<char>(0x80U | ((code >> 12) & 0x3FU)));
+        out.push_back(static_cast<char>(0x80U | ((code >> 6) & 0x3FU)));
+        out.push_back(static_cast<char>(0x80U | (code & 0x3FU)));
+    }
 }
 
-void Json::serialize(std::ostringstream &out) const
+/** Parse string starting with quote at in[i], i is moved after the end. */
+static void Json_parseString(std::string &out,
+                             const char *in,
+                             size_t n,
+                             size_t &i)
 {
-    size_t i = 0;
-    size_t n;
+    size_t start = i + 1;
+    size_t end = Json_findStringSpecial(in, n, start);
 
-    switch (type_)
+    // Fast path without escape sequences
+    if (end < n && in[end] == '"')
     {
-        case TYPE_OBJECT:
-            out << "{";
-            n = data_.object->size();
-            for (auto const &it : *data_.object)
-            {
-                out << "\"" << it.first << "\":";
-                it.second.serialize(out);
-                i++;
-                if (i < n)
-                {
-                    out << ",";
-                }
-            }
-            out << "}";
+        out.assign(in + start, end - start);
+        i = end + 1;
+        return;
+    }
+
+    out.assign(in + start, end - start);
+    i = end;
+
+    while (i < n)
+    {
+        if (in[i] == '"')
+        {
+            i++;
+            return;
+        }
+
+        // Escape sequence
+        if (i + 1 >= n)
+        {
             break;
+        }
 
-        case TYPE_ARRAY:
-            out << "[";
-            n = data_.array->size();
-            for (auto const &it : *data_.array)
+        char c = in[i + 1];
+        i += 2;
+        switch (c)
+        {
+            case '"':
+            case '\\':
+            case '/':
+                out.push_back(c);
+                break;
+            case 'b':
+                out.push_back('\b');
+                break;
+            case 'f':
+                out.push_back('\f');
+                break;
+            case 'n':
+                out.push_back('\n');
+                break;
+            case 'r':
+                out.push_back('\r');
+                break;
+            case 't':
+                out.push_back('\t');
+                break;
+            case 'u':
             {
-                it.serialize(out);
-                i++;
-                if (i < n)
+                uint32_t code = Json_parseHex(in, n, i);
+                i += 4;
+
+                // Surrogate pair
+                if (code >= 0xD800U && code < 0xDC00U && i + 6 <= n &&
+                    in[i] == '\\' && in[i + 1] == 'u')
                 {
-                    out << ",";
+                    uint32_t low = Json_parseHex(in, n, i + 2);
+                    if (low >= 0xDC00U && low < 0xE000U)
+                    {
+                        code = 0x10000U + ((code - 0xD800U) << 10) +
+                               (low - 0xDC00U);
+                        i += 6;
+                    }
                 }
+
+                Json_appendUtf8(out, code);
+                break;
             }
-            out << "]";
-            break;
+            default:
+                // Older files contain unescaped backslashes
+                out.push_back('\\');
+                out.push_back(c);
+                break;
+        }
 
-        case TYPE_STRING:
-            out << "\"" << *data_.string << "\"";
-            break;
+        size_t next = Json_findStringSpecial(in, n, i);
+        out.append(in + i, next - i);
+        i = next;
+    }
 
-        case TYPE_NUMBER:
-            out << data_.number;
-            break;
+    THROW("JSON unexpected end of data in string");
+}
 
-        case TYPE_TRUE:
-            out << "true";
-            break;
+static bool Json_isDigit(const char *in, size_t n, size_t i)
+{
+    return i < n && in[i] >= '0' && in[i] <= '9';
+}
 
-        case TYPE_FALSE:
-            out << "false";
-            break;
+/** Find the end of a number, from_chars also accepts inf, nan and 01. */
+static size_t Json_scanNumber(const char *in, size_t n, size_t i)
+{
+    const size_t start = i;
 
-        case TYPE_NULL:
-        default:
-            out << "null";
-            break;
+    if (i < n && in[i] == '-')
+    {
+        i++;
     }
-}
 
-void Json::serialize(std::ostringstream &out,
-                     const std::string &indent,
-                     const std::string &indent_plus) const
-{
-    std::string indent2;
-    size_t i = 0;
-    size_t n;
+    // Integer part is 0 or starts with a nonzero digit
+    if (!Json_isDigit(in, n, i))
+    {
+        THROW("JSON invalid number at offset " + std::to_string(start));
+    }
 
-    switch (type_)
+    if (in[i] == '0')
     {
-        case TYPE_OBJECT:
-            out << "{\n";
-            indent2 = indent + indent_plus;
-            n = data_.object->size();
-            for (auto const &it : *data_.object)
-            {
-                out << indent2 << "\"" << it.first << "\":";
-                it.second.serialize(out, indent2, indent_plus);
-                i++;
-                if (i < n)
-                {
-                    out << ",\n";
-                }
-            }
-            out << "\n" << indent << "}";
-            break;
+        i++;
+        if (Json_isDigit(in, n, i))
+        {
+            THROW("JSON number with leading zero at offset " +
+                  std::to_string(start));
+        }
+    }
+    else
+    {
+        while (Json_isDigit(in, n, i))
+        {
+            i++;
+        }
+    }
 
-        case TYPE_ARRAY:
-            out << "[";
-            n = data_.array->size();
-            for (auto const &it : *data_.array)
-            {
-                it.serialize(out, indent, indent_plus);
-                i++;
-                if (i < n)
-                {
-                    out << ",";
-                }
-            }
-            out << "]";
-            break;
+    // Fraction and exponent need at least one digit
+    if (i < n && in[i] == '.')
+    {
+        i++;
+        if (!Json_isDigit(in, n, i))
+        {
+            THROW("JSON invalid number at offset " + std::to_string(start));
+        }
+        while (Json_isDigit(in, n, i))
+        {
+            i++;
+        }
+    }
 
-        case TYPE_STRING:
-            out << "\"" << *data_.string << "\"";
-            break;
+    if (i < n && (in[i] == 'e' || in[i] == 'E'))
+    {
+        i++;
+        if (i < n && (in[i] == '+' || in[i] == '-'))
+        {
+            i++;
+        }
+        if (!Json_isDigit(in, n, i))
+        {
+            THROW("JSON invalid number at offset " + std::to_string(start));
+        }
+        while (Json_isDigit(in, n, i))
+        {
+            i++;
+        }
+    }
 
-        case TYPE_NUMBER:
-            out << data_.number;
-            break;
+    return i;
+}
 
-        case TYPE_TRUE:
-            out << "true";
-            break;
+void Json::deserialize(const char *in, size_t n, size_t &i, size_t depth)
+{
+    if (i >= n)
+    {
+        THROW("JSON unexpected end of data");
+    }
 
-        case TYPE_FALSE:
-            out << "false";
-            break;
+    if (depth > JSON_MAX_DEPTH)
+    {
+        THROW("JSON nesting is too deep");
+    }
 
-        case TYPE_NULL:
-        default:
-            out << "null";
-            break;
+    char c = in[i];
+    if (c == '{')
+    {
+        deserializeObject(in, n, i, depth);
+    }
+    else if (c == '[')
+    {
+        deserializeArray(in, n, i, depth);
+    }
+    else if (c == '"')
+    {
+        std::string str;
+        Json_parseString(str, in, n, i);
+        create_string(std::move(str));
+    }
+    else if (c == '-' || (c >= '0' && c <= '9'))
+    {
+        size_t end = Json_scanNumber(in, n, i);
+        double number;
+        std::from_chars_result r = std::from_chars(in + i, in + end, number);
+        if (r.ec != std::errc() || r.ptr != in + end)
+        {
+            THROW("JSON invalid number at offset " + std::to_string(i));
+        }
+        create_number(number);
+        i = end;
+    }
+    else if (n - i >= 4 && std::memcmp(in + i, "null", 4) == 0)
+    {
+        create_type(TYPE_NULL);
+        i += 4;
+    }
+    else if (n - i >= 4 && std::memcmp(in + i, "true", 4) == 0)
+    {
+        create_type(TYPE_TRUE);
+        i += 4;
+    }
+    else if (n - i >= 5 && std::memcmp(in + i, "false", 5) == 0)
+    {
+        create_type(TYPE_FALSE);
+        i += 5;
+    }
+    else
+    {
+        THROW("JSON unexpected character at offset " + std::to_string(i));
     }
 }
 
-void Json::deserialize(Json &obj, const char *in, size_t n, size_t &i)
+void Json::deserializeObject(const char *in,
+                             size_t n,
+                             size_t &i,
+                             size_t depth)
 {
-    size_t str_start;
-    size_t str_len;
-    size_t array_index;
-    std::string str;
-
-    enum State
-    {
-        STATE_VALUE,
-        STATE_OBJECT,
-        STATE_OBJECT_PAIR,
-        STATE_ARRAY,
-        STATE_STRING,
-        STATE_STRING_NAME,
-        STATE_STRING_VALUE,
-        STATE_NUMBER,
-        STATE_TYPE
-    };
-    int state = STATE_VALUE;
-    int next;
+    create_object();
+    std::map<std::string, Json> &obj = *data_.object;
+    std::string key;
+
+    i = Json_skipWhitespace(in, n, i + 1);
+    if (i < n && in[i] == '}')
+    {
+        i++;
+        return;
+    }
 
     while (i < n)
     {
-        switch (state)
+        if (in[i] != '"')
         {
-            case STATE_VALUE:
-                if (in[i] == '{')
-                {
-                    obj.create_object();
-                    state = STATE_OBJECT;
-                }
-                else if (in[i] == '[')
-                {
-                    obj.create_array();
-                    state = STATE_ARRAY;
-                    array_index = 0;
-                }
-                else if (in[i] == '\"')
-                {
-                    str_start = i + 1;
-                    state = STATE_STRING;
-                    next = STATE_STRING_VALUE;
-                }
-                else if (in[i] == '-' || (in[i] > 47 && in[i] < 58))
-                {
-                    str_start = i;
-                    state = STATE_NUMBER;
-                }
-                else if (in[i] > 96 && in[i] < 123)
-                {
-                    str_start = i;
-                    state = STATE_TYPE;
-                }
-                break;
+            THROW("JSON expected object pair name at offset " +
+                  std::to_string(i));
+        }
+        Json_parseString(key, in, n, i);
 
-            case STATE_OBJECT:
-                if (in[i] == '\"')
-                {
-                    str_start = i + 1;
-                    state = STATE_STRING;
-                    next = STATE_STRING_NAME;
-                }
-                else if (in[i] == '}')
-                {
-                    i++;
-                    return;
-                }
-                break;
+        i = Json_skipWhitespace(in, n, i);
+        if (i >= n || in[i] != ':')
+        {
+            THROW("JSON expected ':' at offset " + std::to_string(i));
+        }
+        i = Json_skipWhitespace(in, n, i + 1);
 
-            case STATE_STRING_NAME:
-                if (in[i] == ':')
-                {
-                    state = STATE_OBJECT_PAIR;
-                }
-                break;
+        // Serialized objects have sorted names, insert at the end is O(1)
+        auto it = obj.emplace_hint(obj.end(), key, Json());
+        it->second.deserialize(in, n, i, depth + 1);
 
-            case STATE_OBJECT_PAIR:
-                // parse object pair value
-                deserialize(obj[str], in, n, i);
-                i--;
-                state = STATE_OBJECT;
-                break;
+        i = Json_skipWhitespace(in, n, i);
+        if (i < n && in[i] == ',')
+        {
+            i = Json_skipWhitespace(in, n, i + 1);
+        }
+        else if (i < n && in[i] == '}')
+        {
+            i++;
+            return;
+        }
+        else
+        {
+            THROW("JSON expected ',' or '}' at offset " + std::to_string(i));
+        }
+    }
 
-            case STATE_STRING:
-                // TBD extra characters
-                if (in[i] == '\"')
-                {
-                    str_len = i - str_start;
-                    str.resize(str_len);
-                    for (size_t j = 0; j < str_len; j++)
-                    {
-                        str[j] = in[str_start + j];
-                    }
-                    state = next;
-                }
-                break;
+    THROW("JSON unexpected end of data in object");
+}
 
-            case STATE_STRING_VALUE:
-                obj.create_string(str);
-                return;
+void Json::deserializeArray(const char *in, size_t n, size_t &i, size_t depth)
+{
+    create_array();
+    std::vector<Json> &arr = *data_.array;
 
-            case STATE_NUMBER:
-                // TBD number format
-                if (!(in[i] == '.' || (in[i] > 47 && in[i] < 58)))
-                {
-                    str_len = i - str_start;
-                    str.resize(str_len);
-                    for (size_t j = 0; j < str_len; j++)
-                    {
-                        str[j] = in[str_start + j];
-                    }
-                    obj.create_number(std::stod(str));
-                    return;
-                }
-                break;
+    i = Json_skipWhitespace(in, n, i + 1);
+    if (i < n && in[i] == ']')
+    {
+        i++;
+        return;
+    }
 
-            case STATE_ARRAY:
-                if (in[i] > 32 && in[i] != ']')
-                {
-                    // parse next array element
-                    deserialize(obj[array_index], in, n, i);
-                    array_index++;
-                }
+    while (i < n)
+    {
+        arr.emplace_back();
+        arr.back().deserialize(in, n, i, depth + 1);
 
-                if (in[i] == ']')
-                {
-                    i++;
-                    return;
-                }
-                break;
+        i = Json_skipWhitespace(in, n, i);
+        if (i < n && in[i] == ',')
+        {
+            i = Json_skipWhitespace(in, n, i + 1);
+        }
+        else if (i < n && in[i] == ']')
+        {
+            i++;
+            return;
+        }
+        else
+        {
+            THROW("JSON expected ',' or ']' at offset " + std::to_string(i));
+        }
+    }
 
-            case STATE_TYPE:
-                if (!(in[i] > 96 && in[i] < 123))
-                {
-                    str_len = i - str_start;
-                    str.resize(str_len);
-                    for (size_t j = 0; j < str_len; j++)
-                    {
-                        str[j] = in[str_start + j];
-                    }
+    THROW("JSON unexpected end of data in array");
+}
 
-                    if (str == "null")
-                    {
-                        obj.create_type(TYPE_NULL);
-                    }
-                    else if (str == "false")
-                    {
-                        obj.create_type(TYPE_FALSE);
-                    }
-                    else
-                    {
-                        obj.create_type(TYPE_TRUE);
-                    }
+std::vector<uint8_t> Json::serializeCbor() const
+{
+    std::vector<uint8_t> out;
+    CborWriter writer(out);
+    writer.value(*this);
+    return out;
+}
+
+void Json::deserializeCbor(const uint8_t *in, size_t n)
+{
+    CborReader reader(in, n);
+    deserializeCbor(reader, 0);
+
+    if (!reader.eof())
+    {
+        THROW("CBOR unexpected data after value at offset " +
+              std::to_string(reader.offset()));
+    }
+}
+
+void Json::deserializeCbor(CborReader &in, size_t depth)
+{
+    if (depth > JSON_MAX_DEPTH)
+    {
+        THROW("CBOR nesting is too deep");
+    }
 
-                    return;
+    switch (in.next())
+    {
+        case CborReader::TYPE_OBJECT:
+        {
+            size_t n = in.size();
+            create_object();
+            std::map<std::string, Json> &obj = *data_.object;
+            for (size_t i = 0; i < n; i++)
+            {
+                if (in.next() != CborReader::TYPE_STRING)
+                {
+                    THROW("CBOR object pair name is not string at offset " +
+                          std::to_string(in.offset()));
                 }
-                break;
 
-            default:
-                break;
+                // Written objects have sorted names, insert at the end is O(1)
+                auto it = obj.emplace_hint(obj.end(), in.string(), Json());
+                it->second.deserializeCbor(in, depth + 1);
+            }
+            break;
         }
-
-        i++;
+        case CborReader::TYPE_ARRAY:
+        {
+            size_t n = in.size();
+            create_array();
+            data_.array->resize(n);
+            for (size_t i = 0; i < n; i++)
+            {
+                (*data_.array)[i].deserializeCbor(in, depth + 1);
+            }
+            break;
+        }
+        case CborReader::TYPE_STRING:
+            create_string(std::string(in.string()));
+            break;
+        case CborReader::TYPE_NUMBER:
+            create_number(in.number());
+            break;
+        case CborReader::TYPE_TRUE:
+            create_type(TYPE_TRUE);
+            break;
+        case CborReader::TYPE_FALSE:
+            create_type(TYPE_FALSE);
+            break;
+        case CborReader::TYPE_NULL:
+        default:
+            create_type(TYPE_NULL);
+            break;
     }
 }
@@ -27,10 +27,11 @@
 #include <Error.hpp>
 #include <map>
 #include <memory>
-#include <sstream>
 #include <string>
 #include <vector>
 
+class CborReader;
+
 /** JSON.
 
     example deserialize:
@@ -81,6 +82,9 @@
 
     std::cout << obj.serialize(0) << "\n"; // {"dim":[10,20],"scale":[1,2,3]}
 \endcode
+
+    The same value model can be stored in binary CBOR encoding with
+    serializeCbor() and deserializeCbor().
 */
 class Json
 {
@@ -90,6 +94,11 @@ public:
     Json();
     ~Json() = default;
 
+    Json(const Json &other) = default;
+    Json(Json &&other) noexcept = default;
+    Json &operator=(const Json &other) = default;
+    Json &operator=(Json &&other) noexcept = default;
+
     Json(int32_t in);
     Json(uint32_t in);
     Json(double in);
@@ -138,6 +147,9 @@ public:
     void deserialize(const std::string &in);
     void deserialize(const char *in, size_t n);
 
+    std::vector<uint8_t> serializeCbor() const;
+    void deserializeCbor(const uint8_t *in, size_t n);
+
     void read(const std::string &filename);
     void write(const std::string &filename, size_t indent = DEFAULT_INDENT);
 
@@ -154,14 +166,25 @@ protected:
         TYPE_NULL
     };
 
-    /** Value data. */
+    /** Value data.
+
+        Values are owned by their parent. Copies are deep, moves only
+        transfer the containers.
+    */
     class Data
     {
     public:
-        std::shared_ptr<std::map<std::string, Json>> object;
-        std::shared_ptr<std::vector<Json>> array;
-        std::shared_ptr<std::string> string;
+        std::unique_ptr<std::map<std::string, Json>> object;
+        std::unique_ptr<std::vector<Json>> array;
+        std::string string;
         double number;
+
+        Data() : number(0) {}
+        ~Data() = default;
+        Data(const Data &other);
+        Data(Data &&other) noexcept = default;
+        Data &operator=(const Data &other);
+        Data &operator=(Data &&other) noexcept = default;
     };
 
     Type type_;
@@ -171,15 +194,41 @@ protected:
     void create_array();
     void create_array(const std::vector<double> &in);
     void create_string(const std::string &in);
+    void create_string(std::string &&in);
     void create_number(double in);
     void create_type(Type t);
-    void serialize(std::ostringstream &out) const;
-    void serialize(std::ostringstream &out,
-                   const std::string &indent,
-                   const std::string &indent_plus) const;
-    void deserialize(Json &obj, const char *in, size_t n, size_t &i);
+    void deserialize(const char *in, size_t n, size_t &i, size_t depth);
+    void deserializeObject(const char *in, size_t n, size_t &i, size_t depth);
+    void deserializeArray(const char *in, size_t n, size_t &i, size_t depth);
+    void deserializeCbor(CborReader &in, size_t depth);
 };
 
+inline Json::Data::Data(const Data &other)
+    : string(other.string),
+      number(other.number)
+{
+    if (other.object)
+    {
+        object = std::make_unique<std::map<std::string, Json>>(*other.object);
+    }
+
+    if (other.array)
+    {
+        array = std::make_unique<std::vector<Json>>(*other.array);
+    }
+}
+
+inline Json::Data &Json::Data::operator=(const Data &other)
+{
+    if (this != &other)
+    {
+        Data tmp(other);
+        *this = std::move(tmp);
+    }
+
+    return *this;
+}
+
 inline Json::Json()
 {
     create_type(TYPE_NULL);
@@ -228,29 +277,35 @@ inline Json::Json(const std::vector<double> &in)
 inline void Json::create_object()
 {
     type_ = TYPE_OBJECT;
-    data_.object = std::make_shared<std::map<std::string, Json>>();
+    data_.object = std::make_unique<std::map<std::string, Json>>();
 }
 
 inline void Json::create_array()
 {
     type_ = TYPE_ARRAY;
-    data_.array = std::make_shared<std::vector<Json>>();
+    data_.array = std::make_unique<std::vector<Json>>();
 }
 
 inline void Json::create_array(const std::vector<double> &in)
 {
     create_array();
-    data_.array->resize(in.size());
+    data_.array->reserve(in.size());
     for (size_t i = 0; i < in.size(); i++)
     {
-        (*data_.array)[i] = in[i];
+        data_.array->emplace_back(in[i]);
     }
 }
 
 inline void Json::create_string(const std::string &in)
 {
     type_ = TYPE_STRING;
-    data_.string = std::make_shared<std::string>(in);
+    data_.string = in;
+}
+
+inline void Json::create_string(std::string &&in)
+{
+    type_ = TYPE_STRING;
+    data_.string = std::move(in);
 }
 
 inline void Json::create_number(double in)
@@ -370,9 +425,9 @@ inline Json &Json::operator[](size_t index)
         create_array();
     }
 
-    for (size_t i = data_.array->size(); i <= index; i++)
+    if (index >= data_.array->size())
     {
-        data_.array->push_back(Json());
+        data_.array->resize(index + 1);
     }
 
     return (*data_.array)[index];
@@ -420,7 +475,7 @@ inline const std::string &Json::string() const
         THROW("JSON value is not string");
     }
 
-    return *data_.string;
+    return data_.string;
 }
 
 inline double Json::number() const
@@ -0,0 +1,376 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file JsonWriter.cpp
+*/
+
+#include <JsonWriter.hpp>
+#include <charconv>
+#include <cmath>
+
+/** Buffered output is written to file in blocks of this size. */
+static const size_t JSON_WRITER_BUFFER_SIZE = 65536;
+
+/** Nesting level flags. */
+static const uint8_t JSON_WRITER_OBJECT = 0x01U;
+static const uint8_t JSON_WRITER_ARRAY = 0x00U;
+static const uint8_t JSON_WRITER_ELEMENT = 0x02U;
+
+JsonWriter::JsonWriter(size_t indent)
+    : indent_(indent),
+      objects_(0),
+      pair_(false)
+{
+    // empty
+}
+
+JsonWriter::~JsonWriter()
+{
+    // empty
+}
+
+void JsonWriter::create(const std::string &path)
+{
+    file_.open(path, "w");
+    buffer_.clear();
+    buffer_.reserve(JSON_WRITER_BUFFER_SIZE + 1024);
+    levels_.clear();
+    objects_ = 0;
+    pair_ = false;
+}
+
+void JsonWriter::close()
+{
+    flush();
+    file_.close();
+}
+
+void JsonWriter::flush()
+{
+    if (file_.isOpen() && !buffer_.empty())
+    {
+        file_.write(reinterpret_cast<const uint8_t *>(buffer_.data()),
+                    buffer_.size());
+        buffer_.clear();
+    }
+}
+
+void JsonWriter::separator()
+{
+    if (pair_)
+    {
+        pair_ = false;
+        return;
+    }
+
+    if (levels_.empty())
+    {
+        return;
+    }
+
+    uint8_t &level = levels_.back();
+    if (level & JSON_WRITER_OBJECT)
+    {
+        THROW("JSON writer value in object without name");
+    }
+
+    if (level & JSON_WRITER_ELEMENT)
+    {
+        buffer_ += ',';
+    }
+    level |= JSON_WRITER_ELEMENT;
+}
+
+void JsonWriter::newline(size_t depth)
+{
+    buffer_ += '\n';
+    buffer_.append(depth * indent_, ' ');
+}
+
+void JsonWriter::begin(uint8_t level, char c)
+{
+    separator();
+    buffer_ += c;
+    levels_.push_back(level);
+
+    if (level & JSON_WRITER_OBJECT)
+    {
+        objects_++;
+    }
+}
+
+void JsonWriter::end(uint8_t level, char c)
+{
+    if (levels_.empty() || pair_ ||
+        (levels_.back() & JSON_WRITER_OBJECT) != level)
+    {
+        THROW("JSON writer unbalanced end of object or array");
+    }
+
+    bool empty = (levels_.back() & JSON_WRITER_ELEMENT) == 0;
+    levels_.pop_back();
+
+    if (level & JSON_WRITER_OBJECT)
+    {
+        objects_--;
+        if (indent_ > 0 && !empty)
+        {
+            newline(objects_);
+        }
+    }
+
+    buffer_ += c;
+
+    if (buffer_.size() >= JSON_WRITER_BUFFER_SIZE)
+    {
+        flush();
+    }
+}
+
+void JsonWriter::beginObject()
+{
+    begin(JSON_WRITER_OBJECT, '{');
+}
+
+void JsonWriter::endObject()
+{
+    end(JSON_WRITER_OBJECT, '}');
+}
+
+void JsonWriter::beginArray()
+{
+    begin(JSON_WRITER_ARRAY, '[');
+}
+
+void JsonWriter::endArray()
+{
+    end(JSON_WRITER_ARRAY, ']');
+}
+
+void JsonWriter::key(const std::string &name)
+{
+    if (levels_.empty() || pair_ ||
+        (levels_.back() & JSON_WRITER_OBJECT) == 0)
+    {
+        THROW("JSON writer object pair name outside of object");
+    }
+
+    uint8_t &level = levels_.back();
+    if (level & JSON_WRITER_ELEMENT)
+    {
+        buffer_ += ',';
+    }
+    level |= JSON_WRITER_ELEMENT;
+
+    if (indent_ > 0)
+    {
+        newline(objects_);
+    }
+
+    string(name);
+    buffer_ += ':';
+    pair_ = true;
+}
+
+void JsonWriter::value(double in)
+{
+    separator();
+
+    // JSON has no representation of infinity and not a number
+    if (!std::isfinite(in))
+    {
+        buffer_ += "null";
+    }
+    else
+    {
+        // The shortest representation which reads back to the same number
+        char str[32];
+        std::to_chars_result r = std::to_chars(str, str + sizeof(str), in);
+        buffer_.append(str, static_cast<size_t>(r.ptr - str));
+    }
+
+    if (buffer_.size() >= JSON_WRITER_BUFFER_SIZE)
+    {
+        flush();
+    }
+}
+
+void JsonWriter::value(int32_t in)
+{
+    value(static_cast<int64_t>(in));
+}
+
+void JsonWriter::value(uint32_t in)
+{
+    value(static_cast<uint64_t>(in));
+}
+
+void JsonWriter::value(int64_t in)
+{
+    separator();
+
+    char str[24];
+    std::to_chars_result r = std::to_chars(str, str + sizeof(str), in);
+    buffer_.append(str, static_cast<size_t>(r.ptr - str));
+
+    if (buffer_.size() >= JSON_WRITER_BUFFER_SIZE)
+    {
+        flush();
+    }
+}
+
+void JsonWriter::value(uint64_t in)
+{
+    separator();
+
+    char str[24];
+    std::to_chars_result r = std::to_chars(str, str + sizeof(str), in);
+    buffer_.append(str, static_cast<size_t>(r.ptr - str));
+
+    if (buffer_.size() >= JSON_WRITER_BUFFER_SIZE)
+    {
+        flush();
+    }
+}
+
+void JsonWriter::value(bool in)
+{
+    separator();
+    buffer_ += in ? "true" : "false";
+}
+
+void JsonWriter::null()
+{
+    separator();
+    buffer_ += "null";
+}
+
+void JsonWriter::value(const char *in)
+{
+    value(std::string(in));
+}
+
+void JsonWriter::value(const std::string &in)
+{
+    separator();
+    string(in);
+
+    if (buffer_.size() >= JSON_WRITER_BUFFER_SIZE)
+    {
+        flush();
+    }
+}
+
+void JsonWriter::value(const Json &in)
+{
+    if (in.isObject())
+    {
+        beginObject();
+        for (auto const &it : in.object())
+        {
+            key(it.first);
+            value(it.second);
+        }
+        endObject();
+    }
+    else if (in.isArray())
+    {
+        beginArray();
+        for (auto const &it : in.array())
+        {
+            value(it);
+        }
+        endArray();
+    }
+    else if (in.isString())
+    {
+        value(in.string());
+    }
+    else if (in.isNumber())
+    {
+        value(in.number());
+    }
+    else if (in.isTrue())
+    {
+        value(true);
+    }
+    else if (in.isFalse())
+    {
+        value(false);
+    }
+    else
+    {
+        null();
+    }
+}
+
+void JsonWriter::string(const std::string &in)
+{
+    static const char *hex = "0123456789abcdef";
+
+    buffer_ += '"';
+
+    size_t n = in.size();
+    size_t from = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        unsigned char c = static_cast<unsigned char>(in[i]);
+        if (c >= 0x20 && c != '"' && c != '\\')
+        {
+            continue;
+        }
+
+        buffer_.append(in, from, i - from);
+        from = i + 1;
+
+        switch (c)
+        {
+            case '"':
+                buffer_ += "\\\"";
+                break;
+            case '\\':
+                buffer_ += "\\\\";
+                break;
+            case '\b':
+                buffer_ += "\\b";
+                break;
+            case '\f':
+                buffer_ += "\\f";
+                break;
+            case '\n':
+                buffer_ += "\\n";
+                break;
+            case '\r':
+                buffer_ += "\\r";
+                break;
+            case '\t':
+                buffer_ += "\\t";
+                break;
+            default:
+                buffer_ += "\\u00";
+                buffer_ += hex[c >> 4];
+                buffer_ += hex[c & 15U];
+                break;
+        }
+    }
+
+    buffer_.append(in, from, n - from);
+    buffer_ += '"';
+}
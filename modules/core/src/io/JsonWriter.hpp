@@ -0,0 +1,105 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file JsonWriter.hpp
+*/
+
+#ifndef JSON_WRITER_HPP
+#define JSON_WRITER_HPP
+
+#include <File.hpp>
+#include <Json.hpp>
+#include <string>
+#include <vector>
+
+/** JSON streaming writer.
+
+    Values are written directly to a file through an internal buffer
+    without building Json objects, so large documents are written in
+    constant memory. The output has the same layout as Json::serialize.
+    Without a file, the output is collected in a string.
+
+    example:
+\code
+    JsonWriter out;
+    out.create("nodes.json");
+    out.beginObject();
+    out.key("nodes");
+    out.beginArray();
+    for (size_t i = 0; i < n; i++)
+    {
+        out.value(i);
+    }
+    out.endArray();
+    out.endObject();
+    out.close();
+\endcode
+*/
+class JsonWriter
+{
+public:
+    JsonWriter(size_t indent = Json::DEFAULT_INDENT);
+    ~JsonWriter();
+
+    void create(const std::string &path);
+    void close();
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+    void key(const std::string &name);
+
+    void value(double in);
+    void value(int32_t in);
+    void value(uint32_t in);
+    void value(int64_t in);
+    void value(uint64_t in);
+    void value(bool in);
+    void value(const char *in);
+    void value(const std::string &in);
+    void value(const Json &in);
+    void null();
+
+    template <class T> void value(const std::string &name, const T &in)
+    {
+        key(name);
+        value(in);
+    }
+
+    const std::string &str() const { return buffer_; }
+
+protected:
+    File file_;
+    std::string buffer_;
+    std::vector<uint8_t> levels_;
+    size_t indent_;
+    size_t objects_;
+    bool pair_;
+
+    void separator();
+    void begin(uint8_t level, char c);
+    void end(uint8_t level, char c);
+    void newline(size_t depth);
+    void string(const std::string &in);
+    void flush();
+};
+
+#endif /* JSON_WRITER_HPP */
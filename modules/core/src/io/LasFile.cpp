@@ -24,130 +24,1476 @@
 #include <Endian.hpp>
 #include <Error.hpp>
 #include <LasFile.hpp>
+#include <LasTransform.hpp>
+#include <LazDecoder.hpp>
+#include <LazPointDecoder.hpp>
+#include <ThreadPool.hpp>
+#include <algorithm>
+#include <cstdint>
 #include <cstring>
+#include <limits>
 #include <sstream>
 
+/** Number of point records encoded or decoded at once. */
+static const size_t LAS_FILE_BLOCK_SIZE = 65536;
+
 LasFile::LasFile()
+    : compressed_(false),
+      lazPosition_(0),
+      lazChunk_(0),
+      lazDecoded_(0),
+      create_(false),
+      npoints_(0)
+{
+    // empty
+}
+
+LasFile::~LasFile()
+{
+    // empty
+}
+
+void LasFile::open(const std::string &path)
+{
+    std::memset(&header, 0, sizeof(header));
+    file_.open(path);
+    read(header);
+    readVlr();
+    readWkt();
+    readExtraBytes();
+    readLaszip();
+    file_.seek(header.offset_to_point_data);
+}
+
+uint64_t LasFile::close()
+{
+    uint64_t ret = 0;
+
+    if (create_)
+    {
+        // Final header with bounds and counts
+        for (size_t i = 0; i < 15; i++)
+        {
+            header.number_of_points_by_return[i] = npointsByReturn_[i];
+        }
+
+        header.number_of_point_records = npoints_;
+        header.legacy_number_of_point_records = 0;
+        for (size_t i = 0; i < 5; i++)
+        {
+            header.legacy_number_of_points_by_return[i] = 0;
+        }
+
+        if (header.point_data_record_format < 6 && npoints_ <= UINT32_MAX)
+        {
+            header.legacy_number_of_point_records =
+                static_cast<uint32_t>(npoints_);
+            for (size_t i = 0; i < 5; i++)
+            {
+                header.legacy_number_of_points_by_return[i] =
+                    static_cast<uint32_t>(npointsByReturn_[i]);
+            }
+        }
+
+        if (npoints_ > 0)
+        {
+            header.min_x = (min_[0] * header.x_scale_factor) + header.x_offset;
+            header.min_y = (min_[1] * header.y_scale_factor) + header.y_offset;
+            header.min_z = (min_[2] * header.z_scale_factor) + header.z_offset;
+            header.max_x = (max_[0] * header.x_scale_factor) + header.x_offset;
+            header.max_y = (max_[1] * header.y_scale_factor) + header.y_offset;
+            header.max_z = (max_[2] * header.z_scale_factor) + header.z_offset;
+        }
+
+        uint8_t buffer[375];
+        write(buffer, header);
+        file_.write(buffer, header.header_size, 0);
+
+        ret = npoints_;
+        create_ = false;
+        npoints_ = 0;
+        std::vector<uint8_t>().swap(buffer_);
+    }
+
+    std::memset(&header, 0, sizeof(header));
+    vlr_.clear();
+    extraBytes_.clear();
+    wkt_.clear();
+    compressed_ = false;
+    laszip_.items.clear();
+    laszip_.chunks.clear();
+    std::vector<uint8_t>().swap(lazPoints_);
+    lazPosition_ = 0;
+    lazChunk_ = 0;
+    lazStream_.reset();
+    lazDecoded_ = 0;
+    file_.close();
+
+    return ret;
+}
+
+void LasFile::create(const std::string &path,
+                     const Header &hdr,
+                     const LasFile *vlrSource)
+{
+    uint8_t fmt = hdr.point_data_record_format;
+
+    if (fmt == 4 || fmt == 5 || fmt > 8)
+    {
+        THROW("LAS point format " + std::to_string(fmt) +
+              " can't be written");
+    }
+
+    close();
+
+    header = hdr;
+    std::memcpy(header.file_signature, "LASF", 4);
+    header.version_major = 1;
+    if (fmt > 5 && header.version_minor < 4)
+    {
+        header.version_minor = 4;
+    }
+    if (header.version_minor > 4)
+    {
+        header.version_minor = 4;
+    }
+
+    if (header.version_minor > 3)
+    {
+        header.header_size = 375;
+    }
+    else if (header.version_minor > 2)
+    {
+        header.header_size = 235;
+    }
+    else
+    {
+        header.header_size = 227;
+    }
+
+    size_t size = pointSize(fmt);
+    if (header.point_data_record_length < size)
+    {
+        header.point_data_record_length = static_cast<uint16_t>(size);
+    }
+
+    header.offset_to_wdpr = 0;
+    header.offset_to_evlr = 0;
+    header.number_of_evlr = 0;
+
+    // Copy variable length records, extended records are not copied
+    // except WKT, which is written as a variable length record if it fits
+    std::vector<uint8_t> vlrs;
+    bool wkt = false;
+    header.number_of_vlr = 0;
+    if (vlrSource)
+    {
+        std::vector<uint8_t> data;
+        for (size_t i = 0; i < vlrSource->getVlrSize(); i++)
+        {
+            const VariableLengthRecord &vlr = vlrSource->getVlr(i);
+            bool isWkt = vlr.user_id == "LASF_Projection" &&
+                         vlr.record_id == 2112;
+            // Points are written uncompressed
+            if ((vlr.extended && !isWkt) || (isWkt && wkt) ||
+                vlr.record_length > UINT16_MAX ||
+                (vlr.user_id == "laszip encoded" && vlr.record_id == 22204))
+            {
+                continue;
+            }
+
+            vlrSource->readVlr(i, data);
+
+            size_t pos = vlrs.size();
+            vlrs.resize(pos + 54 + data.size(), 0);
+            std::memcpy(&vlrs[pos + 2],
+                        vlr.user_id.data(),
+                        std::min(vlr.user_id.size(), size_t(16)));
+            htol16(&vlrs[pos + 18], vlr.record_id);
+            htol16(&vlrs[pos + 20], static_cast<uint16_t>(data.size()));
+            std::memcpy(&vlrs[pos + 22],
+                        vlr.description.data(),
+                        std::min(vlr.description.size(), size_t(32)));
+            std::memcpy(&vlrs[pos + 54], data.data(), data.size());
+
+            header.number_of_vlr++;
+            wkt = wkt || isWkt;
+        }
+    }
+
+    // WKT bit is required for formats 6 to 10, but it is set only when
+    // the WKT record is written
+    if (wkt)
+    {
+        header.global_encoding |= 16U;
+    }
+    else
+    {
+        header.global_encoding &= static_cast<uint16_t>(~16U);
+    }
+
+    header.offset_to_point_data =
+        static_cast<uint32_t>(header.header_size + vlrs.size());
+
+    file_.open(path, "w+");
+
+    // Header is written again by close()
+    uint8_t buffer[375];
+    write(buffer, header);
+    file_.write(buffer, header.header_size);
+    file_.write(vlrs.data(), vlrs.size());
+
+    create_ = true;
+    npoints_ = 0;
+    for (size_t i = 0; i < 3; i++)
+    {
+        min_[i] = INT32_MAX;
+        max_[i] = INT32_MIN;
+    }
+    for (size_t i = 0; i < 15; i++)
+    {
+        npointsByReturn_[i] = 0;
+    }
+}
+
+void LasFile::write(uint8_t *buffer, const Header &hdr)
+{
+    std::memset(buffer, 0, 375);
+
+    std::memcpy(&buffer[0], hdr.file_signature, 4);
+    htol16(&buffer[4], hdr.file_source_id);
+    htol16(&buffer[6], hdr.global_encoding);
+    htol32(&buffer[8], hdr.project_id_1);
+    htol16(&buffer[12], hdr.project_id_2);
+    htol16(&buffer[14], hdr.project_id_3);
+    std::memcpy(&buffer[16], hdr.project_id_4, 8);
+
+    buffer[24] = hdr.version_major;
+    buffer[25] = hdr.version_minor;
+    std::memcpy(&buffer[26], hdr.system_identifier, 32);
+    std::memcpy(&buffer[58], hdr.generating_software, 32);
+    htol16(&buffer[90], hdr.file_creation_day_of_year);
+    htol16(&buffer[92], hdr.file_creation_year);
+
+    htol16(&buffer[94], hdr.header_size);
+    htol32(&buffer[96], hdr.offset_to_point_data);
+    htol32(&buffer[100], hdr.number_of_vlr);
+    buffer[104] = hdr.point_data_record_format;
+    htol16(&buffer[105], hdr.point_data_record_length);
+    htol32(&buffer[107], hdr.legacy_number_of_point_records);
+    for (size_t i = 0; i < 5; i++)
+    {
+        htol32(&buffer[111 + (i * 4)],
+               hdr.legacy_number_of_points_by_return[i]);
+    }
+
+    htold(&buffer[131 + (0 * 8)], hdr.x_scale_factor);
+    htold(&buffer[131 + (1 * 8)], hdr.y_scale_factor);
+    htold(&buffer[131 + (2 * 8)], hdr.z_scale_factor);
+    htold(&buffer[131 + (3 * 8)], hdr.x_offset);
+    htold(&buffer[131 + (4 * 8)], hdr.y_offset);
+    htold(&buffer[131 + (5 * 8)], hdr.z_offset);
+    htold(&buffer[131 + (6 * 8)], hdr.max_x);
+    htold(&buffer[131 + (7 * 8)], hdr.min_x);
+    htold(&buffer[131 + (8 * 8)], hdr.max_y);
+    htold(&buffer[131 + (9 * 8)], hdr.min_y);
+    htold(&buffer[131 + (10 * 8)], hdr.max_z);
+    htold(&buffer[131 + (11 * 8)], hdr.min_z);
+
+    htol64(&buffer[227], hdr.offset_to_wdpr);
+
+    htol64(&buffer[235], hdr.offset_to_evlr);
+    htol32(&buffer[243], hdr.number_of_evlr);
+    htol64(&buffer[247], hdr.number_of_point_records);
+    for (size_t i = 0; i < 15; i++)
+    {
+        htol64(&buffer[255 + (i * 8)], hdr.number_of_points_by_return[i]);
+    }
+}
+
+static std::string LasFile_string(const uint8_t *buffer, size_t n)
+{
+    const char *str = reinterpret_cast<const char *>(buffer);
+    size_t length = 0;
+
+    while (length < n && str[length] != 0)
+    {
+        length++;
+    }
+
+    return std::string(str, length);
+}
+
+void LasFile::read(Header &hdr)
+{
+    uint8_t buffer[256];
+
+    if (file_.size() < 227)
+    {
+        THROW("LAS '" + file_.path() + "' has invalid size");
+    }
+
+    file_.read(buffer, 227);
+
+    // signature
+    std::memcpy(hdr.file_signature, buffer, 4);
+
+    if ((hdr.file_signature[0] != 76) || (hdr.file_signature[1] != 65) ||
+        (hdr.file_signature[2] != 83) || (hdr.file_signature[3] != 70))
+    {
+        THROW("LAS '" + file_.path() + "' has invalid signature");
+    }
+
+    // project
+    hdr.file_source_id = ltoh16(&buffer[4]);
+    hdr.global_encoding = ltoh16(&buffer[6]);
+    hdr.project_id_1 = ltoh32(&buffer[8]);
+    hdr.project_id_2 = ltoh16(&buffer[12]);
+    hdr.project_id_3 = ltoh16(&buffer[14]);
+    std::memcpy(hdr.project_id_4, &buffer[16], 8);
+
+    // version
+    hdr.version_major = buffer[24];
+    hdr.version_minor = buffer[25];
+
+    if (hdr.version_major != 1)
+    {
+        THROW("LAS '" + file_.path() + "' has incompatible major version");
+    }
+
+    std::memcpy(hdr.system_identifier, &buffer[26], 32);
+    std::memcpy(hdr.generating_software, &buffer[58], 32);
+    hdr.file_creation_day_of_year = ltoh16(&buffer[90]);
+    hdr.file_creation_year = ltoh16(&buffer[92]);
+
+    // header
+    hdr.header_size = ltoh16(&buffer[94]);
+    hdr.offset_to_point_data = ltoh32(&buffer[96]);
+    hdr.number_of_vlr = ltoh32(&buffer[100]);
+    hdr.point_data_record_format = buffer[104];
+    hdr.point_data_record_length = ltoh16(&buffer[105]);
+
+    hdr.legacy_number_of_point_records = ltoh32(&buffer[107]);
+    hdr.number_of_point_records = hdr.legacy_number_of_point_records;
+    for (int i = 0; i < 5; i++)
+    {
+        uint32_t number = ltoh32(&buffer[111 + (i * 4)]);
+        hdr.legacy_number_of_points_by_return[i] = number;
+        hdr.number_of_points_by_return[i] = number;
+    }
+
+    // scale
+    hdr.x_scale_factor = ltohd(&buffer[131 + (0 * 8)]);
+    hdr.y_scale_factor = ltohd(&buffer[131 + (1 * 8)]);
+    hdr.z_scale_factor = ltohd(&buffer[131 + (2 * 8)]);
+    hdr.x_offset = ltohd(&buffer[131 + (3 * 8)]);
+    hdr.y_offset = ltohd(&buffer[131 + (4 * 8)]);
+    hdr.z_offset = ltohd(&buffer[131 + (5 * 8)]);
+    hdr.max_x = ltohd(&buffer[131 + (6 * 8)]);
+    hdr.min_x = ltohd(&buffer[131 + (7 * 8)]);
+    hdr.max_y = ltohd(&buffer[131 + (8 * 8)]);
+    hdr.min_y = ltohd(&buffer[131 + (9 * 8)]);
+    hdr.max_z = ltohd(&buffer[131 + (10 * 8)]);
+    hdr.min_z = ltohd(&buffer[131 + (11 * 8)]);
+
+    // version 1.3
+    if (hdr.version_minor > 2)
+    {
+        if (file_.size() < 235)
+        {
+            THROW("LAS '" + file_.path() + "' v1.3+ has invalid size");
+        }
+
+        file_.read(buffer, 8);
+        hdr.offset_to_wdpr = ltoh64(&buffer[0]);
+    }
+
+    // version 1.4
+    if (hdr.version_minor > 3)
+    {
+        if (file_.size() < 375)
+        {
+            THROW("LAS '" + file_.path() + "' v1.4+ has invalid size");
+        }
+
+        file_.read(buffer, 140);
+        hdr.offset_to_evlr = ltoh64(&buffer[0]);
+        hdr.number_of_evlr = ltoh32(&buffer[8]);
+        hdr.number_of_point_records = ltoh64(&buffer[12]);
+        for (int i = 0; i < 15; i++)
+        {
+            hdr.number_of_points_by_return[i] = ltoh64(&buffer[20 + (i * 8)]);
+        }
+    }
+}
+
+void LasFile::readVlr()
+{
+    vlr_.clear();
+
+    readVlr(header.header_size, header.number_of_vlr, false);
+
+    if (header.version_minor > 3 && header.number_of_evlr > 0)
+    {
+        readVlr(header.offset_to_evlr, header.number_of_evlr, true);
+    }
+}
+
+void LasFile::readVlr(uint64_t offset, uint32_t n, bool extended)
+{
+    uint8_t buffer[60];
+    uint64_t headerSize = extended ? 60 : 54;
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        if (offset + headerSize > file_.size())
+        {
+            THROW("LAS '" + file_.path() + "' has invalid VLR header");
+        }
+
+        // Positional read keeps the file offset at point data
+        file_.read(buffer, headerSize, offset);
+
+        VariableLengthRecord vlr;
+        vlr.user_id = LasFile_string(&buffer[2], 16);
+        vlr.record_id = ltoh16(&buffer[18]);
+        if (extended)
+        {
+            vlr.record_length = ltoh64(&buffer[20]);
+            vlr.description = LasFile_string(&buffer[28], 32);
+        }
+        else
+        {
+            vlr.record_length = ltoh16(&buffer[20]);
+            vlr.description = LasFile_string(&buffer[22], 32);
+        }
+        vlr.offset = offset + headerSize;
+        vlr.extended = extended;
+
+        if (vlr.record_length > file_.size() - vlr.offset)
+        {
+            THROW("LAS '" + file_.path() + "' has invalid VLR length");
+        }
+
+        offset = vlr.offset + vlr.record_length;
+        vlr_.push_back(vlr);
+    }
+}
+
+size_t LasFile::findVlr(const std::string &user_id, uint16_t record_id) const
+{
+    for (size_t i = 0; i < vlr_.size(); i++)
+    {
+        if (vlr_[i].record_id == record_id && vlr_[i].user_id == user_id)
+        {
+            return i;
+        }
+    }
+
+    return vlr_.size();
+}
+
+void LasFile::readVlr(size_t idx, std::vector<uint8_t> &data) const
+{
+    const VariableLengthRecord &vlr = vlr_[idx];
+
+    data.resize(vlr.record_length);
+    file_.read(data.data(), vlr.record_length, vlr.offset);
+}
+
+void LasFile::readWkt()
+{
+    wkt_.clear();
+
+    size_t idx = findVlr("LASF_Projection", 2112);
+    if (idx < vlr_.size())
+    {
+        std::vector<uint8_t> data;
+        readVlr(idx, data);
+        wkt_ = LasFile_string(data.data(), data.size());
+    }
+}
+
+void LasFile::readLaszip()
+{
+    compressed_ = false;
+    laszip_.items.clear();
+    laszip_.chunks.clear();
+    lazPoints_.clear();
+    lazPosition_ = 0;
+    lazChunk_ = 0;
+    lazStream_.reset();
+    lazDecoded_ = 0;
+
+    // Compressed files have one of the two top bits of format set
+    size_t idx = findVlr("laszip encoded", 22204);
+    if (idx == vlr_.size())
+    {
+        if (header.point_data_record_format & 0xC0U)
+        {
+            THROW("LAS '" + file_.path() + "' is compressed without LASzip");
+        }
+        return;
+    }
+
+    std::vector<uint8_t> data;
+    readVlr(idx, data);
+    if (data.size() < 34)
+    {
+        THROW("LAS '" + file_.path() + "' has invalid LASzip record");
+    }
+
+    laszip_.compressor = ltoh16(&data[0]);
+    laszip_.coder = ltoh16(&data[2]);
+    laszip_.version_major = data[4];
+    laszip_.version_minor = data[5];
+    laszip_.version_revision = ltoh16(&data[6]);
+    laszip_.options = ltoh32(&data[8]);
+    laszip_.chunk_size = ltoh32(&data[12]);
+    laszip_.number_of_special_evlrs = static_cast<int64_t>(ltoh64(&data[16]));
+    laszip_.offset_to_special_evlrs = static_cast<int64_t>(ltoh64(&data[24]));
+
+    size_t nitems = ltoh16(&data[32]);
+    if (data.size() < 34 + (nitems * 6))
+    {
+        THROW("LAS '" + file_.path() + "' has invalid LASzip items");
+    }
+
+    laszip_.items.resize(nitems);
+    for (size_t i = 0; i < nitems; i++)
+    {
+        laszip_.items[i].type = ltoh16(&data[34 + (i * 6)]);
+        laszip_.items[i].size = ltoh16(&data[36 + (i * 6)]);
+        laszip_.items[i].version = ltoh16(&data[38 + (i * 6)]);
+    }
+
+    compressed_ = true;
+
+    // Points are decoded to records of the uncompressed format
+    header.point_data_record_format &= 0x3FU;
+
+    // Compressor 1 is not chunked, all points form one streamed chunk
+    if (laszip_.compressor > 1)
+    {
+        readLaszipChunks();
+    }
+    else if (header.number_of_point_records > 0)
+    {
+        uint64_t end = file_.size();
+        if (header.offset_to_evlr > header.offset_to_point_data &&
+            header.offset_to_evlr < end)
+        {
+            end = header.offset_to_evlr;
+        }
+
+        if (header.offset_to_point_data > end)
+        {
+            THROW("LAS '" + file_.path() + "' has invalid LAZ points");
+        }
+
+        laszip_.chunks.resize(1);
+        laszip_.chunks[0].offset = header.offset_to_point_data;
+        laszip_.chunks[0].size = end - header.offset_to_point_data;
+        laszip_.chunks[0].npoints = header.number_of_point_records;
+    }
+}
+
+void LasFile::readLaszipChunks()
+{
+    uint8_t buffer[8];
+    uint64_t size = file_.size();
+    uint64_t start = header.offset_to_point_data + 8;
+
+    if (start > size)
+    {
+        THROW("LAS '" + file_.path() + "' has invalid LAZ chunk table");
+    }
+
+    file_.read(buffer, 8, header.offset_to_point_data);
+    uint64_t offset = ltoh64(buffer);
+
+    // Writers which can't seek store the offset at the end of file
+    if (offset == UINT64_MAX)
+    {
+        file_.read(buffer, 8, size - 8);
+        offset = ltoh64(buffer);
+    }
+
+    if (offset < start || offset > size - 8)
+    {
+        THROW("LAS '" + file_.path() + "' has invalid LAZ chunk table");
+    }
+
+    file_.read(buffer, 8, offset);
+    uint32_t version = ltoh32(&buffer[0]);
+    uint32_t nchunks = ltoh32(&buffer[4]);
+    if (version != 0)
+    {
+        THROW("LAS '" + file_.path() + "' has unknown LAZ chunk table");
+    }
+
+    // Each chunk has at least one point and one byte
+    if (nchunks > offset - start || nchunks > header.number_of_point_records)
+    {
+        THROW("LAS '" + file_.path() + "' has invalid LAZ chunk count");
+    }
+
+    // Compressed table ends at EVLRs or end of file
+    uint64_t end = size;
+    if (header.offset_to_evlr > offset + 8 && header.offset_to_evlr < end)
+    {
+        end = header.offset_to_evlr;
+    }
+
+    std::vector<uint8_t> data;
+    data.resize(end - offset - 8);
+    file_.read(data.data(), data.size(), offset + 8);
+
+    LazDecoder decoder;
+    decoder.init(data.data(), data.size());
+    LazDecoder::IntegerDecompressor ic(decoder, 32, 2);
+
+    bool variable = laszip_.chunk_size == UINT32_MAX;
+    std::vector<uint32_t> npoints(nchunks);
+    std::vector<uint32_t> bytes(nchunks);
+    for (uint32_t i = 0; i < nchunks; i++)
+    {
+        if (variable)
+        {
+            uint32_t pred = (i > 0) ? npoints[i - 1] : 0;
+            npoints[i] = static_cast<uint32_t>(
+                ic.decompress(static_cast<int32_t>(pred), 0));
+        }
+
+        uint32_t pred = (i > 0) ? bytes[i - 1] : 0;
+        bytes[i] =
+            static_cast<uint32_t>(ic.decompress(static_cast<int32_t>(pred), 1));
+    }
+
+    laszip_.chunks.resize(nchunks);
+    uint64_t remaining = header.number_of_point_records;
+    for (uint32_t i = 0; i < nchunks; i++)
+    {
+        Laszip::Chunk &c = laszip_.chunks[i];
+        c.offset = start;
+        c.size = bytes[i];
+        c.npoints = variable ? npoints[i] : laszip_.chunk_size;
+        if (c.npoints > remaining)
+        {
+            c.npoints = remaining;
+        }
+
+        remaining -= c.npoints;
+        start += c.size;
+    }
+
+    if (start > offset)
+    {
+        THROW("LAS '" + file_.path() + "' has invalid LAZ chunk sizes");
+    }
+}
+
+void LasFile::readLaszipPoints(ThreadPool *pool)
+{
+    if (laszip_.compressor <= 1)
+    {
+        readLaszipStream();
+        return;
+    }
+
+    // Decode the next chunks, one chunk per thread
+    LazPointDecoder decoder(laszip_);
+    size_t stride = header.point_data_record_length;
+    if (decoder.pointSize() != stride)
+    {
+        THROW("LAS '" + file_.path() + "' has LAZ items of different size");
+    }
+
+    size_t n = std::min(laszip_.chunks.size() - lazChunk_,
+                        pool ? pool->size() : size_t(1));
+
+    std::vector<size_t> start(n + 1, 0);
+    std::vector<std::vector<uint8_t>> data(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        const Laszip::Chunk &c = laszip_.chunks[lazChunk_ + i];
+        start[i + 1] = start[i] + static_cast<size_t>(c.npoints);
+        data[i].resize(static_cast<size_t>(c.size));
+        file_.read(data[i].data(), data[i].size(), c.offset);
+    }
+
+    lazPoints_.resize(start[n] * stride);
+    lazPosition_ = 0;
+
+    auto decode = [&](size_t i) {
+        decoder.decode(&lazPoints_[start[i] * stride],
+                       start[i + 1] - start[i],
+                       data[i].data(),
+                       data[i].size());
+    };
+
+    if (pool)
+    {
+        pool->run(n, decode);
+    }
+    else
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            decode(i);
+        }
+    }
+
+    lazChunk_ += n;
+}
+
+void LasFile::readLaszipStream()
+{
+    // Decode the next block of points of the only chunk
+    const Laszip::Chunk &c = laszip_.chunks[lazChunk_];
+    size_t stride = header.point_data_record_length;
+
+    if (!lazStream_)
+    {
+        lazStream_ =
+            std::make_unique<LazPointStream>(laszip_, file_, c.offset, c.size);
+        if (lazStream_->pointSize() != stride)
+        {
+            THROW("LAS '" + file_.path() + "' has LAZ items of different size");
+        }
+    }
+
+    size_t n = LAS_FILE_BLOCK_SIZE;
+    if (c.npoints - lazDecoded_ < n)
+    {
+        n = static_cast<size_t>(c.npoints - lazDecoded_);
+    }
+
+    lazPoints_.resize(n * stride);
+    lazPosition_ = 0;
+    lazStream_->decode(lazPoints_.data(), n);
+    lazDecoded_ += n;
+
+    if (lazDecoded_ == c.npoints)
+    {
+        lazStream_.reset();
+        lazDecoded_ = 0;
+        lazChunk_++;
+    }
+}
+
+/** Size of one value of extra bytes data type 1 to 10. */
+static size_t LasFile_extraBytesSize(uint8_t type)
+{
+    static const size_t size[10] = {1, 1, 2, 2, 4, 4, 8, 8, 4, 8};
+    return size[(type - 1) % 10];
+}
+
+/** Read no_data, min or max of extra bytes descriptor. */
+static double LasFile_extraBytesValue(const uint8_t *buffer, uint8_t type)
+{
+    switch ((type - 1) % 10)
+    {
+        case 0:
+        case 2:
+        case 4:
+        case 6:
+            return static_cast<double>(ltoh64(buffer));
+        case 1:
+        case 3:
+        case 5:
+        case 7:
+            return static_cast<double>(static_cast<int64_t>(ltoh64(buffer)));
+        default:
+            return ltohd(buffer);
+    }
+}
+
+void LasFile::readExtraBytes()
+{
+    const size_t descriptorSize = 192;
+
+    extraBytes_.clear();
+
+    size_t idx = findVlr("LASF_Spec", 4);
+    if (idx == vlr_.size())
+    {
+        return;
+    }
+
+    std::vector<uint8_t> data;
+    readVlr(idx, data);
+
+    size_t position = pointSize(header.point_data_record_format & 0x3FU);
+    size_t n = data.size() / descriptorSize;
+    extraBytes_.resize(n);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        const uint8_t *buffer = &data[i * descriptorSize];
+        ExtraBytes &e = extraBytes_[i];
+
+        e.data_type = buffer[2];
+        e.options = buffer[3];
+        e.name = LasFile_string(&buffer[4], 32);
+        e.description = LasFile_string(&buffer[160], 32);
+
+        if (e.data_type == 0)
+        {
+            // Undocumented bytes, options hold the number of bytes
+            e.size = e.options;
+            e.options = 0;
+        }
+        else if (e.data_type <= 30)
+        {
+            // Types 11 to 30 are deprecated arrays of 2 or 3 values
+            e.size = LasFile_extraBytesSize(e.data_type) *
+                     static_cast<size_t>(((e.data_type - 1) / 10) + 1);
+        }
+        else
+        {
+            THROW("LAS '" + file_.path() + "' has unknown extra bytes type");
+        }
+
+        e.no_data = 0;
+        e.no_data_raw = 0;
+        e.min = 0;
+        e.max = 0;
+        if (e.data_type != 0)
+        {
+            e.no_data = LasFile_extraBytesValue(&buffer[40], e.data_type);
+            e.no_data_raw = ltoh64(&buffer[40]);
+            e.min = LasFile_extraBytesValue(&buffer[64], e.data_type);
+            e.max = LasFile_extraBytesValue(&buffer[88], e.data_type);
+        }
+        e.scale = e.hasScale() ? ltohd(&buffer[112]) : 1.0;
+        e.offset = e.hasOffset() ? ltohd(&buffer[136]) : 0.0;
+
+        e.position = position;
+        position += e.size;
+    }
+
+    if (position > header.point_data_record_length)
+    {
+        THROW("LAS '" + file_.path() + "' has invalid extra bytes size");
+    }
+}
+
+size_t LasFile::findExtraBytes(const std::string &name) const
+{
+    for (size_t i = 0; i < extraBytes_.size(); i++)
+    {
+        if (extraBytes_[i].name == name)
+        {
+            return i;
+        }
+    }
+
+    return extraBytes_.size();
+}
+
+static uint8_t LasFile_u8(const uint8_t *b)
+{
+    return b[0];
+}
+
+static int8_t LasFile_i8(const uint8_t *b)
+{
+    return static_cast<int8_t>(b[0]);
+}
+
+static uint16_t LasFile_u16(const uint8_t *b)
+{
+    return ltoh16(b);
+}
+
+static int16_t LasFile_i16(const uint8_t *b)
+{
+    return static_cast<int16_t>(ltoh16(b));
+}
+
+static uint32_t LasFile_u32(const uint8_t *b)
+{
+    return ltoh32(b);
+}
+
+static int32_t LasFile_i32(const uint8_t *b)
+{
+    return static_cast<int32_t>(ltoh32(b));
+}
+
+static uint64_t LasFile_u64(const uint8_t *b)
+{
+    return ltoh64(b);
+}
+
+static int64_t LasFile_i64(const uint8_t *b)
+{
+    return static_cast<int64_t>(ltoh64(b));
+}
+
+static float LasFile_f32(const uint8_t *b)
 {
-    // empty
+    return ltohf(b);
 }
 
-LasFile::~LasFile()
+static double LasFile_f64(const uint8_t *b)
 {
-    // empty
+    return ltohd(b);
 }
 
-void LasFile::open(const std::string &path)
+/** Widen value to the 64-bit no_data field of its data type. */
+template <class T> static uint64_t LasFile_noData(T value)
 {
-    std::memset(&header, 0, sizeof(header));
-    file_.open(path);
-    read(header);
-    file_.seek(header.offset_to_point_data);
+    if constexpr (std::is_floating_point<T>::value)
+    {
+        double d = static_cast<double>(value);
+        uint64_t bits;
+        std::memcpy(&bits, &d, sizeof(bits));
+        return bits;
+    }
+    else if constexpr (std::is_signed<T>::value)
+    {
+        return static_cast<uint64_t>(static_cast<int64_t>(value));
+    }
+    else
+    {
+        return static_cast<uint64_t>(value);
+    }
 }
 
-void LasFile::close()
+/** Decode one extra bytes value of n point records, no data is NaN. */
+template <class T, T (*load)(const uint8_t *)>
+static void LasFile_column(double *column,
+                           const uint8_t *buffer,
+                           size_t stride,
+                           size_t n,
+                           const LasFile::ExtraBytes &e)
 {
-    std::memset(&header, 0, sizeof(header));
-    file_.close();
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const bool noData = e.hasNoData();
+
+    for (size_t i = 0; i < n; i++)
+    {
+        T value = load(buffer);
+        if (noData && LasFile_noData(value) == e.no_data_raw)
+        {
+            column[i] = nan;
+        }
+        else
+        {
+            column[i] = (static_cast<double>(value) * e.scale) + e.offset;
+        }
+        buffer += stride;
+    }
 }
 
-void LasFile::read(Header &hdr)
+void LasFile::readExtraBytes(double *column,
+                             size_t idx,
+                             const uint8_t *buffer,
+                             size_t n) const
 {
-    uint8_t buffer[256];
+    const ExtraBytes &e = extraBytes_[idx];
+    const uint8_t *p = buffer + e.position;
+    size_t s = header.point_data_record_length;
 
-    if (file_.size() < 227)
+    switch (e.data_type)
     {
-        THROW("LAS '" + file_.path() + "' has invalid size");
+        case 1:
+            LasFile_column<uint8_t, LasFile_u8>(column, p, s, n, e);
+            break;
+        case 2:
+            LasFile_column<int8_t, LasFile_i8>(column, p, s, n, e);
+            break;
+        case 3:
+            LasFile_column<uint16_t, LasFile_u16>(column, p, s, n, e);
+            break;
+        case 4:
+            LasFile_column<int16_t, LasFile_i16>(column, p, s, n, e);
+            break;
+        case 5:
+            LasFile_column<uint32_t, LasFile_u32>(column, p, s, n, e);
+            break;
+        case 6:
+            LasFile_column<int32_t, LasFile_i32>(column, p, s, n, e);
+            break;
+        case 7:
+            LasFile_column<uint64_t, LasFile_u64>(column, p, s, n, e);
+            break;
+        case 8:
+            LasFile_column<int64_t, LasFile_i64>(column, p, s, n, e);
+            break;
+        case 9:
+            LasFile_column<float, LasFile_f32>(column, p, s, n, e);
+            break;
+        case 10:
+            LasFile_column<double, LasFile_f64>(column, p, s, n, e);
+            break;
+        default:
+            THROW("LAS extra bytes '" + e.name + "' are not a single value");
     }
+}
 
-    file_.read(buffer, 227);
+size_t LasFile::pointSize(uint8_t fmt)
+{
+    static const size_t size[11] = {20, 28, 26, 34, 57, 63, 30, 36, 38, 59, 67};
 
-    // signature
-    std::memcpy(hdr.file_signature, buffer, 4);
+    if (fmt > 10)
+    {
+        THROW("Unknown LAS point format");
+    }
 
-    if ((hdr.file_signature[0] != 76) || (hdr.file_signature[1] != 65) ||
-        (hdr.file_signature[2] != 83) || (hdr.file_signature[3] != 70))
+    return size[fmt];
+}
+
+void LasFile::Columns::resize(size_t n, size_t extraBytesSize)
+{
+    x.resize(n);
+    y.resize(n);
+    z.resize(n);
+    intensity.resize(n);
+    return_number.resize(n);
+    number_of_returns.resize(n);
+    scan_direction_flag.resize(n);
+    edge_of_flight_line.resize(n);
+    classification_flags.resize(n);
+    scanner_channel.resize(n);
+    classification.resize(n);
+    user_data.resize(n);
+    angle.resize(n);
+    source_id.resize(n);
+    gps_time.resize(n);
+    red.resize(n);
+    green.resize(n);
+    blue.resize(n);
+    nir.resize(n);
+    extra_bytes.resize(n * extraBytesSize);
+}
+
+size_t LasFile::extraBytesSize() const
+{
+    return header.point_data_record_length -
+           pointSize(header.point_data_record_format & 0x3FU);
+}
+
+/** Encode point records of one format family. */
+template <bool LEGACY, bool GPS, bool RGB, bool NIR>
+static void LasFile_encode(uint8_t *buffer,
+                           size_t stride,
+                           size_t extraBytesSize,
+                           const LasFile::Columns &c,
+                           size_t from,
+                           size_t n)
+{
+    for (size_t i = from; i < from + n; i++, buffer += stride)
     {
-        THROW("LAS '" + file_.path() + "' has invalid signature");
+        size_t pos;
+
+        htol32(&buffer[0], static_cast<uint32_t>(c.x[i]));
+        htol32(&buffer[4], static_cast<uint32_t>(c.y[i]));
+        htol32(&buffer[8], static_cast<uint32_t>(c.z[i]));
+        htol16(&buffer[12], c.intensity[i]);
+
+        if (LEGACY)
+        {
+            buffer[14] = static_cast<uint8_t>(
+                (c.return_number[i] & 7U) |
+                ((c.number_of_returns[i] & 7U) << 3) |
+                ((c.scan_direction_flag[i] & 1U) << 6) |
+                ((c.edge_of_flight_line[i] & 1U) << 7));
+            buffer[15] = static_cast<uint8_t>(
+                (c.classification[i] & 31U) |
+                ((c.classification_flags[i] & 7U) << 5));
+            buffer[16] = static_cast<uint8_t>(c.angle[i]);
+            buffer[17] = c.user_data[i];
+            htol16(&buffer[18], c.source_id[i]);
+            pos = 20;
+        }
+        else
+        {
+            buffer[14] = static_cast<uint8_t>(
+                (c.return_number[i] & 15U) |
+                ((c.number_of_returns[i] & 15U) << 4));
+            buffer[15] = static_cast<uint8_t>(
+                (c.classification_flags[i] & 15U) |
+                ((c.scanner_channel[i] & 3U) << 4) |
+                ((c.scan_direction_flag[i] & 1U) << 6) |
+                ((c.edge_of_flight_line[i] & 1U) << 7));
+            buffer[16] = c.classification[i];
+            buffer[17] = c.user_data[i];
+            htol16(&buffer[18], static_cast<uint16_t>(c.angle[i]));
+            htol16(&buffer[20], c.source_id[i]);
+            pos = 22;
+        }
+
+        if (GPS)
+        {
+            htold(&buffer[pos], c.gps_time[i]);
+            pos += 8;
+        }
+
+        if (RGB)
+        {
+            htol16(&buffer[pos], c.red[i]);
+            htol16(&buffer[pos + 2], c.green[i]);
+            htol16(&buffer[pos + 4], c.blue[i]);
+            pos += 6;
+        }
+
+        if (NIR)
+        {
+            htol16(&buffer[pos], c.nir[i]);
+        }
+
+        if (extraBytesSize > 0)
+        {
+            std::memcpy(&buffer[stride - extraBytesSize],
+                        &c.extra_bytes[i * extraBytesSize],
+                        extraBytesSize);
+        }
     }
+}
 
-    // TBD read all fields from file header to memory
+/** Decode point records of one format family. */
+template <bool LEGACY, bool GPS, bool RGB, bool NIR>
+static void LasFile_decode(LasFile::Columns &c,
+                           size_t from,
+                           size_t n,
+                           const uint8_t *buffer,
+                           size_t stride,
+                           size_t extraBytesSize)
+{
+    for (size_t i = from; i < from + n; i++, buffer += stride)
+    {
+        size_t pos;
 
-    // version
-    hdr.version_major = buffer[24];
-    hdr.version_minor = buffer[25];
+        c.x[i] = static_cast<int32_t>(ltoh32(&buffer[0]));
+        c.y[i] = static_cast<int32_t>(ltoh32(&buffer[4]));
+        c.z[i] = static_cast<int32_t>(ltoh32(&buffer[8]));
+        c.intensity[i] = ltoh16(&buffer[12]);
 
-    if (hdr.version_major != 1)
+        if (LEGACY)
+        {
+            uint32_t data14 = buffer[14];
+            uint32_t data15 = buffer[15];
+            c.return_number[i] = static_cast<uint8_t>(data14 & 7U);
+            c.number_of_returns[i] = static_cast<uint8_t>((data14 >> 3) & 7U);
+            c.scan_direction_flag[i] = static_cast<uint8_t>((data14 >> 6) & 1U);
+            c.edge_of_flight_line[i] = static_cast<uint8_t>((data14 >> 7) & 1U);
+            c.classification[i] = static_cast<uint8_t>(data15 & 31U);
+            c.classification_flags[i] = static_cast<uint8_t>(data15 >> 5);
+            c.scanner_channel[i] = 0;
+            c.angle[i] = static_cast<int8_t>(buffer[16]);
+            c.user_data[i] = buffer[17];
+            c.source_id[i] = ltoh16(&buffer[18]);
+            pos = 20;
+        }
+        else
+        {
+            uint32_t data14 = buffer[14];
+            uint32_t data15 = buffer[15];
+            c.return_number[i] = static_cast<uint8_t>(data14 & 15U);
+            c.number_of_returns[i] = static_cast<uint8_t>(data14 >> 4);
+            c.classification_flags[i] = static_cast<uint8_t>(data15 & 15U);
+            c.scanner_channel[i] = static_cast<uint8_t>((data15 >> 4) & 3U);
+            c.scan_direction_flag[i] = static_cast<uint8_t>((data15 >> 6) & 1U);
+            c.edge_of_flight_line[i] = static_cast<uint8_t>((data15 >> 7) & 1U);
+            c.classification[i] = buffer[16];
+            c.user_data[i] = buffer[17];
+            c.angle[i] = static_cast<int16_t>(ltoh16(&buffer[18]));
+            c.source_id[i] = ltoh16(&buffer[20]);
+            pos = 22;
+        }
+
+        if (GPS)
+        {
+            c.gps_time[i] = ltohd(&buffer[pos]);
+            pos += 8;
+        }
+        else
+        {
+            c.gps_time[i] = 0;
+        }
+
+        if (RGB)
+        {
+            c.red[i] = ltoh16(&buffer[pos]);
+            c.green[i] = ltoh16(&buffer[pos + 2]);
+            c.blue[i] = ltoh16(&buffer[pos + 4]);
+            pos += 6;
+        }
+        else
+        {
+            c.red[i] = 0;
+            c.green[i] = 0;
+            c.blue[i] = 0;
+        }
+
+        c.nir[i] = NIR ? ltoh16(&buffer[pos]) : 0;
+
+        if (extraBytesSize > 0)
+        {
+            std::memcpy(&c.extra_bytes[i * extraBytesSize],
+                        &buffer[stride - extraBytesSize],
+                        extraBytesSize);
+        }
+    }
+}
+
+/** Decode point records of given format. */
+static void LasFile_decode(uint8_t fmt,
+                           LasFile::Columns &c,
+                           size_t f,
+                           size_t n,
+                           const uint8_t *b,
+                           size_t s,
+                           size_t e)
+{
+    switch (fmt)
     {
-        THROW("LAS '" + file_.path() + "' has incompatible major version");
+        case 0:
+            LasFile_decode<true, false, false, false>(c, f, n, b, s, e);
+            break;
+        case 1:
+            LasFile_decode<true, true, false, false>(c, f, n, b, s, e);
+            break;
+        case 2:
+            LasFile_decode<true, false, true, false>(c, f, n, b, s, e);
+            break;
+        case 3:
+            LasFile_decode<true, true, true, false>(c, f, n, b, s, e);
+            break;
+        case 6:
+            LasFile_decode<false, true, false, false>(c, f, n, b, s, e);
+            break;
+        case 7:
+            LasFile_decode<false, true, true, false>(c, f, n, b, s, e);
+            break;
+        default:
+            LasFile_decode<false, true, true, true>(c, f, n, b, s, e);
+            break;
     }
+}
 
-    // header
-    hdr.header_size = ltoh16(&buffer[94]);
-    hdr.offset_to_point_data = ltoh32(&buffer[96]);
-    hdr.point_data_record_format = buffer[104];
-    hdr.point_data_record_length = ltoh16(&buffer[105]);
+/** Encode point records of given format. */
+static void LasFile_encode(uint8_t fmt,
+                           uint8_t *b,
+                           size_t s,
+                           size_t e,
+                           const LasFile::Columns &c,
+                           size_t f,
+                           size_t n)
+{
+    switch (fmt)
+    {
+        case 0:
+            LasFile_encode<true, false, false, false>(b, s, e, c, f, n);
+            break;
+        case 1:
+            LasFile_encode<true, true, false, false>(b, s, e, c, f, n);
+            break;
+        case 2:
+            LasFile_encode<true, false, true, false>(b, s, e, c, f, n);
+            break;
+        case 3:
+            LasFile_encode<true, true, true, false>(b, s, e, c, f, n);
+            break;
+        case 6:
+            LasFile_encode<false, true, false, false>(b, s, e, c, f, n);
+            break;
+        case 7:
+            LasFile_encode<false, true, true, false>(b, s, e, c, f, n);
+            break;
+        default:
+            LasFile_encode<false, true, true, true>(b, s, e, c, f, n);
+            break;
+    }
+}
 
-    hdr.legacy_number_of_point_records = ltoh32(&buffer[107]);
-    hdr.number_of_point_records = hdr.legacy_number_of_point_records;
-    for (int i = 0; i < 5; i++)
+size_t LasFile::read(Columns &columns, size_t n, ThreadPool *pool)
+{
+    uint8_t fmt = header.point_data_record_format & 0x3FU;
+    size_t stride = header.point_data_record_length;
+    size_t extra = extraBytesSize();
+
+    if (fmt == 4 || fmt == 5 || fmt > 8)
     {
-        uint32_t number = ltoh32(&buffer[111 + (i * 4)]);
-        hdr.legacy_number_of_points_by_return[i] = number;
-        hdr.number_of_points_by_return[i] = number;
+        THROW("LAS '" + file_.path() + "' point format " +
+              std::to_string(fmt) + " can't be read in batches");
     }
 
-    // scale
-    hdr.x_scale_factor = ltohd(&buffer[131 + (0 * 8)]);
-    hdr.y_scale_factor = ltohd(&buffer[131 + (1 * 8)]);
-    hdr.z_scale_factor = ltohd(&buffer[131 + (2 * 8)]);
-    hdr.x_offset = ltohd(&buffer[131 + (3 * 8)]);
-    hdr.y_offset = ltohd(&buffer[131 + (4 * 8)]);
-    hdr.z_offset = ltohd(&buffer[131 + (5 * 8)]);
-    hdr.max_x = ltohd(&buffer[131 + (6 * 8)]);
-    hdr.min_x = ltohd(&buffer[131 + (7 * 8)]);
-    hdr.max_y = ltohd(&buffer[131 + (8 * 8)]);
-    hdr.min_y = ltohd(&buffer[131 + (9 * 8)]);
-    hdr.max_z = ltohd(&buffer[131 + (10 * 8)]);
-    hdr.min_z = ltohd(&buffer[131 + (11 * 8)]);
+    n = pointsLeft(n);
+    columns.resize(n, extra);
 
-    // version 1.3
-    if (hdr.version_minor > 2)
+    for (size_t from = 0; from < n; from += LAS_FILE_BLOCK_SIZE)
     {
-        if (file_.size() < 235)
+        size_t count = std::min(n - from, LAS_FILE_BLOCK_SIZE);
+        buffer_.resize(count * stride);
+        read(buffer_.data(), count, pool);
+
+        LasFile_decode(fmt,
+                       columns,
+                       from,
+                       count,
+                       buffer_.data(),
+                       stride,
+                       extra);
+    }
+
+    return n;
+}
+
+void LasFile::write(const Columns &columns)
+{
+    uint8_t fmt = header.point_data_record_format;
+    size_t stride = header.point_data_record_length;
+    size_t extra = extraBytesSize();
+    size_t n = columns.size();
+
+    if (!create_)
+    {
+        THROW("LAS '" + file_.path() + "' is not open for writing");
+    }
+
+    if (columns.extra_bytes.size() != n * extra)
+    {
+        THROW("LAS '" + file_.path() + "' has different extra bytes size");
+    }
+
+    // Statistics for header
+    for (size_t i = 0; i < n; i++)
+    {
+        min_[0] = std::min(min_[0], columns.x[i]);
+        max_[0] = std::max(max_[0], columns.x[i]);
+        min_[1] = std::min(min_[1], columns.y[i]);
+        max_[1] = std::max(max_[1], columns.y[i]);
+        min_[2] = std::min(min_[2], columns.z[i]);
+        max_[2] = std::max(max_[2], columns.z[i]);
+    }
+
+    for (size_t i = 0; i < n; i++)
+    {
+        size_t r = columns.return_number[i];
+        if (r > 0 && r <= 15)
         {
-            THROW("LAS '" + file_.path() + "' v1.3+ has invalid size");
+            npointsByReturn_[r - 1]++;
         }
+    }
 
-        file_.read(buffer, 8);
-        hdr.offset_to_wdpr = ltoh64(&buffer[0]);
+    for (size_t from = 0; from < n; from += LAS_FILE_BLOCK_SIZE)
+    {
+        size_t count = std::min(n - from, LAS_FILE_BLOCK_SIZE);
+        buffer_.resize(count * stride);
+
+        LasFile_encode(fmt,
+                       buffer_.data(),
+                       stride,
+                       extra,
+                       columns,
+                       from,
+                       count);
+
+        file_.write(buffer_.data(), buffer_.size());
     }
 
-    // version 1.4
-    if (hdr.version_minor > 3)
+    npoints_ += n;
+}
+
+size_t LasFile::pointsLeft(size_t n) const
+{
+    uint64_t stride = header.point_data_record_length;
+
+    // Number of decoded points and points in the remaining chunks
+    if (compressed_)
     {
-        if (file_.size() < 375)
+        uint64_t left = 0;
+        if (stride > 0)
         {
-            THROW("LAS '" + file_.path() + "' v1.4+ has invalid size");
+            left = (lazPoints_.size() - lazPosition_) / stride;
         }
 
-        file_.read(buffer, 140);
-        hdr.number_of_point_records = ltoh64(&buffer[12]);
-        for (int i = 0; i < 15; i++)
+        for (size_t i = lazChunk_; i < laszip_.chunks.size(); i++)
         {
-            hdr.number_of_points_by_return[i] = ltoh64(&buffer[20 + (i * 8)]);
+            left += laszip_.chunks[i].npoints;
+        }
+        left -= lazDecoded_;
+
+        return (left < n) ? static_cast<size_t>(left) : n;
+    }
+
+    // Number of points left from the current offset
+    uint64_t end = header.offset_to_point_data +
+                   (header.number_of_point_records * stride);
+    uint64_t offset = file_.offset();
+
+    if (offset >= end || stride == 0)
+    {
+        return 0;
+    }
+
+    uint64_t left = (end - offset) / stride;
+    if (left < n)
+    {
+        n = static_cast<size_t>(left);
+    }
+
+    return n;
+}
+
+size_t LasFile::read(uint8_t *buffer, size_t n, ThreadPool *pool)
+{
+    size_t stride = header.point_data_record_length;
+
+    n = pointsLeft(n);
+
+    if (!compressed_)
+    {
+        file_.read(buffer, n * stride);
+        return n;
+    }
+
+    size_t size = n * stride;
+    size_t pos = 0;
+    while (pos < size)
+    {
+        if (lazPosition_ == lazPoints_.size())
+        {
+            readLaszipPoints(pool);
         }
+
+        size_t count = std::min(size - pos, lazPoints_.size() - lazPosition_);
+        std::memcpy(buffer + pos, &lazPoints_[lazPosition_], count);
+        lazPosition_ += count;
+        pos += count;
     }
+
+    return n;
 }
 
 void LasFile::read(uint8_t *buffer)
 {
+    if (compressed_)
+    {
+        read(buffer, 1);
+        return;
+    }
+
     file_.read(buffer, header.point_data_record_length);
 }
 
 void LasFile::read(Point &pt)
 {
     uint8_t buffer[256];
+    size_t n = header.point_data_record_length;
+
+    // Long extra bytes are read to the internal buffer
+    if (n > sizeof(buffer))
+    {
+        buffer_.resize(n);
+        read(buffer_.data());
+        read(pt, buffer_.data(), header.point_data_record_format);
+        return;
+    }
 
     read(buffer);
     read(pt, buffer, header.point_data_record_format);
@@ -163,9 +1509,9 @@ void LasFile::read(Point &pt, const uint8_t *buffer, uint8_t fmt) const
 
     if (fmt > 5)
     {
-        pt.x = ltoh32(&buffer[0]);
-        pt.y = ltoh32(&buffer[4]);
-        pt.z = ltoh32(&buffer[8]);
+        pt.x = static_cast<int32_t>(ltoh32(&buffer[0]));
+        pt.y = static_cast<int32_t>(ltoh32(&buffer[4]));
+        pt.z = static_cast<int32_t>(ltoh32(&buffer[8]));
         pt.intensity = ltoh16(&buffer[12]);
         uint32_t data14 = static_cast<uint32_t>(buffer[14]);
         pt.return_number = static_cast<uint8_t>(data14 & 15U);
@@ -183,9 +1529,9 @@ void LasFile::read(Point &pt, const uint8_t *buffer, uint8_t fmt) const
     }
     else
     {
-        pt.x = ltoh32(&buffer[0]);
-        pt.y = ltoh32(&buffer[4]);
-        pt.z = ltoh32(&buffer[8]);
+        pt.x = static_cast<int32_t>(ltoh32(&buffer[0]));
+        pt.y = static_cast<int32_t>(ltoh32(&buffer[4]));
+        pt.z = static_cast<int32_t>(ltoh32(&buffer[8]));
         pt.intensity = ltoh16(&buffer[12]);
         uint32_t data14 = static_cast<uint32_t>(buffer[14]);
         pt.return_number = static_cast<uint8_t>(data14 & 7U);
@@ -243,12 +1589,50 @@ void LasFile::transform(double &x,
                         double &z,
                         const uint8_t *buffer) const
 {
-    double px = static_cast<double>(ltoh32(&buffer[0]));
-    double py = static_cast<double>(ltoh32(&buffer[4]));
-    double pz = static_cast<double>(ltoh32(&buffer[8]));
-    x = (px * header.x_scale_factor) + header.x_offset;
-    y = (py * header.y_scale_factor) + header.y_offset;
-    z = (pz * header.z_scale_factor) + header.z_offset;
+    int32_t px = static_cast<int32_t>(ltoh32(&buffer[0]));
+    int32_t py = static_cast<int32_t>(ltoh32(&buffer[4]));
+    int32_t pz = static_cast<int32_t>(ltoh32(&buffer[8]));
+    x = (static_cast<double>(px) * header.x_scale_factor) + header.x_offset;
+    y = (static_cast<double>(py) * header.y_scale_factor) + header.y_offset;
+    z = (static_cast<double>(pz) * header.z_scale_factor) + header.z_offset;
+}
+
+void LasFile::transform(double *xyz, const uint8_t *buffer, size_t n) const
+{
+    const double scale[3] = {header.x_scale_factor,
+                             header.y_scale_factor,
+                             header.z_scale_factor};
+    const double offset[3] = {header.x_offset,
+                              header.y_offset,
+                              header.z_offset};
+
+    lasTransform(xyz,
+                 buffer,
+                 n,
+                 header.point_data_record_length,
+                 scale,
+                 offset);
+}
+
+void LasFile::transform(float *xyz,
+                        const double *origin,
+                        const uint8_t *buffer,
+                        size_t n) const
+{
+    const double scale[3] = {header.x_scale_factor,
+                             header.y_scale_factor,
+                             header.z_scale_factor};
+    const double offset[3] = {header.x_offset,
+                              header.y_offset,
+                              header.z_offset};
+
+    lasTransform(xyz,
+                 buffer,
+                 n,
+                 header.point_data_record_length,
+                 scale,
+                 offset,
+                 origin);
 }
 
 bool LasFile::Header::hasRgb() const
@@ -279,15 +1663,103 @@ Json &LasFile::Point::serialize(Json &out) const
     return out;
 }
 
+Json &LasFile::VariableLengthRecord::serialize(Json &out) const
+{
+    out["user_id"] = user_id;
+    out["record_id"] = static_cast<uint32_t>(record_id);
+    out["record_length"] = record_length;
+    out["description"] = description;
+    out["offset"] = offset;
+    out["extended"] = static_cast<uint32_t>(extended);
+
+    return out;
+}
+
+Json &LasFile::ExtraBytes::serialize(Json &out) const
+{
+    out["name"] = name;
+    out["description"] = description;
+    out["data_type"] = static_cast<uint32_t>(data_type);
+    out["options"] = static_cast<uint32_t>(options);
+    out["position"] = position;
+    out["size"] = size;
+    out["scale"] = scale;
+    out["offset"] = offset;
+
+    return out;
+}
+
+Json &LasFile::Laszip::serialize(Json &out) const
+{
+    out["compressor"] = compressor;
+    out["coder"] = coder;
+    out["version"][0] = version_major;
+    out["version"][1] = version_minor;
+    out["version"][2] = version_revision;
+    out["options"] = options;
+    out["chunk_size"] = chunk_size;
+
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        out["items"][i]["type"] = items[i].type;
+        out["items"][i]["size"] = items[i].size;
+        out["items"][i]["version"] = items[i].version;
+    }
+
+    out["number_of_chunks"] = chunks.size();
+
+    return out;
+}
+
+Json &LasFile::serialize(Json &out) const
+{
+    header.serialize(out["header"]);
+
+    for (size_t i = 0; i < vlr_.size(); i++)
+    {
+        vlr_[i].serialize(out["vlr"][i]);
+    }
+
+    for (size_t i = 0; i < extraBytes_.size(); i++)
+    {
+        extraBytes_[i].serialize(out["extra_bytes"][i]);
+    }
+
+    if (!wkt_.empty())
+    {
+        out["wkt"] = wkt_;
+    }
+
+    if (compressed_)
+    {
+        laszip_.serialize(out["laszip"]);
+    }
+
+    return out;
+}
+
 Json &LasFile::Header::serialize(Json &out) const
 {
+    out["file_source_id"] = file_source_id;
+    out["global_encoding"] = global_encoding;
     out["version"][0] = version_major;
     out["version"][1] = version_minor;
+    out["system_identifier"] = LasFile_string(
+        reinterpret_cast<const uint8_t *>(system_identifier),
+        sizeof(system_identifier));
+    out["generating_software"] = LasFile_string(
+        reinterpret_cast<const uint8_t *>(generating_software),
+        sizeof(generating_software));
+    out["file_creation_day_of_year"] = file_creation_day_of_year;
+    out["file_creation_year"] = file_creation_year;
     out["header_size"] = header_size;
     out["offset_to_point_data"] = offset_to_point_data;
+    out["number_of_vlr"] = number_of_vlr;
     out["point_data_record_format"] = point_data_record_format;
     out["point_data_record_length"] = point_data_record_length;
     out["number_of_point_records"] = number_of_point_records;
+    out["offset_to_evlr"] = offset_to_evlr;
+    out["number_of_evlr"] = number_of_evlr;
     out["scale"][0] = x_scale_factor;
     out["scale"][1] = y_scale_factor;
     out["scale"][2] = z_scale_factor;
@@ -26,9 +26,30 @@
 
 #include <File.hpp>
 #include <Json.hpp>
+#include <cstring>
+#include <memory>
+#include <type_traits>
 #include <vector>
 
-/** LAS (LASer) file format. */
+class LazPointStream;
+class ThreadPool;
+
+/** LAS (LASer) file format.
+
+    Points can be read one by one or in batches into Columns. A file
+    created by create() is written in batches from Columns through an
+    internal buffer. Header bounds and point counts are written by close().
+    Records of an optional source file are copied as variable length
+    records, extended records only when they hold WKT.
+
+    LAZ files are decoded to LAS point records by chunks. Batch reads
+    decode one chunk per thread of the optional thread pool. Unchunked
+    LAZ files are decoded in blocks by a single stream decoder.
+
+    Extra bytes attributes of point records are read either as scaled
+    doubles, where no_data values are NaN, or as unscaled values of their
+    own type by readExtraBytesRaw().
+*/
 class LasFile
 {
 public:
@@ -96,9 +117,9 @@ public:
     struct Point
     {
         // format 0 to 10
-        uint32_t x;
-        uint32_t y;
-        uint32_t z;
+        int32_t x;
+        int32_t y;
+        int32_t z;
         uint16_t intensity; // optional
 
         // format 0 to 10
@@ -143,13 +164,118 @@ public:
         Json &serialize(Json &out) const;
     };
 
+    /** LAS variable length record. */
+    struct VariableLengthRecord
+    {
+        std::string user_id;
+        uint16_t record_id;
+        uint64_t record_length; // bytes after record header
+        std::string description;
+        uint64_t offset;        // file offset of record data
+        bool extended;          // EVLR
+
+        Json &serialize(Json &out) const;
+    };
+
+    /** LAS extra bytes attribute. */
+    struct ExtraBytes
+    {
+        uint8_t data_type;
+        uint8_t options;
+        std::string name;
+        std::string description;
+        double no_data;
+        uint64_t no_data_raw; // no_data field, integers are 64-bit
+        double min;
+        double max;
+        double scale;
+        double offset;
+
+        size_t position; // byte offset in point record
+        size_t size;     // bytes in point record
+
+        bool hasNoData() const { return options & 1U; }
+        bool hasScale() const { return options & 8U; }
+        bool hasOffset() const { return options & 16U; }
+
+        Json &serialize(Json &out) const;
+    };
+
+    /** LAS point columns for batch read and write. */
+    struct Columns
+    {
+        std::vector<int32_t> x;
+        std::vector<int32_t> y;
+        std::vector<int32_t> z;
+        std::vector<uint16_t> intensity;
+        std::vector<uint8_t> return_number;
+        std::vector<uint8_t> number_of_returns;
+        std::vector<uint8_t> scan_direction_flag;
+        std::vector<uint8_t> edge_of_flight_line;
+        std::vector<uint8_t> classification_flags;
+        std::vector<uint8_t> scanner_channel;
+        std::vector<uint8_t> classification;
+        std::vector<uint8_t> user_data;
+        std::vector<int16_t> angle;
+        std::vector<uint16_t> source_id;
+        std::vector<double> gps_time;
+        std::vector<uint16_t> red;
+        std::vector<uint16_t> green;
+        std::vector<uint16_t> blue;
+        std::vector<uint16_t> nir;
+        std::vector<uint8_t> extra_bytes; // all extra bytes of each point
+
+        size_t size() const { return x.size(); }
+        void resize(size_t n, size_t extraBytesSize);
+    };
+
+    /** LASzip compression parameters and chunk table. */
+    struct Laszip
+    {
+        /** Compressed item. */
+        struct Item
+        {
+            uint16_t type;
+            uint16_t size;
+            uint16_t version;
+        };
+
+        /** Compressed chunk of points. */
+        struct Chunk
+        {
+            uint64_t offset;
+            uint64_t size;
+            uint64_t npoints;
+        };
+
+        uint16_t compressor;
+        uint16_t coder;
+        uint8_t version_major;
+        uint8_t version_minor;
+        uint16_t version_revision;
+        uint32_t options;
+        uint32_t chunk_size;
+        int64_t number_of_special_evlrs;
+        int64_t offset_to_special_evlrs;
+        std::vector<Item> items;
+        std::vector<Chunk> chunks;
+
+        Json &serialize(Json &out) const;
+    };
+
     Header header;
 
     LasFile();
     ~LasFile();
 
     void open(const std::string &path);
-    void close();
+    void create(const std::string &path,
+                const Header &hdr,
+                const LasFile *vlrSource = nullptr);
+    uint64_t close();
+
+    size_t read(Columns &columns, size_t n, ThreadPool *pool = nullptr);
+    void write(const Columns &columns);
 
     void read(Point &pt);
     void transform(double &x, double &y, double &z, const Point &pt) const;
@@ -160,11 +286,136 @@ public:
                    double &z,
                    const uint8_t *buffer) const;
 
+    size_t read(uint8_t *buffer, size_t n, ThreadPool *pool = nullptr);
+    void transform(double *xyz, const uint8_t *buffer, size_t n) const;
+    void transform(float *xyz,
+                   const double *origin,
+                   const uint8_t *buffer,
+                   size_t n) const;
+
+    // variable length records, data are read on demand
+    size_t getVlrSize() const { return vlr_.size(); }
+    const VariableLengthRecord &getVlr(size_t idx) const { return vlr_[idx]; }
+    size_t findVlr(const std::string &user_id, uint16_t record_id) const;
+    void readVlr(size_t idx, std::vector<uint8_t> &data) const;
+
+    const std::string &getWkt() const { return wkt_; }
+
+    // LAZ
+    bool isCompressed() const { return compressed_; }
+    const Laszip &getLaszip() const { return laszip_; }
+
+    // extra bytes
+    size_t getExtraBytesSize() const { return extraBytes_.size(); }
+    const ExtraBytes &getExtraBytes(size_t idx) const
+    {
+        return extraBytes_[idx];
+    }
+    size_t findExtraBytes(const std::string &name) const;
+    void readExtraBytes(double *column,
+                        size_t idx,
+                        const uint8_t *buffer,
+                        size_t n) const;
+
+    template <class T>
+    void readExtraBytesRaw(T *column,
+                           size_t idx,
+                           const uint8_t *buffer,
+                           size_t n) const;
+
+    template <class T> static uint8_t extraBytesType();
+
+    static size_t pointSize(uint8_t fmt);
+
+    Json &serialize(Json &out) const;
+
 protected:
     File file_;
-
+    std::vector<VariableLengthRecord> vlr_;
+    std::vector<ExtraBytes> extraBytes_;
+    std::string wkt_;
+    bool compressed_;
+    Laszip laszip_;
+
+    // LAZ reader
+    std::vector<uint8_t> lazPoints_;
+    size_t lazPosition_;
+    size_t lazChunk_;
+    std::unique_ptr<LazPointStream> lazStream_;
+    uint64_t lazDecoded_;
+
+    // writer
+    bool create_;
+    std::vector<uint8_t> buffer_;
+    uint64_t npoints_;
+    int32_t min_[3];
+    int32_t max_[3];
+    uint64_t npointsByReturn_[15];
+
+    size_t extraBytesSize() const;
     void read(Header &hdr);
+    static void write(uint8_t *buffer, const Header &hdr);
+    void readVlr();
+    void readVlr(uint64_t offset, uint32_t n, bool extended);
+    void readWkt();
+    void readLaszip();
+    void readLaszipChunks();
+    void readLaszipPoints(ThreadPool *pool);
+    void readLaszipStream();
+    size_t pointsLeft(size_t n) const;
+    void readExtraBytes();
     void read(Point &pt, const uint8_t *buffer, uint8_t fmt) const;
 };
 
+/** Get extra bytes data type 1 to 10 of values of type T, 0 if none. */
+template <class T> inline uint8_t LasFile::extraBytesType()
+{
+    return std::is_same<T, uint8_t>::value    ? 1
+           : std::is_same<T, int8_t>::value   ? 2
+           : std::is_same<T, uint16_t>::value ? 3
+           : std::is_same<T, int16_t>::value  ? 4
+           : std::is_same<T, uint32_t>::value ? 5
+           : std::is_same<T, int32_t>::value  ? 6
+           : std::is_same<T, uint64_t>::value ? 7
+           : std::is_same<T, int64_t>::value  ? 8
+           : std::is_same<T, float>::value    ? 9
+           : std::is_same<T, double>::value   ? 10
+                                              : 0;
+}
+
+/** Read unscaled values of extra bytes attribute idx of n point records.
+
+    The type T must match the data type of the attribute, for example
+    int16_t for data type 4. No data values are returned unchanged.
+*/
+template <class T>
+inline void LasFile::readExtraBytesRaw(T *column,
+                                       size_t idx,
+                                       const uint8_t *buffer,
+                                       size_t n) const
+{
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+    if (sizeof(T) > 1)
+    {
+        THROW("Raw extra bytes of multi-byte values require little endian "
+              "host");
+    }
+#endif
+
+    const ExtraBytes &e = extraBytes_[idx];
+    if (e.data_type == 0 || e.data_type != extraBytesType<T>())
+    {
+        THROW("LAS extra bytes '" + e.name +
+              "' do not match the requested type");
+    }
+
+    const uint8_t *p = buffer + e.position;
+    size_t stride = header.point_data_record_length;
+    for (size_t i = 0; i < n; i++)
+    {
+        std::memcpy(&column[i], p, sizeof(T));
+        p += stride;
+    }
+}
+
 #endif /* LAS_FILE_HPP */
@@ -0,0 +1,363 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file LasTransform.cpp
+*/
+
+#include <Cpu.hpp>
+#include <Endian.hpp>
+#include <LasTransform.hpp>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+template <class T>
+static void lasTransformScalar(T *xyz,
+                               const uint8_t *buffer,
+                               size_t n,
+                               size_t stride,
+                               const double *scale,
+                               const double *offset,
+                               const double *origin)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        for (size_t j = 0; j < 3; j++)
+        {
+            int32_t v = static_cast<int32_t>(ltoh32(&buffer[j * 4]));
+            double d = (static_cast<double>(v) * scale[j]) + offset[j];
+            xyz[j] = static_cast<T>(d - origin[j]);
+        }
+
+        xyz += 3;
+        buffer += stride;
+    }
+}
+
+#if defined(__x86_64__)
+/*
+    Vector kernels load 16 bytes of each record and convert x, y, z and
+    the following 4 bytes to doubles. This file is compiled with
+    -ffp-contract=off, so multiplication and addition are not fused to FMA
+    in any kernel, even with -mfma or -march=native. Subtraction of zero
+    origin is exact, so the results are equal to the scalar code.
+*/
+
+static inline void lasTransformStore(double *xyz, __m128d xy, __m128d z)
+{
+    _mm_storeu_pd(xyz, xy);
+    _mm_store_sd(xyz + 2, z);
+}
+
+static inline void lasTransformStore(float *xyz, __m128d xy, __m128d z)
+{
+    _mm_storel_pi(reinterpret_cast<__m64 *>(xyz), _mm_cvtpd_ps(xy));
+    _mm_store_ss(xyz + 2, _mm_cvtsd_ss(_mm_setzero_ps(), z));
+}
+
+template <class T>
+static void lasTransformSse2(T *xyz,
+                             const uint8_t *buffer,
+                             size_t n,
+                             size_t stride,
+                             const double *scale,
+                             const double *offset,
+                             const double *origin)
+{
+    const __m128d sxy = _mm_setr_pd(scale[0], scale[1]);
+    const __m128d oxy = _mm_setr_pd(offset[0], offset[1]);
+    const __m128d gxy = _mm_setr_pd(origin[0], origin[1]);
+    const __m128d sz = _mm_set1_pd(scale[2]);
+    const __m128d oz = _mm_set1_pd(offset[2]);
+    const __m128d gz = _mm_set1_pd(origin[2]);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        __m128i v =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(buffer));
+        __m128d xy = _mm_cvtepi32_pd(v);
+        __m128d z = _mm_cvtepi32_pd(_mm_srli_si128(v, 8));
+
+        xy = _mm_sub_pd(_mm_add_pd(_mm_mul_pd(xy, sxy), oxy), gxy);
+        z = _mm_sub_pd(_mm_add_pd(_mm_mul_pd(z, sz), oz), gz);
+        lasTransformStore(xyz, xy, z);
+
+        xyz += 3;
+        buffer += stride;
+    }
+}
+
+__attribute__((target("avx2"))) static inline __m256d
+lasTransformLoadAvx2(const uint8_t *buffer, __m256d s, __m256d o, __m256d g)
+{
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(buffer));
+    __m256d p = _mm256_cvtepi32_pd(v);
+    return _mm256_sub_pd(_mm256_add_pd(_mm256_mul_pd(p, s), o), g);
+}
+
+__attribute__((target("avx2"))) static inline void
+lasTransformStoreAvx2(double *xyz, __m256d v)
+{
+    _mm256_storeu_pd(xyz, v);
+}
+
+__attribute__((target("avx2"))) static inline void
+lasTransformStoreAvx2(float *xyz, __m256d v)
+{
+    _mm_storeu_ps(xyz, _mm256_cvtpd_ps(v));
+}
+
+template <class T>
+__attribute__((target("avx2"))) static void
+lasTransformAvx2(T *xyz,
+                 const uint8_t *buffer,
+                 size_t n,
+                 size_t stride,
+                 const double *scale,
+                 const double *offset,
+                 const double *origin)
+{
+    const __m256d s = _mm256_setr_pd(scale[0], scale[1], scale[2], 0);
+    const __m256d o = _mm256_setr_pd(offset[0], offset[1], offset[2], 0);
+    const __m256d g = _mm256_setr_pd(origin[0], origin[1], origin[2], 0);
+
+    // Four points (x, y, z, unused) are packed to three vectors
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d p0 = lasTransformLoadAvx2(buffer, s, o, g);
+        __m256d p1 = lasTransformLoadAvx2(buffer + stride, s, o, g);
+        __m256d p2 = lasTransformLoadAvx2(buffer + (2 * stride), s, o, g);
+        __m256d p3 = lasTransformLoadAvx2(buffer + (3 * stride), s, o, g);
+
+        __m256d v0 =
+            _mm256_blend_pd(p0, _mm256_permute4x64_pd(p1, 0x00), 0x8);
+        __m256d v1 = _mm256_blend_pd(_mm256_permute4x64_pd(p1, 0xF9),
+                                     _mm256_permute4x64_pd(p2, 0x40),
+                                     0xC);
+        __m256d v2 = _mm256_blend_pd(_mm256_permute4x64_pd(p2, 0xAA),
+                                     _mm256_permute4x64_pd(p3, 0x90),
+                                     0xE);
+
+        lasTransformStoreAvx2(xyz, v0);
+        lasTransformStoreAvx2(xyz + 4, v1);
+        lasTransformStoreAvx2(xyz + 8, v2);
+
+        xyz += 12;
+        buffer += 4 * stride;
+    }
+
+    lasTransformSse2(xyz, buffer, n - i, stride, scale, offset, origin);
+}
+
+__attribute__((target("avx512f"))) static inline __m512d
+lasTransformLoadAvx512(const uint8_t *buffer,
+                       size_t stride,
+                       __m512d s,
+                       __m512d o,
+                       __m512d g)
+{
+    const __m128i *a = reinterpret_cast<const __m128i *>(buffer);
+    const __m128i *b = reinterpret_cast<const __m128i *>(buffer + stride);
+    __m256i v = _mm256_castsi128_si256(_mm_loadu_si128(a));
+    v = _mm256_inserti128_si256(v, _mm_loadu_si128(b), 1);
+    __m512d p = _mm512_maskz_cvtepi32_pd(0xFF, v);
+
+    // Explicit rounding prevents contraction to FMA, which AVX-512 implies
+    p = _mm512_maskz_mul_round_pd(0xFF, p, s, _MM_FROUND_CUR_DIRECTION);
+    p = _mm512_maskz_add_round_pd(0xFF, p, o, _MM_FROUND_CUR_DIRECTION);
+    return _mm512_maskz_sub_round_pd(0xFF, p, g, _MM_FROUND_CUR_DIRECTION);
+}
+
+__attribute__((target("avx512f"))) static inline void
+lasTransformStoreAvx512(double *xyz, __m512d v)
+{
+    _mm512_storeu_pd(xyz, v);
+}
+
+__attribute__((target("avx512f"))) static inline void
+lasTransformStoreAvx512(float *xyz, __m512d v)
+{
+    _mm256_storeu_ps(xyz, _mm512_maskz_cvtpd_ps(0xFF, v));
+}
+
+template <class T>
+__attribute__((target("avx512f"))) static void
+lasTransformAvx512(T *xyz,
+                   const uint8_t *buffer,
+                   size_t n,
+                   size_t stride,
+                   const double *scale,
+                   const double *offset,
+                   const double *origin)
+{
+    const __m512d s = _mm512_setr_pd(scale[0],
+                                     scale[1],
+                                     scale[2],
+                                     0,
+                                     scale[0],
+                                     scale[1],
+                                     scale[2],
+                                     0);
+    const __m512d o = _mm512_setr_pd(offset[0],
+                                     offset[1],
+                                     offset[2],
+                                     0,
+                                     offset[0],
+                                     offset[1],
+                                     offset[2],
+                                     0);
+    const __m512d g = _mm512_setr_pd(origin[0],
+                                     origin[1],
+                                     origin[2],
+                                     0,
+                                     origin[0],
+                                     origin[1],
+                                     origin[2],
+                                     0);
+
+    // Eight points, two per vector, are packed to three vectors
+    const __m512i i0 = _mm512_setr_epi64(0, 1, 2, 4, 5, 6, 8, 9);
+    const __m512i i1 = _mm512_setr_epi64(2, 4, 5, 6, 8, 9, 10, 12);
+    const __m512i i2 = _mm512_setr_epi64(5, 6, 8, 9, 10, 12, 13, 14);
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m512d p0 = lasTransformLoadAvx512(buffer, stride, s, o, g);
+        buffer += 2 * stride;
+        __m512d p1 = lasTransformLoadAvx512(buffer, stride, s, o, g);
+        buffer += 2 * stride;
+        __m512d p2 = lasTransformLoadAvx512(buffer, stride, s, o, g);
+        buffer += 2 * stride;
+        __m512d p3 = lasTransformLoadAvx512(buffer, stride, s, o, g);
+        buffer += 2 * stride;
+
+        lasTransformStoreAvx512(xyz, _mm512_permutex2var_pd(p0, i0, p1));
+        lasTransformStoreAvx512(xyz + 8, _mm512_permutex2var_pd(p1, i1, p2));
+        lasTransformStoreAvx512(xyz + 16,
+                                _mm512_permutex2var_pd(p2, i2, p3));
+
+        xyz += 24;
+    }
+
+    lasTransformSse2(xyz, buffer, n - i, stride, scale, offset, origin);
+}
+#endif /* __x86_64__ */
+
+LasTransformKernel lasTransformKernel()
+{
+#if defined(__x86_64__)
+    if (cpuSupportsAvx512())
+    {
+        return LAS_TRANSFORM_AVX512;
+    }
+
+    if (cpuSupportsAvx2())
+    {
+        return LAS_TRANSFORM_AVX2;
+    }
+
+    return LAS_TRANSFORM_SSE2;
+#else
+    return LAS_TRANSFORM_SCALAR;
+#endif
+}
+
+template <class T>
+static void lasTransformDispatch(T *xyz,
+                                 const uint8_t *buffer,
+                                 size_t n,
+                                 size_t stride,
+                                 const double *scale,
+                                 const double *offset,
+                                 const double *origin,
+                                 LasTransformKernel kernel)
+{
+#if defined(__x86_64__)
+    // Vector kernels read 4 bytes after z of each record
+    if (stride >= 16)
+    {
+        switch (kernel)
+        {
+            case LAS_TRANSFORM_AVX512:
+                if (cpuSupportsAvx512())
+                {
+                    lasTransformAvx512(xyz,
+                                       buffer,
+                                       n,
+                                       stride,
+                                       scale,
+                                       offset,
+                                       origin);
+                    return;
+                }
+                break;
+            case LAS_TRANSFORM_AVX2:
+                if (cpuSupportsAvx2())
+                {
+                    lasTransformAvx2(xyz,
+                                     buffer,
+                                     n,
+                                     stride,
+                                     scale,
+                                     offset,
+                                     origin);
+                    return;
+                }
+                break;
+            case LAS_TRANSFORM_SSE2:
+                lasTransformSse2(xyz, buffer, n, stride, scale, offset, origin);
+                return;
+            case LAS_TRANSFORM_SCALAR:
+            default:
+                break;
+        }
+    }
+#else
+    (void)kernel;
+#endif
+
+    lasTransformScalar(xyz, buffer, n, stride, scale, offset, origin);
+}
+
+void lasTransform(double *xyz,
+                  const uint8_t *buffer,
+                  size_t n,
+                  size_t stride,
+                  const double *scale,
+                  const double *offset,
+                  LasTransformKernel kernel)
+{
+    const double origin[3] = {0, 0, 0};
+    lasTransformDispatch(xyz, buffer, n, stride, scale, offset, origin, kernel);
+}
+
+void lasTransform(float *xyz,
+                  const uint8_t *buffer,
+                  size_t n,
+                  size_t stride,
+                  const double *scale,
+                  const double *offset,
+                  const double *origin,
+                  LasTransformKernel kernel)
+{
+    lasTransformDispatch(xyz, buffer, n, stride, scale, offset, origin, kernel);
+}
@@ -0,0 +1,79 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file LasTransform.hpp
+*/
+
+#ifndef LAS_TRANSFORM_HPP
+#define LAS_TRANSFORM_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/** Instruction set of LAS coordinate transform kernels. */
+enum LasTransformKernel
+{
+    LAS_TRANSFORM_SCALAR,
+    LAS_TRANSFORM_SSE2,
+    LAS_TRANSFORM_AVX2,
+    LAS_TRANSFORM_AVX512
+};
+
+/** Get the fastest kernel supported by the processor. */
+LasTransformKernel lasTransformKernel();
+
+/** Transform raw LAS point records to interleaved x, y, z coordinates.
+
+    Each record starts with signed 32-bit x, y and z values. The result is
+    bit exact with scalar (value * scale) + offset in double precision for
+    all kernels.
+
+    @param xyz Output array of 3 * n coordinates.
+    @param buffer Point records, the record size is stride bytes.
+    @param n Number of records.
+    @param stride Record size in bytes, at least 12.
+    @param scale Scale factors of x, y and z.
+    @param offset Offsets of x, y and z.
+    @param kernel Kernel to use, unsupported kernels fall back to scalar.
+*/
+void lasTransform(double *xyz,
+                  const uint8_t *buffer,
+                  size_t n,
+                  size_t stride,
+                  const double *scale,
+                  const double *offset,
+                  LasTransformKernel kernel = lasTransformKernel());
+
+/** Transform raw LAS point records to coordinates relative to origin.
+
+    The result is ((value * scale) + offset) - origin computed in double
+    precision and rounded to float. It is suitable for rendering of cells
+    far from the coordinate system origin.
+*/
+void lasTransform(float *xyz,
+                  const uint8_t *buffer,
+                  size_t n,
+                  size_t stride,
+                  const double *scale,
+                  const double *offset,
+                  const double *origin,
+                  LasTransformKernel kernel = lasTransformKernel());
+
+#endif /* LAS_TRANSFORM_HPP */
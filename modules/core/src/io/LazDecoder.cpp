@@ -0,0 +1,506 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file LazDecoder.cpp
+*/
+
+#include <LazDecoder.hpp>
+
+/** Minimum range length before renormalization. */
+static const uint32_t LAZ_MIN_LENGTH = 0x01000000U;
+
+/** Initial range length. */
+static const uint32_t LAZ_MAX_LENGTH = 0xFFFFFFFFU;
+
+/** Size of the buffer of file streams. */
+static const size_t LAZ_FILE_BUFFER_SIZE = 65536;
+
+/** Bit model probability precision. */
+static const uint32_t LAZ_BM_LENGTH_SHIFT = 13;
+static const uint32_t LAZ_BM_MAX_COUNT = 1U << LAZ_BM_LENGTH_SHIFT;
+
+/** Symbol model probability precision. */
+static const uint32_t LAZ_DM_LENGTH_SHIFT = 15;
+static const uint32_t LAZ_DM_MAX_COUNT = 1U << LAZ_DM_LENGTH_SHIFT;
+
+LazDecoder::SymbolModel::SymbolModel(uint32_t n)
+    : symbols(n),
+      last_symbol(n - 1),
+      table_size(0),
+      table_shift(0),
+      total_count(0),
+      update_cycle(n),
+      symbols_until_update(0),
+      distribution(n),
+      symbol_count(n, 1)
+{
+    // Large alphabets use a lookup table to find the symbol interval
+    if (symbols > 16)
+    {
+        uint32_t tableBits = 3;
+        while (symbols > (1U << (tableBits + 2)))
+        {
+            tableBits++;
+        }
+        table_size = 1U << tableBits;
+        table_shift = LAZ_DM_LENGTH_SHIFT - tableBits;
+        decoder_table.resize(table_size + 2);
+    }
+
+    update();
+    symbols_until_update = update_cycle = (symbols + 6) >> 1;
+}
+
+void LazDecoder::SymbolModel::update()
+{
+    total_count += update_cycle;
+    if (total_count > LAZ_DM_MAX_COUNT)
+    {
+        total_count = 0;
+        for (uint32_t i = 0; i < symbols; i++)
+        {
+            symbol_count[i] = (symbol_count[i] + 1) >> 1;
+            total_count += symbol_count[i];
+        }
+    }
+
+    uint32_t sum = 0;
+    uint32_t s = 0;
+    uint32_t scale = 0x80000000U / total_count;
+
+    for (uint32_t k = 0; k < symbols; k++)
+    {
+        distribution[k] = (scale * sum) >> (31 - LAZ_DM_LENGTH_SHIFT);
+        sum += symbol_count[k];
+
+        if (table_size > 0)
+        {
+            uint32_t w = distribution[k] >> table_shift;
+            while (s < w)
+            {
+                decoder_table[++s] = k - 1;
+            }
+        }
+    }
+
+    if (table_size > 0)
+    {
+        decoder_table[0] = 0;
+        while (s <= table_size)
+        {
+            decoder_table[++s] = symbols - 1;
+        }
+    }
+
+    update_cycle = (5 * update_cycle) >> 2;
+    uint32_t maxCycle = (symbols + 6) << 3;
+    if (update_cycle > maxCycle)
+    {
+        update_cycle = maxCycle;
+    }
+    symbols_until_update = update_cycle;
+}
+
+LazDecoder::BitModel::BitModel()
+    : bit_0_count(1),
+      bit_count(2),
+      bit_0_prob(1U << (LAZ_BM_LENGTH_SHIFT - 1)),
+      update_cycle(4),
+      bits_until_update(4)
+{
+    // empty
+}
+
+void LazDecoder::BitModel::update()
+{
+    bit_count += update_cycle;
+    if (bit_count > LAZ_BM_MAX_COUNT)
+    {
+        bit_count = (bit_count + 1) >> 1;
+        bit_0_count = (bit_0_count + 1) >> 1;
+        if (bit_0_count == bit_count)
+        {
+            bit_count++;
+        }
+    }
+
+    uint32_t scale = 0x80000000U / bit_count;
+    bit_0_prob = (bit_0_count * scale) >> (31 - LAZ_BM_LENGTH_SHIFT);
+
+    update_cycle = (5 * update_cycle) >> 2;
+    if (update_cycle > 64)
+    {
+        update_cycle = 64;
+    }
+    bits_until_update = update_cycle;
+}
+
+LazDecoder::IntegerDecompressor::IntegerDecompressor(LazDecoder &decoder,
+                                                     uint32_t bits,
+                                                     uint32_t contexts,
+                                                     uint32_t bitsHigh)
+    : decoder_(decoder),
+      contexts_(contexts),
+      bitsHigh_(bitsHigh),
+      k_(0)
+{
+    if (bits > 0 && bits < 32)
+    {
+        corrBits_ = bits;
+        corrRange_ = 1U << bits;
+        corrMin_ = -static_cast<int32_t>(corrRange_ / 2);
+    }
+    else
+    {
+        corrBits_ = 32;
+        corrRange_ = 0;
+        corrMin_ = INT32_MIN;
+    }
+
+    bits_.reserve(contexts_);
+    for (uint32_t i = 0; i < contexts_; i++)
+    {
+        bits_.emplace_back(corrBits_ + 1);
+    }
+
+    // Corrector model 0 is the bit model, models 1 to corrBits_ follow
+    corrector_.reserve(corrBits_ + 1);
+    corrector_.emplace_back(2);
+    for (uint32_t i = 1; i <= corrBits_; i++)
+    {
+        if (i <= bitsHigh_)
+        {
+            corrector_.emplace_back(1U << i);
+        }
+        else
+        {
+            corrector_.emplace_back(1U << bitsHigh_);
+        }
+    }
+}
+
+int32_t LazDecoder::IntegerDecompressor::decompress(int32_t pred,
+                                                    uint32_t context)
+{
+    int64_t real = static_cast<int64_t>(pred) + readCorrector(bits_[context]);
+
+    if (real < 0)
+    {
+        real += corrRange_;
+    }
+    else if (corrRange_ > 0 && real >= corrRange_)
+    {
+        real -= corrRange_;
+    }
+
+    // Values wrap around in 32 bits
+    return static_cast<int32_t>(static_cast<uint32_t>(real));
+}
+
+int32_t LazDecoder::IntegerDecompressor::readCorrector(SymbolModel &model)
+{
+    int32_t c;
+
+    k_ = decoder_.decodeSymbol(model);
+
+    if (k_ == 0)
+    {
+        return static_cast<int32_t>(decoder_.decodeBit(corrector0_));
+    }
+
+    if (k_ >= 32)
+    {
+        return corrMin_;
+    }
+
+    uint32_t v;
+    if (k_ <= bitsHigh_)
+    {
+        v = decoder_.decodeSymbol(corrector_[k_]);
+    }
+    else
+    {
+        uint32_t k1 = k_ - bitsHigh_;
+        v = decoder_.decodeSymbol(corrector_[k_]);
+        v = (v << k1) | decoder_.readBits(k1);
+    }
+
+    // Map [0, 2^k) to [-(2^k - 1), -2^(k-1)] and [2^(k-1), 2^k - 1]
+    if (v >= (1U << (k_ - 1)))
+    {
+        c = static_cast<int32_t>(v + 1);
+    }
+    else
+    {
+        c = static_cast<int32_t>(v) - static_cast<int32_t>((1U << k_) - 1);
+    }
+
+    return c;
+}
+
+LazDecoder::LazDecoder()
+    : buffer_(nullptr),
+      size_(0),
+      position_(0),
+      value_(0),
+      length_(LAZ_MAX_LENGTH),
+      file_(nullptr),
+      fileOffset_(0),
+      fileSize_(0)
+{
+    // empty
+}
+
+void LazDecoder::init(const uint8_t *buffer, size_t size)
+{
+    buffer_ = buffer;
+    size_ = size;
+    position_ = 0;
+    length_ = LAZ_MAX_LENGTH;
+    file_ = nullptr;
+    fileSize_ = 0;
+
+    value_ = static_cast<uint32_t>(getByte()) << 24;
+    value_ |= static_cast<uint32_t>(getByte()) << 16;
+    value_ |= static_cast<uint32_t>(getByte()) << 8;
+    value_ |= static_cast<uint32_t>(getByte());
+}
+
+void LazDecoder::init(const File &file, uint64_t offset, uint64_t size)
+{
+    file_ = &file;
+    fileOffset_ = offset;
+    fileSize_ = size;
+    fileBuffer_.resize(LAZ_FILE_BUFFER_SIZE);
+
+    buffer_ = fileBuffer_.data();
+    size_ = 0;
+    position_ = 0;
+    length_ = LAZ_MAX_LENGTH;
+
+    value_ = static_cast<uint32_t>(getByte()) << 24;
+    value_ |= static_cast<uint32_t>(getByte()) << 16;
+    value_ |= static_cast<uint32_t>(getByte()) << 8;
+    value_ |= static_cast<uint32_t>(getByte());
+}
+
+uint8_t LazDecoder::getByte()
+{
+    if (position_ == size_ && fileSize_ > 0)
+    {
+        readFile();
+    }
+
+    // Reading past the end of stream returns zeros
+    if (position_ < size_)
+    {
+        return buffer_[position_++];
+    }
+
+    return 0;
+}
+
+void LazDecoder::readFile()
+{
+    size_t n = fileBuffer_.size();
+    if (fileSize_ < n)
+    {
+        n = static_cast<size_t>(fileSize_);
+    }
+
+    file_->read(fileBuffer_.data(), n, fileOffset_);
+    fileOffset_ += n;
+    fileSize_ -= n;
+
+    buffer_ = fileBuffer_.data();
+    size_ = n;
+    position_ = 0;
+}
+
+void LazDecoder::renormalize()
+{
+    do
+    {
+        value_ = (value_ << 8) | getByte();
+        length_ <<= 8;
+    } while (length_ < LAZ_MIN_LENGTH);
+}
+
+uint32_t LazDecoder::decodeBit(BitModel &model)
+{
+    uint32_t x = model.bit_0_prob * (length_ >> LAZ_BM_LENGTH_SHIFT);
+    uint32_t sym = (value_ >= x) ? 1U : 0U;
+
+    if (sym == 0)
+    {
+        length_ = x;
+        model.bit_0_count++;
+    }
+    else
+    {
+        value_ -= x;
+        length_ -= x;
+    }
+
+    if (length_ < LAZ_MIN_LENGTH)
+    {
+        renormalize();
+    }
+
+    if (--model.bits_until_update == 0)
+    {
+        model.update();
+    }
+
+    return sym;
+}
+
+uint32_t LazDecoder::decodeSymbol(SymbolModel &model)
+{
+    uint32_t n;
+    uint32_t sym;
+    uint32_t x;
+    uint32_t y = length_;
+
+    if (model.table_size > 0)
+    {
+        length_ >>= LAZ_DM_LENGTH_SHIFT;
+        uint32_t dv = value_ / length_;
+        uint32_t t = dv >> model.table_shift;
+
+        // Binary search in the interval given by the table
+        sym = model.decoder_table[t];
+        n = model.decoder_table[t + 1] + 1;
+        while (n > sym + 1)
+        {
+            uint32_t k = (sym + n) >> 1;
+            if (model.distribution[k] > dv)
+            {
+                n = k;
+            }
+            else
+            {
+                sym = k;
+            }
+        }
+
+        x = model.distribution[sym] * length_;
+        if (sym != model.last_symbol)
+        {
+            y = model.distribution[sym + 1] * length_;
+        }
+    }
+    else
+    {
+        x = sym = 0;
+        length_ >>= LAZ_DM_LENGTH_SHIFT;
+        n = model.symbols;
+        uint32_t k = n >> 1;
+
+        // Bisection
+        do
+        {
+            uint32_t z = length_ * model.distribution[k];
+            if (z > value_)
+            {
+                n = k;
+                y = z;
+            }
+            else
+            {
+                sym = k;
+                x = z;
+            }
+            k = (sym + n) >> 1;
+        } while (k != sym);
+    }
+
+    value_ -= x;
+    length_ = y - x;
+
+    if (length_ < LAZ_MIN_LENGTH)
+    {
+        renormalize();
+    }
+
+    model.symbol_count[sym]++;
+    if (--model.symbols_until_update == 0)
+    {
+        model.update();
+    }
+
+    return sym;
+}
+
+uint32_t LazDecoder::readBit()
+{
+    length_ >>= 1;
+    uint32_t sym = value_ / length_;
+    value_ -= length_ * sym;
+
+    if (length_ < LAZ_MIN_LENGTH)
+    {
+        renormalize();
+    }
+
+    return sym;
+}
+
+uint32_t LazDecoder::readBits(uint32_t bits)
+{
+    if (bits > 19)
+    {
+        uint32_t lower = readShort();
+        uint32_t upper = readBits(bits - 16);
+        return (upper << 16) | lower;
+    }
+
+    length_ >>= bits;
+    uint32_t sym = value_ / length_;
+    value_ -= length_ * sym;
+
+    if (length_ < LAZ_MIN_LENGTH)
+    {
+        renormalize();
+    }
+
+    return sym;
+}
+
+uint32_t LazDecoder::readShort()
+{
+    length_ >>= 16;
+    uint32_t sym = value_ / length_;
+    value_ -= length_ * sym;
+
+    if (length_ < LAZ_MIN_LENGTH)
+    {
+        renormalize();
+    }
+
+    return sym;
+}
+
+uint32_t LazDecoder::readInt()
+{
+    uint32_t lower = readShort();
+    uint32_t upper = readShort();
+    return (upper << 16) | lower;
+}
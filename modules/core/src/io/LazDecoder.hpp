@@ -0,0 +1,130 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file LazDecoder.hpp
+*/
+
+#ifndef LAZ_DECODER_HPP
+#define LAZ_DECODER_HPP
+
+#include <File.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/** LAZ arithmetic decoder.
+
+    Range decoder with adaptive symbol and bit models and integer
+    decompressor as defined by LASzip compressed streams. The stream is
+    either a buffer in memory or a range of a file, which is read through
+    a small buffer as the decoder advances.
+*/
+class LazDecoder
+{
+public:
+    /** Adaptive symbol model. */
+    struct SymbolModel
+    {
+        uint32_t symbols;
+        uint32_t last_symbol;
+        uint32_t table_size;
+        uint32_t table_shift;
+        uint32_t total_count;
+        uint32_t update_cycle;
+        uint32_t symbols_until_update;
+        std::vector<uint32_t> distribution;
+        std::vector<uint32_t> symbol_count;
+        std::vector<uint32_t> decoder_table;
+
+        explicit SymbolModel(uint32_t n);
+        void update();
+    };
+
+    /** Adaptive bit model. */
+    struct BitModel
+    {
+        uint32_t bit_0_count;
+        uint32_t bit_count;
+        uint32_t bit_0_prob;
+        uint32_t update_cycle;
+        uint32_t bits_until_update;
+
+        BitModel();
+        void update();
+    };
+
+    /** Integer decompressor, decodes corrections of predicted values. */
+    class IntegerDecompressor
+    {
+    public:
+        IntegerDecompressor(LazDecoder &decoder,
+                            uint32_t bits = 16,
+                            uint32_t contexts = 1,
+                            uint32_t bitsHigh = 8);
+
+        int32_t decompress(int32_t pred, uint32_t context = 0);
+        uint32_t getK() const { return k_; }
+
+    protected:
+        LazDecoder &decoder_;
+        uint32_t contexts_;
+        uint32_t bitsHigh_;
+        uint32_t corrBits_;
+        uint32_t corrRange_;
+        int32_t corrMin_;
+        uint32_t k_;
+        std::vector<SymbolModel> bits_;
+        BitModel corrector0_;
+        std::vector<SymbolModel> corrector_;
+
+        int32_t readCorrector(SymbolModel &model);
+    };
+
+    LazDecoder();
+
+    void init(const uint8_t *buffer, size_t size);
+    void init(const File &file, uint64_t offset, uint64_t size);
+
+    uint32_t decodeBit(BitModel &model);
+    uint32_t decodeSymbol(SymbolModel &model);
+    uint32_t readBit();
+    uint32_t readBits(uint32_t bits);
+    uint32_t readShort();
+    uint32_t readInt();
+
+protected:
+    const uint8_t *buffer_;
+    size_t size_;
+    size_t position_;
+    uint32_t value_;
+    uint32_t length_;
+
+    // file stream
+    const File *file_;
+    uint64_t fileOffset_;
+    uint64_t fileSize_;
+    std::vector<uint8_t> fileBuffer_;
+
+    uint8_t getByte();
+    void readFile();
+    void renormalize();
+};
+
+#endif /* LAZ_DECODER_HPP */
@@ -0,0 +1,1506 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file LazPointDecoder.cpp
+*/
+
+#include <Endian.hpp>
+#include <Error.hpp>
+#include <LazDecoder.hpp>
+#include <LazPointDecoder.hpp>
+#include <cstring>
+#include <memory>
+
+/** LASzip item types. */
+static const uint16_t LAZ_ITEM_BYTE = 0;
+static const uint16_t LAZ_ITEM_POINT10 = 6;
+static const uint16_t LAZ_ITEM_GPSTIME11 = 7;
+static const uint16_t LAZ_ITEM_RGB12 = 8;
+static const uint16_t LAZ_ITEM_POINT14 = 10;
+static const uint16_t LAZ_ITEM_RGB14 = 11;
+static const uint16_t LAZ_ITEM_RGBNIR14 = 12;
+static const uint16_t LAZ_ITEM_BYTE14 = 14;
+
+/** LASzip compressor of LAS 1.4 layered chunks. */
+static const uint16_t LAZ_COMPRESSOR_LAYERED = 3;
+
+/** GPS time codes of the multiplier model. */
+static const uint32_t LAZ_GPS_TIME_MULTI = 500;
+static const int32_t LAZ_GPS_TIME_MULTI_MINUS = -10;
+static const uint32_t LAZ_GPS_TIME_MULTI_UNCHANGED = 511;
+
+/** Return map of pointwise points. */
+static const uint8_t LAZ_NUMBER_RETURN_MAP[8][8] = {
+    {15, 14, 13, 12, 11, 10, 9, 8},
+    {14, 0, 1, 3, 6, 10, 10, 9},
+    {13, 1, 2, 4, 7, 11, 11, 10},
+    {12, 3, 4, 5, 8, 12, 12, 11},
+    {11, 6, 7, 8, 9, 13, 13, 12},
+    {10, 10, 11, 12, 13, 14, 14, 13},
+    {9, 10, 11, 12, 13, 14, 15, 14},
+    {8, 9, 10, 11, 12, 13, 14, 15}};
+
+/** Return map of layered points. */
+static const uint8_t LAZ_NUMBER_RETURN_MAP_6CTX[16][16] = {
+    {0, 1, 2, 3, 4, 5, 3, 4, 4, 5, 5, 5, 5, 5, 5, 5},
+    {1, 0, 1, 3, 4, 5, 3, 4, 4, 5, 5, 5, 5, 5, 5, 5},
+    {2, 1, 2, 4, 5, 3, 4, 4, 5, 5, 5, 5, 5, 5, 5, 5},
+    {3, 3, 4, 5, 4, 5, 4, 4, 5, 5, 5, 5, 5, 5, 5, 5},
+    {4, 4, 5, 4, 5, 5, 4, 4, 5, 5, 5, 5, 5, 5, 5, 5},
+    {5, 5, 3, 5, 5, 5, 4, 4, 5, 5, 5, 5, 5, 5, 5, 5},
+    {3, 3, 4, 4, 4, 4, 4, 4, 5, 5, 5, 5, 5, 5, 5, 5},
+    {4, 4, 4, 4, 4, 4, 4, 4, 5, 5, 5, 5, 5, 5, 5, 5},
+    {4, 4, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5},
+    {5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5},
+    {5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5},
+    {5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5},
+    {5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5},
+    {5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5},
+    {5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5},
+    {5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5}};
+
+/** Lazily created symbol model. */
+typedef std::unique_ptr<LazDecoder::SymbolModel> LazPointDecoderModel;
+
+static uint32_t LazPointDecoder_decode(LazDecoder &dec,
+                                       LazPointDecoderModel &model,
+                                       uint32_t symbols)
+{
+    if (!model)
+    {
+        model = std::make_unique<LazDecoder::SymbolModel>(symbols);
+    }
+
+    return dec.decodeSymbol(*model);
+}
+
+static uint8_t LazPointDecoder_fold(int32_t n)
+{
+    if (n < 0)
+    {
+        n += 256;
+    }
+    else if (n > 255)
+    {
+        n -= 256;
+    }
+
+    return static_cast<uint8_t>(n);
+}
+
+static int32_t LazPointDecoder_clamp(int32_t n)
+{
+    return (n < 0) ? 0 : ((n > 255) ? 255 : n);
+}
+
+/** Context of coordinate differences from the K of previous corrector. */
+static uint32_t LazPointDecoder_context(uint32_t n, uint32_t k, uint32_t max)
+{
+    return ((n == 1) ? 1U : 0U) + ((k < max) ? (k & ~1U) : max);
+}
+
+static int32_t LazPointDecoder_add(int32_t a, int32_t b)
+{
+    return static_cast<int32_t>(static_cast<uint32_t>(a) +
+                                static_cast<uint32_t>(b));
+}
+
+static int32_t LazPointDecoder_multiply(int32_t a, int32_t b)
+{
+    return static_cast<int32_t>(static_cast<uint32_t>(a) *
+                                static_cast<uint32_t>(b));
+}
+
+/** Streaming median of the last five values. */
+struct LazPointDecoderMedian
+{
+    int32_t values[5];
+    bool high;
+
+    LazPointDecoderMedian() : values{0, 0, 0, 0, 0}, high(true) {}
+
+    int32_t get() const { return values[2]; }
+    void add(int32_t v);
+};
+
+void LazPointDecoderMedian::add(int32_t v)
+{
+    if (high)
+    {
+        if (v < values[2])
+        {
+            values[4] = values[3];
+            values[3] = values[2];
+            if (v < values[0])
+            {
+                values[2] = values[1];
+                values[1] = values[0];
+                values[0] = v;
+            }
+            else if (v < values[1])
+            {
+                values[2] = values[1];
+                values[1] = v;
+            }
+            else
+            {
+                values[2] = v;
+            }
+        }
+        else
+        {
+            if (v < values[3])
+            {
+                values[4] = values[3];
+                values[3] = v;
+            }
+            else
+            {
+                values[4] = v;
+            }
+            high = false;
+        }
+    }
+    else
+    {
+        if (values[2] < v)
+        {
+            values[0] = values[1];
+            values[1] = values[2];
+            if (values[4] < v)
+            {
+                values[2] = values[3];
+                values[3] = values[4];
+                values[4] = v;
+            }
+            else if (values[3] < v)
+            {
+                values[2] = values[3];
+                values[3] = v;
+            }
+            else
+            {
+                values[2] = v;
+            }
+        }
+        else
+        {
+            if (values[1] < v)
+            {
+                values[0] = values[1];
+                values[1] = v;
+            }
+            else
+            {
+                values[0] = v;
+            }
+            high = true;
+        }
+    }
+}
+
+/** GPS time predicted from up to four interleaved sequences. */
+struct LazPointDecoderGpsTime
+{
+    LazDecoder &dec;
+    LazDecoder::SymbolModel multi;
+    LazDecoder::SymbolModel zeroDiff;
+    LazDecoder::IntegerDecompressor ic;
+    bool layered;
+    uint32_t codeFull;
+    uint32_t last;
+    uint32_t next;
+    uint64_t value[4];
+    int32_t diff[4];
+    int32_t extreme[4];
+
+    LazPointDecoderGpsTime(LazDecoder &decoder, bool layeredItem);
+
+    void init(uint64_t v);
+    void read();
+    void readFull();
+    void update(int32_t d);
+};
+
+LazPointDecoderGpsTime::LazPointDecoderGpsTime(LazDecoder &decoder,
+                                               bool layeredItem)
+    : dec(decoder),
+      multi(layeredItem ? 515 : 516),
+      zeroDiff(layeredItem ? 5 : 6),
+      ic(decoder, 32, 9),
+      layered(layeredItem),
+      codeFull(layeredItem ? 511 : 512),
+      last(0),
+      next(0),
+      value{0, 0, 0, 0},
+      diff{0, 0, 0, 0},
+      extreme{0, 0, 0, 0}
+{
+    // empty
+}
+
+void LazPointDecoderGpsTime::init(uint64_t v)
+{
+    last = 0;
+    next = 0;
+    for (size_t i = 0; i < 4; i++)
+    {
+        value[i] = 0;
+        diff[i] = 0;
+        extreme[i] = 0;
+    }
+    value[0] = v;
+}
+
+void LazPointDecoderGpsTime::readFull()
+{
+    next = (next + 1) & 3U;
+    int32_t high = ic.decompress(static_cast<int32_t>(value[last] >> 32), 8);
+    value[next] = static_cast<uint64_t>(static_cast<uint32_t>(high)) << 32;
+    value[next] |= dec.readInt();
+    last = next;
+    diff[last] = 0;
+    extreme[last] = 0;
+}
+
+void LazPointDecoderGpsTime::update(int32_t d)
+{
+    // Extreme differences replace the predicted difference after a while
+    extreme[last]++;
+    if (extreme[last] > 3)
+    {
+        diff[last] = d;
+        extreme[last] = 0;
+    }
+}
+
+void LazPointDecoderGpsTime::read()
+{
+    if (diff[last] == 0)
+    {
+        uint32_t sym = dec.decodeSymbol(zeroDiff);
+
+        // Pointwise items code unchanged time as zero
+        if (!layered)
+        {
+            if (sym == 0)
+            {
+                return;
+            }
+            sym--;
+        }
+
+        if (sym == 0)
+        {
+            diff[last] = ic.decompress(0, 0);
+            value[last] += static_cast<uint64_t>(diff[last]);
+            extreme[last] = 0;
+        }
+        else if (sym == 1)
+        {
+            readFull();
+        }
+        else
+        {
+            last = (last + sym - 1) & 3U;
+            read();
+        }
+
+        return;
+    }
+
+    uint32_t sym = dec.decodeSymbol(multi);
+    if (sym == 1)
+    {
+        value[last] += static_cast<uint64_t>(ic.decompress(diff[last], 1));
+        extreme[last] = 0;
+    }
+    else if (sym < LAZ_GPS_TIME_MULTI_UNCHANGED)
+    {
+        int32_t d;
+        if (sym == 0)
+        {
+            d = ic.decompress(0, 7);
+            update(d);
+        }
+        else if (sym < LAZ_GPS_TIME_MULTI)
+        {
+            int32_t m = static_cast<int32_t>(sym);
+            d = ic.decompress(LazPointDecoder_multiply(m, diff[last]),
+                              (sym < 10) ? 2 : 3);
+        }
+        else if (sym == LAZ_GPS_TIME_MULTI)
+        {
+            int32_t m = static_cast<int32_t>(LAZ_GPS_TIME_MULTI);
+            d = ic.decompress(LazPointDecoder_multiply(m, diff[last]), 4);
+            update(d);
+        }
+        else
+        {
+            int32_t m = static_cast<int32_t>(LAZ_GPS_TIME_MULTI - sym);
+            if (m > LAZ_GPS_TIME_MULTI_MINUS)
+            {
+                d = ic.decompress(LazPointDecoder_multiply(m, diff[last]), 5);
+            }
+            else
+            {
+                m = LAZ_GPS_TIME_MULTI_MINUS;
+                d = ic.decompress(LazPointDecoder_multiply(m, diff[last]), 6);
+                update(d);
+            }
+        }
+        value[last] += static_cast<uint64_t>(d);
+    }
+    else if (sym == codeFull)
+    {
+        readFull();
+    }
+    else if (sym > codeFull)
+    {
+        last = (last + sym - codeFull) & 3U;
+        read();
+    }
+}
+
+/** Models of RGB differences. */
+struct LazPointDecoderRgb
+{
+    LazDecoder::SymbolModel byteUsed;
+    std::vector<LazDecoder::SymbolModel> diff;
+
+    LazPointDecoderRgb() : byteUsed(128), diff(6, LazDecoder::SymbolModel(256))
+    {
+    }
+
+    void read(LazDecoder &dec, uint16_t *rgb, const uint16_t *last);
+};
+
+void LazPointDecoderRgb::read(LazDecoder &dec,
+                              uint16_t *rgb,
+                              const uint16_t *last)
+{
+    // Red is predicted from the last red, green and blue from red changes
+    int32_t low[3];
+    int32_t high[3];
+    int32_t lastLow[3];
+    int32_t lastHigh[3];
+    for (size_t i = 0; i < 3; i++)
+    {
+        lastLow[i] = last[i] & 255;
+        lastHigh[i] = last[i] >> 8;
+        low[i] = lastLow[i];
+        high[i] = lastHigh[i];
+    }
+
+    uint32_t sym = dec.decodeSymbol(byteUsed);
+
+    if (sym & 1U)
+    {
+        int32_t corr = static_cast<int32_t>(dec.decodeSymbol(diff[0]));
+        low[0] = LazPointDecoder_fold(corr + lastLow[0]);
+    }
+
+    if (sym & 2U)
+    {
+        int32_t corr = static_cast<int32_t>(dec.decodeSymbol(diff[1]));
+        high[0] = LazPointDecoder_fold(corr + lastHigh[0]);
+    }
+
+    if (sym & 64U)
+    {
+        int32_t d = low[0] - lastLow[0];
+        if (sym & 4U)
+        {
+            int32_t corr = static_cast<int32_t>(dec.decodeSymbol(diff[2]));
+            int32_t pred = LazPointDecoder_clamp(d + lastLow[1]);
+            low[1] = LazPointDecoder_fold(corr + pred);
+        }
+
+        if (sym & 16U)
+        {
+            int32_t corr = static_cast<int32_t>(dec.decodeSymbol(diff[4]));
+            d = (d + (low[1] - lastLow[1])) / 2;
+            int32_t pred = LazPointDecoder_clamp(d + lastLow[2]);
+            low[2] = LazPointDecoder_fold(corr + pred);
+        }
+
+        d = high[0] - lastHigh[0];
+        if (sym & 8U)
+        {
+            int32_t corr = static_cast<int32_t>(dec.decodeSymbol(diff[3]));
+            int32_t pred = LazPointDecoder_clamp(d + lastHigh[1]);
+            high[1] = LazPointDecoder_fold(corr + pred);
+        }
+
+        if (sym & 32U)
+        {
+            int32_t corr = static_cast<int32_t>(dec.decodeSymbol(diff[5]));
+            d = (d + (high[1] - lastHigh[1])) / 2;
+            int32_t pred = LazPointDecoder_clamp(d + lastHigh[2]);
+            high[2] = LazPointDecoder_fold(corr + pred);
+        }
+    }
+    else
+    {
+        // Grey
+        for (size_t i = 1; i < 3; i++)
+        {
+            low[i] = low[0];
+            high[i] = high[0];
+        }
+    }
+
+    for (size_t i = 0; i < 3; i++)
+    {
+        rgb[i] = static_cast<uint16_t>(low[i] | (high[i] << 8));
+    }
+}
+
+/** Decoder of one item of a point record. */
+class LazPointDecoderItem
+{
+public:
+    virtual ~LazPointDecoderItem() {}
+
+    /** Get the number of layers of a layered item. */
+    virtual size_t layers() const { return 0; }
+
+    /** Set the compressed data of one layer before init(). */
+    virtual void setLayer(size_t, const uint8_t *, size_t) {}
+
+    /** Start a chunk with the first raw item. */
+    virtual void init(const uint8_t *item, uint32_t &context) = 0;
+
+    /** Decode the next item. Layered items share the scanner channel. */
+    virtual void read(uint8_t *item, uint32_t &context) = 0;
+};
+
+/** Point of formats 0 to 5, pointwise version 2. */
+class LazPointDecoderPoint10 : public LazPointDecoderItem
+{
+public:
+    explicit LazPointDecoderPoint10(LazDecoder &dec);
+    virtual ~LazPointDecoderPoint10() {}
+
+    virtual void init(const uint8_t *item, uint32_t &context);
+    virtual void read(uint8_t *item, uint32_t &context);
+
+protected:
+    LazDecoder &dec_;
+    LazDecoder::SymbolModel changedValues_;
+    LazDecoder::IntegerDecompressor icIntensity_;
+    std::vector<LazDecoder::SymbolModel> scanAngleRank_;
+    LazDecoder::IntegerDecompressor icPointSourceId_;
+    LazPointDecoderModel bitByte_[256];
+    LazPointDecoderModel classification_[256];
+    LazPointDecoderModel userData_[256];
+    LazDecoder::IntegerDecompressor icDx_;
+    LazDecoder::IntegerDecompressor icDy_;
+    LazDecoder::IntegerDecompressor icZ_;
+    LazPointDecoderMedian lastDx_[16];
+    LazPointDecoderMedian lastDy_[16];
+    uint16_t lastIntensity_[16];
+    int32_t lastZ_[8];
+    uint8_t last_[20];
+};
+
+LazPointDecoderPoint10::LazPointDecoderPoint10(LazDecoder &dec)
+    : dec_(dec),
+      changedValues_(64),
+      icIntensity_(dec, 16, 4),
+      scanAngleRank_(2, LazDecoder::SymbolModel(256)),
+      icPointSourceId_(dec, 16),
+      icDx_(dec, 32, 2),
+      icDy_(dec, 32, 22),
+      icZ_(dec, 32, 20),
+      lastIntensity_{},
+      lastZ_{},
+      last_{}
+{
+    // empty
+}
+
+void LazPointDecoderPoint10::init(const uint8_t *item, uint32_t &context)
+{
+    (void)context;
+    std::memcpy(last_, item, sizeof(last_));
+    htol16(&last_[12], 0);
+}
+
+void LazPointDecoderPoint10::read(uint8_t *item, uint32_t &context)
+{
+    (void)context;
+    uint32_t changed = dec_.decodeSymbol(changedValues_);
+
+    if (changed & 32U)
+    {
+        last_[14] = static_cast<uint8_t>(
+            LazPointDecoder_decode(dec_, bitByte_[last_[14]], 256));
+    }
+
+    uint32_t r = last_[14] & 7U;
+    uint32_t n = (last_[14] >> 3) & 7U;
+    uint32_t m = LAZ_NUMBER_RETURN_MAP[n][r];
+    uint32_t l = (n > r) ? (n - r) : (r - n);
+
+    if (changed & 16U)
+    {
+        int32_t pred = lastIntensity_[m];
+        uint16_t v = static_cast<uint16_t>(
+            icIntensity_.decompress(pred, (m < 3) ? m : 3));
+        lastIntensity_[m] = v;
+        htol16(&last_[12], v);
+    }
+    else if (changed != 0)
+    {
+        htol16(&last_[12], lastIntensity_[m]);
+    }
+
+    if (changed & 8U)
+    {
+        last_[15] = static_cast<uint8_t>(
+            LazPointDecoder_decode(dec_, classification_[last_[15]], 256));
+    }
+
+    if (changed & 4U)
+    {
+        uint32_t direction = (last_[14] >> 6) & 1U;
+        int32_t v = static_cast<int32_t>(
+            dec_.decodeSymbol(scanAngleRank_[direction]));
+        last_[16] = LazPointDecoder_fold(v + last_[16]);
+    }
+
+    if (changed & 2U)
+    {
+        last_[17] = static_cast<uint8_t>(
+            LazPointDecoder_decode(dec_, userData_[last_[17]], 256));
+    }
+
+    if (changed & 1U)
+    {
+        int32_t pred = ltoh16(&last_[18]);
+        htol16(&last_[18],
+               static_cast<uint16_t>(icPointSourceId_.decompress(pred)));
+    }
+
+    // Coordinates
+    int32_t median = lastDx_[m].get();
+    int32_t diff = icDx_.decompress(median, (n == 1) ? 1 : 0);
+    int32_t x = static_cast<int32_t>(ltoh32(&last_[0]));
+    htol32(&last_[0], static_cast<uint32_t>(LazPointDecoder_add(x, diff)));
+    lastDx_[m].add(diff);
+
+    median = lastDy_[m].get();
+    uint32_t k = icDx_.getK();
+    diff = icDy_.decompress(median, LazPointDecoder_context(n, k, 20));
+    int32_t y = static_cast<int32_t>(ltoh32(&last_[4]));
+    htol32(&last_[4], static_cast<uint32_t>(LazPointDecoder_add(y, diff)));
+    lastDy_[m].add(diff);
+
+    k = (icDx_.getK() + icDy_.getK()) / 2;
+    lastZ_[l] = icZ_.decompress(lastZ_[l], LazPointDecoder_context(n, k, 18));
+    htol32(&last_[8], static_cast<uint32_t>(lastZ_[l]));
+
+    std::memcpy(item, last_, sizeof(last_));
+}
+
+/** GPS time of formats 1, 3, 4 and 5, pointwise version 2. */
+class LazPointDecoderGpsTime11 : public LazPointDecoderItem
+{
+public:
+    explicit LazPointDecoderGpsTime11(LazDecoder &dec) : gpsTime_(dec, false)
+    {
+    }
+    virtual ~LazPointDecoderGpsTime11() {}
+
+    virtual void init(const uint8_t *item, uint32_t &context)
+    {
+        (void)context;
+        gpsTime_.init(ltoh64(item));
+    }
+
+    virtual void read(uint8_t *item, uint32_t &context)
+    {
+        (void)context;
+        gpsTime_.read();
+        htol64(item, gpsTime_.value[gpsTime_.last]);
+    }
+
+protected:
+    LazPointDecoderGpsTime gpsTime_;
+};
+
+/** RGB of formats 2, 3 and 5, pointwise version 2. */
+class LazPointDecoderRgb12 : public LazPointDecoderItem
+{
+public:
+    explicit LazPointDecoderRgb12(LazDecoder &dec) : dec_(dec), last_{} {}
+    virtual ~LazPointDecoderRgb12() {}
+
+    virtual void init(const uint8_t *item, uint32_t &context)
+    {
+        (void)context;
+        for (size_t i = 0; i < 3; i++)
+        {
+            last_[i] = ltoh16(&item[i * 2]);
+        }
+    }
+
+    virtual void read(uint8_t *item, uint32_t &context)
+    {
+        (void)context;
+        rgb_.read(dec_, last_, last_);
+        for (size_t i = 0; i < 3; i++)
+        {
+            htol16(&item[i * 2], last_[i]);
+        }
+    }
+
+protected:
+    LazDecoder &dec_;
+    LazPointDecoderRgb rgb_;
+    uint16_t last_[3];
+};
+
+/** Extra bytes, pointwise version 2. */
+class LazPointDecoderByte10 : public LazPointDecoderItem
+{
+public:
+    LazPointDecoderByte10(LazDecoder &dec, size_t n)
+        : dec_(dec),
+          models_(n, LazDecoder::SymbolModel(256)),
+          last_(n)
+    {
+    }
+    virtual ~LazPointDecoderByte10() {}
+
+    virtual void init(const uint8_t *item, uint32_t &context)
+    {
+        (void)context;
+        std::memcpy(last_.data(), item, last_.size());
+    }
+
+    virtual void read(uint8_t *item, uint32_t &context)
+    {
+        (void)context;
+        for (size_t i = 0; i < last_.size(); i++)
+        {
+            int32_t v = static_cast<int32_t>(dec_.decodeSymbol(models_[i]));
+            last_[i] = LazPointDecoder_fold(v + last_[i]);
+        }
+        std::memcpy(item, last_.data(), last_.size());
+    }
+
+protected:
+    LazDecoder &dec_;
+    std::vector<LazDecoder::SymbolModel> models_;
+    std::vector<uint8_t> last_;
+};
+
+/** Unpacked point of formats 6 to 10. */
+struct LazPointDecoderPoint14Data
+{
+    int32_t x;
+    int32_t y;
+    int32_t z;
+    uint16_t intensity;
+    uint32_t returnNumber;
+    uint32_t numberOfReturns;
+    uint32_t classificationFlags;
+    uint32_t scannerChannel;
+    uint32_t scanDirectionFlag;
+    uint32_t edgeOfFlightLine;
+    uint32_t classification;
+    uint32_t userData;
+    int16_t scanAngle;
+    uint16_t pointSourceId;
+    uint64_t gpsTime;
+    bool gpsTimeChange;
+
+    void unpack(const uint8_t *item);
+    void pack(uint8_t *item) const;
+};
+
+void LazPointDecoderPoint14Data::unpack(const uint8_t *item)
+{
+    x = static_cast<int32_t>(ltoh32(&item[0]));
+    y = static_cast<int32_t>(ltoh32(&item[4]));
+    z = static_cast<int32_t>(ltoh32(&item[8]));
+    intensity = ltoh16(&item[12]);
+    returnNumber = item[14] & 15U;
+    numberOfReturns = (item[14] >> 4) & 15U;
+    classificationFlags = item[15] & 15U;
+    scannerChannel = (item[15] >> 4) & 3U;
+    scanDirectionFlag = (item[15] >> 6) & 1U;
+    edgeOfFlightLine = (item[15] >> 7) & 1U;
+    classification = item[16];
+    userData = item[17];
+    scanAngle = static_cast<int16_t>(ltoh16(&item[18]));
+    pointSourceId = ltoh16(&item[20]);
+    gpsTime = ltoh64(&item[22]);
+    gpsTimeChange = false;
+}
+
+void LazPointDecoderPoint14Data::pack(uint8_t *item) const
+{
+    htol32(&item[0], static_cast<uint32_t>(x));
+    htol32(&item[4], static_cast<uint32_t>(y));
+    htol32(&item[8], static_cast<uint32_t>(z));
+    htol16(&item[12], intensity);
+    item[14] = static_cast<uint8_t>(returnNumber | (numberOfReturns << 4));
+    item[15] = static_cast<uint8_t>(classificationFlags |
+                                    (scannerChannel << 4) |
+                                    (scanDirectionFlag << 6) |
+                                    (edgeOfFlightLine << 7));
+    item[16] = static_cast<uint8_t>(classification);
+    item[17] = static_cast<uint8_t>(userData);
+    htol16(&item[18], static_cast<uint16_t>(scanAngle));
+    htol16(&item[20], pointSourceId);
+    htol64(&item[22], gpsTime);
+}
+
+/** Layers of points of formats 6 to 10. */
+enum LazPointDecoderLayer
+{
+    LAZ_LAYER_XY,
+    LAZ_LAYER_Z,
+    LAZ_LAYER_CLASSIFICATION,
+    LAZ_LAYER_FLAGS,
+    LAZ_LAYER_INTENSITY,
+    LAZ_LAYER_SCAN_ANGLE,
+    LAZ_LAYER_USER_DATA,
+    LAZ_LAYER_POINT_SOURCE,
+    LAZ_LAYER_GPS_TIME,
+    LAZ_LAYER_COUNT
+};
+
+/** Models of one scanner channel of formats 6 to 10. */
+struct LazPointDecoderPoint14Context
+{
+    LazPointDecoderPoint14Data last;
+    uint16_t lastIntensity[8];
+    LazPointDecoderMedian lastDx[12];
+    LazPointDecoderMedian lastDy[12];
+    int32_t lastZ[8];
+
+    std::vector<LazDecoder::SymbolModel> changedValues;
+    LazDecoder::SymbolModel scannerChannel;
+    LazPointDecoderModel numberOfReturns[16];
+    LazDecoder::SymbolModel returnNumberGpsSame;
+    LazPointDecoderModel returnNumber[16];
+    LazDecoder::IntegerDecompressor icDx;
+    LazDecoder::IntegerDecompressor icDy;
+    LazDecoder::IntegerDecompressor icZ;
+    LazPointDecoderModel classification[64];
+    LazPointDecoderModel flags[64];
+    LazPointDecoderModel userData[64];
+    LazDecoder::IntegerDecompressor icIntensity;
+    LazDecoder::IntegerDecompressor icScanAngle;
+    LazDecoder::IntegerDecompressor icPointSourceId;
+    LazPointDecoderGpsTime gpsTime;
+
+    LazPointDecoderPoint14Context(LazDecoder *dec,
+                                  const LazPointDecoderPoint14Data &item);
+};
+
+LazPointDecoderPoint14Context::LazPointDecoderPoint14Context(
+    LazDecoder *dec,
+    const LazPointDecoderPoint14Data &item)
+    : last(item),
+      changedValues(8, LazDecoder::SymbolModel(128)),
+      scannerChannel(3),
+      returnNumberGpsSame(13),
+      icDx(dec[LAZ_LAYER_XY], 32, 2),
+      icDy(dec[LAZ_LAYER_XY], 32, 22),
+      icZ(dec[LAZ_LAYER_Z], 32, 20),
+      icIntensity(dec[LAZ_LAYER_INTENSITY], 16, 4),
+      icScanAngle(dec[LAZ_LAYER_SCAN_ANGLE], 16, 2),
+      icPointSourceId(dec[LAZ_LAYER_POINT_SOURCE], 16),
+      gpsTime(dec[LAZ_LAYER_GPS_TIME], true)
+{
+    last.gpsTimeChange = false;
+
+    for (size_t i = 0; i < 8; i++)
+    {
+        lastIntensity[i] = item.intensity;
+        lastZ[i] = item.z;
+    }
+
+    gpsTime.init(item.gpsTime);
+}
+
+/** Point of formats 6 to 10, layered versions 3 and 4. */
+class LazPointDecoderPoint14 : public LazPointDecoderItem
+{
+public:
+    LazPointDecoderPoint14() : changed_{}, context_(0) {}
+    virtual ~LazPointDecoderPoint14() {}
+
+    virtual size_t layers() const { return LAZ_LAYER_COUNT; }
+    virtual void setLayer(size_t idx, const uint8_t *data, size_t size);
+
+    virtual void init(const uint8_t *item, uint32_t &context);
+    virtual void read(uint8_t *item, uint32_t &context);
+
+protected:
+    LazDecoder dec_[LAZ_LAYER_COUNT];
+    bool changed_[LAZ_LAYER_COUNT];
+    std::unique_ptr<LazPointDecoderPoint14Context> contexts_[4];
+    uint32_t context_;
+};
+
+void LazPointDecoderPoint14::setLayer(size_t idx,
+                                      const uint8_t *data,
+                                      size_t size)
+{
+    // Empty layers keep the values of the previous point
+    changed_[idx] = size > 0;
+    if (idx == LAZ_LAYER_XY || size > 0)
+    {
+        dec_[idx].init(data, size);
+    }
+}
+
+void LazPointDecoderPoint14::init(const uint8_t *item, uint32_t &context)
+{
+    LazPointDecoderPoint14Data point;
+    point.unpack(item);
+
+    context_ = point.scannerChannel;
+    context = context_;
+    contexts_[context_] =
+        std::make_unique<LazPointDecoderPoint14Context>(dec_, point);
+}
+
+void LazPointDecoderPoint14::read(uint8_t *item, uint32_t &context)
+{
+    LazPointDecoderPoint14Context *c = contexts_[context_].get();
+    LazDecoder &dec = dec_[LAZ_LAYER_XY];
+
+    uint32_t lpr = (c->last.returnNumber == 1) ? 1U : 0U;
+    lpr += (c->last.returnNumber >= c->last.numberOfReturns) ? 2U : 0U;
+    lpr += c->last.gpsTimeChange ? 4U : 0U;
+
+    uint32_t changed = dec.decodeSymbol(c->changedValues[lpr]);
+
+    // Scanner channel has its own context
+    if (changed & 64U)
+    {
+        uint32_t diff = dec.decodeSymbol(c->scannerChannel);
+        uint32_t channel = (context_ + diff + 1) % 4;
+        if (!contexts_[channel])
+        {
+            contexts_[channel] =
+                std::make_unique<LazPointDecoderPoint14Context>(dec_, c->last);
+        }
+
+        context_ = channel;
+        context = context_;
+        c = contexts_[context_].get();
+        c->last.scannerChannel = channel;
+    }
+
+    LazPointDecoderPoint14Data &last = c->last;
+    bool pointSourceChange = (changed & 32U) != 0;
+    bool gpsTimeChange = (changed & 16U) != 0;
+    bool scanAngleChange = (changed & 8U) != 0;
+    uint32_t gps = gpsTimeChange ? 1U : 0U;
+
+    // Returns
+    uint32_t n = last.numberOfReturns;
+    if (changed & 4U)
+    {
+        n = LazPointDecoder_decode(dec, c->numberOfReturns[n], 16);
+        last.numberOfReturns = n;
+    }
+
+    uint32_t r = last.returnNumber;
+    switch (changed & 3U)
+    {
+        case 1:
+            r = (r + 1) % 16;
+            break;
+        case 2:
+            r = (r + 15) % 16;
+            break;
+        case 3:
+            if (gpsTimeChange)
+            {
+                r = LazPointDecoder_decode(dec, c->returnNumber[r], 16);
+            }
+            else
+            {
+                r = (r + dec.decodeSymbol(c->returnNumberGpsSame) + 2) % 16;
+            }
+            break;
+        default:
+            break;
+    }
+    last.returnNumber = r;
+
+    uint32_t m = LAZ_NUMBER_RETURN_MAP_6CTX[n][r];
+    uint32_t l = (n > r) ? (n - r) : (r - n);
+    if (l > 7)
+    {
+        l = 7;
+    }
+
+    // Single, first, last and intermediate returns
+    uint32_t cpr = ((r == 1) ? 2U : 0U) + ((r >= n) ? 1U : 0U);
+
+    // Coordinates
+    uint32_t idx = (m << 1) | gps;
+    int32_t median = c->lastDx[idx].get();
+    int32_t diff = c->icDx.decompress(median, (n == 1) ? 1 : 0);
+    last.x = LazPointDecoder_add(last.x, diff);
+    c->lastDx[idx].add(diff);
+
+    median = c->lastDy[idx].get();
+    uint32_t k = c->icDx.getK();
+    diff = c->icDy.decompress(median, LazPointDecoder_context(n, k, 20));
+    last.y = LazPointDecoder_add(last.y, diff);
+    c->lastDy[idx].add(diff);
+
+    if (changed_[LAZ_LAYER_Z])
+    {
+        k = (c->icDx.getK() + c->icDy.getK()) / 2;
+        uint32_t ctx = LazPointDecoder_context(n, k, 18);
+        last.z = c->icZ.decompress(c->lastZ[l], ctx);
+        c->lastZ[l] = last.z;
+    }
+
+    // Attributes
+    if (changed_[LAZ_LAYER_CLASSIFICATION])
+    {
+        uint32_t ccc = ((last.classification & 0x1FU) << 1) +
+                       ((cpr == 3) ? 1U : 0U);
+        last.classification =
+            LazPointDecoder_decode(dec_[LAZ_LAYER_CLASSIFICATION],
+                                   c->classification[ccc],
+                                   256);
+    }
+
+    if (changed_[LAZ_LAYER_FLAGS])
+    {
+        uint32_t f = (last.edgeOfFlightLine << 5) |
+                     (last.scanDirectionFlag << 4) | last.classificationFlags;
+        f = LazPointDecoder_decode(dec_[LAZ_LAYER_FLAGS], c->flags[f], 64);
+        last.edgeOfFlightLine = (f >> 5) & 1U;
+        last.scanDirectionFlag = (f >> 4) & 1U;
+        last.classificationFlags = f & 15U;
+    }
+
+    if (changed_[LAZ_LAYER_INTENSITY])
+    {
+        idx = (cpr << 1) | gps;
+        last.intensity = static_cast<uint16_t>(
+            c->icIntensity.decompress(c->lastIntensity[idx], cpr));
+        c->lastIntensity[idx] = last.intensity;
+    }
+
+    if (changed_[LAZ_LAYER_SCAN_ANGLE] && scanAngleChange)
+    {
+        last.scanAngle = static_cast<int16_t>(
+            c->icScanAngle.decompress(last.scanAngle, gps));
+    }
+
+    if (changed_[LAZ_LAYER_USER_DATA])
+    {
+        last.userData = LazPointDecoder_decode(dec_[LAZ_LAYER_USER_DATA],
+                                               c->userData[last.userData / 4],
+                                               256);
+    }
+
+    if (changed_[LAZ_LAYER_POINT_SOURCE] && pointSourceChange)
+    {
+        last.pointSourceId = static_cast<uint16_t>(
+            c->icPointSourceId.decompress(last.pointSourceId));
+    }
+
+    if (changed_[LAZ_LAYER_GPS_TIME] && gpsTimeChange)
+    {
+        c->gpsTime.read();
+        last.gpsTime = c->gpsTime.value[c->gpsTime.last];
+    }
+
+    last.pack(item);
+    last.gpsTimeChange = gpsTimeChange;
+}
+
+/** Models of RGB and NIR of one scanner channel. */
+struct LazPointDecoderRgb14Context
+{
+    LazPointDecoderRgb rgb;
+    LazDecoder::SymbolModel nirUsed;
+    LazDecoder::SymbolModel nirDiff0;
+    LazDecoder::SymbolModel nirDiff1;
+    uint16_t last[4];
+
+    explicit LazPointDecoderRgb14Context(const uint16_t *item)
+        : nirUsed(4),
+          nirDiff0(256),
+          nirDiff1(256),
+          last{item[0], item[1], item[2], item[3]}
+    {
+    }
+};
+
+/** RGB and NIR of formats 7 and 8, layered versions 3 and 4. */
+class LazPointDecoderRgb14 : public LazPointDecoderItem
+{
+public:
+    explicit LazPointDecoderRgb14(bool nir)
+        : nir_(nir),
+          changed_{},
+          context_(0)
+    {
+    }
+    virtual ~LazPointDecoderRgb14() {}
+
+    virtual size_t layers() const { return nir_ ? 2 : 1; }
+    virtual void setLayer(size_t idx, const uint8_t *data, size_t size);
+
+    virtual void init(const uint8_t *item, uint32_t &context);
+    virtual void read(uint8_t *item, uint32_t &context);
+
+protected:
+    bool nir_;
+    LazDecoder dec_[2];
+    bool changed_[2];
+    std::unique_ptr<LazPointDecoderRgb14Context> contexts_[4];
+    uint32_t context_;
+};
+
+void LazPointDecoderRgb14::setLayer(size_t idx,
+                                    const uint8_t *data,
+                                    size_t size)
+{
+    changed_[idx] = size > 0;
+    if (size > 0)
+    {
+        dec_[idx].init(data, size);
+    }
+}
+
+void LazPointDecoderRgb14::init(const uint8_t *item, uint32_t &context)
+{
+    uint16_t v[4] = {0, 0, 0, 0};
+    for (size_t i = 0; i < (nir_ ? 4U : 3U); i++)
+    {
+        v[i] = ltoh16(&item[i * 2]);
+    }
+
+    context_ = context;
+    contexts_[context_] = std::make_unique<LazPointDecoderRgb14Context>(v);
+}
+
+void LazPointDecoderRgb14::read(uint8_t *item, uint32_t &context)
+{
+    // New scanner channel starts from the last values of the previous one
+    if (context_ != context)
+    {
+        if (!contexts_[context])
+        {
+            contexts_[context] = std::make_unique<LazPointDecoderRgb14Context>(
+                contexts_[context_]->last);
+        }
+        context_ = context;
+    }
+
+    LazPointDecoderRgb14Context &c = *contexts_[context_];
+
+    if (changed_[0])
+    {
+        c.rgb.read(dec_[0], c.last, c.last);
+    }
+
+    if (nir_ && changed_[1])
+    {
+        uint32_t sym = dec_[1].decodeSymbol(c.nirUsed);
+        int32_t low = c.last[3] & 255;
+        int32_t high = c.last[3] >> 8;
+
+        if (sym & 1U)
+        {
+            uint32_t corr = dec_[1].decodeSymbol(c.nirDiff0);
+            low = LazPointDecoder_fold(static_cast<int32_t>(corr) + low);
+        }
+
+        if (sym & 2U)
+        {
+            uint32_t corr = dec_[1].decodeSymbol(c.nirDiff1);
+            high = LazPointDecoder_fold(static_cast<int32_t>(corr) + high);
+        }
+
+        c.last[3] = static_cast<uint16_t>(low | (high << 8));
+    }
+
+    for (size_t i = 0; i < (nir_ ? 4U : 3U); i++)
+    {
+        htol16(&item[i * 2], c.last[i]);
+    }
+}
+
+/** Extra bytes of one scanner channel. */
+struct LazPointDecoderByte14Context
+{
+    std::vector<LazDecoder::SymbolModel> models;
+    std::vector<uint8_t> last;
+
+    explicit LazPointDecoderByte14Context(const std::vector<uint8_t> &item)
+        : models(item.size(), LazDecoder::SymbolModel(256)),
+          last(item)
+    {
+    }
+};
+
+/** Extra bytes, layered versions 3 and 4. Each byte has its own layer. */
+class LazPointDecoderByte14 : public LazPointDecoderItem
+{
+public:
+    explicit LazPointDecoderByte14(size_t n)
+        : dec_(n),
+          changed_(n, 0),
+          context_(0)
+    {
+    }
+    virtual ~LazPointDecoderByte14() {}
+
+    virtual size_t layers() const { return dec_.size(); }
+    virtual void setLayer(size_t idx, const uint8_t *data, size_t size);
+
+    virtual void init(const uint8_t *item, uint32_t &context);
+    virtual void read(uint8_t *item, uint32_t &context);
+
+protected:
+    std::vector<LazDecoder> dec_;
+    std::vector<uint8_t> changed_;
+    std::unique_ptr<LazPointDecoderByte14Context> contexts_[4];
+    uint32_t context_;
+};
+
+void LazPointDecoderByte14::setLayer(size_t idx,
+                                     const uint8_t *data,
+                                     size_t size)
+{
+    changed_[idx] = (size > 0) ? 1 : 0;
+    if (size > 0)
+    {
+        dec_[idx].init(data, size);
+    }
+}
+
+void LazPointDecoderByte14::init(const uint8_t *item, uint32_t &context)
+{
+    std::vector<uint8_t> v(item, item + dec_.size());
+    context_ = context;
+    contexts_[context_] = std::make_unique<LazPointDecoderByte14Context>(v);
+}
+
+void LazPointDecoderByte14::read(uint8_t *item, uint32_t &context)
+{
+    if (context_ != context)
+    {
+        if (!contexts_[context])
+        {
+            contexts_[context] = std::make_unique<LazPointDecoderByte14Context>(
+                contexts_[context_]->last);
+        }
+        context_ = context;
+    }
+
+    LazPointDecoderByte14Context &c = *contexts_[context_];
+
+    for (size_t i = 0; i < c.last.size(); i++)
+    {
+        if (changed_[i])
+        {
+            int32_t v = static_cast<int32_t>(dec_[i].decodeSymbol(c.models[i]));
+            c.last[i] = LazPointDecoder_fold(v + c.last[i]);
+        }
+    }
+
+    std::memcpy(item, c.last.data(), c.last.size());
+}
+
+/** Create decoders of LAZ items which read from one arithmetic decoder. */
+static void LazPointDecoder_createItems(
+    std::vector<std::unique_ptr<LazPointDecoderItem>> &items,
+    LazDecoder &dec,
+    const std::vector<LasFile::Laszip::Item> &types)
+{
+    for (const LasFile::Laszip::Item &item : types)
+    {
+        std::unique_ptr<LazPointDecoderItem> p;
+
+        switch (item.type)
+        {
+            case LAZ_ITEM_BYTE:
+                p = std::make_unique<LazPointDecoderByte10>(dec, item.size);
+                break;
+            case LAZ_ITEM_POINT10:
+                p = std::make_unique<LazPointDecoderPoint10>(dec);
+                break;
+            case LAZ_ITEM_GPSTIME11:
+                p = std::make_unique<LazPointDecoderGpsTime11>(dec);
+                break;
+            case LAZ_ITEM_RGB12:
+                p = std::make_unique<LazPointDecoderRgb12>(dec);
+                break;
+            case LAZ_ITEM_POINT14:
+                p = std::make_unique<LazPointDecoderPoint14>();
+                break;
+            case LAZ_ITEM_RGB14:
+                p = std::make_unique<LazPointDecoderRgb14>(false);
+                break;
+            case LAZ_ITEM_RGBNIR14:
+                p = std::make_unique<LazPointDecoderRgb14>(true);
+                break;
+            case LAZ_ITEM_BYTE14:
+                p = std::make_unique<LazPointDecoderByte14>(item.size);
+                break;
+            default:
+                THROW("LAZ item type " + std::to_string(item.type) +
+                      " is not supported");
+        }
+
+        items.push_back(std::move(p));
+    }
+}
+
+/** Initialize item decoders from the raw first point of a chunk. */
+static void LazPointDecoder_init(
+    std::vector<std::unique_ptr<LazPointDecoderItem>> &items,
+    const std::vector<LasFile::Laszip::Item> &types,
+    const uint8_t *point,
+    uint32_t &context)
+{
+    size_t offset = 0;
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        items[i]->init(&point[offset], context);
+        offset += types[i].size;
+    }
+}
+
+/** Decode the next point of a chunk. */
+static void LazPointDecoder_read(
+    std::vector<std::unique_ptr<LazPointDecoderItem>> &items,
+    const std::vector<LasFile::Laszip::Item> &types,
+    uint8_t *point,
+    uint32_t &context)
+{
+    size_t offset = 0;
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        items[i]->read(&point[offset], context);
+        offset += types[i].size;
+    }
+}
+
+LazPointDecoder::LazPointDecoder(const LasFile::Laszip &laszip)
+    : items_(laszip.items),
+      layered_(laszip.compressor == LAZ_COMPRESSOR_LAYERED),
+      pointSize_(0)
+{
+    if (laszip.compressor < 1 || laszip.compressor > LAZ_COMPRESSOR_LAYERED)
+    {
+        THROW("LAZ compressor " + std::to_string(laszip.compressor) +
+              " is not supported");
+    }
+
+    for (const LasFile::Laszip::Item &item : items_)
+    {
+        bool supported;
+        size_t size = item.size;
+
+        switch (item.type)
+        {
+            case LAZ_ITEM_BYTE:
+                supported = !layered_ && item.version == 2;
+                break;
+            case LAZ_ITEM_POINT10:
+                supported = !layered_ && item.version == 2 && size == 20;
+                break;
+            case LAZ_ITEM_GPSTIME11:
+                supported = !layered_ && item.version == 2 && size == 8;
+                break;
+            case LAZ_ITEM_RGB12:
+                supported = !layered_ && item.version == 2 && size == 6;
+                break;
+            case LAZ_ITEM_POINT14:
+                supported = layered_ && (item.version == 3 ||
+                                         item.version == 4) && size == 30;
+                break;
+            case LAZ_ITEM_RGB14:
+                supported = layered_ && (item.version == 3 ||
+                                         item.version == 4) && size == 6;
+                break;
+            case LAZ_ITEM_RGBNIR14:
+                supported = layered_ && (item.version == 3 ||
+                                         item.version == 4) && size == 8;
+                break;
+            case LAZ_ITEM_BYTE14:
+                supported = layered_ && (item.version == 3 ||
+                                         item.version == 4);
+                break;
+            default:
+                supported = false;
+                break;
+        }
+
+        if (!supported)
+        {
+            THROW("LAZ item type " + std::to_string(item.type) +
+                  " version " + std::to_string(item.version) +
+                  " is not supported");
+        }
+
+        pointSize_ += size;
+    }
+}
+
+void LazPointDecoder::decode(uint8_t *points,
+                             size_t npoints,
+                             const uint8_t *data,
+                             size_t size) const
+{
+    if (npoints == 0)
+    {
+        return;
+    }
+
+    // The first point of each chunk is stored raw
+    if (size < pointSize_)
+    {
+        THROW("LAZ chunk is truncated");
+    }
+
+    std::memcpy(points, data, pointSize_);
+    size_t pos = pointSize_;
+
+    LazDecoder dec;
+    std::vector<std::unique_ptr<LazPointDecoderItem>> items;
+    LazPointDecoder_createItems(items, dec, items_);
+
+    if (layered_)
+    {
+        // Number of points, sizes of all layers and then the layers
+        std::vector<size_t> layers;
+        pos += 4;
+        for (const auto &item : items)
+        {
+            for (size_t i = 0; i < item->layers(); i++)
+            {
+                if (pos + 4 > size)
+                {
+                    THROW("LAZ chunk is truncated");
+                }
+                layers.push_back(ltoh32(&data[pos]));
+                pos += 4;
+            }
+        }
+
+        size_t idx = 0;
+        for (const auto &item : items)
+        {
+            for (size_t i = 0; i < item->layers(); i++)
+            {
+                if (layers[idx] > size - pos)
+                {
+                    THROW("LAZ chunk is truncated");
+                }
+                item->setLayer(i, &data[pos], layers[idx]);
+                pos += layers[idx];
+                idx++;
+            }
+        }
+    }
+    else
+    {
+        dec.init(&data[pos], size - pos);
+    }
+
+    uint32_t context = 0;
+    LazPointDecoder_init(items, items_, points, context);
+
+    for (size_t p = 1; p < npoints; p++)
+    {
+        LazPointDecoder_read(items, items_, &points[p * pointSize_], context);
+    }
+}
+
+LazPointStream::LazPointStream(const LasFile::Laszip &laszip,
+                               const File &file,
+                               uint64_t offset,
+                               uint64_t size)
+    : LazPointDecoder(laszip),
+      file_(file),
+      offset_(offset),
+      size_(size),
+      context_(0),
+      npoints_(0)
+{
+    if (layered_)
+    {
+        THROW("LAZ layered chunks can't be streamed");
+    }
+
+    LazPointDecoder_createItems(decoders_, dec_, items_);
+}
+
+LazPointStream::~LazPointStream()
+{
+    // empty
+}
+
+void LazPointStream::decode(uint8_t *points, size_t npoints)
+{
+    if (npoints == 0)
+    {
+        return;
+    }
+
+    size_t p = 0;
+
+    // The first point is stored raw and followed by the compressed stream
+    if (npoints_ == 0)
+    {
+        if (size_ < pointSize_)
+        {
+            THROW("LAZ chunk is truncated");
+        }
+
+        file_.read(points, pointSize_, offset_);
+        dec_.init(file_, offset_ + pointSize_, size_ - pointSize_);
+        LazPointDecoder_init(decoders_, items_, points, context_);
+        p = 1;
+    }
+
+    for (; p < npoints; p++)
+    {
+        LazPointDecoder_read(decoders_,
+                             items_,
+                             &points[p * pointSize_],
+                             context_);
+    }
+
+    npoints_ += npoints;
+}
@@ -0,0 +1,87 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file LazPointDecoder.hpp
+*/
+
+#ifndef LAZ_POINT_DECODER_HPP
+#define LAZ_POINT_DECODER_HPP
+
+#include <LasFile.hpp>
+#include <LazDecoder.hpp>
+#include <memory>
+
+class LazPointDecoderItem;
+
+/** LAZ point decoder.
+
+    Decodes one LASzip chunk to uncompressed LAS point records. Chunks are
+    independent, so one decoder can decode several chunks in parallel.
+    Supported are pointwise items of version 2 (formats 0 to 3) and layered
+    items of versions 3 and 4 (formats 6 to 8), with extra bytes.
+*/
+class LazPointDecoder
+{
+public:
+    explicit LazPointDecoder(const LasFile::Laszip &laszip);
+
+    /** Get the size of one decoded point record. */
+    size_t pointSize() const { return pointSize_; }
+
+    void decode(uint8_t *points,
+                size_t npoints,
+                const uint8_t *data,
+                size_t size) const;
+
+protected:
+    std::vector<LasFile::Laszip::Item> items_;
+    bool layered_;
+    size_t pointSize_;
+};
+
+/** LAZ point stream decoder.
+
+    Decodes one pointwise chunk from a file in parts of any number of
+    points. The arithmetic decoder and the item models keep their state
+    between calls, so the single chunk of an unchunked file (compressor 1)
+    is decoded without holding it in memory.
+*/
+class LazPointStream : public LazPointDecoder
+{
+public:
+    LazPointStream(const LasFile::Laszip &laszip,
+                   const File &file,
+                   uint64_t offset,
+                   uint64_t size);
+    ~LazPointStream();
+
+    void decode(uint8_t *points, size_t npoints);
+
+protected:
+    const File &file_;
+    uint64_t offset_;
+    uint64_t size_;
+    LazDecoder dec_;
+    std::vector<std::unique_ptr<LazPointDecoderItem>> decoders_;
+    uint32_t context_;
+    uint64_t npoints_;
+};
+
+#endif /* LAZ_POINT_DECODER_HPP */
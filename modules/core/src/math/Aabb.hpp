@@ -43,6 +43,7 @@ public:
     void getCenter(T &x, T &y, T &z) const;
     bool intersects(const Aabb<T> &box) const;
     bool isInside(const Aabb<T> &box) const;
+    bool isInside(T x, T y, T z) const;
 
     Json &serialize(Json &out) const;
 
@@ -132,6 +133,12 @@ template <class T> inline bool Aabb<T>::isInside(const Aabb &box) const
              (max_[2] > box.max_[2] || min_[2] < box.min_[2]));
 }
 
+template <class T> inline bool Aabb<T>::isInside(T x, T y, T z) const
+{
+    return !(x < min_[0] || x > max_[0] || y < min_[1] || y > max_[1] ||
+             z < min_[2] || z > max_[2]);
+}
+
 template <class T> inline Json &Aabb<T>::serialize(Json &out) const
 {
     out["min"][0] = min_[0];
@@ -0,0 +1,598 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file AabbBatch.cpp
+*/
+
+#include <AabbBatch.hpp>
+#include <Cpu.hpp>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+template <class T, size_t P>
+static void aabbMinMaxScalar(T *min, T *max, const T *data, size_t n)
+{
+    for (size_t k = 0; k < P; k++)
+    {
+        min[k] = max[k] = data[k];
+    }
+
+    for (size_t i = 1; i < n; i++)
+    {
+        for (size_t k = 0; k < P; k++)
+        {
+            T v = data[(i * P) + k];
+            if (v < min[k])
+            {
+                min[k] = v;
+            }
+            if (v > max[k])
+            {
+                max[k] = v;
+            }
+        }
+    }
+}
+
+template <class T>
+static uint8_t aabbFrustumScalar(const T *planes,
+                                 T x1,
+                                 T y1,
+                                 T z1,
+                                 T x2,
+                                 T y2,
+                                 T z2)
+{
+    uint8_t result = AABB_FRUSTUM_INSIDE;
+
+    for (size_t p = 0; p < 6; p++)
+    {
+        const T *plane = &planes[p * 4];
+        bool a = plane[0] >= 0;
+        bool b = plane[1] >= 0;
+        bool c = plane[2] >= 0;
+
+        // The most positive corner is outside, the box is outside
+        T d = (plane[0] * (a ? x2 : x1)) + (plane[1] * (b ? y2 : y1));
+        d = d + (plane[2] * (c ? z2 : z1)) + plane[3];
+        if (d < 0)
+        {
+            return AABB_FRUSTUM_OUTSIDE;
+        }
+
+        // The most negative corner is outside, the box intersects
+        d = (plane[0] * (a ? x1 : x2)) + (plane[1] * (b ? y1 : y2));
+        d = d + (plane[2] * (c ? z1 : z2)) + plane[3];
+        if (d < 0)
+        {
+            result = AABB_FRUSTUM_INTERSECTS;
+        }
+    }
+
+    return result;
+}
+
+template <class T>
+static void aabbFrustumScalar(uint8_t *result,
+                              const T *planes,
+                              const T *const *min,
+                              const T *const *max,
+                              size_t from,
+                              size_t n)
+{
+    for (size_t i = from; i < n; i++)
+    {
+        result[i] = aabbFrustumScalar(planes,
+                                      min[0][i],
+                                      min[1][i],
+                                      min[2][i],
+                                      max[0][i],
+                                      max[1][i],
+                                      max[2][i]);
+    }
+}
+
+#if defined(__x86_64__)
+/*
+    Vector kernels keep one accumulator per lane. Coordinates with period
+    P are accumulated in P vectors, so that each lane always gets the same
+    coordinate. Multiplication and addition are not fused, so the frustum
+    results are equal to the scalar code. AVX2 kernels are the same as
+    SSE2 kernels, compiled with the AVX2 target.
+*/
+
+/** SSE2 single precision operations. */
+struct AabbSse2f
+{
+    typedef float T;
+    typedef __m128 V;
+    static const size_t WIDTH = 4;
+    static V load(const T *p) { return _mm_loadu_ps(p); }
+    static void store(T *p, V a) { _mm_storeu_ps(p, a); }
+    static V set1(T a) { return _mm_set1_ps(a); }
+    static V zero() { return _mm_setzero_ps(); }
+    static V min(V a, V b) { return _mm_min_ps(a, b); }
+    static V max(V a, V b) { return _mm_max_ps(a, b); }
+    static V add(V a, V b) { return _mm_add_ps(a, b); }
+    static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+    static V lt(V a, V b) { return _mm_cmplt_ps(a, b); }
+    static V bitOr(V a, V b) { return _mm_or_ps(a, b); }
+    static int mask(V a) { return _mm_movemask_ps(a); }
+};
+
+/** SSE2 double precision operations. */
+struct AabbSse2d
+{
+    typedef double T;
+    typedef __m128d V;
+    static const size_t WIDTH = 2;
+    static V load(const T *p) { return _mm_loadu_pd(p); }
+    static void store(T *p, V a) { _mm_storeu_pd(p, a); }
+    static V set1(T a) { return _mm_set1_pd(a); }
+    static V zero() { return _mm_setzero_pd(); }
+    static V min(V a, V b) { return _mm_min_pd(a, b); }
+    static V max(V a, V b) { return _mm_max_pd(a, b); }
+    static V add(V a, V b) { return _mm_add_pd(a, b); }
+    static V mul(V a, V b) { return _mm_mul_pd(a, b); }
+    static V lt(V a, V b) { return _mm_cmplt_pd(a, b); }
+    static V bitOr(V a, V b) { return _mm_or_pd(a, b); }
+    static int mask(V a) { return _mm_movemask_pd(a); }
+};
+
+#define AABB_AVX2 __attribute__((target("avx2")))
+
+/** AVX2 single precision operations. */
+struct AabbAvx2f
+{
+    typedef float T;
+    typedef __m256 V;
+    static const size_t WIDTH = 8;
+    AABB_AVX2 static V load(const T *p) { return _mm256_loadu_ps(p); }
+    AABB_AVX2 static void store(T *p, V a) { _mm256_storeu_ps(p, a); }
+    AABB_AVX2 static V set1(T a) { return _mm256_set1_ps(a); }
+    AABB_AVX2 static V zero() { return _mm256_setzero_ps(); }
+    AABB_AVX2 static V min(V a, V b) { return _mm256_min_ps(a, b); }
+    AABB_AVX2 static V max(V a, V b) { return _mm256_max_ps(a, b); }
+    AABB_AVX2 static V add(V a, V b) { return _mm256_add_ps(a, b); }
+    AABB_AVX2 static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+    AABB_AVX2 static V lt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    AABB_AVX2 static V bitOr(V a, V b) { return _mm256_or_ps(a, b); }
+    AABB_AVX2 static int mask(V a) { return _mm256_movemask_ps(a); }
+};
+
+/** AVX2 double precision operations. */
+struct AabbAvx2d
+{
+    typedef double T;
+    typedef __m256d V;
+    static const size_t WIDTH = 4;
+    AABB_AVX2 static V load(const T *p) { return _mm256_loadu_pd(p); }
+    AABB_AVX2 static void store(T *p, V a) { _mm256_storeu_pd(p, a); }
+    AABB_AVX2 static V set1(T a) { return _mm256_set1_pd(a); }
+    AABB_AVX2 static V zero() { return _mm256_setzero_pd(); }
+    AABB_AVX2 static V min(V a, V b) { return _mm256_min_pd(a, b); }
+    AABB_AVX2 static V max(V a, V b) { return _mm256_max_pd(a, b); }
+    AABB_AVX2 static V add(V a, V b) { return _mm256_add_pd(a, b); }
+    AABB_AVX2 static V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+    AABB_AVX2 static V lt(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+    AABB_AVX2 static V bitOr(V a, V b) { return _mm256_or_pd(a, b); }
+    AABB_AVX2 static int mask(V a) { return _mm256_movemask_pd(a); }
+};
+
+template <class S, size_t P>
+static void aabbMinMaxSse2(typename S::T *min,
+                           typename S::T *max,
+                           const typename S::T *data,
+                           size_t n)
+{
+    typedef typename S::T T;
+    typedef typename S::V V;
+    const size_t w = S::WIDTH;
+
+    V lo[P];
+    V hi[P];
+    for (size_t k = 0; k < P; k++)
+    {
+        lo[k] = hi[k] = S::load(data + (k * w));
+    }
+
+    size_t i = w;
+    for (; i + w <= n; i += w)
+    {
+        for (size_t k = 0; k < P; k++)
+        {
+            V v = S::load(data + (i * P) + (k * w));
+            lo[k] = S::min(v, lo[k]);
+            hi[k] = S::max(v, hi[k]);
+        }
+    }
+
+    T a[P * S::WIDTH];
+    T b[P * S::WIDTH];
+    for (size_t k = 0; k < P; k++)
+    {
+        S::store(a + (k * w), lo[k]);
+        S::store(b + (k * w), hi[k]);
+    }
+
+    for (size_t k = 0; k < P; k++)
+    {
+        min[k] = a[k];
+        max[k] = b[k];
+    }
+
+    for (size_t j = P; j < P * w; j++)
+    {
+        size_t k = j % P;
+        if (a[j] < min[k])
+        {
+            min[k] = a[j];
+        }
+        if (b[j] > max[k])
+        {
+            max[k] = b[j];
+        }
+    }
+
+    for (; i < n; i++)
+    {
+        for (size_t k = 0; k < P; k++)
+        {
+            T v = data[(i * P) + k];
+            if (v < min[k])
+            {
+                min[k] = v;
+            }
+            if (v > max[k])
+            {
+                max[k] = v;
+            }
+        }
+    }
+}
+
+template <class S, size_t P>
+AABB_AVX2 static void aabbMinMaxAvx2(typename S::T *min,
+                           typename S::T *max,
+                           const typename S::T *data,
+                           size_t n)
+{
+    typedef typename S::T T;
+    typedef typename S::V V;
+    const size_t w = S::WIDTH;
+
+    V lo[P];
+    V hi[P];
+    for (size_t k = 0; k < P; k++)
+    {
+        lo[k] = hi[k] = S::load(data + (k * w));
+    }
+
+    size_t i = w;
+    for (; i + w <= n; i += w)
+    {
+        for (size_t k = 0; k < P; k++)
+        {
+            V v = S::load(data + (i * P) + (k * w));
+            lo[k] = S::min(v, lo[k]);
+            hi[k] = S::max(v, hi[k]);
+        }
+    }
+
+    T a[P * S::WIDTH];
+    T b[P * S::WIDTH];
+    for (size_t k = 0; k < P; k++)
+    {
+        S::store(a + (k * w), lo[k]);
+        S::store(b + (k * w), hi[k]);
+    }
+
+    for (size_t k = 0; k < P; k++)
+    {
+        min[k] = a[k];
+        max[k] = b[k];
+    }
+
+    for (size_t j = P; j < P * w; j++)
+    {
+        size_t k = j % P;
+        if (a[j] < min[k])
+        {
+            min[k] = a[j];
+        }
+        if (b[j] > max[k])
+        {
+            max[k] = b[j];
+        }
+    }
+
+    for (; i < n; i++)
+    {
+        for (size_t k = 0; k < P; k++)
+        {
+            T v = data[(i * P) + k];
+            if (v < min[k])
+            {
+                min[k] = v;
+            }
+            if (v > max[k])
+            {
+                max[k] = v;
+            }
+        }
+    }
+}
+
+template <class S>
+static void aabbFrustumSse2(uint8_t *result,
+                           const typename S::T *planes,
+                           const typename S::T *const *min,
+                           const typename S::T *const *max,
+                           size_t n)
+{
+    typedef typename S::V V;
+    const size_t w = S::WIDTH;
+    const V zero = S::zero();
+
+    V coef[24];
+    bool positive[18];
+    for (size_t j = 0; j < 24; j++)
+    {
+        coef[j] = S::set1(planes[j]);
+    }
+    for (size_t p = 0; p < 6; p++)
+    {
+        for (size_t k = 0; k < 3; k++)
+        {
+            positive[(p * 3) + k] = planes[(p * 4) + k] >= 0;
+        }
+    }
+
+    size_t i = 0;
+    for (; i + w <= n; i += w)
+    {
+        V lo[3];
+        V hi[3];
+        for (size_t k = 0; k < 3; k++)
+        {
+            lo[k] = S::load(min[k] + i);
+            hi[k] = S::load(max[k] + i);
+        }
+
+        V outside = zero;
+        V intersects = zero;
+        for (size_t p = 0; p < 6; p++)
+        {
+            const V *c = &coef[p * 4];
+            const bool *s = &positive[p * 3];
+
+            V d = S::add(S::mul(c[0], s[0] ? hi[0] : lo[0]),
+                         S::mul(c[1], s[1] ? hi[1] : lo[1]));
+            d = S::add(S::add(d, S::mul(c[2], s[2] ? hi[2] : lo[2])),
+                       c[3]);
+            outside = S::bitOr(outside, S::lt(d, zero));
+
+            d = S::add(S::mul(c[0], s[0] ? lo[0] : hi[0]),
+                       S::mul(c[1], s[1] ? lo[1] : hi[1]));
+            d = S::add(S::add(d, S::mul(c[2], s[2] ? lo[2] : hi[2])),
+                       c[3]);
+            intersects = S::bitOr(intersects, S::lt(d, zero));
+        }
+
+        int mo = S::mask(outside);
+        int mi = S::mask(intersects);
+        for (size_t j = 0; j < w; j++)
+        {
+            uint8_t r = AABB_FRUSTUM_INSIDE;
+            if ((mo >> j) & 1)
+            {
+                r = AABB_FRUSTUM_OUTSIDE;
+            }
+            else if ((mi >> j) & 1)
+            {
+                r = AABB_FRUSTUM_INTERSECTS;
+            }
+            result[i + j] = r;
+        }
+    }
+
+    aabbFrustumScalar(result, planes, min, max, i, n);
+}
+
+template <class S>
+AABB_AVX2 static void aabbFrustumAvx2(uint8_t *result,
+                           const typename S::T *planes,
+                           const typename S::T *const *min,
+                           const typename S::T *const *max,
+                           size_t n)
+{
+    typedef typename S::V V;
+    const size_t w = S::WIDTH;
+    const V zero = S::zero();
+
+    V coef[24];
+    bool positive[18];
+    for (size_t j = 0; j < 24; j++)
+    {
+        coef[j] = S::set1(planes[j]);
+    }
+    for (size_t p = 0; p < 6; p++)
+    {
+        for (size_t k = 0; k < 3; k++)
+        {
+            positive[(p * 3) + k] = planes[(p * 4) + k] >= 0;
+        }
+    }
+
+    size_t i = 0;
+    for (; i + w <= n; i += w)
+    {
+        V lo[3];
+        V hi[3];
+        for (size_t k = 0; k < 3; k++)
+        {
+            lo[k] = S::load(min[k] + i);
+            hi[k] = S::load(max[k] + i);
+        }
+
+        V outside = zero;
+        V intersects = zero;
+        for (size_t p = 0; p < 6; p++)
+        {
+            const V *c = &coef[p * 4];
+            const bool *s = &positive[p * 3];
+
+            V d = S::add(S::mul(c[0], s[0] ? hi[0] : lo[0]),
+                         S::mul(c[1], s[1] ? hi[1] : lo[1]));
+            d = S::add(S::add(d, S::mul(c[2], s[2] ? hi[2] : lo[2])),
+                       c[3]);
+            outside = S::bitOr(outside, S::lt(d, zero));
+
+            d = S::add(S::mul(c[0], s[0] ? lo[0] : hi[0]),
+                       S::mul(c[1], s[1] ? lo[1] : hi[1]));
+            d = S::add(S::add(d, S::mul(c[2], s[2] ? lo[2] : hi[2])),
+                       c[3]);
+            intersects = S::bitOr(intersects, S::lt(d, zero));
+        }
+
+        int mo = S::mask(outside);
+        int mi = S::mask(intersects);
+        for (size_t j = 0; j < w; j++)
+        {
+            uint8_t r = AABB_FRUSTUM_INSIDE;
+            if ((mo >> j) & 1)
+            {
+                r = AABB_FRUSTUM_OUTSIDE;
+            }
+            else if ((mi >> j) & 1)
+            {
+                r = AABB_FRUSTUM_INTERSECTS;
+            }
+            result[i + j] = r;
+        }
+    }
+
+    aabbFrustumScalar(result, planes, min, max, i, n);
+}
+#endif /* __x86_64__ */
+
+template <class T, size_t P, class SSE2, class AVX2>
+static void aabbMinMaxDispatch(T *min, T *max, const T *data, size_t n)
+{
+#if defined(__x86_64__)
+    if (n >= 2 * AVX2::WIDTH && cpuSupportsAvx2())
+    {
+        aabbMinMaxAvx2<AVX2, P>(min, max, data, n);
+        return;
+    }
+
+    if (n >= 2 * SSE2::WIDTH)
+    {
+        aabbMinMaxSse2<SSE2, P>(min, max, data, n);
+        return;
+    }
+#endif
+
+    aabbMinMaxScalar<T, P>(min, max, data, n);
+}
+
+template <class T, class SSE2, class AVX2>
+static void aabbFrustumDispatch(uint8_t *result,
+                                const T *planes,
+                                const T *const *min,
+                                const T *const *max,
+                                size_t n)
+{
+#if defined(__x86_64__)
+    if (cpuSupportsAvx2())
+    {
+        aabbFrustumAvx2<AVX2>(result, planes, min, max, n);
+    }
+    else
+    {
+        aabbFrustumSse2<SSE2>(result, planes, min, max, n);
+    }
+#else
+    aabbFrustumScalar(result, planes, min, max, 0, n);
+#endif
+}
+
+#if !defined(__x86_64__)
+/* Placeholders for dispatch templates on other architectures. */
+struct AabbSse2f
+{
+};
+struct AabbSse2d
+{
+};
+struct AabbAvx2f
+{
+};
+struct AabbAvx2d
+{
+};
+#endif
+
+void aabbMinMax(float &min, float &max, const float *data, size_t n)
+{
+    aabbMinMaxDispatch<float, 1, AabbSse2f, AabbAvx2f>(&min, &max, data, n);
+}
+
+void aabbMinMax(double &min, double &max, const double *data, size_t n)
+{
+    aabbMinMaxDispatch<double, 1, AabbSse2d, AabbAvx2d>(&min, &max, data, n);
+}
+
+void aabbMinMax3(float *min, float *max, const float *xyz, size_t n)
+{
+    aabbMinMaxDispatch<float, 3, AabbSse2f, AabbAvx2f>(min, max, xyz, n);
+}
+
+void aabbMinMax3(double *min, double *max, const double *xyz, size_t n)
+{
+    aabbMinMaxDispatch<double, 3, AabbSse2d, AabbAvx2d>(min, max, xyz, n);
+}
+
+void aabbFrustum(uint8_t *result,
+                 const float *planes,
+                 const float *const *min,
+                 const float *const *max,
+                 size_t n)
+{
+    aabbFrustumDispatch<float, AabbSse2f, AabbAvx2f>(result,
+                                                     planes,
+                                                     min,
+                                                     max,
+                                                     n);
+}
+
+void aabbFrustum(uint8_t *result,
+                 const double *planes,
+                 const double *const *min,
+                 const double *const *max,
+                 size_t n)
+{
+    aabbFrustumDispatch<double, AabbSse2d, AabbAvx2d>(result,
+                                                      planes,
+                                                      min,
+                                                      max,
+                                                      n);
+}
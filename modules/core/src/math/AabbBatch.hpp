@@ -0,0 +1,68 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file AabbBatch.hpp
+*/
+
+#ifndef AABB_BATCH_HPP
+#define AABB_BATCH_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/** Result of AABB and frustum test. */
+enum AabbFrustumResult
+{
+    AABB_FRUSTUM_OUTSIDE,
+    AABB_FRUSTUM_INTERSECTS,
+    AABB_FRUSTUM_INSIDE
+};
+
+/** Compute minimum and maximum of n values, n > 0. */
+void aabbMinMax(float &min, float &max, const float *data, size_t n);
+void aabbMinMax(double &min, double &max, const double *data, size_t n);
+
+/** Compute bounds of n interleaved x, y, z coordinates, n > 0. */
+void aabbMinMax3(float *min, float *max, const float *xyz, size_t n);
+void aabbMinMax3(double *min, double *max, const double *xyz, size_t n);
+
+/** Test n AABBs against six frustum planes.
+
+    Point [x, y, z] is inside of plane [a, b, c, d] when
+    a * x + b * y + c * z + d >= 0.
+
+    @param result Output AabbFrustumResult for each box.
+    @param planes Six planes given by 24 values.
+    @param min Columns of minimum x, y and z of boxes.
+    @param max Columns of maximum x, y and z of boxes.
+    @param n Number of boxes.
+*/
+void aabbFrustum(uint8_t *result,
+                 const float *planes,
+                 const float *const *min,
+                 const float *const *max,
+                 size_t n);
+void aabbFrustum(uint8_t *result,
+                 const double *planes,
+                 const double *const *min,
+                 const double *const *max,
+                 size_t n);
+
+#endif /* AABB_BATCH_HPP */
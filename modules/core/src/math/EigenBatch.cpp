@@ -0,0 +1,153 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file EigenBatch.cpp
+*/
+
+#include <EigenBatch.hpp>
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+/** Number of matrices rotated together. */
+static const size_t EIGEN_BATCH_BLOCK = 64;
+
+/** Index of element [row][column] in six unique elements. */
+static const size_t EIGEN_BATCH_ELEMENT[3][3] = {{0, 1, 2},
+                                                 {1, 3, 4},
+                                                 {2, 4, 5}};
+
+/** Rotate rows and columns p and q to zero element [p][q]. */
+template <class T>
+static void eigenRotate(T (*m)[EIGEN_BATCH_BLOCK],
+                        T (*v)[EIGEN_BATCH_BLOCK],
+                        size_t count,
+                        size_t p,
+                        size_t q,
+                        size_t r)
+{
+    T *app = m[EIGEN_BATCH_ELEMENT[p][p]];
+    T *aqq = m[EIGEN_BATCH_ELEMENT[q][q]];
+    T *apq = m[EIGEN_BATCH_ELEMENT[p][q]];
+    T *arp = m[EIGEN_BATCH_ELEMENT[r][p]];
+    T *arq = m[EIGEN_BATCH_ELEMENT[r][q]];
+
+    for (size_t i = 0; i < count; i++)
+    {
+        // Tangent of the rotation angle, the smaller root
+        T d = aqq[i] - app[i];
+        T sign = (d < 0) ? T(-1) : T(1);
+        T den = d + (sign * std::sqrt((d * d) + (4 * apq[i] * apq[i])));
+        T t = (2 * apq[i]) / ((std::fabs(den) > 0) ? den : T(1));
+        T c = 1 / std::sqrt(1 + (t * t));
+        T s = t * c;
+
+        app[i] -= t * apq[i];
+        aqq[i] += t * apq[i];
+        apq[i] = 0;
+
+        T rp = arp[i];
+        T rq = arq[i];
+        arp[i] = (c * rp) - (s * rq);
+        arq[i] = (s * rp) + (c * rq);
+
+        for (size_t k = 0; k < 3; k++)
+        {
+            T vp = v[(3 * k) + p][i];
+            T vq = v[(3 * k) + q][i];
+            v[(3 * k) + p][i] = (c * vp) - (s * vq);
+            v[(3 * k) + q][i] = (s * vp) + (c * vq);
+        }
+    }
+}
+
+template <class T>
+static void eigenSymmetric3Batch(T *const *values,
+                                 T *const *vectors,
+                                 const T *const *a,
+                                 size_t n)
+{
+    // Jacobi method converges quadratically
+    const size_t sweeps = (sizeof(T) > 4) ? 8 : 5;
+
+    T m[6][EIGEN_BATCH_BLOCK];
+    T v[9][EIGEN_BATCH_BLOCK];
+
+    for (size_t from = 0; from < n; from += EIGEN_BATCH_BLOCK)
+    {
+        size_t count = std::min(n - from, EIGEN_BATCH_BLOCK);
+
+        for (size_t k = 0; k < 6; k++)
+        {
+            std::copy(a[k] + from, a[k] + from + count, m[k]);
+        }
+
+        for (size_t k = 0; k < 9; k++)
+        {
+            std::fill(v[k], v[k] + count, (k % 4 == 0) ? T(1) : T(0));
+        }
+
+        for (size_t sweep = 0; sweep < sweeps; sweep++)
+        {
+            eigenRotate(m, v, count, 0, 1, 2);
+            eigenRotate(m, v, count, 0, 2, 1);
+            eigenRotate(m, v, count, 1, 2, 0);
+        }
+
+        // Sort eigenpairs by descending eigenvalues
+        for (size_t i = 0; i < count; i++)
+        {
+            std::pair<T, size_t> order[3] = {{m[0][i], 0},
+                                             {m[3][i], 1},
+                                             {m[5][i], 2}};
+            std::sort(order,
+                      order + 3,
+                      [](const std::pair<T, size_t> &x,
+                         const std::pair<T, size_t> &y) {
+                          return x.first > y.first;
+                      });
+
+            for (size_t k = 0; k < 3; k++)
+            {
+                size_t c = order[k].second;
+                values[k][from + i] = order[k].first;
+                vectors[(3 * k) + 0][from + i] = v[c][i];
+                vectors[(3 * k) + 1][from + i] = v[3 + c][i];
+                vectors[(3 * k) + 2][from + i] = v[6 + c][i];
+            }
+        }
+    }
+}
+
+void eigenSymmetric3(float *const *values,
+                     float *const *vectors,
+                     const float *const *a,
+                     size_t n)
+{
+    eigenSymmetric3Batch(values, vectors, a, n);
+}
+
+void eigenSymmetric3(double *const *values,
+                     double *const *vectors,
+                     const double *const *a,
+                     size_t n)
+{
+    eigenSymmetric3Batch(values, vectors, a, n);
+}
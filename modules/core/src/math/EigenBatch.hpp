@@ -0,0 +1,50 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file EigenBatch.hpp
+*/
+
+#ifndef EIGEN_BATCH_HPP
+#define EIGEN_BATCH_HPP
+
+#include <cstddef>
+
+/** Compute eigenvalues and eigenvectors of n symmetric 3x3 matrices.
+
+    Cyclic Jacobi rotations are applied to blocks of matrices for a fixed
+    number of sweeps. Loops over matrices have no branches, so they are
+    vectorized by the compiler.
+
+    @param values Three output columns of eigenvalues in descending order.
+    @param vectors Nine output columns of x, y and z of the unit
+        eigenvector of the first, second and third eigenvalue.
+    @param a Six columns of elements a00, a01, a02, a11, a12 and a22.
+    @param n Number of matrices.
+*/
+void eigenSymmetric3(float *const *values,
+                     float *const *vectors,
+                     const float *const *a,
+                     size_t n);
+void eigenSymmetric3(double *const *values,
+                     double *const *vectors,
+                     const double *const *a,
+                     size_t n);
+
+#endif /* EIGEN_BATCH_HPP */
@@ -0,0 +1,199 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file CanopyModel.cpp
+*/
+
+#include <CanopyModel.hpp>
+#include <Error.hpp>
+#include <GroundFilter.hpp>
+#include <RasterFile.hpp>
+#include <algorithm>
+#include <cmath>
+
+/** Memory of one point read into DatabaseCell. */
+static const double CANOPY_MODEL_POINT_SIZE = 64.0;
+
+/** The smallest tile size in cells. */
+static const size_t CANOPY_MODEL_MIN_TILE_SIZE = 16;
+
+CanopyModel::CanopyModel()
+    : cellSize(0.5),
+      fillRadius(2),
+      pitThreshold(1.0),
+      pitIterations(2),
+      tileSize(512),
+      memoryBudget(1073741824ULL)
+{
+}
+
+CanopyModel::~CanopyModel()
+{
+}
+
+size_t CanopyModel::getTileSize(const Database &db, size_t nthreads) const
+{
+    double dx = db.aabb.max(0) - db.aabb.min(0);
+    double dy = db.aabb.max(1) - db.aabb.min(1);
+    double area = std::max(dx * dy, 1.0);
+    double density = static_cast<double>(db.getPointSize()) / area;
+    double halo = static_cast<double>(fillRadius + pitIterations) * cellSize;
+
+    // Side of a tile with halo which fits into memory of one thread
+    double budget = static_cast<double>(memoryBudget) /
+                    static_cast<double>(nthreads);
+    double side = std::sqrt(budget / (density * CANOPY_MODEL_POINT_SIZE));
+    double cells = std::floor((side - (2.0 * halo)) / cellSize);
+
+    size_t result = tileSize;
+    if (cells < static_cast<double>(result))
+    {
+        result = static_cast<size_t>(std::max(cells, 0.0));
+    }
+
+    return std::max(result, CANOPY_MODEL_MIN_TILE_SIZE);
+}
+
+void CanopyModel::run(const Database &db,
+                      const std::string &path,
+                      ThreadPool &pool) const
+{
+    if (db.findColumn(Database::CHUNK_ID_HEIGHT, sizeof(float)) ==
+        db.getFile().getEntrySize())
+    {
+        THROW("Canopy model requires height above ground in database '" +
+              db.path() + "'");
+    }
+
+    RasterFile out;
+    out.create(path, db.aabb, cellSize, getTileSize(db, pool.size()));
+    out.metadata["type"] = "chm";
+
+    size_t halo = fillRadius + pitIterations;
+
+    pool.run(out.size(), [&](size_t i) {
+        Raster tile;
+        out.getTile(tile, i);
+
+        Raster raster;
+        raster.create(tile.getX() - static_cast<int64_t>(halo),
+                      tile.getY() - static_cast<int64_t>(halo),
+                      tile.getSizeX() + (2 * halo),
+                      tile.getSizeY() + (2 * halo),
+                      cellSize);
+
+        double x1 = static_cast<double>(raster.getX()) * cellSize;
+        double y1 = static_cast<double>(raster.getY()) * cellSize;
+        double x2 = x1 + (static_cast<double>(raster.getSizeX()) * cellSize);
+        double y2 = y1 + (static_cast<double>(raster.getSizeY()) * cellSize);
+
+        Aabbd window;
+        window.set(x1, y1, db.aabb.min(2), x2, y2, db.aabb.max(2));
+
+        DatabaseCell cell;
+        db.read(cell, window);
+
+        compute(raster, cell);
+        raster.fill(fillRadius);
+        removePits(raster);
+
+        tile.copy(raster);
+        out.write(tile, i);
+    });
+
+    out.close();
+}
+
+void CanopyModel::compute(Raster &raster, const DatabaseCell &cell) const
+{
+    std::vector<float> &data = raster.data();
+
+    for (size_t i = 0; i < cell.size(); i++)
+    {
+        size_t ix;
+        size_t iy;
+
+        if (GroundFilter::isNoise(cell.laser[i].classification) ||
+            !raster.index(ix, iy, cell.xyz[3 * i], cell.xyz[3 * i + 1]))
+        {
+            continue;
+        }
+
+        // Heights below ground are ground
+        float h = std::max(cell.height[i], 0.0F);
+        float &v = data[(iy * raster.getSizeX()) + ix];
+        if (std::isnan(v) || h > v)
+        {
+            v = h;
+        }
+    }
+}
+
+void CanopyModel::removePits(Raster &raster) const
+{
+    const size_t nx = raster.getSizeX();
+    const size_t ny = raster.getSizeY();
+    std::vector<float> &data = raster.data();
+    float neighbours[8];
+
+    for (size_t k = 0; k < pitIterations; k++)
+    {
+        const std::vector<float> src = data;
+
+        for (size_t iy = 1; iy + 1 < ny; iy++)
+        {
+            for (size_t ix = 1; ix + 1 < nx; ix++)
+            {
+                float v = src[(iy * nx) + ix];
+                if (std::isnan(v))
+                {
+                    continue;
+                }
+
+                size_t n = 0;
+                for (size_t y = iy - 1; y <= iy + 1; y++)
+                {
+                    for (size_t x = ix - 1; x <= ix + 1; x++)
+                    {
+                        float u = src[(y * nx) + x];
+                        if ((x != ix || y != iy) && !std::isnan(u))
+                        {
+                            neighbours[n++] = u;
+                        }
+                    }
+                }
+
+                if (n < 5)
+                {
+                    continue;
+                }
+
+                std::nth_element(neighbours,
+                                 neighbours + (n / 2),
+                                 neighbours + n);
+                float median = neighbours[n / 2];
+                if (median - v > static_cast<float>(pitThreshold))
+                {
+                    data[(iy * nx) + ix] = median;
+                }
+            }
+        }
+    }
+}
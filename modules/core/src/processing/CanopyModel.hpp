@@ -0,0 +1,68 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file CanopyModel.hpp
+*/
+
+#ifndef CANOPY_MODEL_HPP
+#define CANOPY_MODEL_HPP
+
+#include <Database.hpp>
+#include <Raster.hpp>
+#include <ThreadPool.hpp>
+#include <string>
+
+/** Canopy Model.
+
+    Creates canopy height model from height above ground. Raster cells get
+    the highest return. Small gaps between returns inside crowns are filled
+    and pits are removed: a cell which is lower than the median of its 8
+    neighbours by more than a threshold gets the median. Pit removal is
+    repeated a few times.
+
+    Raster tiles are computed in parallel with a halo which covers gap
+    filling and all pit removal passes, so tile edges match. Tile size is
+    reduced when the points of all tiles in progress would not fit into
+    the memory budget.
+*/
+class CanopyModel
+{
+public:
+    double cellSize;
+    size_t fillRadius;
+    double pitThreshold;
+    size_t pitIterations;
+    size_t tileSize;
+    uint64_t memoryBudget;
+
+    CanopyModel();
+    ~CanopyModel();
+
+    void run(const Database &db,
+             const std::string &path,
+             ThreadPool &pool) const;
+    void compute(Raster &raster, const DatabaseCell &cell) const;
+    void removePits(Raster &raster) const;
+
+protected:
+    size_t getTileSize(const Database &db, size_t nthreads) const;
+};
+
+#endif /* CANOPY_MODEL_HPP */
@@ -0,0 +1,423 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file Clustering.cpp
+*/
+
+#include <Clustering.hpp>
+#include <ColumnWriter.hpp>
+#include <Error.hpp>
+#include <GroundFilter.hpp>
+#include <NeighbourSearch.hpp>
+#include <TileGrid.hpp>
+#include <UnionFind.hpp>
+#include <VoxelGrid.hpp>
+#include <algorithm>
+#include <limits>
+
+/** Number of chunks of links joined in parallel. */
+static const size_t CLUSTERING_CHUNKS = 64;
+
+/** Elements which are not in any set. */
+static const size_t CLUSTERING_NONE = std::numeric_limits<size_t>::max();
+
+Clustering::Clustering()
+    : method(METHOD_VOXELS),
+      voxelSize(0.1),
+      distance(0.1),
+      minPoints(5),
+      minClusterSize(10),
+      tileSize(50.0)
+{
+}
+
+Clustering::~Clustering()
+{
+}
+
+/** Point of a tile cluster which is also in other tiles. */
+struct ClusteringLink
+{
+    uint64_t record;
+    size_t node;
+
+    bool operator<(const ClusteringLink &b) const
+    {
+        return record < b.record || (record == b.record && node < b.node);
+    }
+};
+
+size_t Clustering::run(Database &db, ThreadPool &pool) const
+{
+    bool voxels = method == METHOD_VOXELS;
+
+    if (voxels ? !(voxelSize > 0) : (!(distance > 0) || minPoints == 0))
+    {
+        THROW("Invalid clustering parameters");
+    }
+
+    double halo = 2.0 * (voxels ? voxelSize : distance);
+
+    TileGrid grid;
+    grid.create(db, tileSize, halo);
+
+    // Clusters of tiles with their first owned point and size
+    std::vector<std::vector<uint64_t>> first(grid.size());
+    std::vector<std::vector<uint64_t>> count(grid.size());
+    std::vector<std::vector<ClusteringLink>> links(grid.size());
+
+    pool.run(grid.size(), [&](size_t i) {
+        DatabaseCell cell;
+        std::vector<size_t> own;
+        grid.read(cell, own, i);
+
+        std::vector<uint32_t> labels;
+        std::vector<uint8_t> core;
+        size_t n = label(labels, core, cell);
+
+        first[i].assign(n, std::numeric_limits<uint64_t>::max());
+        count[i].assign(n, 0);
+
+        std::vector<uint8_t> owned(cell.size(), 0);
+        for (size_t k = 0; k < own.size(); k++)
+        {
+            owned[own[k]] = 1;
+        }
+
+        Aabbd tile;
+        grid.getTile(tile, i);
+
+        for (size_t k = 0; k < cell.size(); k++)
+        {
+            if (labels[k] == 0)
+            {
+                continue;
+            }
+
+            size_t c = labels[k] - 1;
+            uint64_t record = cell.record[k];
+            double x = cell.xyz[3 * k];
+            double y = cell.xyz[3 * k + 1];
+
+            if (owned[k])
+            {
+                first[i][c] = std::min(first[i][c], record);
+                count[i][c]++;
+            }
+
+            // Core points of the halo and of the inner edge of the tile
+            bool edge = !owned[k] || x < tile.min(0) + halo ||
+                        y < tile.min(1) + halo || x > tile.max(0) - halo ||
+                        y > tile.max(1) - halo;
+            if (core[k] && edge)
+            {
+                links[i].push_back({record, c});
+            }
+        }
+    });
+
+    // Clusters of all tiles are nodes of one union find
+    std::vector<size_t> offset(grid.size() + 1, 0);
+    for (size_t i = 0; i < grid.size(); i++)
+    {
+        offset[i + 1] = offset[i] + first[i].size();
+    }
+
+    std::vector<ClusteringLink> all;
+    for (size_t i = 0; i < grid.size(); i++)
+    {
+        for (size_t k = 0; k < links[i].size(); k++)
+        {
+            all.push_back({links[i][k].record, offset[i] + links[i][k].node});
+        }
+        std::vector<ClusteringLink>().swap(links[i]);
+    }
+    std::sort(all.begin(), all.end());
+
+    // The same point in more tiles joins their clusters
+    UnionFind nodes(offset.back());
+    pool.run(CLUSTERING_CHUNKS, [&](size_t c) {
+        size_t from = (c * all.size()) / CLUSTERING_CHUNKS;
+        size_t to = ((c + 1) * all.size()) / CLUSTERING_CHUNKS;
+        for (size_t k = std::max(from, static_cast<size_t>(1)); k < to; k++)
+        {
+            if (all[k].record == all[k - 1].record)
+            {
+                nodes.unite(all[k - 1].node, all[k].node);
+            }
+        }
+    });
+
+    std::vector<uint64_t> rootFirst(nodes.size(),
+                                    std::numeric_limits<uint64_t>::max());
+    std::vector<uint64_t> rootCount(nodes.size(), 0);
+    for (size_t i = 0; i < grid.size(); i++)
+    {
+        for (size_t c = 0; c < first[i].size(); c++)
+        {
+            size_t root = nodes.find(offset[i] + c);
+            rootFirst[root] = std::min(rootFirst[root], first[i][c]);
+            rootCount[root] += count[i][c];
+        }
+    }
+
+    // Number large clusters in the order of their first points
+    std::vector<std::pair<uint64_t, size_t>> clusters;
+    for (size_t root = 0; root < nodes.size(); root++)
+    {
+        if (rootCount[root] > 0 && rootCount[root] >= minClusterSize)
+        {
+            clusters.push_back({rootFirst[root], root});
+        }
+    }
+    std::sort(clusters.begin(), clusters.end());
+
+    std::vector<uint32_t> ids(nodes.size(), 0);
+    for (size_t k = 0; k < clusters.size(); k++)
+    {
+        ids[clusters[k].second] = static_cast<uint32_t>(k + 1);
+    }
+
+    ColumnWriter column;
+    column.create(db, Database::CHUNK_ID_LABEL, sizeof(uint32_t));
+
+    pool.run(grid.size(), [&](size_t i) {
+        DatabaseCell cell;
+        std::vector<size_t> own;
+        grid.read(cell, own, i);
+
+        // Labels of tiles are the same as in the first pass
+        std::vector<uint32_t> labels;
+        std::vector<uint8_t> core;
+        label(labels, core, cell);
+
+        std::vector<uint32_t> values(cell.size(), 0);
+        for (size_t k = 0; k < own.size(); k++)
+        {
+            size_t p = own[k];
+            if (labels[p] > 0)
+            {
+                values[p] = ids[nodes.find(offset[i] + labels[p] - 1)];
+            }
+        }
+
+        column.write(cell, own, values);
+    });
+
+    column.close();
+
+    // Reopen with the new column
+    db.open(db.path());
+
+    return clusters.size();
+}
+
+/** Connect neighbouring voxels, each voxel is one element. */
+static void Clustering_voxels(UnionFind &sets,
+                              std::vector<size_t> &element,
+                              std::vector<uint8_t> &core,
+                              const DatabaseCell &cell,
+                              double voxelSize)
+{
+    VoxelGrid voxels;
+    voxels.create(cell, voxelSize);
+    sets.create(voxels.size());
+
+    const std::vector<size_t> &sorted = voxels.getPoints();
+    for (size_t v = 0; v < voxels.size(); v++)
+    {
+        for (size_t k = 0; k < voxels[v].count; k++)
+        {
+            element[sorted[voxels[v].from + k]] = v;
+        }
+    }
+    core.assign(cell.size(), 1);
+
+    // Half of the 26 neighbours, the other half connects back
+    for (size_t v = 0; v < voxels.size(); v++)
+    {
+        int64_t gx;
+        int64_t gy;
+        int64_t gz;
+        voxels.getCoordinates(gx, gy, gz, v);
+
+        for (int64_t dz = 0; dz <= 1; dz++)
+        {
+            for (int64_t dy = (dz > 0) ? -1 : 0; dy <= 1; dy++)
+            {
+                int64_t dx = (dz > 0 || dy > 0) ? -1 : 1;
+                for (; dx <= 1; dx++)
+                {
+                    size_t u = voxels.find(gx + dx, gy + dy, gz + dz);
+                    if (u < voxels.size())
+                    {
+                        sets.unite(v, u);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/** Connect core points and attach border points to the nearest core
+    point, each point is one element.
+*/
+static void Clustering_dbscan(UnionFind &sets,
+                              std::vector<size_t> &element,
+                              std::vector<uint8_t> &core,
+                              const DatabaseCell &cell,
+                              double distance,
+                              size_t minPoints)
+{
+    size_t n = cell.size();
+    sets.create(n);
+    core.assign(n, 0);
+
+    NeighbourSearch neighbourSearch;
+    neighbourSearch.create(cell, distance);
+    const VoxelGrid &voxels = neighbourSearch.getVoxels();
+
+    // Neighbours do not include the point itself
+    NeighbourSearch::Result result;
+    for (size_t v = 0; v < voxels.size(); v++)
+    {
+        neighbourSearch.radius(result, v, distance);
+        for (size_t j = 0; j < result.points.size(); j++)
+        {
+            size_t neighbours = result.from[j + 1] - result.from[j];
+            core[result.points[j]] = (neighbours + 1 >= minPoints) ? 1 : 0;
+        }
+    }
+
+    for (size_t v = 0; v < voxels.size(); v++)
+    {
+        neighbourSearch.radius(result, v, distance);
+        for (size_t j = 0; j < result.points.size(); j++)
+        {
+            size_t p = result.points[j];
+            size_t nearest = CLUSTERING_NONE;
+
+            for (size_t c = result.from[j]; c < result.from[j + 1]; c++)
+            {
+                size_t q = result.index[c];
+                if (!core[q])
+                {
+                    continue;
+                }
+
+                if (core[p])
+                {
+                    if (q < p)
+                    {
+                        sets.unite(p, q);
+                    }
+                }
+                else if (nearest == CLUSTERING_NONE ||
+                         result.distance[c] < result.distance[nearest] ||
+                         (!(result.distance[nearest] < result.distance[c]) &&
+                          cell.record[q] < cell.record[result.index[nearest]]))
+                {
+                    nearest = c;
+                }
+            }
+
+            if (core[p])
+            {
+                element[p] = p;
+            }
+            else if (nearest != CLUSTERING_NONE)
+            {
+                element[p] = result.index[nearest];
+            }
+        }
+    }
+}
+
+size_t Clustering::label(std::vector<uint32_t> &labels,
+                         std::vector<uint8_t> &core,
+                         const DatabaseCell &cell) const
+{
+    labels.assign(cell.size(), 0);
+    core.assign(cell.size(), 0);
+
+    // Ground connects all objects, noise and ground are not clustered
+    DatabaseCell search;
+    std::vector<size_t> map;
+    for (size_t k = 0; k < cell.size(); k++)
+    {
+        uint8_t classification = cell.laser[k].classification;
+        if (classification == GroundFilter::CLASS_GROUND ||
+            GroundFilter::isNoise(classification))
+        {
+            continue;
+        }
+
+        search.xyz.push_back(cell.xyz[3 * k]);
+        search.xyz.push_back(cell.xyz[3 * k + 1]);
+        search.xyz.push_back(cell.xyz[3 * k + 2]);
+        search.laser.push_back(cell.laser[k]);
+        search.record.push_back(cell.record[k]);
+        map.push_back(k);
+    }
+
+    if (map.empty())
+    {
+        return 0;
+    }
+
+    UnionFind sets;
+    std::vector<size_t> element(map.size(), CLUSTERING_NONE);
+    std::vector<uint8_t> searchCore;
+    if (method == METHOD_VOXELS)
+    {
+        Clustering_voxels(sets, element, searchCore, search, voxelSize);
+    }
+    else
+    {
+        Clustering_dbscan(sets,
+                          element,
+                          searchCore,
+                          search,
+                          distance,
+                          minPoints);
+    }
+
+    // Roots of sets are numbered from one in the order of points
+    std::vector<uint32_t> local(sets.size(), 0);
+    size_t n = 0;
+    for (size_t k = 0; k < map.size(); k++)
+    {
+        if (element[k] == CLUSTERING_NONE)
+        {
+            continue;
+        }
+
+        size_t root = sets.find(element[k]);
+        if (local[root] == 0)
+        {
+            local[root] = static_cast<uint32_t>(++n);
+        }
+
+        labels[map[k]] = local[root];
+        core[map[k]] = searchCore[k];
+    }
+
+    return n;
+}
@@ -0,0 +1,75 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file Clustering.hpp
+*/
+
+#ifndef CLUSTERING_HPP
+#define CLUSTERING_HPP
+
+#include <Database.hpp>
+#include <ThreadPool.hpp>
+#include <vector>
+
+/** Clustering.
+
+    Labels Euclidean clusters of points. Voxel method finds connected
+    components of occupied voxels, voxels are connected to all of their
+    26 neighbours. DBSCAN method connects core points, which have at
+    least the minimum number of points within the distance including
+    themselves. Other points within the distance of a core point join
+    the cluster of the nearest one. Clusters smaller than the minimum
+    cluster size and points which are not connected get label zero.
+
+    Tiles are labelled in parallel with a halo of two voxels or two
+    distances, so connections of all owned points are seen in their
+    tile. Core points near tile edges link clusters of neighbouring
+    tiles in a concurrent union find. Clusters are numbered by their
+    first point in the file, so labels do not depend on tiles. Each
+    tile is labelled twice to keep only one tile per thread in memory.
+    Ground and noise points are ignored. Labels are written as the label
+    column of the database.
+*/
+class Clustering
+{
+public:
+    enum Method
+    {
+        METHOD_VOXELS,
+        METHOD_DBSCAN
+    };
+
+    Method method;
+    double voxelSize;
+    double distance;
+    size_t minPoints;
+    size_t minClusterSize;
+    double tileSize;
+
+    Clustering();
+    ~Clustering();
+
+    size_t run(Database &db, ThreadPool &pool) const;
+    size_t label(std::vector<uint32_t> &labels,
+                 std::vector<uint8_t> &core,
+                 const DatabaseCell &cell) const;
+};
+
+#endif /* CLUSTERING_HPP */
@@ -0,0 +1,381 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file DbhEstimation.cpp
+*/
+
+#include <DbhEstimation.hpp>
+#include <Error.hpp>
+#include <GroundFilter.hpp>
+#include <TileGrid.hpp>
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+/** Number of least squares iterations. */
+static const size_t DBH_ESTIMATION_REFINE = 10;
+
+DbhEstimation::DbhEstimation()
+    : sliceMin(1.25),
+      sliceMax(1.35),
+      inlierDistance(0.02),
+      iterations(256),
+      minPoints(6),
+      maxDiameter(2.0),
+      tileSize(100.0)
+{
+}
+
+DbhEstimation::~DbhEstimation()
+{
+}
+
+Json &DbhEstimation::Stem::serialize(Json &out) const
+{
+    out["tree"] = tree;
+    out["x"] = x;
+    out["y"] = y;
+    out["z"] = z;
+    out["dbh"] = dbh;
+    out["rmse"] = rmse;
+    out["points"] = static_cast<uint64_t>(points);
+    out["inliers"] = static_cast<uint64_t>(inliers);
+
+    return out;
+}
+
+/** Slice point. */
+struct DbhEstimationPoint
+{
+    uint32_t tree;
+    uint64_t record;
+    double xyz[3];
+
+    bool operator<(const DbhEstimationPoint &b) const
+    {
+        return tree < b.tree || (tree == b.tree && record < b.record);
+    }
+};
+
+void DbhEstimation::run(std::vector<Stem> &stems,
+                        const Database &db,
+                        ThreadPool &pool) const
+{
+    size_t n = db.getFile().getEntrySize();
+    if (db.findColumn(Database::CHUNK_ID_TREE, sizeof(uint32_t)) == n ||
+        db.findColumn(Database::CHUNK_ID_HEIGHT, sizeof(float)) == n)
+    {
+        THROW("DBH estimation requires trees and height above ground in "
+              "database '" +
+              db.path() + "'");
+    }
+
+    TileGrid grid;
+    grid.create(db, tileSize, 0);
+
+    // Slice points of all tiles
+    std::vector<std::vector<DbhEstimationPoint>> tiles(grid.size());
+
+    pool.run(grid.size(), [&](size_t i) {
+        DatabaseCell cell;
+        std::vector<size_t> own;
+        grid.read(cell, own, i);
+
+        for (size_t k = 0; k < own.size(); k++)
+        {
+            size_t p = own[k];
+            if (cell.tree[p] == 0 || !(cell.height[p] >= sliceMin) ||
+                !(cell.height[p] <= sliceMax) ||
+                GroundFilter::isNoise(cell.laser[p].classification))
+            {
+                continue;
+            }
+
+            tiles[i].push_back({cell.tree[p],
+                                cell.record[p],
+                                {cell.xyz[3 * p],
+                                 cell.xyz[3 * p + 1],
+                                 cell.xyz[3 * p + 2]}});
+        }
+    });
+
+    // Points of each tree together, sorted independently of tiles
+    std::vector<DbhEstimationPoint> points;
+    for (size_t i = 0; i < tiles.size(); i++)
+    {
+        points.insert(points.end(), tiles[i].begin(), tiles[i].end());
+        tiles[i].clear();
+        tiles[i].shrink_to_fit();
+    }
+    std::sort(points.begin(), points.end());
+
+    std::vector<size_t> from;
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        if (i == 0 || points[i].tree != points[i - 1].tree)
+        {
+            from.push_back(i);
+        }
+    }
+    from.push_back(points.size());
+
+    size_t ntrees = from.size() - 1;
+    std::vector<Stem> fitted(ntrees);
+    std::vector<uint8_t> valid(ntrees, 0);
+
+    pool.run(ntrees, [&](size_t t) {
+        size_t count = from[t + 1] - from[t];
+        std::vector<double> xyz(3 * count);
+        for (size_t k = 0; k < count; k++)
+        {
+            const DbhEstimationPoint &p = points[from[t] + k];
+            xyz[3 * k] = p.xyz[0];
+            xyz[3 * k + 1] = p.xyz[1];
+            xyz[3 * k + 2] = p.xyz[2];
+        }
+
+        fitted[t].tree = points[from[t]].tree;
+        valid[t] = fit(fitted[t], xyz.data(), count) ? 1 : 0;
+    });
+
+    stems.clear();
+    for (size_t t = 0; t < ntrees; t++)
+    {
+        if (valid[t])
+        {
+            stems.push_back(fitted[t]);
+        }
+    }
+}
+
+/** Circle through three points, false if they are on a line. */
+static bool DbhEstimation_circle(double &cx,
+                                 double &cy,
+                                 double &r,
+                                 const double *a,
+                                 const double *b,
+                                 const double *c)
+{
+    double bx = b[0] - a[0];
+    double by = b[1] - a[1];
+    double qx = c[0] - a[0];
+    double qy = c[1] - a[1];
+    double d = 2.0 * ((bx * qy) - (by * qx));
+    if (!(std::fabs(d) > 1e-12))
+    {
+        return false;
+    }
+
+    double b2 = (bx * bx) + (by * by);
+    double q2 = (qx * qx) + (qy * qy);
+    double ux = ((qy * b2) - (by * q2)) / d;
+    double uy = ((bx * q2) - (qx * b2)) / d;
+
+    cx = a[0] + ux;
+    cy = a[1] + uy;
+    r = std::sqrt((ux * ux) + (uy * uy));
+
+    return true;
+}
+
+/** Determinant of a 3x3 matrix. */
+static double DbhEstimation_determinant(const double m[3][3])
+{
+    return (m[0][0] * ((m[1][1] * m[2][2]) - (m[1][2] * m[2][1]))) -
+           (m[0][1] * ((m[1][0] * m[2][2]) - (m[1][2] * m[2][0]))) +
+           (m[0][2] * ((m[1][0] * m[2][1]) - (m[1][1] * m[2][0])));
+}
+
+bool DbhEstimation::fit(Stem &stem, const double *xyz, size_t n) const
+{
+    stem.points = n;
+    stem.inliers = 0;
+    if (n < std::max(minPoints, size_t(3)))
+    {
+        return false;
+    }
+
+    // Coordinates relative to the first point keep precision
+    std::vector<double> p(2 * n);
+    for (size_t i = 0; i < n; i++)
+    {
+        p[2 * i] = xyz[3 * i] - xyz[0];
+        p[2 * i + 1] = xyz[3 * i + 1] - xyz[1];
+    }
+
+    auto count = [&](double cx, double cy, double r) -> size_t {
+        size_t inliers = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            double dx = p[2 * i] - cx;
+            double dy = p[2 * i + 1] - cy;
+            double e = std::sqrt((dx * dx) + (dy * dy)) - r;
+            if (std::fabs(e) <= inlierDistance)
+            {
+                inliers++;
+            }
+        }
+        return inliers;
+    };
+
+    // RANSAC
+    std::mt19937 random(stem.tree);
+    std::uniform_int_distribution<size_t> uniform(0, n - 1);
+    double maxRadius = 0.5 * maxDiameter;
+    double bestX = 0;
+    double bestY = 0;
+    double bestR = 0;
+    size_t best = 0;
+
+    for (size_t k = 0; k < iterations; k++)
+    {
+        size_t a = uniform(random);
+        size_t b = uniform(random);
+        size_t c = uniform(random);
+        if (a == b || a == c || b == c)
+        {
+            continue;
+        }
+
+        double cx;
+        double cy;
+        double r;
+        if (!DbhEstimation_circle(cx, cy, r, &p[2 * a], &p[2 * b], &p[2 * c]) ||
+            r > maxRadius)
+        {
+            continue;
+        }
+
+        size_t inliers = count(cx, cy, r);
+        if (inliers > best)
+        {
+            best = inliers;
+            bestX = cx;
+            bestY = cy;
+            bestR = r;
+        }
+    }
+
+    if (best < 3)
+    {
+        return false;
+    }
+
+    // Geometric least squares of inliers by Gauss-Newton iterations
+    double cx = bestX;
+    double cy = bestY;
+    double r = bestR;
+    for (size_t k = 0; k < DBH_ESTIMATION_REFINE; k++)
+    {
+        double a[3][3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
+        double g[3] = {0, 0, 0};
+
+        for (size_t i = 0; i < n; i++)
+        {
+            double dx = p[2 * i] - bestX;
+            double dy = p[2 * i + 1] - bestY;
+            double e0 = std::sqrt((dx * dx) + (dy * dy)) - bestR;
+            if (!(std::fabs(e0) <= inlierDistance))
+            {
+                continue;
+            }
+
+            dx = p[2 * i] - cx;
+            dy = p[2 * i + 1] - cy;
+            double d = std::sqrt((dx * dx) + (dy * dy));
+            if (!(d > 0))
+            {
+                continue;
+            }
+
+            double j[3] = {-dx / d, -dy / d, -1.0};
+            double e = d - r;
+            for (size_t u = 0; u < 3; u++)
+            {
+                for (size_t v = 0; v < 3; v++)
+                {
+                    a[u][v] += j[u] * j[v];
+                }
+                g[u] += j[u] * e;
+            }
+        }
+
+        // Solve a * step = -g by Cramer's rule
+        double det = DbhEstimation_determinant(a);
+        if (!(std::fabs(det) > 1e-18))
+        {
+            break;
+        }
+
+        double step[3];
+        for (size_t u = 0; u < 3; u++)
+        {
+            double m[3][3];
+            for (size_t row = 0; row < 3; row++)
+            {
+                for (size_t col = 0; col < 3; col++)
+                {
+                    m[row][col] = (col == u) ? -g[row] : a[row][col];
+                }
+            }
+
+            step[u] = DbhEstimation_determinant(m) / det;
+        }
+
+        cx += step[0];
+        cy += step[1];
+        r += step[2];
+    }
+
+    if (!(r > 0) || r > maxRadius)
+    {
+        return false;
+    }
+
+    // Quality of the refined circle
+    double sum2 = 0;
+    double sumZ = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        double dx = p[2 * i] - cx;
+        double dy = p[2 * i + 1] - cy;
+        double e = std::sqrt((dx * dx) + (dy * dy)) - r;
+        if (std::fabs(e) <= inlierDistance)
+        {
+            sum2 += e * e;
+            sumZ += xyz[3 * i + 2];
+            stem.inliers++;
+        }
+    }
+
+    if (stem.inliers < 3)
+    {
+        return false;
+    }
+
+    double ninliers = static_cast<double>(stem.inliers);
+    stem.x = cx + xyz[0];
+    stem.y = cy + xyz[1];
+    stem.z = sumZ / ninliers;
+    stem.dbh = 2.0 * r;
+    stem.rmse = std::sqrt(sum2 / ninliers);
+
+    return true;
+}
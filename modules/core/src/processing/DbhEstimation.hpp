@@ -0,0 +1,79 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file DbhEstimation.hpp
+*/
+
+#ifndef DBH_ESTIMATION_HPP
+#define DBH_ESTIMATION_HPP
+
+#include <Database.hpp>
+#include <Json.hpp>
+#include <ThreadPool.hpp>
+#include <vector>
+
+/** DBH Estimation.
+
+    Estimates diameter at breast height of segmented trees. Points of each
+    tree in a thin slice of height above ground are collected from tiles in
+    parallel. A circle is found by RANSAC with a random generator seeded by
+    the tree id and refined by geometric least squares fit to its inliers.
+    Trees are fitted in parallel.
+
+    Each stem has the circle center, mean height of inliers, diameter and
+    fit quality given by the number of inliers and the root mean square
+    distance of inliers from the circle.
+*/
+class DbhEstimation
+{
+public:
+    /** Stem at breast height. */
+    struct Stem
+    {
+        uint32_t tree;
+        double x;
+        double y;
+        double z;
+        double dbh;
+        double rmse;
+        size_t points;
+        size_t inliers;
+
+        Json &serialize(Json &out) const;
+    };
+
+    double sliceMin;
+    double sliceMax;
+    double inlierDistance;
+    size_t iterations;
+    size_t minPoints;
+    double maxDiameter;
+    double tileSize;
+
+    DbhEstimation();
+    ~DbhEstimation();
+
+    void run(std::vector<Stem> &stems,
+             const Database &db,
+             ThreadPool &pool) const;
+    bool fit(Stem &stem, const double *xyz, size_t n) const;
+};
+
+#endif /* DBH_ESTIMATION_HPP */
@@ -0,0 +1,257 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file GroundFilter.cpp
+*/
+
+#include <ColumnWriter.hpp>
+#include <GroundFilter.hpp>
+#include <TileGrid.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+const uint8_t GroundFilter::CLASS_UNCLASSIFIED = 1;
+const uint8_t GroundFilter::CLASS_GROUND = 2;
+const uint8_t GroundFilter::CLASS_LOW_NOISE = 7;
+const uint8_t GroundFilter::CLASS_HIGH_NOISE = 18;
+
+/** Grid cells without points. */
+static const double GROUND_FILTER_EMPTY =
+    std::numeric_limits<double>::infinity();
+
+GroundFilter::GroundFilter()
+    : cellSize(1.0),
+      maxWindowSize(20.0),
+      slope(1.0),
+      initialDistance(0.5),
+      maxDistance(3.0),
+      tileSize(100.0)
+{
+}
+
+GroundFilter::~GroundFilter()
+{
+}
+
+bool GroundFilter::isNoise(uint8_t classification)
+{
+    return classification == CLASS_LOW_NOISE ||
+           classification == CLASS_HIGH_NOISE;
+}
+
+void GroundFilter::run(Database &db, ThreadPool &pool) const
+{
+    // Each opening spreads values by the window size
+    std::vector<size_t> windows;
+    getWindows(windows);
+    double halo = cellSize;
+    for (size_t i = 0; i < windows.size(); i++)
+    {
+        halo += static_cast<double>(windows[i] - 1) * cellSize;
+    }
+
+    TileGrid grid;
+    grid.create(db, tileSize, halo);
+
+    ColumnWriter column;
+    column.create(db, Database::CHUNK_ID_CLASSIFICATION, sizeof(uint8_t));
+
+    pool.run(grid.size(), [&](size_t i) {
+        DatabaseCell cell;
+        std::vector<size_t> own;
+        grid.read(cell, own, i);
+
+        classify(cell);
+
+        std::vector<uint8_t> values(cell.size());
+        for (size_t k = 0; k < cell.size(); k++)
+        {
+            values[k] = cell.laser[k].classification;
+        }
+        column.write(cell, own, values);
+    });
+
+    column.close();
+
+    // Reopen with the new column
+    db.open(db.path());
+}
+
+void GroundFilter::getWindows(std::vector<size_t> &windows) const
+{
+    size_t maxWindow = static_cast<size_t>(maxWindowSize / cellSize);
+
+    windows.clear();
+    windows.push_back(3);
+    while ((windows.back() * 2) - 1 <= maxWindow)
+    {
+        windows.push_back((windows.back() * 2) - 1);
+    }
+}
+
+void GroundFilter::classify(DatabaseCell &cell) const
+{
+    size_t n = cell.size();
+    if (n == 0)
+    {
+        return;
+    }
+
+    // Grid of the lowest points is aligned to multiples of the cell size,
+    // so neighbouring tiles share grid cells
+    std::vector<int64_t> gx(n);
+    std::vector<int64_t> gy(n);
+    int64_t x1 = std::numeric_limits<int64_t>::max();
+    int64_t y1 = std::numeric_limits<int64_t>::max();
+    int64_t x2 = std::numeric_limits<int64_t>::min();
+    int64_t y2 = std::numeric_limits<int64_t>::min();
+    for (size_t i = 0; i < n; i++)
+    {
+        gx[i] = static_cast<int64_t>(std::floor(cell.xyz[3 * i] / cellSize));
+        gy[i] =
+            static_cast<int64_t>(std::floor(cell.xyz[3 * i + 1] / cellSize));
+        x1 = std::min(x1, gx[i]);
+        y1 = std::min(y1, gy[i]);
+        x2 = std::max(x2, gx[i]);
+        y2 = std::max(y2, gy[i]);
+    }
+
+    size_t nx = static_cast<size_t>(x2 - x1 + 1);
+    size_t ny = static_cast<size_t>(y2 - y1 + 1);
+
+    std::vector<size_t> index(n);
+    std::vector<double> grid(nx * ny, GROUND_FILTER_EMPTY);
+    std::vector<double> tmp(nx * ny);
+    std::vector<uint8_t> ground(n, 0);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        if (isNoise(cell.laser[i].classification))
+        {
+            continue;
+        }
+
+        index[i] = static_cast<size_t>(((gy[i] - y1) * (x2 - x1 + 1)) +
+                                       (gx[i] - x1));
+        grid[index[i]] = std::min(grid[index[i]], cell.xyz[3 * i + 2]);
+        ground[i] = 1;
+    }
+
+    // Progressive opening with exponentially growing windows
+    std::vector<size_t> windows;
+    getWindows(windows);
+
+    size_t wPrevious = 1;
+    for (size_t k = 0; k < windows.size(); k++)
+    {
+        size_t w = windows[k];
+
+        double dh = initialDistance;
+        if (k > 0)
+        {
+            dh += slope * static_cast<double>(w - wPrevious) * cellSize;
+            dh = std::min(dh, maxDistance);
+        }
+
+        open(grid, tmp, nx, ny, w);
+
+        for (size_t i = 0; i < n; i++)
+        {
+            if (ground[i] && cell.xyz[3 * i + 2] - grid[index[i]] > dh)
+            {
+                ground[i] = 0;
+            }
+        }
+
+        wPrevious = w;
+    }
+
+    for (size_t i = 0; i < n; i++)
+    {
+        uint8_t &classification = cell.laser[i].classification;
+        if (ground[i])
+        {
+            classification = CLASS_GROUND;
+        }
+        else if (classification == CLASS_GROUND)
+        {
+            classification = CLASS_UNCLASSIFIED;
+        }
+    }
+}
+
+/** Minimum or maximum of valid values in a window along rows or columns. */
+template <class Compare>
+static void GroundFilter_filter(std::vector<double> &out,
+                                const std::vector<double> &in,
+                                size_t nx,
+                                size_t ny,
+                                size_t r,
+                                bool rows,
+                                Compare compare)
+{
+    size_t n = rows ? nx : ny;
+    size_t m = rows ? ny : nx;
+    size_t line = rows ? nx : 1;
+    size_t step = rows ? 1 : nx;
+
+    for (size_t j = 0; j < m; j++)
+    {
+        const double *src = &in[j * line];
+        double *dst = &out[j * line];
+
+        for (size_t i = 0; i < n; i++)
+        {
+            size_t from = (i > r) ? i - r : 0;
+            size_t to = std::min(i + r + 1, n);
+            double v = GROUND_FILTER_EMPTY;
+
+            for (size_t k = from; k < to; k++)
+            {
+                double z = src[k * step];
+                if (z < GROUND_FILTER_EMPTY &&
+                    (!(v < GROUND_FILTER_EMPTY) || compare(z, v)))
+                {
+                    v = z;
+                }
+            }
+
+            dst[i * step] = v;
+        }
+    }
+}
+
+void GroundFilter::open(std::vector<double> &grid,
+                        std::vector<double> &tmp,
+                        size_t nx,
+                        size_t ny,
+                        size_t w) const
+{
+    size_t r = w / 2;
+    auto lower = [](double a, double b) { return a < b; };
+    auto higher = [](double a, double b) { return a > b; };
+
+    // Erosion followed by dilation, both separable
+    GroundFilter_filter(tmp, grid, nx, ny, r, true, lower);
+    GroundFilter_filter(grid, tmp, nx, ny, r, false, lower);
+    GroundFilter_filter(tmp, grid, nx, ny, r, true, higher);
+    GroundFilter_filter(grid, tmp, nx, ny, r, false, higher);
+}
@@ -0,0 +1,79 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file GroundFilter.hpp
+*/
+
+#ifndef GROUND_FILTER_HPP
+#define GROUND_FILTER_HPP
+
+#include <Database.hpp>
+#include <ThreadPool.hpp>
+#include <cstdint>
+#include <vector>
+
+/** Ground Filter.
+
+    Progressive morphological filter (Zhang et al. 2003). The lowest points
+    are gridded and the grid is opened with windows of growing size. Points
+    higher above the opened surface than a threshold, which grows with the
+    window size and terrain slope, are not ground.
+
+    The database is processed by tiles in parallel. The grid is aligned to
+    multiples of the cell size and the halo of each tile covers the reach
+    of all openings, so results do not depend on the tile size.
+
+    Ground points are classified as 2, points previously classified as
+    ground become 1 (unclassified), noise (7 and 18) is ignored. Results
+    are written as the classification column of the database.
+*/
+class GroundFilter
+{
+public:
+    static const uint8_t CLASS_UNCLASSIFIED;
+    static const uint8_t CLASS_GROUND;
+    static const uint8_t CLASS_LOW_NOISE;
+    static const uint8_t CLASS_HIGH_NOISE;
+
+    double cellSize;
+    double maxWindowSize;
+    double slope;
+    double initialDistance;
+    double maxDistance;
+    double tileSize;
+
+    GroundFilter();
+    ~GroundFilter();
+
+    void run(Database &db, ThreadPool &pool) const;
+    void classify(DatabaseCell &cell) const;
+    void getWindows(std::vector<size_t> &windows) const;
+
+    static bool isNoise(uint8_t classification);
+
+protected:
+    void open(std::vector<double> &grid,
+              std::vector<double> &tmp,
+              size_t nx,
+              size_t ny,
+              size_t w) const;
+};
+
+#endif /* GROUND_FILTER_HPP */
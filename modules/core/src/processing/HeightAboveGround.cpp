@@ -0,0 +1,170 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file HeightAboveGround.cpp
+*/
+
+#include <ColumnWriter.hpp>
+#include <HeightAboveGround.hpp>
+#include <RasterFile.hpp>
+#include <TileGrid.hpp>
+#include <algorithm>
+
+/** Number of points interpolated at once. */
+static const size_t HEIGHT_ABOVE_GROUND_BATCH_SIZE = 4096;
+
+HeightAboveGround::HeightAboveGround() : tileSize(100.0), recompute(false)
+{
+}
+
+HeightAboveGround::~HeightAboveGround()
+{
+}
+
+/** Describe inputs of the height column. */
+static void HeightAboveGround_inputs(Json &inputs,
+                                     const Database &db,
+                                     const RasterFile &dtm)
+{
+    // Classification column replaces classification of point records,
+    // which do not change until the database is compacted
+    size_t id =
+        db.findColumn(Database::CHUNK_ID_CLASSIFICATION, sizeof(uint8_t));
+    if (id < db.getFile().getEntrySize())
+    {
+        ChunkFile::Chunk c;
+        (void)db.getFile().map(id, c);
+        inputs["classification"] = static_cast<uint64_t>(c.checksum);
+    }
+
+    inputs["dtm"] = static_cast<uint64_t>(dtm.getFingerprint());
+}
+
+bool HeightAboveGround::isCached(const Database &db,
+                                 const std::string &dtmPath)
+{
+    const ChunkFile &file = db.getFile();
+    size_t id = db.findColumn(Database::CHUNK_ID_HEIGHT, sizeof(float));
+    size_t metadataId = file.findEntry(Database::CHUNK_ID_HEIGHT_METADATA);
+    if (id == file.getEntrySize() || metadataId == file.getEntrySize())
+    {
+        return false;
+    }
+
+    ChunkFile::Chunk c;
+    const uint8_t *data = file.map(metadataId, c);
+    Json metadata;
+    metadata.deserializeCbor(data, static_cast<size_t>(c.data_length));
+
+    RasterFile dtm;
+    dtm.open(dtmPath);
+    Json inputs;
+    HeightAboveGround_inputs(inputs, db, dtm);
+    dtm.close();
+
+    return metadata.serialize(0) == inputs.serialize(0);
+}
+
+void HeightAboveGround::run(Database &db,
+                            const std::string &dtmPath,
+                            ThreadPool &pool) const
+{
+    if (!recompute && isCached(db, dtmPath))
+    {
+        return;
+    }
+
+    RasterFile dtm;
+    dtm.open(dtmPath);
+
+    TileGrid grid;
+    grid.create(db, tileSize, 0);
+
+    ColumnWriter column;
+    column.create(db, Database::CHUNK_ID_HEIGHT, sizeof(float));
+
+    pool.run(grid.size(), [&](size_t i) {
+        DatabaseCell cell;
+        std::vector<size_t> own;
+        grid.read(cell, own, i);
+        if (own.empty())
+        {
+            return;
+        }
+
+        // Terrain with one more cell for interpolation at tile edges
+        Aabbd window;
+        grid.getTile(window, i);
+        double c = dtm.getCellSize();
+        window.set(window.min(0) - c,
+                   window.min(1) - c,
+                   window.min(2),
+                   window.max(0) + c,
+                   window.max(1) + c,
+                   window.max(2));
+
+        Raster raster;
+        dtm.read(raster, window);
+
+        std::vector<float> height;
+        compute(height, cell, raster);
+        column.write(cell, own, height);
+    });
+
+    Json inputs;
+    HeightAboveGround_inputs(inputs, db, dtm);
+    column.close(Database::CHUNK_ID_HEIGHT_METADATA, inputs);
+    dtm.close();
+
+    // Reopen with the new column
+    db.open(db.path());
+}
+
+void HeightAboveGround::compute(std::vector<float> &height,
+                                const DatabaseCell &cell,
+                                const Raster &dtm) const
+{
+    size_t n = cell.size();
+    height.resize(n);
+
+    std::vector<double> x(HEIGHT_ABOVE_GROUND_BATCH_SIZE);
+    std::vector<double> y(HEIGHT_ABOVE_GROUND_BATCH_SIZE);
+    std::vector<float> z(HEIGHT_ABOVE_GROUND_BATCH_SIZE);
+
+    for (size_t from = 0; from < n; from += HEIGHT_ABOVE_GROUND_BATCH_SIZE)
+    {
+        size_t count = std::min(n - from, HEIGHT_ABOVE_GROUND_BATCH_SIZE);
+        const double *xyz = &cell.xyz[3 * from];
+
+        // Columns of coordinates
+        for (size_t i = 0; i < count; i++)
+        {
+            x[i] = xyz[3 * i];
+            y[i] = xyz[3 * i + 1];
+        }
+
+        dtm.interpolate(z.data(), x.data(), y.data(), count);
+
+        for (size_t i = 0; i < count; i++)
+        {
+            height[from + i] = static_cast<float>(xyz[3 * i + 2] - z[i]);
+        }
+    }
+}
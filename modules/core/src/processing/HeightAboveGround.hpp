@@ -0,0 +1,63 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file HeightAboveGround.hpp
+*/
+
+#ifndef HEIGHT_ABOVE_GROUND_HPP
+#define HEIGHT_ABOVE_GROUND_HPP
+
+#include <Database.hpp>
+#include <Raster.hpp>
+#include <ThreadPool.hpp>
+#include <string>
+#include <vector>
+
+/** Height Above Ground.
+
+    Computes height of each point above the digital terrain model. Terrain
+    height is interpolated bilinearly from the raster in batches over
+    separate x and y columns of each tile. Tiles are processed in parallel
+    and results are written as the height column of the database, which
+    is then read into DatabaseCell::height.
+
+    The column is computed once per dataset. Its metadata store the
+    checksum of the classification column and the fingerprint of the
+    terrain model. The column is reused while both inputs are the same,
+    unless recomputation is requested.
+*/
+class HeightAboveGround
+{
+public:
+    double tileSize;
+    bool recompute;
+
+    HeightAboveGround();
+    ~HeightAboveGround();
+
+    void run(Database &db, const std::string &dtmPath, ThreadPool &pool) const;
+    void compute(std::vector<float> &height,
+                 const DatabaseCell &cell,
+                 const Raster &dtm) const;
+
+    static bool isCached(const Database &db, const std::string &dtmPath);
+};
+
+#endif /* HEIGHT_ABOVE_GROUND_HPP */
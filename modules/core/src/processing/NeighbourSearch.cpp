@@ -0,0 +1,245 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file NeighbourSearch.cpp
+*/
+
+#include <Error.hpp>
+#include <NeighbourSearch.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+
+NeighbourSearch::NeighbourSearch() : cell_(nullptr)
+{
+}
+
+NeighbourSearch::~NeighbourSearch()
+{
+}
+
+void NeighbourSearch::create(const DatabaseCell &cell, double cellSize)
+{
+    cell_ = &cell;
+    voxels_.create(cell, cellSize);
+}
+
+double NeighbourSearch::cellSize(const DatabaseCell &cell,
+                                 size_t k,
+                                 double maxDistance)
+{
+    // Mean density of occupied space from a coarse grid
+    VoxelGrid coarse;
+    coarse.create(cell, maxDistance);
+    if (coarse.empty())
+    {
+        return maxDistance;
+    }
+
+    double mean = static_cast<double>(cell.size()) /
+                  static_cast<double>(coarse.size());
+
+    // Voxels with about k points
+    double size = maxDistance * std::cbrt(static_cast<double>(k) / mean);
+
+    return std::min(std::max(size, maxDistance / 16.0), maxDistance);
+}
+
+void NeighbourSearch::gather(std::vector<size_t> &candidates,
+                             size_t voxel,
+                             size_t ring) const
+{
+    int64_t gx;
+    int64_t gy;
+    int64_t gz;
+    voxels_.getCoordinates(gx, gy, gz, voxel);
+
+    const std::vector<size_t> &points = voxels_.getPoints();
+    int64_t r = static_cast<int64_t>(ring);
+
+    // Voxels on the surface of the cube of the given ring
+    for (int64_t z = -r; z <= r; z++)
+    {
+        for (int64_t y = -r; y <= r; y++)
+        {
+            bool inner = std::abs(z) < r && std::abs(y) < r;
+            int64_t step = (inner && r > 0) ? 2 * r : 1;
+
+            for (int64_t x = -r; x <= r; x += step)
+            {
+                size_t v = voxels_.find(gx + x, gy + y, gz + z);
+                if (v == voxels_.size())
+                {
+                    continue;
+                }
+
+                const VoxelGrid::Voxel &found = voxels_[v];
+                candidates.insert(candidates.end(),
+                                  points.begin() +
+                                      static_cast<ptrdiff_t>(found.from),
+                                  points.begin() +
+                                      static_cast<ptrdiff_t>(found.from +
+                                                             found.count));
+            }
+        }
+    }
+}
+
+/** Squared distance between two points. */
+static double NeighbourSearch_distance(const double *a, const double *b)
+{
+    double dx = a[0] - b[0];
+    double dy = a[1] - b[1];
+    double dz = a[2] - b[2];
+    return (dx * dx) + (dy * dy) + (dz * dz);
+}
+
+/** Initialize result with points of the voxel. */
+static void NeighbourSearch_points(NeighbourSearch::Result &result,
+                                   const VoxelGrid &voxels,
+                                   size_t voxel)
+{
+    const VoxelGrid::Voxel &v = voxels[voxel];
+    const std::vector<size_t> &points = voxels.getPoints();
+
+    result.points.assign(
+        points.begin() + static_cast<ptrdiff_t>(v.from),
+        points.begin() + static_cast<ptrdiff_t>(v.from + v.count));
+    result.from.assign(1, 0);
+    result.index.clear();
+    result.distance.clear();
+}
+
+void NeighbourSearch::nearest(Result &result,
+                              size_t voxel,
+                              size_t k,
+                              double maxDistance) const
+{
+    NeighbourSearch_points(result, voxels_, voxel);
+
+    const double *xyz = cell_->xyz.data();
+    double size = voxels_.getVoxelSize();
+    double max2 = maxDistance * maxDistance;
+    size_t maxRing = static_cast<size_t>(std::ceil(maxDistance / size));
+
+    // Add rings until all points have k neighbours inside searched cube
+    std::vector<size_t> candidates;
+    gather(candidates, voxel, 0);
+
+    for (size_t ring = 1; ring <= maxRing; ring++)
+    {
+        gather(candidates, voxel, ring);
+
+        if (ring == maxRing)
+        {
+            break;
+        }
+
+        double reach = static_cast<double>(ring) * size;
+        double reach2 = std::min(reach * reach, max2);
+        bool done = true;
+
+        for (size_t j = 0; j < result.points.size() && done; j++)
+        {
+            const double *p = &xyz[3 * result.points[j]];
+            size_t count = 0;
+            for (size_t c = 0; c < candidates.size() && count <= k; c++)
+            {
+                if (NeighbourSearch_distance(p, &xyz[3 * candidates[c]]) <=
+                    reach2)
+                {
+                    count++;
+                }
+            }
+
+            // The point itself is one of the candidates
+            done = count > k;
+        }
+
+        if (done)
+        {
+            break;
+        }
+    }
+
+    // The k nearest candidates of each point sorted by distance
+    std::vector<std::pair<double, size_t>> d;
+    for (size_t j = 0; j < result.points.size(); j++)
+    {
+        size_t self = result.points[j];
+        const double *p = &xyz[3 * self];
+
+        d.clear();
+        for (size_t c = 0; c < candidates.size(); c++)
+        {
+            double d2 = NeighbourSearch_distance(p, &xyz[3 * candidates[c]]);
+            if (candidates[c] != self && d2 <= max2)
+            {
+                d.emplace_back(d2, candidates[c]);
+            }
+        }
+
+        size_t n = std::min(k, d.size());
+        std::partial_sort(d.begin(),
+                          d.begin() + static_cast<ptrdiff_t>(n),
+                          d.end());
+
+        for (size_t c = 0; c < n; c++)
+        {
+            result.index.push_back(d[c].second);
+            result.distance.push_back(std::sqrt(d[c].first));
+        }
+        result.from.push_back(result.index.size());
+    }
+}
+
+void NeighbourSearch::radius(Result &result, size_t voxel, double r) const
+{
+    NeighbourSearch_points(result, voxels_, voxel);
+
+    const double *xyz = cell_->xyz.data();
+    double r2 = r * r;
+    size_t maxRing =
+        static_cast<size_t>(std::ceil(r / voxels_.getVoxelSize()));
+
+    std::vector<size_t> candidates;
+    for (size_t ring = 0; ring <= maxRing; ring++)
+    {
+        gather(candidates, voxel, ring);
+    }
+
+    for (size_t j = 0; j < result.points.size(); j++)
+    {
+        size_t self = result.points[j];
+        const double *p = &xyz[3 * self];
+
+        for (size_t c = 0; c < candidates.size(); c++)
+        {
+            double d2 = NeighbourSearch_distance(p, &xyz[3 * candidates[c]]);
+            if (candidates[c] != self && d2 <= r2)
+            {
+                result.index.push_back(candidates[c]);
+                result.distance.push_back(std::sqrt(d2));
+            }
+        }
+        result.from.push_back(result.index.size());
+    }
+}
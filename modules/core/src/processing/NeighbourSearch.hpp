@@ -0,0 +1,82 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file NeighbourSearch.hpp
+*/
+
+#ifndef NEIGHBOUR_SEARCH_HPP
+#define NEIGHBOUR_SEARCH_HPP
+
+#include <DatabaseCell.hpp>
+#include <VoxelGrid.hpp>
+#include <cstddef>
+#include <vector>
+
+/** Neighbour Search.
+
+    Finds neighbours of points in a voxel grid. Queries are batched by
+    voxels: candidates are gathered once from rings of voxels around each
+    voxel and shared by all of its points. Nearest neighbour search adds
+    rings until every point has enough neighbours closer than the searched
+    distance, so results are exact up to the maximum distance. Results do
+    not depend on the voxel size, which only affects speed.
+*/
+class NeighbourSearch
+{
+public:
+    /** Neighbours of points of one voxel. */
+    struct Result
+    {
+        /** Points of the voxel. */
+        std::vector<size_t> points;
+
+        /** Neighbours of point j are in [from[j], from[j + 1]). */
+        std::vector<size_t> from;
+        std::vector<size_t> index;
+        std::vector<double> distance;
+    };
+
+    NeighbourSearch();
+    ~NeighbourSearch();
+
+    void create(const DatabaseCell &cell, double cellSize);
+
+    const VoxelGrid &getVoxels() const { return voxels_; }
+
+    void nearest(Result &result,
+                 size_t voxel,
+                 size_t k,
+                 double maxDistance) const;
+    void radius(Result &result, size_t voxel, double r) const;
+
+    static double cellSize(const DatabaseCell &cell,
+                           size_t k,
+                           double maxDistance);
+
+protected:
+    const DatabaseCell *cell_;
+    VoxelGrid voxels_;
+
+    void gather(std::vector<size_t> &candidates,
+                size_t voxel,
+                size_t ring) const;
+};
+
+#endif /* NEIGHBOUR_SEARCH_HPP */
@@ -0,0 +1,310 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file NormalEstimation.cpp
+*/
+
+#include <ColumnWriter.hpp>
+#include <EigenBatch.hpp>
+#include <Endian.hpp>
+#include <Error.hpp>
+#include <GroundFilter.hpp>
+#include <NeighbourSearch.hpp>
+#include <NormalEstimation.hpp>
+#include <TileGrid.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+/** Number of covariance matrices solved at once. */
+static const size_t NORMAL_ESTIMATION_BATCH_SIZE = 256;
+
+/** Minimum number of neighbours for a plane. */
+static const size_t NORMAL_ESTIMATION_MIN_NEIGHBOURS = 2;
+
+NormalEstimation::NormalEstimation()
+    : neighbours(16),
+      maxDistance(0.5),
+      radius(0),
+      tileSize(50.0)
+{
+}
+
+NormalEstimation::~NormalEstimation()
+{
+}
+
+void NormalEstimation::run(Database &db, ThreadPool &pool) const
+{
+    if (!(radius > 0) && (neighbours == 0 || !(maxDistance > 0)))
+    {
+        THROW("Invalid normal estimation parameters");
+    }
+
+    TileGrid grid;
+    grid.create(db, tileSize, (radius > 0) ? radius : maxDistance);
+
+    ColumnWriter column;
+    column.create(db, Database::CHUNK_ID_NORMAL, Database::NORMAL_SIZE);
+
+    pool.run(grid.size(), [&](size_t i) {
+        DatabaseCell cell;
+        std::vector<size_t> own;
+        grid.read(cell, own, i);
+
+        std::vector<int16_t> normal;
+        std::vector<uint8_t> features;
+        compute(normal, features, cell, own);
+
+        // Little endian records of points indexed by cell point
+        std::vector<uint8_t> values(cell.size() * Database::NORMAL_SIZE);
+        for (size_t k = 0; k < own.size(); k++)
+        {
+            uint8_t *value = &values[own[k] * Database::NORMAL_SIZE];
+            for (size_t c = 0; c < 3; c++)
+            {
+                htol16(value + (2 * c),
+                       static_cast<uint16_t>(normal[(3 * k) + c]));
+            }
+            value[6] = features[2 * k];
+            value[7] = features[(2 * k) + 1];
+        }
+
+        column.write(cell, own, values.data());
+    });
+
+    column.close();
+
+    // Reopen with the new column
+    db.open(db.path());
+}
+
+/** Covariance matrices of a batch of points and their results. */
+struct NormalEstimationBatch
+{
+    std::vector<float> a[6];
+    std::vector<float> values[3];
+    std::vector<float> vectors[9];
+    std::vector<size_t> slot;
+
+    NormalEstimationBatch();
+    void flush(std::vector<int16_t> &normal, std::vector<uint8_t> &features);
+};
+
+NormalEstimationBatch::NormalEstimationBatch()
+{
+    for (size_t k = 0; k < 3; k++)
+    {
+        values[k].resize(NORMAL_ESTIMATION_BATCH_SIZE);
+    }
+
+    for (size_t k = 0; k < 9; k++)
+    {
+        vectors[k].resize(NORMAL_ESTIMATION_BATCH_SIZE);
+    }
+}
+
+/** Quantize a value in [0, 1] to 8 bits. */
+static uint8_t NormalEstimation_quantize(float v)
+{
+    return static_cast<uint8_t>(
+        std::lround(std::min(std::max(v, 0.0F), 1.0F) * 255.0F));
+}
+
+void NormalEstimationBatch::flush(std::vector<int16_t> &normal,
+                                  std::vector<uint8_t> &features)
+{
+    size_t n = slot.size();
+    if (n == 0)
+    {
+        return;
+    }
+
+    float *pv[3] = {values[0].data(), values[1].data(), values[2].data()};
+    float *pe[9];
+    for (size_t k = 0; k < 9; k++)
+    {
+        pe[k] = vectors[k].data();
+    }
+    const float *pa[6];
+    for (size_t k = 0; k < 6; k++)
+    {
+        pa[k] = a[k].data();
+    }
+
+    eigenSymmetric3(pv, pe, pa, n);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        float l1 = std::max(values[0][i], 0.0F);
+        float l2 = std::max(values[1][i], 0.0F);
+        float l3 = std::max(values[2][i], 0.0F);
+        if (!(l1 > 0))
+        {
+            continue;
+        }
+
+        // Normal from the smallest eigenvalue pointing up
+        float sign = (vectors[8][i] < 0) ? -1.0F : 1.0F;
+        for (size_t c = 0; c < 3; c++)
+        {
+            float v = sign * vectors[6 + c][i] * 32767.0F;
+            normal[(3 * slot[i]) + c] = static_cast<int16_t>(std::lround(v));
+        }
+
+        features[2 * slot[i]] = NormalEstimation_quantize((l1 - l2) / l1);
+        features[(2 * slot[i]) + 1] =
+            NormalEstimation_quantize((l2 - l3) / l1);
+    }
+
+    for (size_t k = 0; k < 6; k++)
+    {
+        a[k].clear();
+    }
+    slot.clear();
+}
+
+void NormalEstimation::compute(std::vector<int16_t> &normal,
+                               std::vector<uint8_t> &features,
+                               const DatabaseCell &cell,
+                               const std::vector<size_t> &points) const
+{
+    normal.assign(3 * points.size(), 0);
+    features.assign(2 * points.size(), 0);
+
+    const size_t none = std::numeric_limits<size_t>::max();
+    std::vector<size_t> slot(cell.size(), none);
+    for (size_t k = 0; k < points.size(); k++)
+    {
+        slot[points[k]] = k;
+    }
+
+    // Noise points are not neighbours
+    DatabaseCell search;
+    std::vector<size_t> map;
+    for (size_t k = 0; k < cell.size(); k++)
+    {
+        if (GroundFilter::isNoise(cell.laser[k].classification))
+        {
+            continue;
+        }
+
+        search.xyz.push_back(cell.xyz[3 * k]);
+        search.xyz.push_back(cell.xyz[3 * k + 1]);
+        search.xyz.push_back(cell.xyz[3 * k + 2]);
+        search.laser.push_back(cell.laser[k]);
+        map.push_back(k);
+    }
+
+    double voxelSize = radius;
+    if (!(radius > 0))
+    {
+        voxelSize = NeighbourSearch::cellSize(search, neighbours, maxDistance);
+    }
+
+    NeighbourSearch neighbourSearch;
+    neighbourSearch.create(search, voxelSize);
+    const VoxelGrid &voxels = neighbourSearch.getVoxels();
+    const std::vector<size_t> &sorted = voxels.getPoints();
+    const double *xyz = search.xyz.data();
+
+    NormalEstimationBatch batch;
+    NeighbourSearch::Result result;
+
+    for (size_t v = 0; v < voxels.size(); v++)
+    {
+        // Skip voxels which have only points of the halo
+        bool requested = false;
+        for (size_t k = 0; k < voxels[v].count && !requested; k++)
+        {
+            requested = slot[map[sorted[voxels[v].from + k]]] != none;
+        }
+
+        if (!requested)
+        {
+            continue;
+        }
+
+        if (radius > 0)
+        {
+            neighbourSearch.radius(result, v, radius);
+        }
+        else
+        {
+            neighbourSearch.nearest(result, v, neighbours, maxDistance);
+        }
+
+        for (size_t j = 0; j < result.points.size(); j++)
+        {
+            size_t p = result.points[j];
+            size_t k = slot[map[p]];
+            size_t from = result.from[j];
+            size_t to = result.from[j + 1];
+
+            if (k == none || to - from < NORMAL_ESTIMATION_MIN_NEIGHBOURS)
+            {
+                continue;
+            }
+
+            // Covariance of the point and its neighbours relative to the
+            // point, which keeps precision of large coordinates
+            double sum[3] = {0, 0, 0};
+            double sum2[6] = {0, 0, 0, 0, 0, 0};
+            for (size_t c = from; c < to; c++)
+            {
+                const double *q = &xyz[3 * result.index[c]];
+                double dx = q[0] - xyz[3 * p];
+                double dy = q[1] - xyz[3 * p + 1];
+                double dz = q[2] - xyz[3 * p + 2];
+                sum[0] += dx;
+                sum[1] += dy;
+                sum[2] += dz;
+                sum2[0] += dx * dx;
+                sum2[1] += dx * dy;
+                sum2[2] += dx * dz;
+                sum2[3] += dy * dy;
+                sum2[4] += dy * dz;
+                sum2[5] += dz * dz;
+            }
+
+            double n = static_cast<double>(to - from + 1);
+            double m[3] = {sum[0] / n, sum[1] / n, sum[2] / n};
+            double cov[6] = {(sum2[0] / n) - (m[0] * m[0]),
+                             (sum2[1] / n) - (m[0] * m[1]),
+                             (sum2[2] / n) - (m[0] * m[2]),
+                             (sum2[3] / n) - (m[1] * m[1]),
+                             (sum2[4] / n) - (m[1] * m[2]),
+                             (sum2[5] / n) - (m[2] * m[2])};
+
+            for (size_t c = 0; c < 6; c++)
+            {
+                batch.a[c].push_back(static_cast<float>(cov[c]));
+            }
+            batch.slot.push_back(k);
+
+            if (batch.slot.size() == NORMAL_ESTIMATION_BATCH_SIZE)
+            {
+                batch.flush(normal, features);
+            }
+        }
+    }
+
+    batch.flush(normal, features);
+}
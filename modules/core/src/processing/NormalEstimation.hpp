@@ -0,0 +1,61 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file NormalEstimation.hpp
+*/
+
+#ifndef NORMAL_ESTIMATION_HPP
+#define NORMAL_ESTIMATION_HPP
+
+#include <Database.hpp>
+#include <ThreadPool.hpp>
+#include <vector>
+
+/** Normal Estimation.
+
+    Computes normal, linearity, planarity and sphericity of each point from
+    covariance of its neighbourhood. Neighbourhood is given by the nearest
+    neighbours up to the maximum distance, or by the radius when it is set.
+    Eigenvectors of batches of covariance matrices are computed together.
+    The normal is the eigenvector of the smallest eigenvalue, oriented up.
+
+    Tiles are processed in parallel with a halo of the search distance.
+    Results are written as the normal column of the database, which is
+    then read into DatabaseCell::normal and DatabaseCell::features.
+*/
+class NormalEstimation
+{
+public:
+    size_t neighbours;
+    double maxDistance;
+    double radius;
+    double tileSize;
+
+    NormalEstimation();
+    ~NormalEstimation();
+
+    void run(Database &db, ThreadPool &pool) const;
+    void compute(std::vector<int16_t> &normal,
+                 std::vector<uint8_t> &features,
+                 const DatabaseCell &cell,
+                 const std::vector<size_t> &points) const;
+};
+
+#endif /* NORMAL_ESTIMATION_HPP */
@@ -0,0 +1,242 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file OutlierFilter.cpp
+*/
+
+#include <ColumnWriter.hpp>
+#include <Error.hpp>
+#include <GroundFilter.hpp>
+#include <NeighbourSearch.hpp>
+#include <OutlierFilter.hpp>
+#include <TileGrid.hpp>
+#include <cmath>
+#include <limits>
+
+OutlierFilter::OutlierFilter()
+    : method(METHOD_STATISTICAL),
+      neighbours(16),
+      deviation(2.0),
+      maxDistance(1.0),
+      radius(0.1),
+      minNeighbours(4),
+      tileSize(50.0)
+{
+}
+
+OutlierFilter::~OutlierFilter()
+{
+}
+
+void OutlierFilter::run(Database &db, ThreadPool &pool) const
+{
+    bool statistical = method == METHOD_STATISTICAL;
+
+    if (statistical ? (neighbours == 0 || !(maxDistance > 0))
+                    : !(radius > 0))
+    {
+        THROW("Invalid outlier filter parameters");
+    }
+
+    TileGrid grid;
+    grid.create(db, tileSize, statistical ? maxDistance : radius);
+
+    // Distribution of mean distances from sums of tiles
+    double threshold = 0;
+    if (statistical)
+    {
+        std::vector<double> sum(grid.size(), 0);
+        std::vector<double> sum2(grid.size(), 0);
+        std::vector<size_t> count(grid.size(), 0);
+
+        pool.run(grid.size(), [&](size_t i) {
+            DatabaseCell cell;
+            std::vector<size_t> own;
+            grid.read(cell, own, i);
+
+            std::vector<double> value;
+            compute(value, cell, own);
+
+            for (size_t k = 0; k < value.size(); k++)
+            {
+                if (!std::isnan(value[k]))
+                {
+                    sum[i] += value[k];
+                    sum2[i] += value[k] * value[k];
+                    count[i]++;
+                }
+            }
+        });
+
+        double s = 0;
+        double s2 = 0;
+        size_t n = 0;
+        for (size_t i = 0; i < grid.size(); i++)
+        {
+            s += sum[i];
+            s2 += sum2[i];
+            n += count[i];
+        }
+
+        if (n > 0)
+        {
+            double mean = s / static_cast<double>(n);
+            double var = std::max((s2 / static_cast<double>(n)) -
+                                      (mean * mean),
+                                  0.0);
+            threshold = mean + (deviation * std::sqrt(var));
+        }
+    }
+
+    ColumnWriter column;
+    column.create(db, Database::CHUNK_ID_CLASSIFICATION, sizeof(uint8_t));
+
+    pool.run(grid.size(), [&](size_t i) {
+        DatabaseCell cell;
+        std::vector<size_t> own;
+        grid.read(cell, own, i);
+
+        std::vector<double> value;
+        compute(value, cell, own);
+
+        std::vector<uint8_t> values(cell.size());
+        for (size_t k = 0; k < cell.size(); k++)
+        {
+            values[k] = cell.laser[k].classification;
+        }
+
+        for (size_t k = 0; k < own.size(); k++)
+        {
+            if (std::isnan(value[k]))
+            {
+                continue;
+            }
+
+            bool outlier =
+                statistical ? value[k] > threshold
+                            : value[k] < static_cast<double>(minNeighbours);
+            if (outlier)
+            {
+                values[own[k]] = GroundFilter::CLASS_LOW_NOISE;
+            }
+        }
+
+        column.write(cell, own, values);
+    });
+
+    column.close();
+
+    // Reopen with the new column
+    db.open(db.path());
+}
+
+void OutlierFilter::compute(std::vector<double> &value,
+                            const DatabaseCell &cell,
+                            const std::vector<size_t> &points) const
+{
+    value.assign(points.size(), std::numeric_limits<double>::quiet_NaN());
+
+    const size_t none = std::numeric_limits<size_t>::max();
+    std::vector<size_t> slot(cell.size(), none);
+    for (size_t k = 0; k < points.size(); k++)
+    {
+        slot[points[k]] = k;
+    }
+
+    // Noise points are not neighbours
+    DatabaseCell search;
+    std::vector<size_t> map;
+    for (size_t k = 0; k < cell.size(); k++)
+    {
+        if (GroundFilter::isNoise(cell.laser[k].classification))
+        {
+            continue;
+        }
+
+        search.xyz.push_back(cell.xyz[3 * k]);
+        search.xyz.push_back(cell.xyz[3 * k + 1]);
+        search.xyz.push_back(cell.xyz[3 * k + 2]);
+        search.laser.push_back(cell.laser[k]);
+        map.push_back(k);
+    }
+
+    // Voxels are sized for the number of neighbours or for the radius
+    double voxelSize = radius;
+    if (method == METHOD_STATISTICAL)
+    {
+        voxelSize = NeighbourSearch::cellSize(search, neighbours, maxDistance);
+    }
+
+    NeighbourSearch neighbourSearch;
+    neighbourSearch.create(search, voxelSize);
+    const VoxelGrid &voxels = neighbourSearch.getVoxels();
+    const std::vector<size_t> &sorted = voxels.getPoints();
+
+    NeighbourSearch::Result result;
+    for (size_t v = 0; v < voxels.size(); v++)
+    {
+        // Skip voxels which have only points of the halo
+        bool requested = false;
+        for (size_t k = 0; k < voxels[v].count && !requested; k++)
+        {
+            requested = slot[map[sorted[voxels[v].from + k]]] != none;
+        }
+
+        if (!requested)
+        {
+            continue;
+        }
+
+        if (method == METHOD_STATISTICAL)
+        {
+            neighbourSearch.nearest(result, v, neighbours, maxDistance);
+        }
+        else
+        {
+            neighbourSearch.radius(result, v, radius);
+        }
+
+        for (size_t j = 0; j < result.points.size(); j++)
+        {
+            size_t k = slot[map[result.points[j]]];
+            if (k == none)
+            {
+                continue;
+            }
+
+            size_t n = result.from[j + 1] - result.from[j];
+
+            if (method == METHOD_STATISTICAL)
+            {
+                // Missing neighbours are at the maximum distance
+                double sum = static_cast<double>(neighbours - n) * maxDistance;
+                for (size_t c = result.from[j]; c < result.from[j + 1]; c++)
+                {
+                    sum += result.distance[c];
+                }
+                value[k] = sum / static_cast<double>(neighbours);
+            }
+            else
+            {
+                value[k] = static_cast<double>(n);
+            }
+        }
+    }
+}
@@ -0,0 +1,72 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file OutlierFilter.hpp
+*/
+
+#ifndef OUTLIER_FILTER_HPP
+#define OUTLIER_FILTER_HPP
+
+#include <Database.hpp>
+#include <ThreadPool.hpp>
+#include <vector>
+
+/** Outlier Filter.
+
+    Classifies isolated points as low noise. Statistical filter computes
+    mean distance of each point to its nearest neighbours, points further
+    than the global mean plus a multiple of the standard deviation are
+    noise. Neighbours beyond the maximum distance count as being at the
+    maximum distance. Radius filter marks points with too few neighbours
+    within the radius.
+
+    Tiles are processed in parallel with a halo of the search distance.
+    Statistical filter computes the global distribution in the first pass
+    and classifies points in the second pass, so only one tile per thread
+    is in memory. Points which are already noise are ignored. The result
+    is written as the classification column of the database.
+*/
+class OutlierFilter
+{
+public:
+    enum Method
+    {
+        METHOD_STATISTICAL,
+        METHOD_RADIUS
+    };
+
+    Method method;
+    size_t neighbours;
+    double deviation;
+    double maxDistance;
+    double radius;
+    size_t minNeighbours;
+    double tileSize;
+
+    OutlierFilter();
+    ~OutlierFilter();
+
+    void run(Database &db, ThreadPool &pool) const;
+    void compute(std::vector<double> &value,
+                 const DatabaseCell &cell,
+                 const std::vector<size_t> &points) const;
+};
+
+#endif /* OUTLIER_FILTER_HPP */
@@ -0,0 +1,262 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file Raster.cpp
+*/
+
+#include <Raster.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+Raster::Raster() : x_(0), y_(0), nx_(0), ny_(0), cellSize_(1.0)
+{
+}
+
+Raster::~Raster()
+{
+}
+
+void Raster::create(int64_t x,
+                    int64_t y,
+                    size_t nx,
+                    size_t ny,
+                    double cellSize)
+{
+    x_ = x;
+    y_ = y;
+    nx_ = nx;
+    ny_ = ny;
+    cellSize_ = cellSize;
+    data_.assign(nx * ny, std::numeric_limits<float>::quiet_NaN());
+}
+
+void Raster::clear()
+{
+    x_ = y_ = 0;
+    nx_ = ny_ = 0;
+    data_.clear();
+}
+
+int64_t Raster::cell(double v) const
+{
+    return static_cast<int64_t>(std::floor(v / cellSize_));
+}
+
+bool Raster::index(size_t &ix, size_t &iy, double x, double y) const
+{
+    int64_t gx = cell(x) - x_;
+    int64_t gy = cell(y) - y_;
+
+    if (gx < 0 || gy < 0 || gx >= static_cast<int64_t>(nx_) ||
+        gy >= static_cast<int64_t>(ny_))
+    {
+        return false;
+    }
+
+    ix = static_cast<size_t>(gx);
+    iy = static_cast<size_t>(gy);
+
+    return true;
+}
+
+float Raster::value(double x, double y) const
+{
+    size_t ix;
+    size_t iy;
+
+    if (!index(ix, iy, x, y))
+    {
+        return std::numeric_limits<float>::quiet_NaN();
+    }
+
+    return at(ix, iy);
+}
+
+float Raster::interpolate(double x, double y) const
+{
+    // Bilinear interpolation between centers of the nearest 4 cells
+    double fx = (x / cellSize_) - 0.5 - static_cast<double>(x_);
+    double fy = (y / cellSize_) - 0.5 - static_cast<double>(y_);
+    double x0 = std::floor(fx);
+    double y0 = std::floor(fy);
+    double tx = fx - x0;
+    double ty = fy - y0;
+
+    double sum = 0;
+    double sumWeight = 0;
+    for (size_t k = 0; k < 4; k++)
+    {
+        double cx = x0 + static_cast<double>(k & 1U);
+        double cy = y0 + static_cast<double>(k >> 1);
+
+        if (cx < 0 || cy < 0 || cx >= static_cast<double>(nx_) ||
+            cy >= static_cast<double>(ny_))
+        {
+            continue;
+        }
+
+        float v = at(static_cast<size_t>(cx), static_cast<size_t>(cy));
+        if (std::isnan(v))
+        {
+            continue;
+        }
+
+        double w = ((k & 1U) ? tx : 1.0 - tx) * ((k >> 1) ? ty : 1.0 - ty);
+        sum += w * static_cast<double>(v);
+        sumWeight += w;
+    }
+
+    // Missing cells are left out and the rest is renormalized
+    if (!(sumWeight > 0))
+    {
+        return value(x, y);
+    }
+
+    return static_cast<float>(sum / sumWeight);
+}
+
+void Raster::interpolate(float *out,
+                         const double *x,
+                         const double *y,
+                         size_t n) const
+{
+    if (data_.empty())
+    {
+        std::fill(out, out + n, std::numeric_limits<float>::quiet_NaN());
+        return;
+    }
+
+    const double scale = 1.0 / cellSize_;
+    const double ox = static_cast<double>(x_) + 0.5;
+    const double oy = static_cast<double>(y_) + 0.5;
+    const double mx = static_cast<double>(nx_ - 1);
+    const double my = static_cast<double>(ny_ - 1);
+    const float *d = data_.data();
+
+    // Without branches, positions outside of cell centers are clamped
+    for (size_t i = 0; i < n; i++)
+    {
+        double fx = std::min(std::max((x[i] * scale) - ox, 0.0), mx);
+        double fy = std::min(std::max((y[i] * scale) - oy, 0.0), my);
+        size_t x0 = static_cast<size_t>(fx);
+        size_t y0 = static_cast<size_t>(fy);
+        size_t x1 = std::min(x0 + 1, nx_ - 1);
+        size_t y1 = std::min(y0 + 1, ny_ - 1);
+        double tx = fx - static_cast<double>(x0);
+        double ty = fy - static_cast<double>(y0);
+
+        const float *r0 = d + (y0 * nx_);
+        const float *r1 = d + (y1 * nx_);
+        double v0 = ((1.0 - tx) * r0[x0]) + (tx * r0[x1]);
+        double v1 = ((1.0 - tx) * r1[x0]) + (tx * r1[x1]);
+        out[i] = static_cast<float>(((1.0 - ty) * v0) + (ty * v1));
+    }
+
+    // Missing cells are handled one by one
+    for (size_t i = 0; i < n; i++)
+    {
+        if (std::isnan(out[i]))
+        {
+            out[i] = interpolate(x[i], y[i]);
+        }
+    }
+}
+
+void Raster::copy(const Raster &src)
+{
+    int64_t x1 = std::max(x_, src.x_);
+    int64_t y1 = std::max(y_, src.y_);
+    int64_t x2 = std::min(x_ + static_cast<int64_t>(nx_),
+                          src.x_ + static_cast<int64_t>(src.nx_));
+    int64_t y2 = std::min(y_ + static_cast<int64_t>(ny_),
+                          src.y_ + static_cast<int64_t>(src.ny_));
+
+    for (int64_t gy = y1; gy < y2; gy++)
+    {
+        for (int64_t gx = x1; gx < x2; gx++)
+        {
+            at(static_cast<size_t>(gx - x_), static_cast<size_t>(gy - y_)) =
+                src.at(static_cast<size_t>(gx - src.x_),
+                       static_cast<size_t>(gy - src.y_));
+        }
+    }
+}
+
+void Raster::fill(size_t radius)
+{
+    const std::vector<float> src = data_;
+    const int64_t nx = static_cast<int64_t>(nx_);
+    const int64_t ny = static_cast<int64_t>(ny_);
+    const int64_t r = static_cast<int64_t>(radius);
+
+    // Inverse distance weighting of the nearest ring with values
+    for (int64_t iy = 0; iy < ny; iy++)
+    {
+        for (int64_t ix = 0; ix < nx; ix++)
+        {
+            if (!std::isnan(src[static_cast<size_t>((iy * nx) + ix)]))
+            {
+                continue;
+            }
+
+            double sum = 0;
+            double sumWeight = 0;
+            for (int64_t d = 1; d <= r && !(sumWeight > 0); d++)
+            {
+                for (int64_t y = iy - d; y <= iy + d; y++)
+                {
+                    if (y < 0 || y >= ny)
+                    {
+                        continue;
+                    }
+
+                    // Only cells on the ring at distance d
+                    int64_t step = (y == iy - d || y == iy + d) ? 1 : 2 * d;
+                    for (int64_t x = ix - d; x <= ix + d; x += step)
+                    {
+                        if (x < 0 || x >= nx)
+                        {
+                            continue;
+                        }
+
+                        float v = src[static_cast<size_t>((y * nx) + x)];
+                        if (std::isnan(v))
+                        {
+                            continue;
+                        }
+
+                        double dx = static_cast<double>(x - ix);
+                        double dy = static_cast<double>(y - iy);
+                        double w = 1.0 / ((dx * dx) + (dy * dy));
+                        sum += w * static_cast<double>(v);
+                        sumWeight += w;
+                    }
+                }
+            }
+
+            if (sumWeight > 0)
+            {
+                data_[static_cast<size_t>((iy * nx) + ix)] =
+                    static_cast<float>(sum / sumWeight);
+            }
+        }
+    }
+}
@@ -0,0 +1,86 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file Raster.hpp
+*/
+
+#ifndef RASTER_HPP
+#define RASTER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/** Raster.
+
+    Rectangular grid of float values in x and y. Cells are aligned to
+    multiples of the cell size, cell (gx, gy) covers [gx * cellSize,
+    (gx + 1) * cellSize) in x and the same in y. The raster stores cells
+    from (x, y) to (x + nx - 1, y + ny - 1). Missing values are NaN.
+*/
+class Raster
+{
+public:
+    Raster();
+    ~Raster();
+
+    void create(int64_t x, int64_t y, size_t nx, size_t ny, double cellSize);
+    void clear();
+
+    int64_t getX() const { return x_; }
+    int64_t getY() const { return y_; }
+    size_t getSizeX() const { return nx_; }
+    size_t getSizeY() const { return ny_; }
+    double getCellSize() const { return cellSize_; }
+    size_t size() const { return data_.size(); }
+    bool empty() const { return data_.empty(); }
+
+    std::vector<float> &data() { return data_; }
+    const std::vector<float> &data() const { return data_; }
+
+    float &at(size_t ix, size_t iy) { return data_[(iy * nx_) + ix]; }
+    const float &at(size_t ix, size_t iy) const
+    {
+        return data_[(iy * nx_) + ix];
+    }
+
+    int64_t cell(double v) const;
+    bool index(size_t &ix, size_t &iy, double x, double y) const;
+
+    float value(double x, double y) const;
+    float interpolate(double x, double y) const;
+    void interpolate(float *out,
+                     const double *x,
+                     const double *y,
+                     size_t n) const;
+
+    void copy(const Raster &src);
+    void fill(size_t radius);
+
+protected:
+    int64_t x_;
+    int64_t y_;
+    size_t nx_;
+    size_t ny_;
+    double cellSize_;
+    std::vector<float> data_;
+};
+
+#endif /* RASTER_HPP */
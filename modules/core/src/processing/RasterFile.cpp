@@ -0,0 +1,285 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file RasterFile.cpp
+*/
+
+#include <Crc32.hpp>
+#include <Endian.hpp>
+#include <Error.hpp>
+#include <RasterFile.hpp>
+#include <algorithm>
+#include <cmath>
+
+const uint32_t RasterFile::CHUNK_ID_METADATA = 0x524D4554U;
+const uint32_t RasterFile::CHUNK_ID_TILE = 0x5254494CU;
+
+RasterFile::RasterFile()
+    : create_(false),
+      cellSize_(1.0),
+      x_(0),
+      y_(0),
+      nx_(0),
+      ny_(0),
+      tileSize_(0),
+      ntx_(0),
+      nty_(0),
+      fingerprint_(0)
+{
+}
+
+RasterFile::~RasterFile()
+{
+}
+
+void RasterFile::create(const std::string &path,
+                        const Aabbd &boundary,
+                        double cellSize,
+                        size_t tileSize)
+{
+    if (!(cellSize > 0) || tileSize == 0)
+    {
+        THROW("Invalid raster cell size or tile size");
+    }
+
+    cellSize_ = cellSize;
+    tileSize_ = tileSize;
+    x_ = static_cast<int64_t>(std::floor(boundary.min(0) / cellSize_));
+    y_ = static_cast<int64_t>(std::floor(boundary.min(1) / cellSize_));
+    nx_ = static_cast<size_t>(
+        static_cast<int64_t>(std::floor(boundary.max(0) / cellSize_)) - x_ +
+        1);
+    ny_ = static_cast<size_t>(
+        static_cast<int64_t>(std::floor(boundary.max(1) / cellSize_)) - y_ +
+        1);
+    ntx_ = (nx_ + tileSize_ - 1) / tileSize_;
+    nty_ = (ny_ + tileSize_ - 1) / tileSize_;
+    tiles_.assign(ntx_ * nty_, -1);
+    fingerprint_ = 0;
+
+    file_.open(path, "w");
+    create_ = true;
+}
+
+void RasterFile::open(const std::string &path)
+{
+    file_.open(path, "r");
+    create_ = false;
+
+    size_t id = file_.findEntry(CHUNK_ID_METADATA);
+    if (id == file_.getEntrySize())
+    {
+        THROW("Missing raster metadata in file '" + path + "'");
+    }
+
+    file_.readJson(id, metadata);
+
+    cellSize_ = metadata["cell_size"].number();
+    x_ = static_cast<int64_t>(metadata["x"].number());
+    y_ = static_cast<int64_t>(metadata["y"].number());
+    nx_ = static_cast<size_t>(metadata["nx"].uint64());
+    ny_ = static_cast<size_t>(metadata["ny"].uint64());
+    tileSize_ = static_cast<size_t>(metadata["tile_size"].uint64());
+    if (!(cellSize_ > 0) || tileSize_ == 0)
+    {
+        THROW("Invalid raster metadata in file '" + path + "'");
+    }
+
+    ntx_ = (nx_ + tileSize_ - 1) / tileSize_;
+    nty_ = (ny_ + tileSize_ - 1) / tileSize_;
+    const Json &tiles = metadata["tiles"];
+    if (tiles.size() != ntx_ * nty_)
+    {
+        THROW("Invalid raster tiles in file '" + path + "'");
+    }
+
+    tiles_.resize(tiles.size());
+    for (size_t i = 0; i < tiles_.size(); i++)
+    {
+        tiles_[i] = static_cast<int64_t>(tiles[i].number());
+        if (tiles_[i] >= static_cast<int64_t>(file_.getEntrySize()))
+        {
+            THROW("Invalid raster tiles in file '" + path + "'");
+        }
+    }
+
+    // Tile checksums are read from chunk headers without tile data
+    std::vector<uint8_t> cbor = metadata.serializeCbor();
+    fingerprint_ = crc32c(0, cbor.data(), cbor.size());
+    for (size_t i = 0; i < tiles_.size(); i++)
+    {
+        if (tiles_[i] >= 0)
+        {
+            ChunkFile::Chunk c;
+            uint8_t checksum[4];
+            file_.read(static_cast<size_t>(tiles_[i]), c);
+            htol32(checksum, c.checksum);
+            fingerprint_ = crc32c(fingerprint_, checksum, sizeof(checksum));
+        }
+    }
+}
+
+void RasterFile::close()
+{
+    if (create_)
+    {
+        metadata["cell_size"] = cellSize_;
+        metadata["x"] = static_cast<double>(x_);
+        metadata["y"] = static_cast<double>(y_);
+        metadata["nx"] = static_cast<uint64_t>(nx_);
+        metadata["ny"] = static_cast<uint64_t>(ny_);
+        metadata["tile_size"] = static_cast<uint64_t>(tileSize_);
+        for (size_t i = 0; i < tiles_.size(); i++)
+        {
+            metadata["tiles"][i] = static_cast<double>(tiles_[i]);
+        }
+
+        file_.writeJson(CHUNK_ID_METADATA, metadata);
+        file_.writeDirectory();
+        create_ = false;
+    }
+
+    file_.close();
+}
+
+void RasterFile::getTile(Raster &tile, size_t i) const
+{
+    size_t tx = (i % ntx_) * tileSize_;
+    size_t ty = (i / ntx_) * tileSize_;
+
+    tile.create(x_ + static_cast<int64_t>(tx),
+                y_ + static_cast<int64_t>(ty),
+                std::min(tileSize_, nx_ - tx),
+                std::min(tileSize_, ny_ - ty),
+                cellSize_);
+}
+
+void RasterFile::getTile(Aabbd &box, size_t i) const
+{
+    Raster tile;
+    getTile(tile, i);
+
+    double x1 = static_cast<double>(tile.getX()) * cellSize_;
+    double y1 = static_cast<double>(tile.getY()) * cellSize_;
+
+    box.set(x1,
+            y1,
+            0,
+            x1 + (static_cast<double>(tile.getSizeX()) * cellSize_),
+            y1 + (static_cast<double>(tile.getSizeY()) * cellSize_),
+            0);
+}
+
+void RasterFile::write(const Raster &tile, size_t i)
+{
+    const std::vector<float> &data = tile.data();
+
+    // Tiles without values are not stored
+    bool empty = std::all_of(data.begin(), data.end(), [](float v) {
+        return std::isnan(v);
+    });
+    if (empty)
+    {
+        return;
+    }
+
+    std::vector<uint8_t> buffer(data.size() * sizeof(float));
+    for (size_t k = 0; k < data.size(); k++)
+    {
+        htolf(&buffer[k * sizeof(float)], data[k]);
+    }
+
+    ChunkFile::Chunk c;
+    c.type = CHUNK_ID_TILE;
+    c.major_version = 1;
+    c.minor_version = 0;
+    c.codec = Compression::CODEC_LZ4;
+    c.flags = ChunkFile::CHUNK_FLAG_CHECKSUM;
+    c.stride = sizeof(float);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    tiles_[i] = static_cast<int64_t>(file_.getEntrySize());
+    file_.write(c, buffer.data(), buffer.size());
+}
+
+void RasterFile::read(Raster &tile, size_t i) const
+{
+    getTile(tile, i);
+
+    if (tiles_[i] < 0)
+    {
+        return;
+    }
+
+    ChunkFile::Chunk c;
+    std::vector<uint8_t> buffer;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        file_.read(static_cast<size_t>(tiles_[i]), c, buffer);
+    }
+
+    std::vector<float> &data = tile.data();
+    if (buffer.size() != data.size() * sizeof(float))
+    {
+        THROW("Invalid raster tile size in file '" + file_.path() + "'");
+    }
+    for (size_t k = 0; k < data.size(); k++)
+    {
+        data[k] = ltohf(&buffer[k * sizeof(float)]);
+    }
+}
+
+void RasterFile::read(Raster &out, const Aabbd &window) const
+{
+    int64_t x1 = static_cast<int64_t>(std::floor(window.min(0) / cellSize_));
+    int64_t y1 = static_cast<int64_t>(std::floor(window.min(1) / cellSize_));
+    int64_t x2 = static_cast<int64_t>(std::floor(window.max(0) / cellSize_));
+    int64_t y2 = static_cast<int64_t>(std::floor(window.max(1) / cellSize_));
+
+    out.create(x1,
+               y1,
+               static_cast<size_t>(x2 - x1 + 1),
+               static_cast<size_t>(y2 - y1 + 1),
+               cellSize_);
+
+    // Tiles which overlap the window
+    int64_t t = static_cast<int64_t>(tileSize_);
+    int64_t tx1 = std::max(x1 - x_, int64_t(0)) / t;
+    int64_t ty1 = std::max(y1 - y_, int64_t(0)) / t;
+    int64_t tx2 = std::min(x2 - x_, static_cast<int64_t>(nx_) - 1);
+    int64_t ty2 = std::min(y2 - y_, static_cast<int64_t>(ny_) - 1);
+    if (tx2 < 0 || ty2 < 0)
+    {
+        return;
+    }
+    tx2 /= t;
+    ty2 /= t;
+
+    Raster tile;
+    for (int64_t ty = ty1; ty <= ty2; ty++)
+    {
+        for (int64_t tx = tx1; tx <= tx2; tx++)
+        {
+            int64_t i = (ty * static_cast<int64_t>(ntx_)) + tx;
+            read(tile, static_cast<size_t>(i));
+            out.copy(tile);
+        }
+    }
+}
@@ -0,0 +1,97 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file RasterFile.hpp
+*/
+
+#ifndef RASTER_FILE_HPP
+#define RASTER_FILE_HPP
+
+#include <Aabb.hpp>
+#include <ChunkFile.hpp>
+#include <Json.hpp>
+#include <Raster.hpp>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/** Raster File.
+
+    Chunk file with a large raster divided into square tiles. Each tile is
+    stored as one LZ4 compressed chunk of float values ('RTIL' chunk) and
+    tiles without any value are not stored. Raster metadata ('RMET' chunk)
+    follow the tiles. Tiles can be written from many threads in any order,
+    so only one tile of each thread has to be in memory.
+
+    Metadata contain the cell size, the first cell and the number of cells
+    in x and y, the tile size in cells and directory entries of all tiles.
+    Other values stored in 'metadata' by the caller are kept.
+
+    The fingerprint of an opened raster combines its metadata and the
+    checksums of all tiles, so results computed from the raster can tell
+    whether it was changed.
+*/
+class RasterFile
+{
+public:
+    static const uint32_t CHUNK_ID_METADATA;
+    static const uint32_t CHUNK_ID_TILE;
+
+    Json metadata;
+
+    RasterFile();
+    ~RasterFile();
+
+    void create(const std::string &path,
+                const Aabbd &boundary,
+                double cellSize,
+                size_t tileSize);
+    void open(const std::string &path);
+    void close();
+
+    size_t size() const { return tiles_.size(); }
+    double getCellSize() const { return cellSize_; }
+    size_t getTileSize() const { return tileSize_; }
+    uint32_t getFingerprint() const { return fingerprint_; }
+
+    void getTile(Raster &tile, size_t i) const;
+    void getTile(Aabbd &box, size_t i) const;
+
+    void read(Raster &tile, size_t i) const;
+    void read(Raster &out, const Aabbd &window) const;
+    void write(const Raster &tile, size_t i);
+
+protected:
+    mutable ChunkFile file_;
+    mutable std::mutex mutex_;
+    bool create_;
+    double cellSize_;
+    int64_t x_;
+    int64_t y_;
+    size_t nx_;
+    size_t ny_;
+    size_t tileSize_;
+    size_t ntx_;
+    size_t nty_;
+    std::vector<int64_t> tiles_;
+    uint32_t fingerprint_;
+};
+
+#endif /* RASTER_FILE_HPP */
@@ -0,0 +1,230 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file TerrainModel.cpp
+*/
+
+#include <GroundFilter.hpp>
+#include <RasterFile.hpp>
+#include <TerrainModel.hpp>
+#include <algorithm>
+#include <cmath>
+
+TerrainModel::TerrainModel()
+    : method(METHOD_IDW),
+      cellSize(1.0),
+      radius(2.0),
+      power(2.0),
+      fillRadius(32),
+      tileSize(256)
+{
+}
+
+TerrainModel::~TerrainModel()
+{
+}
+
+const char *TerrainModel::methodName(Method method)
+{
+    switch (method)
+    {
+        case METHOD_MIN:
+            return "min";
+        case METHOD_MEAN:
+            return "mean";
+        case METHOD_IDW:
+        default:
+            return "idw";
+    }
+}
+
+void TerrainModel::run(const Database &db,
+                       const std::string &path,
+                       ThreadPool &pool) const
+{
+    RasterFile out;
+    out.create(path, db.aabb, cellSize, tileSize);
+    out.metadata["type"] = "dtm";
+    out.metadata["method"] = methodName(method);
+
+    // Halo in cells
+    size_t search = (method == METHOD_IDW)
+                        ? static_cast<size_t>(std::ceil(radius / cellSize))
+                        : 0;
+    size_t halo = fillRadius + search;
+
+    pool.run(out.size(), [&](size_t i) {
+        Raster tile;
+        out.getTile(tile, i);
+
+        Raster raster;
+        raster.create(tile.getX() - static_cast<int64_t>(halo),
+                      tile.getY() - static_cast<int64_t>(halo),
+                      tile.getSizeX() + (2 * halo),
+                      tile.getSizeY() + (2 * halo),
+                      cellSize);
+
+        double x1 = static_cast<double>(raster.getX()) * cellSize;
+        double y1 = static_cast<double>(raster.getY()) * cellSize;
+        double x2 = x1 + (static_cast<double>(raster.getSizeX()) * cellSize);
+        double y2 = y1 + (static_cast<double>(raster.getSizeY()) * cellSize);
+
+        Aabbd window;
+        window.set(x1, y1, db.aabb.min(2), x2, y2, db.aabb.max(2));
+
+        DatabaseCell cell;
+        db.read(cell, window);
+
+        compute(raster, cell);
+        raster.fill(fillRadius);
+
+        tile.copy(raster);
+        out.write(tile, i);
+    });
+
+    out.close();
+}
+
+void TerrainModel::compute(Raster &raster, const DatabaseCell &cell) const
+{
+    size_t nx = raster.getSizeX();
+    size_t ny = raster.getSizeY();
+
+    // Ground points sorted by raster cells
+    std::vector<size_t> start(raster.size() + 1, 0);
+    std::vector<size_t> index(cell.size());
+    for (size_t i = 0; i < cell.size(); i++)
+    {
+        size_t ix;
+        size_t iy;
+        index[i] = raster.size();
+        if (cell.laser[i].classification == GroundFilter::CLASS_GROUND &&
+            raster.index(ix, iy, cell.xyz[3 * i], cell.xyz[3 * i + 1]))
+        {
+            index[i] = (iy * nx) + ix;
+            start[index[i] + 1]++;
+        }
+    }
+
+    for (size_t k = 0; k < raster.size(); k++)
+    {
+        start[k + 1] += start[k];
+    }
+
+    std::vector<size_t> points(start.back());
+    std::vector<size_t> next(start.begin(), start.end() - 1);
+    for (size_t i = 0; i < cell.size(); i++)
+    {
+        if (index[i] < raster.size())
+        {
+            points[next[index[i]]++] = i;
+        }
+    }
+
+    std::vector<float> &data = raster.data();
+
+    if (method != METHOD_IDW)
+    {
+        for (size_t k = 0; k < raster.size(); k++)
+        {
+            if (start[k] == start[k + 1])
+            {
+                continue;
+            }
+
+            double v = 0;
+            if (method == METHOD_MIN)
+            {
+                v = cell.xyz[3 * points[start[k]] + 2];
+            }
+            for (size_t j = start[k]; j < start[k + 1]; j++)
+            {
+                double z = cell.xyz[3 * points[j] + 2];
+                v = (method == METHOD_MIN) ? std::min(v, z) : v + z;
+            }
+
+            if (method == METHOD_MEAN)
+            {
+                v /= static_cast<double>(start[k + 1] - start[k]);
+            }
+
+            data[k] = static_cast<float>(v);
+        }
+
+        return;
+    }
+
+    // Inverse distance weighting at cell centers
+    const int64_t r = static_cast<int64_t>(std::ceil(radius / cellSize));
+    const double radius2 = radius * radius;
+    for (size_t iy = 0; iy < ny; iy++)
+    {
+        for (size_t ix = 0; ix < nx; ix++)
+        {
+            double cx = (static_cast<double>(raster.getX() +
+                                             static_cast<int64_t>(ix)) +
+                         0.5) *
+                        cellSize;
+            double cy = (static_cast<double>(raster.getY() +
+                                             static_cast<int64_t>(iy)) +
+                         0.5) *
+                        cellSize;
+
+            double sum = 0;
+            double sumWeight = 0;
+            int64_t y1 = std::max(static_cast<int64_t>(iy) - r, int64_t(0));
+            int64_t y2 = std::min(static_cast<int64_t>(iy) + r,
+                                  static_cast<int64_t>(ny) - 1);
+            int64_t x1 = std::max(static_cast<int64_t>(ix) - r, int64_t(0));
+            int64_t x2 = std::min(static_cast<int64_t>(ix) + r,
+                                  static_cast<int64_t>(nx) - 1);
+
+            for (int64_t y = y1; y <= y2; y++)
+            {
+                for (int64_t x = x1; x <= x2; x++)
+                {
+                    size_t k = (static_cast<size_t>(y) * nx) +
+                               static_cast<size_t>(x);
+                    for (size_t j = start[k]; j < start[k + 1]; j++)
+                    {
+                        const double *p = &cell.xyz[3 * points[j]];
+                        double dx = p[0] - cx;
+                        double dy = p[1] - cy;
+                        double d2 = (dx * dx) + (dy * dy);
+                        if (d2 > radius2)
+                        {
+                            continue;
+                        }
+
+                        double w =
+                            1.0 / std::pow(std::max(d2, 1e-12), power * 0.5);
+                        sum += w * p[2];
+                        sumWeight += w;
+                    }
+                }
+            }
+
+            if (sumWeight > 0)
+            {
+                data[(iy * nx) + ix] = static_cast<float>(sum / sumWeight);
+            }
+        }
+    }
+}
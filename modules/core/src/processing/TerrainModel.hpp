@@ -0,0 +1,72 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file TerrainModel.hpp
+*/
+
+#ifndef TERRAIN_MODEL_HPP
+#define TERRAIN_MODEL_HPP
+
+#include <Database.hpp>
+#include <Raster.hpp>
+#include <ThreadPool.hpp>
+#include <string>
+
+/** Terrain Model.
+
+    Creates digital terrain model from points classified as ground. Raster
+    cells get the lowest height, mean height or inverse distance weighted
+    height of ground points around cell centers. Cells without ground
+    points are filled from the nearest cells with values.
+
+    Raster tiles are computed in parallel. Points of each tile are read
+    from the database with a halo which covers the search radius and the
+    fill radius, so only one tile per thread is in memory and tile edges
+    match. Tiles are written to a raster file.
+*/
+class TerrainModel
+{
+public:
+    enum Method
+    {
+        METHOD_MIN,
+        METHOD_MEAN,
+        METHOD_IDW
+    };
+
+    Method method;
+    double cellSize;
+    double radius;
+    double power;
+    size_t fillRadius;
+    size_t tileSize;
+
+    TerrainModel();
+    ~TerrainModel();
+
+    void run(const Database &db,
+             const std::string &path,
+             ThreadPool &pool) const;
+    void compute(Raster &raster, const DatabaseCell &cell) const;
+
+    static const char *methodName(Method method);
+};
+
+#endif /* TERRAIN_MODEL_HPP */
@@ -0,0 +1,125 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file TileGrid.cpp
+*/
+
+#include <Error.hpp>
+#include <TileGrid.hpp>
+#include <cmath>
+#include <limits>
+
+TileGrid::TileGrid()
+    : db_(nullptr),
+      tileSize_(0),
+      halo_(0),
+      nx_(0),
+      ny_(0)
+{
+}
+
+TileGrid::~TileGrid()
+{
+}
+
+void TileGrid::create(const Database &db, double tileSize, double halo)
+{
+    if (!db.isIndexed())
+    {
+        THROW("Tiles can be created only for spatial index database");
+    }
+
+    if (!(tileSize > 0) || halo < 0)
+    {
+        THROW("Invalid tile size");
+    }
+
+    db_ = &db;
+    boundary_ = db.aabb;
+    tileSize_ = tileSize;
+    halo_ = halo;
+
+    double dx = boundary_.max(0) - boundary_.min(0);
+    double dy = boundary_.max(1) - boundary_.min(1);
+    nx_ = std::max(static_cast<size_t>(std::ceil(dx / tileSize_)), size_t(1));
+    ny_ = std::max(static_cast<size_t>(std::ceil(dy / tileSize_)), size_t(1));
+}
+
+void TileGrid::getTile(Aabbd &box, size_t i) const
+{
+    double x = boundary_.min(0) + (static_cast<double>(i % nx_) * tileSize_);
+    double y = boundary_.min(1) + (static_cast<double>(i / nx_) * tileSize_);
+
+    box.set(x,
+            y,
+            boundary_.min(2),
+            x + tileSize_,
+            y + tileSize_,
+            boundary_.max(2));
+}
+
+void TileGrid::getWindow(Aabbd &box, size_t i) const
+{
+    Aabbd tile;
+    getTile(tile, i);
+
+    // Points outside of the boundary belong to edge tiles, quantized
+    // coordinates can be slightly outside of the header bounds
+    const double far = std::numeric_limits<double>::max();
+    size_t ix = i % nx_;
+    size_t iy = i / nx_;
+
+    box.set((ix == 0) ? -far : tile.min(0) - halo_,
+            (iy == 0) ? -far : tile.min(1) - halo_,
+            -far,
+            (ix + 1 == nx_) ? far : tile.max(0) + halo_,
+            (iy + 1 == ny_) ? far : tile.max(1) + halo_,
+            far);
+}
+
+size_t TileGrid::tile(double x, double y) const
+{
+    // Points on the far boundary belong to the last tile
+    double fx = std::floor((x - boundary_.min(0)) / tileSize_);
+    double fy = std::floor((y - boundary_.min(1)) / tileSize_);
+
+    size_t ix = (fx > 0) ? std::min(static_cast<size_t>(fx), nx_ - 1) : 0;
+    size_t iy = (fy > 0) ? std::min(static_cast<size_t>(fy), ny_ - 1) : 0;
+
+    return (iy * nx_) + ix;
+}
+
+void TileGrid::read(DatabaseCell &cell,
+                    std::vector<size_t> &own,
+                    size_t i) const
+{
+    Aabbd window;
+    getWindow(window, i);
+    db_->read(cell, window);
+
+    own.clear();
+    for (size_t k = 0; k < cell.size(); k++)
+    {
+        if (tile(cell.xyz[3 * k], cell.xyz[3 * k + 1]) == i)
+        {
+            own.push_back(k);
+        }
+    }
+}
@@ -0,0 +1,67 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file TileGrid.hpp
+*/
+
+#ifndef TILE_GRID_HPP
+#define TILE_GRID_HPP
+
+#include <Aabb.hpp>
+#include <Database.hpp>
+#include <cstddef>
+#include <vector>
+
+/** Tile Grid.
+
+    Divides a spatial index database into square columns in x and y for
+    processing in parallel. Each tile is read with a halo of neighbouring
+    points, so that results at tile edges match processing of the whole
+    cloud. Results are kept only for points owned by the tile. Every point
+    is owned by exactly one tile.
+*/
+class TileGrid
+{
+public:
+    TileGrid();
+    ~TileGrid();
+
+    void create(const Database &db, double tileSize, double halo);
+
+    size_t size() const { return nx_ * ny_; }
+    size_t getSizeX() const { return nx_; }
+    size_t getSizeY() const { return ny_; }
+
+    void getTile(Aabbd &box, size_t i) const;
+    void getWindow(Aabbd &box, size_t i) const;
+    size_t tile(double x, double y) const;
+
+    void read(DatabaseCell &cell, std::vector<size_t> &own, size_t i) const;
+
+protected:
+    const Database *db_;
+    Aabbd boundary_;
+    double tileSize_;
+    double halo_;
+    size_t nx_;
+    size_t ny_;
+};
+
+#endif /* TILE_GRID_HPP */
@@ -0,0 +1,411 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file TreeSegmentation.cpp
+*/
+
+#include <ColumnWriter.hpp>
+#include <Error.hpp>
+#include <GroundFilter.hpp>
+#include <RasterFile.hpp>
+#include <TileGrid.hpp>
+#include <TreeSegmentation.hpp>
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+TreeSegmentation::TreeSegmentation()
+    : minHeight(2.0),
+      topRadius(2.0),
+      maxCrownRadius(8.0),
+      minPointHeight(0.5),
+      tileSize(100.0)
+{
+}
+
+TreeSegmentation::~TreeSegmentation()
+{
+}
+
+/** Raster cells within distance from a tile. */
+static void TreeSegmentation_window(Raster &raster,
+                                    const RasterFile &chm,
+                                    const Aabbd &tile,
+                                    double distance)
+{
+    double c = chm.getCellSize();
+    Aabbd window;
+    window.set(tile.min(0) - distance - c,
+               tile.min(1) - distance - c,
+               tile.min(2),
+               tile.max(0) + distance + c,
+               tile.max(1) + distance + c,
+               tile.max(2));
+
+    chm.read(raster, window);
+}
+
+/** Order of tops by position, rows first. */
+static bool TreeSegmentation_less(const TreeSegmentation::Top &a,
+                                  const TreeSegmentation::Top &b)
+{
+    return a.y < b.y || (a.y == b.y && a.x < b.x);
+}
+
+size_t TreeSegmentation::run(Database &db,
+                             const std::string &chmPath,
+                             ThreadPool &pool)
+{
+    if (db.findColumn(Database::CHUNK_ID_HEIGHT, sizeof(float)) ==
+        db.getFile().getEntrySize())
+    {
+        THROW("Tree segmentation requires height above ground in database '" +
+              db.path() + "'");
+    }
+
+    RasterFile chm;
+    chm.open(chmPath);
+
+    TileGrid grid;
+    grid.create(db, tileSize, 0);
+
+    // Tree tops of all tiles
+    std::vector<std::vector<Top>> tiles(grid.size());
+
+    pool.run(grid.size(), [&](size_t i) {
+        Aabbd tile;
+        grid.getTile(tile, i);
+
+        Raster raster;
+        TreeSegmentation_window(raster, chm, tile, topRadius);
+
+        std::vector<Top> tops;
+        findTops(tops, raster);
+
+        // Tops are owned by the tile which contains their cell center
+        double c = raster.getCellSize();
+        for (const Top &top : tops)
+        {
+            double x = (static_cast<double>(top.x) + 0.5) * c;
+            double y = (static_cast<double>(top.y) + 0.5) * c;
+            if (grid.tile(x, y) == i)
+            {
+                tiles[i].push_back(top);
+            }
+        }
+    });
+
+    tops_.clear();
+    for (size_t i = 0; i < grid.size(); i++)
+    {
+        tops_.insert(tops_.end(), tiles[i].begin(), tiles[i].end());
+    }
+    std::sort(tops_.begin(), tops_.end(), TreeSegmentation_less);
+
+    // Crowns of each tile, tree id is index of the top plus one
+    ColumnWriter column;
+    column.create(db, Database::CHUNK_ID_TREE, sizeof(uint32_t));
+
+    pool.run(grid.size(), [&](size_t i) {
+        Aabbd tile;
+        grid.getTile(tile, i);
+
+        Raster raster;
+        TreeSegmentation_window(raster, chm, tile, 2.0 * maxCrownRadius);
+
+        // Tops inside of the raster
+        Top first = {0, raster.getY(), 0};
+        Top last = {0,
+                    raster.getY() + static_cast<int64_t>(raster.getSizeY()),
+                    0};
+        size_t from = static_cast<size_t>(
+            std::lower_bound(tops_.begin(),
+                             tops_.end(),
+                             first,
+                             [](const Top &a, const Top &b) {
+                                 return a.y < b.y;
+                             }) -
+            tops_.begin());
+        size_t to = static_cast<size_t>(
+            std::lower_bound(tops_.begin(),
+                             tops_.end(),
+                             last,
+                             [](const Top &a, const Top &b) {
+                                 return a.y < b.y;
+                             }) -
+            tops_.begin());
+
+        std::vector<uint32_t> labels;
+        grow(labels, raster, tops_, from, to);
+
+        DatabaseCell cell;
+        std::vector<size_t> own;
+        grid.read(cell, own, i);
+
+        std::vector<uint32_t> values(cell.size(), 0);
+        for (size_t k = 0; k < own.size(); k++)
+        {
+            size_t p = own[k];
+            size_t ix;
+            size_t iy;
+
+            if (cell.laser[p].classification == GroundFilter::CLASS_GROUND ||
+                GroundFilter::isNoise(cell.laser[p].classification) ||
+                !(cell.height[p] >= minPointHeight) ||
+                !raster.index(ix, iy, cell.xyz[3 * p], cell.xyz[3 * p + 1]))
+            {
+                continue;
+            }
+
+            values[p] = labels[(iy * raster.getSizeX()) + ix];
+        }
+
+        column.write(cell, own, values);
+    });
+
+    column.close();
+    chm.close();
+
+    // Reopen with the new column
+    db.open(db.path());
+
+    return tops_.size();
+}
+
+/** Compare cells by height, higher first, then by position. */
+static bool TreeSegmentation_higher(float ha,
+                                    int64_t xa,
+                                    int64_t ya,
+                                    float hb,
+                                    int64_t xb,
+                                    int64_t yb)
+{
+    if (ha > hb)
+    {
+        return true;
+    }
+    if (ha < hb)
+    {
+        return false;
+    }
+    return ya < yb || (ya == yb && xa < xb);
+}
+
+void TreeSegmentation::findTops(std::vector<Top> &tops,
+                                const Raster &chm) const
+{
+    const int64_t nx = static_cast<int64_t>(chm.getSizeX());
+    const int64_t ny = static_cast<int64_t>(chm.getSizeY());
+    const int64_t x0 = chm.getX();
+    const int64_t y0 = chm.getY();
+    const double c = chm.getCellSize();
+    const int64_t r = static_cast<int64_t>(std::floor(topRadius / c));
+    const double r2 = (topRadius * topRadius) / (c * c);
+
+    tops.clear();
+
+    for (int64_t y = y0; y < y0 + ny; y++)
+    {
+        for (int64_t x = x0; x < x0 + nx; x++)
+        {
+            float h = chm.at(static_cast<size_t>(x - x0),
+                             static_cast<size_t>(y - y0));
+            if (!(h >= static_cast<float>(minHeight)))
+            {
+                continue;
+            }
+
+            // The highest cell in the circle
+            bool top = true;
+            for (int64_t dy = -r; dy <= r && top; dy++)
+            {
+                int64_t yy = y + dy;
+                if (yy < y0 || yy >= y0 + ny)
+                {
+                    continue;
+                }
+
+                for (int64_t dx = -r; dx <= r && top; dx++)
+                {
+                    int64_t xx = x + dx;
+                    if (xx < x0 || xx >= x0 + nx || (dx == 0 && dy == 0) ||
+                        static_cast<double>((dx * dx) + (dy * dy)) > r2)
+                    {
+                        continue;
+                    }
+
+                    float v = chm.at(static_cast<size_t>(xx - x0),
+                                     static_cast<size_t>(yy - y0));
+                    if (!std::isnan(v) &&
+                        TreeSegmentation_higher(v, xx, yy, h, x, y))
+                    {
+                        top = false;
+                    }
+                }
+            }
+
+            if (top)
+            {
+                tops.push_back({x, y, h});
+            }
+        }
+    }
+}
+
+/** Cell waiting in the flooding queue. */
+struct TreeSegmentationCell
+{
+    float height;
+    int64_t x;
+    int64_t y;
+
+    bool operator<(const TreeSegmentationCell &b) const
+    {
+        // The highest cell is on top of the queue
+        return TreeSegmentation_higher(b.height, b.x, b.y, height, x, y);
+    }
+};
+
+void TreeSegmentation::grow(std::vector<uint32_t> &labels,
+                            const Raster &chm,
+                            const std::vector<Top> &tops,
+                            size_t from,
+                            size_t to) const
+{
+    const int64_t nx = static_cast<int64_t>(chm.getSizeX());
+    const int64_t ny = static_cast<int64_t>(chm.getSizeY());
+    const int64_t x0 = chm.getX();
+    const int64_t y0 = chm.getY();
+    const double c = chm.getCellSize();
+    const double r2 = (maxCrownRadius * maxCrownRadius) / (c * c);
+    const float hmin = static_cast<float>(minHeight);
+
+    labels.assign(chm.size(), 0);
+
+    auto index = [&](int64_t x, int64_t y) -> size_t {
+        return static_cast<size_t>(((y - y0) * nx) + (x - x0));
+    };
+
+    std::priority_queue<TreeSegmentationCell> queue;
+
+    auto push = [&](int64_t x, int64_t y) {
+        for (int64_t dy = -1; dy <= 1; dy++)
+        {
+            for (int64_t dx = -1; dx <= 1; dx++)
+            {
+                int64_t xx = x + dx;
+                int64_t yy = y + dy;
+                if (xx < x0 || yy < y0 || xx >= x0 + nx || yy >= y0 + ny)
+                {
+                    continue;
+                }
+
+                size_t k = index(xx, yy);
+                float h = chm.data()[k];
+                if (labels[k] == 0 && h >= hmin)
+                {
+                    queue.push({h, xx, yy});
+                }
+            }
+        }
+    };
+
+    // Tree id is the index of the top in all tops plus one
+    for (size_t i = from; i < to; i++)
+    {
+        const Top &top = tops[i];
+        if (top.x < x0 || top.x >= x0 + nx)
+        {
+            continue;
+        }
+
+        labels[index(top.x, top.y)] = static_cast<uint32_t>(i + 1);
+    }
+
+    for (size_t i = from; i < to; i++)
+    {
+        const Top &top = tops[i];
+        if (top.x >= x0 && top.x < x0 + nx)
+        {
+            push(top.x, top.y);
+        }
+    }
+
+    while (!queue.empty())
+    {
+        TreeSegmentationCell cell = queue.top();
+        queue.pop();
+
+        size_t k = index(cell.x, cell.y);
+        if (labels[k] != 0)
+        {
+            continue;
+        }
+
+        // The highest labeled neighbour with the top close enough
+        uint32_t label = 0;
+        float best = 0;
+        int64_t bx = 0;
+        int64_t by = 0;
+        for (int64_t dy = -1; dy <= 1; dy++)
+        {
+            for (int64_t dx = -1; dx <= 1; dx++)
+            {
+                int64_t xx = cell.x + dx;
+                int64_t yy = cell.y + dy;
+                if (xx < x0 || yy < y0 || xx >= x0 + nx || yy >= y0 + ny)
+                {
+                    continue;
+                }
+
+                size_t n = index(xx, yy);
+                uint32_t l = labels[n];
+                if (l == 0)
+                {
+                    continue;
+                }
+
+                const Top &top = tops[l - 1];
+                double ex = static_cast<double>(cell.x - top.x);
+                double ey = static_cast<double>(cell.y - top.y);
+                if ((ex * ex) + (ey * ey) > r2)
+                {
+                    continue;
+                }
+
+                float h = chm.data()[n];
+                if (label == 0 ||
+                    TreeSegmentation_higher(h, xx, yy, best, bx, by))
+                {
+                    label = l;
+                    best = h;
+                    bx = xx;
+                    by = yy;
+                }
+            }
+        }
+
+        if (label != 0)
+        {
+            labels[k] = label;
+            push(cell.x, cell.y);
+        }
+    }
+}
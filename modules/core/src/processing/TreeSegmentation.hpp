@@ -0,0 +1,83 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file TreeSegmentation.hpp
+*/
+
+#ifndef TREE_SEGMENTATION_HPP
+#define TREE_SEGMENTATION_HPP
+
+#include <Database.hpp>
+#include <Raster.hpp>
+#include <ThreadPool.hpp>
+#include <string>
+#include <vector>
+
+/** Tree Segmentation.
+
+    Segments individual trees by marker controlled watershed of the canopy
+    height model. Tree tops are the highest cells within the top radius.
+    Crowns grow from tops into lower cells in the order of decreasing
+    height, each cell joins the highest neighbour crown whose top is within
+    the maximum crown radius. Points above the minimum point height get the
+    tree of their canopy cell.
+
+    Tree tops of all tiles are found in parallel first. They are numbered
+    by their position in the global raster, so tree ids do not depend on
+    tiles. Crowns of each tile are grown with a halo of two crown radii,
+    so crowns which cross tile edges get the same tree in all tiles.
+    Trees are written as the tree column of the database.
+*/
+class TreeSegmentation
+{
+public:
+    /** Tree top. */
+    struct Top
+    {
+        int64_t x;
+        int64_t y;
+        float height;
+    };
+
+    double minHeight;
+    double topRadius;
+    double maxCrownRadius;
+    double minPointHeight;
+    double tileSize;
+
+    TreeSegmentation();
+    ~TreeSegmentation();
+
+    size_t run(Database &db, const std::string &chmPath, ThreadPool &pool);
+
+    void findTops(std::vector<Top> &tops, const Raster &chm) const;
+    void grow(std::vector<uint32_t> &labels,
+              const Raster &chm,
+              const std::vector<Top> &tops,
+              size_t from,
+              size_t to) const;
+
+    const std::vector<Top> &getTops() const { return tops_; }
+
+protected:
+    std::vector<Top> tops_;
+};
+
+#endif /* TREE_SEGMENTATION_HPP */
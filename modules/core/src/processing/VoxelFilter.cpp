@@ -0,0 +1,202 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file VoxelFilter.cpp
+*/
+
+#include <Error.hpp>
+#include <TileGrid.hpp>
+#include <VoxelFilter.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+/** Number of tiles computed in parallel for each thread. */
+static const size_t VOXEL_FILTER_TILES_PER_THREAD = 4;
+
+VoxelFilter::VoxelFilter() : voxelSize(0.1), tileSize(50.0)
+{
+}
+
+VoxelFilter::~VoxelFilter()
+{
+}
+
+void VoxelFilter::run(const Database &db,
+                      const std::string &path,
+                      ThreadPool &pool) const
+{
+    if (!(voxelSize > 0))
+    {
+        THROW("Invalid voxel size");
+    }
+
+    TileGrid grid;
+    grid.create(db, tileSize, voxelSize);
+
+    // Points without extra bytes and with the same scale and offset
+    LasFile::Header hdr = db.getHeader();
+    hdr.point_data_record_length = 0;
+    std::memset(hdr.generating_software, 0, sizeof(hdr.generating_software));
+    std::memcpy(hdr.generating_software, "3D Forest", 9);
+
+    LasFile las;
+    las.create(path, hdr);
+
+    size_t batch = pool.size() * VOXEL_FILTER_TILES_PER_THREAD;
+    std::vector<LasFile::Columns> columns(batch);
+
+    for (size_t from = 0; from < grid.size(); from += batch)
+    {
+        size_t n = std::min(batch, grid.size() - from);
+
+        pool.run(n, [&](size_t k) {
+            size_t i = from + k;
+
+            DatabaseCell cell;
+            std::vector<size_t> own;
+            grid.read(cell, own, i);
+
+            VoxelGrid voxels;
+            voxels.create(cell, voxelSize);
+
+            DatabaseCell points;
+            voxels.downsample(points);
+
+            // Keep voxels with center in this tile
+            size_t m = 0;
+            for (size_t v = 0; v < voxels.size(); v++)
+            {
+                double x;
+                double y;
+                double z;
+                voxels.getCenter(x, y, z, v);
+                if (grid.tile(x, y) != i)
+                {
+                    continue;
+                }
+
+                for (size_t c = 0; c < 3; c++)
+                {
+                    points.xyz[3 * m + c] = points.xyz[3 * v + c];
+                }
+                points.laser[m] = points.laser[v];
+                if (!points.rgb.empty())
+                {
+                    for (size_t c = 0; c < 3; c++)
+                    {
+                        points.rgb[3 * m + c] = points.rgb[3 * v + c];
+                    }
+                }
+                if (!points.height.empty())
+                {
+                    points.height[m] = points.height[v];
+                }
+                m++;
+            }
+
+            points.xyz.resize(3 * m);
+            points.laser.resize(m);
+            if (!points.rgb.empty())
+            {
+                points.rgb.resize(3 * m);
+            }
+            if (!points.height.empty())
+            {
+                points.height.resize(m);
+            }
+
+            convert(columns[k], points, las.header);
+        });
+
+        for (size_t k = 0; k < n; k++)
+        {
+            las.write(columns[k]);
+        }
+    }
+
+    las.close();
+}
+
+/** Quantize a coordinate to LAS integer. */
+static int32_t VoxelFilter_quantize(double v, double scale, double offset)
+{
+    return static_cast<int32_t>(std::lround((v - offset) / scale));
+}
+
+/** Quantize a color from [0, 1] to 16 bits. */
+static uint16_t VoxelFilter_color(float v)
+{
+    float c = std::min(std::max(v, 0.0F), 1.0F) * 65535.0F;
+    return static_cast<uint16_t>(std::lround(c));
+}
+
+void VoxelFilter::convert(LasFile::Columns &columns,
+                          const DatabaseCell &cell,
+                          const LasFile::Header &hdr)
+{
+    size_t n = cell.size();
+    bool rgb = hdr.hasRgb() && !cell.rgb.empty();
+    bool gps = !cell.gps.empty();
+
+    columns.resize(n, 0);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        const DatabaseCell::Laser &laser = cell.laser[i];
+
+        columns.x[i] = VoxelFilter_quantize(cell.xyz[3 * i],
+                                            hdr.x_scale_factor,
+                                            hdr.x_offset);
+        columns.y[i] = VoxelFilter_quantize(cell.xyz[3 * i + 1],
+                                            hdr.y_scale_factor,
+                                            hdr.y_offset);
+        columns.z[i] = VoxelFilter_quantize(cell.xyz[3 * i + 2],
+                                            hdr.z_scale_factor,
+                                            hdr.z_offset);
+        columns.intensity[i] = laser.intensity;
+        columns.return_number[i] = laser.returnNumber;
+        columns.number_of_returns[i] = laser.numberOfReturns;
+        columns.scan_direction_flag[i] = 0;
+        columns.edge_of_flight_line[i] = 0;
+        columns.classification_flags[i] = 0;
+        columns.scanner_channel[i] = 0;
+        columns.classification[i] = laser.classification;
+        columns.user_data[i] = laser.userData;
+        columns.angle[i] = laser.scanAngle;
+        columns.source_id[i] = 0;
+        columns.gps_time[i] = gps ? cell.gps[i] : 0.0;
+
+        if (rgb)
+        {
+            columns.red[i] = VoxelFilter_color(cell.rgb[3 * i]);
+            columns.green[i] = VoxelFilter_color(cell.rgb[3 * i + 1]);
+            columns.blue[i] = VoxelFilter_color(cell.rgb[3 * i + 2]);
+        }
+        else
+        {
+            columns.red[i] = 0;
+            columns.green[i] = 0;
+            columns.blue[i] = 0;
+        }
+
+        columns.nir[i] = 0;
+    }
+}
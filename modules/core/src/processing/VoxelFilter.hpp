@@ -0,0 +1,59 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file VoxelFilter.hpp
+*/
+
+#ifndef VOXEL_FILTER_HPP
+#define VOXEL_FILTER_HPP
+
+#include <Database.hpp>
+#include <LasFile.hpp>
+#include <ThreadPool.hpp>
+#include <VoxelGrid.hpp>
+#include <string>
+
+/** Voxel Filter.
+
+    Downsamples a spatial index database to one point per voxel at the
+    centroid of its points. Tiles are read with a halo of one voxel and
+    each voxel is kept by the tile which contains its center, so voxels
+    at tile edges are complete and written once. Groups of tiles are
+    processed in parallel and written to LAS in tile order.
+*/
+class VoxelFilter
+{
+public:
+    double voxelSize;
+    double tileSize;
+
+    VoxelFilter();
+    ~VoxelFilter();
+
+    void run(const Database &db,
+             const std::string &path,
+             ThreadPool &pool) const;
+
+    static void convert(LasFile::Columns &columns,
+                        const DatabaseCell &cell,
+                        const LasFile::Header &hdr);
+};
+
+#endif /* VOXEL_FILTER_HPP */
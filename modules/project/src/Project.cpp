@@ -23,6 +23,8 @@
 
 #include <Error.hpp>
 #include <Project.hpp>
+#include <ThreadPool.hpp>
+#include <filesystem>
 
 Project::Project()
 {
@@ -57,6 +59,8 @@ void Project::open(const std::string &path)
                     readFile(it);
                 }
             }
+
+            readCatalog();
         }
         else
         {
@@ -75,6 +79,7 @@ void Project::close()
     path_ = "";
     projectName_ = "";
     files_.clear();
+    catalog_.clear();
 }
 
 void Project::readFile(const Json &json)
@@ -88,3 +93,30 @@ void Project::readFile(const Json &json)
     file->read(json);
     files_.push_back(file);
 }
+
+void Project::readCatalog()
+{
+    std::filesystem::path catalogPath(path_);
+    catalogPath.replace_extension(".catalog");
+
+    std::vector<std::string> paths(files_.size());
+    for (size_t i = 0; i < files_.size(); i++)
+    {
+        paths[i] = files_[i]->path;
+    }
+
+    catalog_.read(catalogPath.string());
+
+    ThreadPool pool;
+    if (catalog_.refresh(paths, pool))
+    {
+        try
+        {
+            catalog_.write(catalogPath.string());
+        }
+        catch (std::exception &e)
+        {
+            // The catalog is only a cache, the project opens without it
+        }
+    }
+}
@@ -24,9 +24,14 @@
 #ifndef PROJECT_HPP
 #define PROJECT_HPP
 
+#include <ProjectCatalog.hpp>
 #include <ProjectFile.hpp>
 
-/** Project. */
+/** Project.
+
+    Header summaries of project files are kept in a catalog which is
+    stored next to the project file ('.catalog' extension).
+*/
 class Project
 {
 public:
@@ -38,13 +43,16 @@ public:
 
     size_t size() const { return files_.size(); }
     const ProjectFile &getSnapshot(size_t i) const { return *files_[i]; }
+    const ProjectCatalog &getCatalog() const { return catalog_; }
 
 protected:
     std::string path_;
     std::string projectName_;
     std::vector<std::shared_ptr<ProjectFile>> files_;
+    ProjectCatalog catalog_;
 
     void readFile(const Json &json);
+    void readCatalog();
 };
 
 #endif /* PROJECT_HPP */
@@ -0,0 +1,361 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file ProjectCatalog.cpp
+*/
+
+#include <ChunkFile.hpp>
+#include <Error.hpp>
+#include <LasFile.hpp>
+#include <ProjectCatalog.hpp>
+#include <ThreadPool.hpp>
+#include <chrono>
+#include <filesystem>
+#include <unordered_map>
+
+const uint32_t ProjectCatalog::CHUNK_ID_CATALOG = 0x50434154U;
+
+/** Catalog format version, older catalogs are rebuilt. */
+static const uint32_t PROJECT_CATALOG_VERSION = 1;
+
+ProjectCatalog::Entry::Entry()
+    : size(0),
+      mtime_sec(0),
+      mtime_nsec(0),
+      number_of_point_records(0),
+      point_data_record_format(0),
+      version_major(0),
+      version_minor(0),
+      compressed(false)
+{
+    // empty
+}
+
+std::string ProjectCatalog::Entry::crs() const
+{
+    // Name of the coordinate system is the first quoted WKT string
+    size_t from = wkt.find('"');
+    if (from != std::string::npos)
+    {
+        size_t to = wkt.find('"', from + 1);
+        if (to != std::string::npos)
+        {
+            return wkt.substr(from + 1, to - from - 1);
+        }
+    }
+
+    return wkt;
+}
+
+void ProjectCatalog::Entry::read(const Json &in)
+{
+    path = in["path"].string();
+
+    size = in["size"].uint64();
+    mtime_sec = static_cast<int64_t>(in["mtime"][0].number());
+    mtime_nsec = static_cast<int64_t>(in["mtime"][1].number());
+
+    const Json &box = in["boundary"];
+    boundary.set(box["min"][0].number(),
+                 box["min"][1].number(),
+                 box["min"][2].number(),
+                 box["max"][0].number(),
+                 box["max"][1].number(),
+                 box["max"][2].number());
+
+    number_of_point_records = in["points"].uint64();
+    point_data_record_format = static_cast<uint8_t>(in["format"].uint64());
+    version_major = static_cast<uint8_t>(in["version"][0].uint64());
+    version_minor = static_cast<uint8_t>(in["version"][1].uint64());
+    compressed = in["compressed"].uint64() != 0;
+
+    wkt.clear();
+    if (in.containsString("wkt"))
+    {
+        wkt = in["wkt"].string();
+    }
+
+    error.clear();
+    if (in.containsString("error"))
+    {
+        error = in["error"].string();
+    }
+}
+
+Json &ProjectCatalog::Entry::write(Json &out) const
+{
+    out["path"] = path;
+
+    out["size"] = size;
+    out["mtime"][0] = mtime_sec;
+    out["mtime"][1] = mtime_nsec;
+
+    boundary.serialize(out["boundary"]);
+
+    out["points"] = number_of_point_records;
+    out["format"] = static_cast<uint32_t>(point_data_record_format);
+    out["version"][0] = static_cast<uint32_t>(version_major);
+    out["version"][1] = static_cast<uint32_t>(version_minor);
+    out["compressed"] = static_cast<uint32_t>(compressed);
+
+    if (!wkt.empty())
+    {
+        out["wkt"] = wkt;
+    }
+
+    if (!error.empty())
+    {
+        out["error"] = error;
+    }
+
+    return out;
+}
+
+static void ProjectCatalog_fingerprint(ProjectCatalog::Entry &e)
+{
+    std::error_code ec;
+    std::filesystem::path path(e.path);
+
+    e.size = 0;
+    e.mtime_sec = 0;
+    e.mtime_nsec = 0;
+
+    uintmax_t size = std::filesystem::file_size(path, ec);
+    if (ec)
+    {
+        return;
+    }
+
+    std::filesystem::file_time_type t =
+        std::filesystem::last_write_time(path, ec);
+    if (ec)
+    {
+        return;
+    }
+
+    // Split to keep both parts exact as Json numbers
+    int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     t.time_since_epoch())
+                     .count();
+
+    e.size = static_cast<uint64_t>(size);
+    e.mtime_sec = ns / 1000000000;
+    e.mtime_nsec = ns % 1000000000;
+}
+
+static void ProjectCatalog_readHeader(ProjectCatalog::Entry &e)
+{
+    try
+    {
+        LasFile las;
+        las.open(e.path);
+
+        e.boundary.set(las.header.min_x,
+                       las.header.min_y,
+                       las.header.min_z,
+                       las.header.max_x,
+                       las.header.max_y,
+                       las.header.max_z);
+        e.number_of_point_records = las.header.number_of_point_records;
+        e.point_data_record_format = las.header.point_data_record_format;
+        e.version_major = las.header.version_major;
+        e.version_minor = las.header.version_minor;
+        e.compressed = las.isCompressed();
+        e.wkt = las.getWkt();
+        e.error.clear();
+    }
+    catch (std::exception &ex)
+    {
+        // Unreadable files stay in the catalog until they change
+        e.error = ex.what();
+    }
+}
+
+ProjectCatalog::ProjectCatalog()
+{
+}
+
+ProjectCatalog::~ProjectCatalog()
+{
+}
+
+void ProjectCatalog::clear()
+{
+    entries_.clear();
+    boundary_ = Aabbd();
+}
+
+void ProjectCatalog::read(const std::string &path)
+{
+    clear();
+
+    if (!std::filesystem::exists(path))
+    {
+        return;
+    }
+
+    // The catalog is a cache, damaged catalog is rebuilt by refresh()
+    try
+    {
+        ChunkFile file;
+        file.open(path, "r");
+
+        size_t id = file.findEntry(CHUNK_ID_CATALOG);
+        if (id == file.getEntrySize())
+        {
+            return;
+        }
+
+        Json in;
+        file.readJson(id, in);
+        file.close();
+
+        if (in["version"].uint64() != PROJECT_CATALOG_VERSION)
+        {
+            return;
+        }
+
+        const std::vector<Json> &files = in["files"].array();
+        entries_.resize(files.size());
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            entries_[i].read(files[i]);
+        }
+    }
+    catch (std::exception &e)
+    {
+        entries_.clear();
+    }
+
+    updateBoundary();
+}
+
+void ProjectCatalog::write(const std::string &path) const
+{
+    Json out;
+    out["version"] = PROJECT_CATALOG_VERSION;
+    for (size_t i = 0; i < entries_.size(); i++)
+    {
+        entries_[i].write(out["files"][i]);
+    }
+
+    // Replace the old catalog only when the new one is complete
+    const std::string tmpPath = path + ".tmp";
+
+    ChunkFile file;
+    file.open(tmpPath, "w");
+    file.writeJson(CHUNK_ID_CATALOG, out);
+    file.writeDirectory();
+    file.close();
+
+    std::filesystem::rename(tmpPath, path);
+}
+
+bool ProjectCatalog::refresh(const std::vector<std::string> &paths,
+                             ThreadPool &pool)
+{
+    std::unordered_map<std::string, size_t> cached;
+    for (size_t i = 0; i < entries_.size(); i++)
+    {
+        cached[entries_[i].path] = i;
+    }
+
+    // Headers are read only from new or modified files
+    std::vector<Entry> entries(paths.size());
+    std::vector<uint8_t> modified(paths.size(), 0);
+
+    pool.run(paths.size(), [&](size_t i) {
+        Entry &e = entries[i];
+        e.path = paths[i];
+        ProjectCatalog_fingerprint(e);
+
+        auto search = cached.find(e.path);
+        if (search != cached.end())
+        {
+            const Entry &old = entries_[search->second];
+            if (old.size == e.size && old.mtime_sec == e.mtime_sec &&
+                old.mtime_nsec == e.mtime_nsec)
+            {
+                e = old;
+                return;
+            }
+        }
+
+        ProjectCatalog_readHeader(e);
+        modified[i] = 1;
+    });
+
+    bool changed = entries.size() != entries_.size();
+    for (size_t i = 0; i < entries.size() && !changed; i++)
+    {
+        changed = modified[i] || entries[i].path != entries_[i].path;
+    }
+
+    entries_ = std::move(entries);
+    updateBoundary();
+
+    return changed;
+}
+
+void ProjectCatalog::select(std::vector<size_t> &ids,
+                            const Aabbd &window) const
+{
+    ids.clear();
+
+    for (size_t i = 0; i < entries_.size(); i++)
+    {
+        if (entries_[i].valid() && entries_[i].boundary.intersects(window))
+        {
+            ids.push_back(i);
+        }
+    }
+}
+
+void ProjectCatalog::updateBoundary()
+{
+    double min[3] = {0, 0, 0};
+    double max[3] = {0, 0, 0};
+    bool empty = true;
+
+    for (size_t i = 0; i < entries_.size(); i++)
+    {
+        if (!entries_[i].valid())
+        {
+            continue;
+        }
+
+        const Aabbd &box = entries_[i].boundary;
+        for (size_t k = 0; k < 3; k++)
+        {
+            if (empty || box.min(k) < min[k])
+            {
+                min[k] = box.min(k);
+            }
+
+            if (empty || box.max(k) > max[k])
+            {
+                max[k] = box.max(k);
+            }
+        }
+        empty = false;
+    }
+
+    boundary_.set(min[0], min[1], min[2], max[0], max[1], max[2]);
+}
@@ -0,0 +1,103 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file ProjectCatalog.hpp
+*/
+
+#ifndef PROJECT_CATALOG_HPP
+#define PROJECT_CATALOG_HPP
+
+#include <Aabb.hpp>
+#include <Json.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+/** Project Catalog.
+
+    Caches header summaries of all project point cloud files in a sidecar
+    file next to the project file. Each summary has a fingerprint made
+    of file size and modification time. When a project is opened, only
+    files with changed fingerprint are opened, in parallel, so projects
+    with thousands of tiles open without reading their headers.
+
+    The sidecar is a chunk file with a single 'PCAT' chunk which contains
+    the catalog in CBOR encoding.
+*/
+class ProjectCatalog
+{
+public:
+    static const uint32_t CHUNK_ID_CATALOG;
+
+    /** Header summary of one file. */
+    struct Entry
+    {
+        std::string path;
+
+        // fingerprint
+        uint64_t size;
+        int64_t mtime_sec;
+        int64_t mtime_nsec;
+
+        // summary
+        Aabbd boundary;
+        uint64_t number_of_point_records;
+        uint8_t point_data_record_format;
+        uint8_t version_major;
+        uint8_t version_minor;
+        bool compressed;
+        std::string wkt;
+        std::string error;
+
+        Entry();
+
+        bool valid() const { return error.empty(); }
+        std::string crs() const;
+
+        void read(const Json &in);
+        Json &write(Json &out) const;
+    };
+
+    ProjectCatalog();
+    ~ProjectCatalog();
+
+    void clear();
+
+    void read(const std::string &path);
+    void write(const std::string &path) const;
+
+    bool refresh(const std::vector<std::string> &paths, ThreadPool &pool);
+
+    size_t size() const { return entries_.size(); }
+    const Entry &getEntry(size_t i) const { return entries_[i]; }
+
+    const Aabbd &boundary() const { return boundary_; }
+    void select(std::vector<size_t> &ids, const Aabbd &window) const;
+
+protected:
+    std::vector<Entry> entries_;
+    Aabbd boundary_;
+
+    void updateBoundary();
+};
+
+#endif /* PROJECT_CATALOG_HPP */
@@ -22,7 +22,6 @@
 */
 
 #include <Error.hpp>
-#include <LasFile.hpp>
 #include <ProjectFile.hpp>
 #include <filesystem>
 #include <iostream>
@@ -51,9 +50,7 @@ void ProjectFile::read(const Json &json)
 
     fileName = fsPath.filename().string();
 
-    // Data file
-    // LasFile las;
-    // las.open(file.fileName);
+    // Header summary of the data file is cached by ProjectCatalog
 
     // Override timestamp
     if (json.containsString("timestamp"))
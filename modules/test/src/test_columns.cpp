@@ -0,0 +1,132 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file test_columns.cpp
+*/
+
+#include <ChunkFile.hpp>
+#include <Database.hpp>
+#include <Error.hpp>
+#include <GroundFilter.hpp>
+#include <LasFile.hpp>
+#include <NormalEstimation.hpp>
+#include <SpatialIndex.hpp>
+#include <ThreadPool.hpp>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+/** Odd number of points leaves 1-byte columns with odd length. */
+static const size_t TEST_COLUMNS_SIZE = 1001;
+
+/** Write terrain points with a few points above the ground. */
+static void test_columns_las(const std::string &path)
+{
+    LasFile::Header hdr;
+    std::memset(&hdr, 0, sizeof(hdr));
+    hdr.version_major = 1;
+    hdr.version_minor = 2;
+    hdr.point_data_record_format = 1;
+    hdr.x_scale_factor = 0.001;
+    hdr.y_scale_factor = 0.001;
+    hdr.z_scale_factor = 0.001;
+
+    LasFile::Columns columns;
+    columns.resize(TEST_COLUMNS_SIZE, 0);
+    for (size_t i = 0; i < TEST_COLUMNS_SIZE; i++)
+    {
+        double x = static_cast<double>(i % 31) * 0.5;
+        double y = static_cast<double>(i / 31) * 0.5;
+        double z = 0.1 * std::sin(x) + ((i % 17 == 0) ? 5.0 : 0.0);
+
+        columns.x[i] = static_cast<int32_t>(std::lround(x * 1000.0));
+        columns.y[i] = static_cast<int32_t>(std::lround(y * 1000.0));
+        columns.z[i] = static_cast<int32_t>(std::lround(z * 1000.0));
+        columns.return_number[i] = 1;
+        columns.number_of_returns[i] = 1;
+        columns.classification[i] = GroundFilter::CLASS_UNCLASSIFIED;
+    }
+
+    LasFile las;
+    las.create(path, hdr);
+    las.write(columns);
+    las.close();
+}
+
+/** Data of all chunks with extended header must be 8 byte aligned. */
+static void test_columns_aligned(const ChunkFile &file)
+{
+    for (size_t id = 0; id < file.getEntrySize(); id++)
+    {
+        ChunkFile::Chunk c;
+        const uint8_t *data = file.map(id, c);
+        if (c.header_lenght >= ChunkFile::CHUNK_HEADER_EXTENDED_SIZE &&
+            reinterpret_cast<uintptr_t>(data) % 8 != 0)
+        {
+            THROW("Chunk " + std::to_string(id) + " is not aligned");
+        }
+    }
+}
+
+int main()
+{
+    const std::string lasPath = "test_columns.las";
+    const std::string dbPath = "test_columns.db";
+
+    try
+    {
+        test_columns_las(lasPath);
+        SpatialIndex::create(dbPath, lasPath, 2);
+
+        // Normals are written after a 1-byte classification column
+        ThreadPool pool;
+        Database db;
+        db.open(dbPath);
+
+        GroundFilter ground;
+        ground.run(db, pool);
+
+        NormalEstimation normals;
+        normals.run(db, pool);
+
+        const ChunkFile &file = db.getFile();
+        test_columns_aligned(file);
+
+        size_t id =
+            db.findColumn(Database::CHUNK_ID_NORMAL, Database::NORMAL_SIZE);
+        ChunkView<uint64_t> column = file.view<uint64_t>(id);
+        if (column.size() != TEST_COLUMNS_SIZE)
+        {
+            THROW("Invalid size of normal column");
+        }
+
+        db.close();
+        (void)std::remove(dbPath.c_str());
+        (void)std::remove(lasPath.c_str());
+    }
+    catch (std::exception &e)
+    {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,171 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file test_transform.cpp
+*/
+
+#include <Cpu.hpp>
+#include <Error.hpp>
+#include <LasTransform.hpp>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+/** Record sizes with and without room for 16 byte vector loads. */
+static const size_t TEST_TRANSFORM_STRIDE[] = {12, 20, 34};
+
+/** Batch sizes cover empty batches, vector tails and long runs. */
+static const size_t TEST_TRANSFORM_COUNT[] =
+    {0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 1001};
+
+/** Transform to absolute coordinates in double precision. */
+static void test_transform_run(double *xyz,
+                               const std::vector<uint8_t> &buffer,
+                               size_t n,
+                               size_t stride,
+                               const double *scale,
+                               const double *offset,
+                               const double *,
+                               LasTransformKernel kernel)
+{
+    lasTransform(xyz, buffer.data(), n, stride, scale, offset, kernel);
+}
+
+/** Transform to coordinates relative to origin in float precision. */
+static void test_transform_run(float *xyz,
+                               const std::vector<uint8_t> &buffer,
+                               size_t n,
+                               size_t stride,
+                               const double *scale,
+                               const double *offset,
+                               const double *origin,
+                               LasTransformKernel kernel)
+{
+    lasTransform(xyz, buffer.data(), n, stride, scale, offset, origin, kernel);
+}
+
+/** Compare output of one kernel with the scalar kernel. */
+template <class T>
+static void test_transform_compare(const std::vector<uint8_t> &buffer,
+                                   size_t n,
+                                   size_t stride,
+                                   const double *scale,
+                                   const double *offset,
+                                   const double *origin,
+                                   LasTransformKernel kernel)
+{
+    std::vector<T> expected(3 * n + 1);
+    std::vector<T> result(3 * n + 1);
+
+    test_transform_run(expected.data(),
+                       buffer,
+                       n,
+                       stride,
+                       scale,
+                       offset,
+                       origin,
+                       LAS_TRANSFORM_SCALAR);
+    test_transform_run(result.data(),
+                       buffer,
+                       n,
+                       stride,
+                       scale,
+                       offset,
+                       origin,
+                       kernel);
+
+    if (std::memcmp(expected.data(), result.data(), 3 * n * sizeof(T)) != 0)
+    {
+        THROW("Kernel " + std::to_string(kernel) + " differs from scalar" +
+              " for n " + std::to_string(n) + " stride " +
+              std::to_string(stride));
+    }
+}
+
+/** Run all batch sizes and record sizes with one kernel. */
+static void test_transform_kernel(LasTransformKernel kernel)
+{
+    // Scale factors and offsets are not exact in binary, so any fused
+    // multiply-add rounds differently from separate operations.
+    const double scale[3] = {0.001, 0.01, 0.00025};
+    const double offset[3] = {-654321.987, 1234567.891, 311.3};
+    const double origin[3] = {-654000.5, 1234600.25, 300.125};
+
+    std::mt19937 gen(2020);
+    std::uniform_int_distribution<uint32_t> dist;
+
+    for (size_t stride : TEST_TRANSFORM_STRIDE)
+    {
+        for (size_t n : TEST_TRANSFORM_COUNT)
+        {
+            std::vector<uint8_t> buffer(n * stride + 1);
+            for (size_t i = 0; i < buffer.size(); i++)
+            {
+                buffer[i] = static_cast<uint8_t>(dist(gen));
+            }
+
+            test_transform_compare<double>(buffer,
+                                           n,
+                                           stride,
+                                           scale,
+                                           offset,
+                                           origin,
+                                           kernel);
+            test_transform_compare<float>(buffer,
+                                          n,
+                                          stride,
+                                          scale,
+                                          offset,
+                                          origin,
+                                          kernel);
+        }
+    }
+}
+
+int main()
+{
+    try
+    {
+        test_transform_kernel(LAS_TRANSFORM_SSE2);
+
+        // Unsupported kernels fall back to scalar, so they are still run
+        if (!cpuSupportsAvx2())
+        {
+            std::cout << "AVX2 is not supported, tested as scalar"
+                      << std::endl;
+        }
+        test_transform_kernel(LAS_TRANSFORM_AVX2);
+
+        if (!cpuSupportsAvx512())
+        {
+            std::cout << "AVX-512 is not supported, tested as scalar"
+                      << std::endl;
+        }
+        test_transform_kernel(LAS_TRANSFORM_AVX512);
+    }
+    catch (std::exception &e)
+    {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -48,7 +48,7 @@ int main(int argc, char *argv[])
         las.open(filename);
 
         Json obj;
-        std::cout << las.header.serialize(obj).serialize() << std::endl;
+        std::cout << las.serialize(obj).serialize() << std::endl;
     }
     catch (std::exception &e)
     {
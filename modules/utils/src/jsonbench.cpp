@@ -0,0 +1,300 @@
+/*
+    Copyright 2020 VUKOZ
+
+    This file is part of 3D Forest.
+
+    3D Forest is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    3D Forest is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with 3D Forest.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+    @file jsonbench.cpp
+
+    Compares speed of Json::deserialize() with the state machine parser
+    which it replaced. The old parser is copied below, it only creates
+    values through the public interface of Json.
+*/
+
+#include <Json.hpp>
+#include <Time.hpp>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+/** Parser of Json before the recursive descent parser. */
+static void jsonbench_legacy(Json &obj, const char *in, size_t n, size_t &i)
+{
+    size_t str_start = 0;
+    size_t str_len;
+    size_t array_index = 0;
+    std::string str;
+
+    enum State
+    {
+        STATE_VALUE,
+        STATE_OBJECT,
+        STATE_OBJECT_PAIR,
+        STATE_ARRAY,
+        STATE_STRING,
+        STATE_STRING_NAME,
+        STATE_STRING_VALUE,
+        STATE_NUMBER,
+        STATE_TYPE
+    };
+    int state = STATE_VALUE;
+    int next = STATE_STRING_VALUE;
+
+    while (i < n)
+    {
+        switch (state)
+        {
+            case STATE_VALUE:
+                if (in[i] == '{')
+                {
+                    obj.deserialize("{}", 2);
+                    state = STATE_OBJECT;
+                }
+                else if (in[i] == '[')
+                {
+                    obj.deserialize("[]", 2);
+                    state = STATE_ARRAY;
+                    array_index = 0;
+                }
+                else if (in[i] == '\"')
+                {
+                    str_start = i + 1;
+                    state = STATE_STRING;
+                    next = STATE_STRING_VALUE;
+                }
+                else if (in[i] == '-' || (in[i] > 47 && in[i] < 58))
+                {
+                    str_start = i;
+                    state = STATE_NUMBER;
+                }
+                else if (in[i] > 96 && in[i] < 123)
+                {
+                    str_start = i;
+                    state = STATE_TYPE;
+                }
+                break;
+
+            case STATE_OBJECT:
+                if (in[i] == '\"')
+                {
+                    str_start = i + 1;
+                    state = STATE_STRING;
+                    next = STATE_STRING_NAME;
+                }
+                else if (in[i] == '}')
+                {
+                    i++;
+                    return;
+                }
+                break;
+
+            case STATE_STRING_NAME:
+                if (in[i] == ':')
+                {
+                    state = STATE_OBJECT_PAIR;
+                }
+                break;
+
+            case STATE_OBJECT_PAIR:
+                // parse object pair value
+                jsonbench_legacy(obj[str], in, n, i);
+                i--;
+                state = STATE_OBJECT;
+                break;
+
+            case STATE_STRING:
+                if (in[i] == '\"')
+                {
+                    str_len = i - str_start;
+                    str.resize(str_len);
+                    for (size_t j = 0; j < str_len; j++)
+                    {
+                        str[j] = in[str_start + j];
+                    }
+                    state = next;
+                }
+                break;
+
+            case STATE_STRING_VALUE:
+                obj = str;
+                return;
+
+            case STATE_NUMBER:
+                if (!(in[i] == '.' || (in[i] > 47 && in[i] < 58)))
+                {
+                    str_len = i - str_start;
+                    str.resize(str_len);
+                    for (size_t j = 0; j < str_len; j++)
+                    {
+                        str[j] = in[str_start + j];
+                    }
+                    obj = std::stod(str);
+                    return;
+                }
+                break;
+
+            case STATE_ARRAY:
+                if (in[i] > 32 && in[i] != ']')
+                {
+                    // parse next array element
+                    jsonbench_legacy(obj[array_index], in, n, i);
+                    array_index++;
+                }
+
+                if (in[i] == ']')
+                {
+                    i++;
+                    return;
+                }
+                break;
+
+            case STATE_TYPE:
+                if (!(in[i] > 96 && in[i] < 123))
+                {
+                    // Literal is valid input of the current parser
+                    obj.deserialize(in + str_start, i - str_start);
+                    return;
+                }
+                break;
+
+            default:
+                break;
+        }
+
+        i++;
+    }
+}
+
+/** Create document with records similar to database metadata. */
+static std::string jsonbench_document(size_t nrecords)
+{
+    Json doc;
+    for (size_t r = 0; r < nrecords; r++)
+    {
+        Json &record = doc["files"][r];
+        double x = static_cast<double>(r % 1000) * 0.25;
+        record["path"] = "tile_" + std::to_string(r) + ".las";
+        record["points"] = static_cast<uint64_t>(r * 1013);
+        record["min"] = std::vector<double>{x, -x, 0.125};
+        record["max"] = std::vector<double>{x + 100.5, 100.5 - x, 30.75};
+        record["scale"] = std::vector<double>{0.001, 0.001, 0.001};
+        record["indexed"].deserialize((r % 2 == 0) ? "true" : "false");
+    }
+    return doc.serialize();
+}
+
+int main(int argc, char *argv[])
+{
+    const char *filename = nullptr;
+    size_t nrecords = 10000;
+    size_t repeat = 10;
+
+    for (int opt = 1; opt < argc; opt++)
+    {
+        if (strcmp(argv[opt], "-i") == 0)
+        {
+            opt++;
+            if (opt < argc)
+            {
+                filename = argv[opt];
+            }
+        }
+        else if (strcmp(argv[opt], "-n") == 0)
+        {
+            opt++;
+            if (opt < argc)
+            {
+                nrecords = std::stoul(argv[opt]);
+            }
+        }
+        else if (strcmp(argv[opt], "-r") == 0)
+        {
+            opt++;
+            if (opt < argc)
+            {
+                repeat = std::stoul(argv[opt]);
+            }
+        }
+    }
+
+    try
+    {
+        std::string text;
+        if (filename)
+        {
+            // The old parser does not handle escape sequences and numbers
+            // with exponent, results of such input are not equal
+            Json doc;
+            doc.read(filename);
+            text = doc.serialize();
+        }
+        else
+        {
+            text = jsonbench_document(nrecords);
+        }
+
+        // Best time of all repeats
+        double legacyTime = 0;
+        double currentTime = 0;
+        Json legacy;
+        Json current;
+
+        for (size_t r = 0; r < repeat; r++)
+        {
+            double t0 = getRealTime();
+            legacy = Json();
+            size_t i = 0;
+            jsonbench_legacy(legacy, text.c_str(), text.size(), i);
+
+            double t1 = getRealTime();
+            current = Json();
+            current.deserialize(text);
+
+            double t2 = getRealTime();
+            if (r == 0 || t1 - t0 < legacyTime)
+            {
+                legacyTime = t1 - t0;
+            }
+            if (r == 0 || t2 - t1 < currentTime)
+            {
+                currentTime = t2 - t1;
+            }
+        }
+
+        double mbyte = static_cast<double>(text.size()) / 1048576.0;
+
+        Json obj;
+        obj["bytes"] = static_cast<uint64_t>(text.size());
+        obj["legacy_ms"] = legacyTime * 1000.0;
+        obj["current_ms"] = currentTime * 1000.0;
+        obj["legacy_mb_s"] = mbyte / legacyTime;
+        obj["current_mb_s"] = mbyte / currentTime;
+        obj["speedup"] = legacyTime / currentTime;
+        obj["equal"].deserialize(legacy.serialize(0) == current.serialize(0)
+                                     ? "true"
+                                     : "false");
+        std::cout << obj.serialize() << std::endl;
+    }
+    catch (std::exception &e)
+    {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
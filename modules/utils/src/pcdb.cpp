@@ -22,18 +22,49 @@
 */
 
 #include <Aabb.hpp>
+#include <CanopyModel.hpp>
+#include <ChunkFile.hpp>
+#include <Clustering.hpp>
+#include <Database.hpp>
+#include <DbhEstimation.hpp>
 #include <Error.hpp>
+#include <GroundFilter.hpp>
+#include <HeightAboveGround.hpp>
+#include <JsonWriter.hpp>
+#include <NormalEstimation.hpp>
+#include <OctreeIndex.hpp>
+#include <OutlierFilter.hpp>
+#include <RasterFile.hpp>
 #include <SpatialIndex.hpp>
+#include <TerrainModel.hpp>
+#include <ThreadPool.hpp>
+#include <TreeSegmentation.hpp>
+#include <VoxelFilter.hpp>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <vector>
 
 enum Command
 {
     COMMAND_NONE,
     COMMAND_CREATE_INDEX,
     COMMAND_PRINT,
-    COMMAND_SELECT
+    COMMAND_SELECT,
+    COMMAND_VERIFY,
+    COMMAND_NODES,
+    COMMAND_APPEND,
+    COMMAND_COMPACT,
+    COMMAND_GROUND,
+    COMMAND_TERRAIN,
+    COMMAND_HEIGHT,
+    COMMAND_CANOPY,
+    COMMAND_VOXEL,
+    COMMAND_OUTLIERS,
+    COMMAND_NORMALS,
+    COMMAND_TREES,
+    COMMAND_DBH,
+    COMMAND_CLUSTERS
 };
 
 void getarg(size_t *v, int &opt, int argc, char *argv[])
@@ -64,15 +95,292 @@ void getarg(const char **v, int &opt, int argc, char *argv[])
 }
 
 void cmd_create_index(const char *filename_out,
-                      const char *filename_in,
-                      size_t maxlevel)
+                      const std::vector<std::string> &filenames_in,
+                      size_t maxlevel,
+                      const Aabbd *boundary)
+{
+    if ((!filename_out) || filenames_in.empty())
+    {
+        THROW("Invalid arguments");
+    }
+
+    if (boundary)
+    {
+        SpatialIndex::create(filename_out, filenames_in, maxlevel, *boundary);
+    }
+    else
+    {
+        SpatialIndex::create(filename_out, filenames_in, maxlevel);
+    }
+}
+
+void cmd_append(const char *filename_out,
+                const std::vector<std::string> &filenames_in)
+{
+    if ((!filename_out) || filenames_in.empty())
+    {
+        THROW("Invalid arguments");
+    }
+
+    SpatialIndex::append(filename_out, filenames_in);
+}
+
+void cmd_compact(const char *filename_in)
+{
+    if (!filename_in)
+    {
+        THROW("Invalid arguments");
+    }
+
+    SpatialIndex::compact(filename_in);
+}
+
+void cmd_ground(const char *filename_in)
+{
+    if (!filename_in)
+    {
+        THROW("Invalid arguments");
+    }
+
+    Database db;
+    db.open(filename_in);
+
+    ThreadPool pool;
+    GroundFilter filter;
+    filter.run(db, pool);
+
+    // Count classes from the new column
+    size_t id = db.findColumn(Database::CHUNK_ID_CLASSIFICATION, 1);
+    ChunkView<uint8_t> column = db.getFile().view<uint8_t>(id);
+    uint64_t nground = 0;
+    for (size_t i = 0; i < column.size(); i++)
+    {
+        if (column[i] == GroundFilter::CLASS_GROUND)
+        {
+            nground++;
+        }
+    }
+
+    Json out;
+    out["points"] = db.getPointSize();
+    out["ground"] = nground;
+    std::cout << out.serialize() << std::endl;
+}
+
+void cmd_outliers(const char *filename_in, double radius)
+{
+    if (!filename_in)
+    {
+        THROW("Invalid arguments");
+    }
+
+    Database db;
+    db.open(filename_in);
+
+    // Radius filter is used when the radius is given
+    ThreadPool pool;
+    OutlierFilter filter;
+    if (radius > 0)
+    {
+        filter.method = OutlierFilter::METHOD_RADIUS;
+        filter.radius = radius;
+    }
+    filter.run(db, pool);
+
+    size_t id = db.findColumn(Database::CHUNK_ID_CLASSIFICATION, 1);
+    ChunkView<uint8_t> column = db.getFile().view<uint8_t>(id);
+    uint64_t nnoise = 0;
+    for (size_t i = 0; i < column.size(); i++)
+    {
+        if (GroundFilter::isNoise(column[i]))
+        {
+            nnoise++;
+        }
+    }
+
+    Json out;
+    out["points"] = db.getPointSize();
+    out["noise"] = nnoise;
+    std::cout << out.serialize() << std::endl;
+}
+
+void cmd_normals(const char *filename_in, double radius)
+{
+    if (!filename_in)
+    {
+        THROW("Invalid arguments");
+    }
+
+    Database db;
+    db.open(filename_in);
+
+    // Radius neighbourhood is used when the radius is given
+    ThreadPool pool;
+    NormalEstimation normals;
+    normals.radius = radius;
+    normals.run(db, pool);
+
+    size_t id = db.findColumn(Database::CHUNK_ID_NORMAL, Database::NORMAL_SIZE);
+    ChunkView<uint64_t> column = db.getFile().view<uint64_t>(id);
+    uint64_t nnormals = 0;
+    for (size_t i = 0; i < column.size(); i++)
+    {
+        // Normal is zero if it is unknown
+        if ((column[i] & 0xFFFFFFFFFFFFULL) != 0)
+        {
+            nnormals++;
+        }
+    }
+
+    Json out;
+    out["points"] = db.getPointSize();
+    out["normals"] = nnormals;
+    std::cout << out.serialize() << std::endl;
+}
+
+void cmd_terrain(const char *filename_out, const char *filename_in)
 {
     if ((!filename_out) || (!filename_in))
     {
         THROW("Invalid arguments");
     }
 
-    SpatialIndex::create(filename_out, filename_in, maxlevel);
+    Database db;
+    db.open(filename_in);
+
+    ThreadPool pool;
+    TerrainModel dtm;
+    dtm.run(db, filename_out, pool);
+}
+
+void cmd_height(const std::vector<std::string> &filenames_in)
+{
+    if (filenames_in.size() != 2)
+    {
+        THROW("Invalid arguments");
+    }
+
+    Database db;
+    db.open(filenames_in[0]);
+
+    ThreadPool pool;
+    HeightAboveGround hag;
+    hag.run(db, filenames_in[1], pool);
+}
+
+void cmd_canopy(const char *filename_out, const char *filename_in)
+{
+    if ((!filename_out) || (!filename_in))
+    {
+        THROW("Invalid arguments");
+    }
+
+    Database db;
+    db.open(filename_in);
+
+    ThreadPool pool;
+    CanopyModel chm;
+    chm.run(db, filename_out, pool);
+}
+
+void cmd_voxel(const char *filename_out,
+               const char *filename_in,
+               double voxelSize)
+{
+    if ((!filename_out) || (!filename_in))
+    {
+        THROW("Invalid arguments");
+    }
+
+    Database db;
+    db.open(filename_in);
+
+    ThreadPool pool;
+    VoxelFilter filter;
+    filter.voxelSize = voxelSize;
+    filter.run(db, filename_out, pool);
+}
+
+void cmd_trees(const std::vector<std::string> &filenames_in)
+{
+    if (filenames_in.size() != 2)
+    {
+        THROW("Invalid arguments");
+    }
+
+    Database db;
+    db.open(filenames_in[0]);
+
+    ThreadPool pool;
+    TreeSegmentation segmentation;
+    size_t ntrees = segmentation.run(db, filenames_in[1], pool);
+
+    Json out;
+    out["points"] = db.getPointSize();
+    out["trees"] = ntrees;
+    std::cout << out.serialize() << std::endl;
+}
+
+void cmd_dbh(const char *filename_in)
+{
+    if (!filename_in)
+    {
+        THROW("Invalid arguments");
+    }
+
+    Database db;
+    db.open(filename_in);
+
+    ThreadPool pool;
+    DbhEstimation dbh;
+    std::vector<DbhEstimation::Stem> stems;
+    dbh.run(stems, db, pool);
+
+    Json out;
+    for (size_t i = 0; i < stems.size(); i++)
+    {
+        stems[i].serialize(out["stems"][i]);
+    }
+    std::cout << out.serialize() << std::endl;
+}
+
+void cmd_clusters(const char *filename_in, double voxelSize, double radius)
+{
+    if (!filename_in)
+    {
+        THROW("Invalid arguments");
+    }
+
+    Database db;
+    db.open(filename_in);
+
+    // DBSCAN is used when the radius is given
+    ThreadPool pool;
+    Clustering clustering;
+    clustering.voxelSize = voxelSize;
+    if (radius > 0)
+    {
+        clustering.method = Clustering::METHOD_DBSCAN;
+        clustering.distance = radius;
+    }
+    size_t nclusters = clustering.run(db, pool);
+
+    size_t id = db.findColumn(Database::CHUNK_ID_LABEL, sizeof(uint32_t));
+    ChunkView<uint32_t> column = db.getFile().view<uint32_t>(id);
+    uint64_t nclustered = 0;
+    for (size_t i = 0; i < column.size(); i++)
+    {
+        if (column[i] != 0)
+        {
+            nclustered++;
+        }
+    }
+
+    Json out;
+    out["points"] = db.getPointSize();
+    out["clusters"] = nclusters;
+    out["clustered"] = nclustered;
+    std::cout << out.serialize() << std::endl;
 }
 
 void cmd_print(const char *filename_in)
@@ -81,6 +389,96 @@ void cmd_print(const char *filename_in)
     {
         THROW("Invalid arguments");
     }
+
+    ChunkFile file;
+    file.open(filename_in, "r");
+
+    Json out;
+    if (file.hasDirectory())
+    {
+        for (size_t i = 0; i < file.getEntrySize(); i++)
+        {
+            file.getEntry(i).serialize(out["chunks"][i]);
+        }
+
+        size_t id = file.findEntry(SpatialIndex::CHUNK_ID_METADATA);
+        if (id == file.getEntrySize())
+        {
+            id = file.findEntry(RasterFile::CHUNK_ID_METADATA);
+        }
+        if (id < file.getEntrySize())
+        {
+            file.readJson(id, out["metadata"]);
+        }
+    }
+    else
+    {
+        // Walk chunk headers
+        ChunkFile::Chunk chunk;
+        size_t i = 0;
+        while (!file.eof())
+        {
+            uint64_t offset = file.offset();
+            file.read(chunk);
+            chunk.serialize(out["chunks"][i])["offset"] = offset;
+            file.seek(offset + chunk.total_length);
+            i++;
+        }
+    }
+
+    std::cout << out.serialize() << std::endl;
+
+    file.close();
+}
+
+void cmd_verify(const char *filename_in)
+{
+    if (!filename_in)
+    {
+        THROW("Invalid arguments");
+    }
+
+    ChunkFile file;
+    file.open(filename_in, "r");
+
+    ThreadPool pool;
+    std::vector<ChunkFile::Entry> failed;
+    bool ok = file.verify(failed, pool);
+    file.close();
+
+    if (!ok)
+    {
+        Json out;
+        for (size_t i = 0; i < failed.size(); i++)
+        {
+            failed[i].serialize(out["failed"][i]);
+        }
+        std::cout << out.serialize() << std::endl;
+
+        THROW("Verification failed");
+    }
+}
+
+void cmd_nodes(const char *filename_out, const char *filename_in)
+{
+    if ((!filename_out) || (!filename_in))
+    {
+        THROW("Invalid arguments");
+    }
+
+    ChunkFile file;
+    file.open(filename_in, "rm");
+
+    OctreeIndex index;
+    index.read(file);
+
+    // Stream all index nodes to the output file
+    JsonWriter out;
+    out.create(filename_out);
+    index.serialize(out);
+    out.close();
+
+    file.close();
 }
 
 void cmd_select(const char *filename_in, const Aabbd &window)
@@ -90,17 +488,70 @@ void cmd_select(const char *filename_in, const Aabbd &window)
         THROW("Invalid arguments");
     }
 
-    (void)window;
+    // The index is used directly from the mapped file
+    ChunkFile file;
+    file.open(filename_in, "rm");
+
+    OctreeIndex index;
+    index.read(file);
+
+    std::vector<OctreeIndex::Cell> cells;
+    index.select(cells, window);
+
+    Json out;
+    uint64_t npoints = 0;
+    size_t n = 0;
+    size_t segment = 0;
+    size_t id = file.findEntry(SpatialIndex::CHUNK_ID_SEGMENT_INDEX);
+
+    // Base index is followed by indices of appended segments
+    while (true)
+    {
+        for (size_t i = 0; i < cells.size(); i++)
+        {
+            Json &cell = out["cells"][n++];
+            cell["code"] = cells[i].code_;
+            cell["from"] = cells[i].from_;
+            cell["n"] = cells[i].n_;
+            cell["inside"] = static_cast<uint32_t>(cells[i].inside_);
+            if (segment > 0)
+            {
+                cell["segment"] = segment;
+            }
+            npoints += cells[i].n_;
+        }
+
+        if (id == file.getEntrySize())
+        {
+            break;
+        }
+
+        OctreeIndex segmentIndex;
+        segmentIndex.read(file, id);
+        cells.clear();
+        segmentIndex.select(cells, window);
+        segment++;
+        id = file.findEntry(SpatialIndex::CHUNK_ID_SEGMENT_INDEX, id + 1);
+    }
+    out["points"] = npoints;
+
+    std::cout << out.serialize() << std::endl;
+
+    file.close();
 }
 
 int main(int argc, char *argv[])
 {
     int command = COMMAND_NONE;
     size_t maxlevel = 2;
+    double voxelSize = 0.1;
+    double radius = 0;
     double wx1 = 0, wy1 = 0, wz1 = 0, wx2 = 0, wy2 = 0, wz2 = 0;
+    bool useBoundary = false;
     Aabbd window;
     const char *filename_out = nullptr;
     const char *filename_in = nullptr;
+    std::vector<std::string> filenames_in;
 
     for (int opt = 1; opt < argc; opt++)
     {
@@ -116,13 +567,87 @@ int main(int argc, char *argv[])
         {
             command = COMMAND_SELECT;
         }
+        else if (strcmp(argv[opt], "-v") == 0)
+        {
+            command = COMMAND_VERIFY;
+        }
+        else if (strcmp(argv[opt], "-n") == 0)
+        {
+            command = COMMAND_NODES;
+        }
+        else if (strcmp(argv[opt], "-a") == 0)
+        {
+            command = COMMAND_APPEND;
+        }
+        else if (strcmp(argv[opt], "-c") == 0)
+        {
+            command = COMMAND_COMPACT;
+        }
+        else if (strcmp(argv[opt], "-g") == 0)
+        {
+            command = COMMAND_GROUND;
+        }
+        else if (strcmp(argv[opt], "-r") == 0)
+        {
+            command = COMMAND_TERRAIN;
+        }
+        else if (strcmp(argv[opt], "-z") == 0)
+        {
+            command = COMMAND_HEIGHT;
+        }
+        else if (strcmp(argv[opt], "-m") == 0)
+        {
+            command = COMMAND_CANOPY;
+        }
+        else if (strcmp(argv[opt], "-w") == 0)
+        {
+            command = COMMAND_VOXEL;
+        }
+        else if (strcmp(argv[opt], "-u") == 0)
+        {
+            command = COMMAND_OUTLIERS;
+        }
+        else if (strcmp(argv[opt], "-f") == 0)
+        {
+            command = COMMAND_NORMALS;
+        }
+        else if (strcmp(argv[opt], "-k") == 0)
+        {
+            command = COMMAND_TREES;
+        }
+        else if (strcmp(argv[opt], "-d") == 0)
+        {
+            command = COMMAND_DBH;
+        }
+        else if (strcmp(argv[opt], "-q") == 0)
+        {
+            command = COMMAND_CLUSTERS;
+        }
+        else if (strcmp(argv[opt], "-b") == 0)
+        {
+            // Window is the index boundary
+            useBoundary = true;
+        }
         else if (strcmp(argv[opt], "-l") == 0)
         {
             getarg(&maxlevel, opt, argc, argv);
         }
+        else if (strcmp(argv[opt], "-e") == 0)
+        {
+            getarg(&voxelSize, opt, argc, argv);
+        }
+        else if (strcmp(argv[opt], "-t") == 0)
+        {
+            getarg(&radius, opt, argc, argv);
+        }
         else if (strcmp(argv[opt], "-i") == 0)
         {
             getarg(&filename_in, opt, argc, argv);
+            if (filename_in)
+            {
+                // Index can be created from many input files
+                filenames_in.push_back(filename_in);
+            }
         }
         else if (strcmp(argv[opt], "-o") == 0)
         {
@@ -159,7 +684,47 @@ int main(int argc, char *argv[])
         switch (command)
         {
             case COMMAND_CREATE_INDEX:
-                cmd_create_index(filename_out, filename_in, maxlevel);
+                window.set(wx1, wy1, wz1, wx2, wy2, wz2);
+                cmd_create_index(filename_out,
+                                 filenames_in,
+                                 maxlevel,
+                                 useBoundary ? &window : nullptr);
+                break;
+            case COMMAND_APPEND:
+                cmd_append(filename_out, filenames_in);
+                break;
+            case COMMAND_COMPACT:
+                cmd_compact(filename_in);
+                break;
+            case COMMAND_GROUND:
+                cmd_ground(filename_in);
+                break;
+            case COMMAND_TERRAIN:
+                cmd_terrain(filename_out, filename_in);
+                break;
+            case COMMAND_HEIGHT:
+                cmd_height(filenames_in);
+                break;
+            case COMMAND_CANOPY:
+                cmd_canopy(filename_out, filename_in);
+                break;
+            case COMMAND_VOXEL:
+                cmd_voxel(filename_out, filename_in, voxelSize);
+                break;
+            case COMMAND_OUTLIERS:
+                cmd_outliers(filename_in, radius);
+                break;
+            case COMMAND_NORMALS:
+                cmd_normals(filename_in, radius);
+                break;
+            case COMMAND_TREES:
+                cmd_trees(filenames_in);
+                break;
+            case COMMAND_DBH:
+                cmd_dbh(filename_in);
+                break;
+            case COMMAND_CLUSTERS:
+                cmd_clusters(filename_in, voxelSize, radius);
                 break;
             case COMMAND_PRINT:
                 cmd_print(filename_in);
@@ -168,6 +733,12 @@ int main(int argc, char *argv[])
                 window.set(wx1, wy1, wz1, wx2, wy2, wz2);
                 cmd_select(filename_in, window);
                 break;
+            case COMMAND_VERIFY:
+                cmd_verify(filename_in);
+                break;
+            case COMMAND_NODES:
+                cmd_nodes(filename_out, filename_in);
+                break;
             case COMMAND_NONE:
             default:
                 THROW("Unknown command");